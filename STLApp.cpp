@@ -19,6 +19,8 @@
 #include "STLApp.h"
 #include "STLWindow.h"
 
+#include <string.h>
+
 #undef  B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT          "STLoverApplication"
 
@@ -121,6 +123,11 @@ STLoverApplication::ArgvReceived(int32 argc, char** argv)
 {
 	BMessage *message = NULL;
 	for (int32 i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--benchmark") == 0) {
+			CreateWindow()->PostMessage(MSG_BENCHMARK);
+			continue;
+		}
+
 		entry_ref ref;
 		status_t err = get_ref_for_path(argv[i], &ref);
 		if (err == B_OK) {
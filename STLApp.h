@@ -62,9 +62,12 @@
 #define MSG_FILE_EXPORT_VRML			'EVRM'
 #define MSG_FILE_EXPORT_OFF				'EOFF'
 #define MSG_FILE_EXPORT_OBJ				'EOBJ'
+#define MSG_FILE_SCREENSHOT				'SSHT'
+#define MSG_FILE_SCREENSHOT_SET			'SSHS'
 #define MSG_VIEWMODE_POINTS				'PNTS'
 #define MSG_VIEWMODE_WIREFRAME			'WIRF'
 #define MSG_VIEWMODE_SOLID				'SOLD'
+#define MSG_VIEWMODE_SOLID_EDGES		'SEDG'
 #define MSG_VIEWMODE_RESETPOS			'RSPS'
 #define MSG_VIEWMODE_AXES				'AXES'
 #define MSG_VIEWMODE_AXES_PLANE			'AXPL'
@@ -79,8 +82,22 @@
 #define MSG_VIEWMODE_TOP				'VTOP'
 #define MSG_VIEWMODE_RIGHT				'VRGT'
 #define MSG_VIEWMODE_FRONT				'VFRT'
+#define MSG_VIEWMODE_ISO				'VISO'
 #define MSG_VIEWMODE_ORTHO				'VORT'
+#define MSG_VIEWMODE_DEFECTS			'VDEF'
+#define MSG_VIEWMODE_DEFECTS_DONE		'VDFR'
+#define MSG_VIEWMODE_NEXT_DEFECT		'NDEF'
+#define MSG_VIEWMODE_HULL			'VHUL'
+#define MSG_VIEWMODE_HULL_DONE		'VHLD'
+#define MSG_VIEWMODE_PARTS_DONE		'VPTD'
+#define MSG_VIEWMODE_MIN_BOX		'VMBX'
+#define MSG_VIEWMODE_SMOOTH		'VSMO'
+#define MSG_VIEWMODE_SMOOTH_DONE	'VSMD'
+#define MSG_VIEWMODE_CREASE		'VCRS'
+#define MSG_VIEWMODE_CREASE_DROP	'VCRD'
 #define MSG_TOOLS_EDIT_TITLE			'EDTI'
+#define MSG_EDIT_UNDO					'UNDO'
+#define MSG_EDIT_REDO					'REDO'
 #define MSG_TOOLS_TITLE_SET				'TIST'
 #define MSG_TOOLS_SCALE					'SCAL'
 #define MSG_TOOLS_SCALE_3				'SCL3'
@@ -88,6 +105,9 @@
 #define MSG_TOOLS_SCALE_SET_3			'SST3'
 #define MSG_TOOLS_ROTATE				'ROTA'
 #define MSG_TOOLS_ROTATE_SET			'SROT'
+#define MSG_TOOLS_ORIENT_HEIGHT			'ORHT'
+#define MSG_TOOLS_ORIENT_SUPPORT		'ORSP'
+#define MSG_TOOLS_ORIENT_DONE			'ORDN'
 #define MSG_TOOLS_MIRROR_XY				'M_XY'
 #define MSG_TOOLS_MIRROR_YZ				'M_YZ'
 #define MSG_TOOLS_MIRROR_XZ				'M_XZ'
@@ -100,9 +120,29 @@
 #define MSG_TOOLS_MOVE_MIDDLE			'MDLE'
 #define MSG_TOOLS_REPAIR				'REPR'
 #define MSG_TOOLS_REPAIR_DO				'REPD'
+#define MSG_TOOLS_REPAIR_PROGRESS		'REPP'
+#define MSG_TOOLS_REPAIR_CANCEL			'REPC'
+#define MSG_TOOLS_REPAIR_DONE			'REPF'
 #define MSG_TOOLS_MEASURE				'RLRO'
 #define MSG_TOOLS_MEASURE_DROP			'RLRC'
 #define MSG_TOOLS_MEASURE_UPDATE		'RLUP'
+#define MSG_TOOLS_MEASURE_INDEX_DONE	'RLIX'
+#define MSG_TOOLS_SECTION				'SECT'
+#define MSG_TOOLS_SECTION_DROP			'SECD'
+#define MSG_TOOLS_OVERHANG				'OVHG'
+#define MSG_TOOLS_OVERHANG_DROP			'OVHD'
+#define MSG_TOOLS_THICKNESS				'THIK'
+#define MSG_TOOLS_THICKNESS_DROP		'THKD'
+#define MSG_TOOLS_THICKNESS_DONE		'THKR'
+#define MSG_TOOLS_INTERSECTIONS			'ISEC'
+#define MSG_TOOLS_INTERSECTIONS_DROP	'ISED'
+#define MSG_TOOLS_INTERSECTIONS_DONE	'ISER'
+#define MSG_TOOLS_COMPARE				'CMPR'
+#define MSG_TOOLS_COMPARE_DROP			'CMPD'
+#define MSG_TOOLS_COMPARE_DONE			'CMPF'
+#define MSG_TOOLS_CURVATURE				'CURV'
+#define MSG_TOOLS_CURVATURE_DROP		'CURD'
+#define MSG_TOOLS_CURVATURE_DONE		'CURF'
 #define MSG_PULSE						'PULS'
 #define MSG_APPEND_REFS_RECIEVED		'APRR'
 #define MSG_INPUT_VALUE_UPDATED			'IVUP'
@@ -117,10 +157,15 @@
 #define MSG_WINDOW_CLOSED				'CWIN'
 #define MSG_FILE_OPENED					'FOOK'
 #define MSG_FILE_OPEN_FAILED			'FOER'
+#define MSG_FILE_APPENDED				'FAOK'
+#define MSG_FILE_APPEND_FAILED			'FAER'
 #define MSG_HELP_WIKI					'WIKI'
+#define MSG_BENCHMARK					'BNCH'
 
 #define FOV	30
 #define FPS_LIMIT 100
+#define BENCHMARK_LOAD_TIMEOUT 30000000
+#define MEASURE_SNAP_RADIUS 12
 
 #define TOOLBAR_ICON_SIZE 22
 #define INPUT_WINDOW_ALIGN_MARGIN 16
@@ -0,0 +1,211 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLAutoOrient.h"
+#include "STLHull.h"
+#include "STLOverhang.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <set>
+
+STLAutoOrient::STLAutoOrient(stl_file *stl, const STLHull *hull, int32 goal, float angle)
+	: fStl(stl),
+	fHull(hull),
+	fGoal(goal),
+	fLimit(STLOverhang::Limit(angle)),
+	fBedTolerance(0),
+	fRotation(1.0f),
+	fBest({ 0, 0 }),
+	fCurrent({ 0, 0 })
+{
+	if (fStl->stats.number_of_facets <= 0 || !fHull->IsValid())
+		return;
+
+	Prepare();
+
+	std::vector<glm::vec3> directions;
+	Candidates(directions);
+
+	std::vector<Score> scores(directions.size());
+	ParallelFor(directions.size(), 1, [this, &directions, &scores](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++)
+			scores[i] = Evaluate(directions[i]);
+	});
+
+	// The current orientation comes first and is only left for a
+	// clearly better one
+	size_t best = 0;
+	for (size_t i = 1; i < scores.size(); i++) {
+		if (Better(scores[i], scores[best]))
+			best = i;
+	}
+
+	fCurrent = scores[0];
+	fBest = scores[best];
+	fRotation = RotationToBottom(directions[best]);
+
+	// Only the result outlives the search
+	std::vector<glm::vec3>().swap(fNormals);
+	std::vector<float>().swap(fAreas);
+	fHull = NULL;
+}
+
+void
+STLAutoOrient::Prepare(void)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	fNormals.resize(facets);
+	fAreas.resize(facets);
+
+	// Normals are taken from the vertices, the stored ones are not
+	// always trustworthy
+	ParallelFor(facets, ORIENT_GRAIN, [this](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			const stl_vertex *v = fStl->facet_start[i].vertex;
+			glm::vec3 a(v[0].x, v[0].y, v[0].z);
+			glm::vec3 b(v[1].x, v[1].y, v[1].z);
+			glm::vec3 c(v[2].x, v[2].y, v[2].z);
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			fNormals[i] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+			fAreas[i] = length * 0.5f;
+		}
+	});
+
+	fBedTolerance = std::max(std::max(fStl->stats.size.x, fStl->stats.size.y),
+		fStl->stats.size.z) * OVERHANG_BED_TOLERANCE;
+}
+
+void
+STLAutoOrient::Candidates(std::vector<glm::vec3> &directions) const
+{
+	directions.push_back(glm::vec3(0, 0, -1));
+
+	const STLHull::Box &box = fHull->MinimumBox();
+	for (int k = 0; k < 3; k++) {
+		directions.push_back(box.axes[k]);
+		directions.push_back(-box.axes[k]);
+	}
+
+	// Resting on a hull face, largest first, one per direction cell so
+	// a flat side split into many triangles is tried once
+	struct Face {
+		float area;
+		glm::vec3 normal;
+	};
+	std::vector<Face> faces;
+	const std::vector<glm::vec3> &vertices = fHull->Vertices();
+	const std::vector<int32> &triangles = fHull->Triangles();
+	for (size_t t = 0; t < triangles.size(); t += 3) {
+		glm::vec3 a = vertices[triangles[t]];
+		glm::vec3 normal = glm::cross(vertices[triangles[t + 1]] - a, vertices[triangles[t + 2]] - a);
+		float length = glm::length(normal);
+		if (length > 0.0f)
+			faces.push_back({ length, normal / length });
+	}
+	std::stable_sort(faces.begin(), faces.end(),
+		[](const Face &a, const Face &b) { return a.area > b.area; });
+
+	std::set<uint32> keys;
+	for (size_t f = 0; f < faces.size() && keys.size() < ORIENT_FACES; f++) {
+		uint32 key = 0;
+		for (int k = 0; k < 3; k++)
+			key = key * 1024 + (uint32)lroundf((faces[f].normal[k] + 1.0f) * 511.5f);
+		if (keys.insert(key).second)
+			directions.push_back(faces[f].normal);
+	}
+
+	// Fibonacci sphere
+	float golden = M_PI * (3.0f - sqrtf(5.0f));
+	for (int32 i = 0; i < ORIENT_SAMPLES; i++) {
+		float z = 1.0f - (i + 0.5f) * 2.0f / ORIENT_SAMPLES;
+		float radius = sqrtf(std::max(0.0f, 1.0f - z * z));
+		directions.push_back(glm::vec3(radius * cosf(golden * i), radius * sinf(golden * i), z));
+	}
+}
+
+STLAutoOrient::Score
+STLAutoOrient::Evaluate(const glm::vec3 &down) const
+{
+	// Heights are measured upwards, against the down direction
+	float low = FLT_MAX;
+	float high = -FLT_MAX;
+	const std::vector<glm::vec3> &vertices = fHull->Vertices();
+	for (size_t i = 0; i < vertices.size(); i++) {
+		float height = -glm::dot(vertices[i], down);
+		low = std::min(low, height);
+		high = std::max(high, height);
+	}
+
+	float bed = low + fBedTolerance;
+	double support = 0.0;
+	int32 facets = fNormals.size();
+	for (int32 i = 0; i < facets; i++) {
+		if (glm::dot(fNormals[i], down) <= fLimit)
+			continue;
+
+		const stl_vertex *v = fStl->facet_start[i].vertex;
+		float top = -FLT_MAX;
+		for (int k = 0; k < 3; k++)
+			top = std::max(top, -(v[k].x * down.x + v[k].y * down.y + v[k].z * down.z));
+		if (top > bed)
+			support += fAreas[i];
+	}
+
+	Score score = { high - low, support };
+	return score;
+}
+
+bool
+STLAutoOrient::Better(const Score &a, const Score &b) const
+{
+	double goalA = fGoal == ORIENT_HEIGHT ? a.height : a.support;
+	double goalB = fGoal == ORIENT_HEIGHT ? b.height : b.support;
+	double otherA = fGoal == ORIENT_HEIGHT ? a.support : a.height;
+	double otherB = fGoal == ORIENT_HEIGHT ? b.support : b.height;
+
+	double tie = std::max(goalA, goalB) * ORIENT_TIE;
+	if (fabs(goalA - goalB) > tie)
+		return goalA < goalB;
+
+	return otherA < otherB - std::max(otherA, otherB) * ORIENT_TIE;
+}
+
+glm::mat3
+STLAutoOrient::RotationToBottom(const glm::vec3 &down)
+{
+	// Rodrigues' formula with the axis left unnormalized, straight down
+	// needs no turn and straight up half a turn about X
+	glm::vec3 bottom(0, 0, -1);
+	glm::vec3 axis = glm::cross(down, bottom);
+	float sine = glm::length(axis);
+	float cosine = glm::dot(down, bottom);
+	if (sine < 1.0e-6f) {
+		if (cosine > 0.0f)
+			return glm::mat3(1.0f);
+		return glm::mat3(glm::vec3(1, 0, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, -1));
+	}
+
+	glm::mat3 cross(glm::vec3(0, axis.z, -axis.y), glm::vec3(-axis.z, 0, axis.x),
+		glm::vec3(axis.y, -axis.x, 0));
+	return glm::mat3(1.0f) + cross + cross * cross * ((1.0f - cosine) / (sine * sine));
+}
@@ -0,0 +1,83 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_AUTOORIENT
+#define STLOVER_AUTOORIENT
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+class STLHull;
+
+#define ORIENT_HEIGHT		0
+#define ORIENT_SUPPORT		1
+
+#define ORIENT_FACES		256			// largest hull faces tried as the base
+#define ORIENT_SAMPLES		256			// even spread of other directions
+#define ORIENT_TIE			1.0e-3		// relative difference counted as a tie
+#define ORIENT_GRAIN		16384
+
+// Searches the rotation that lays the model down with the lowest height or
+// the least facet area needing support. The down directions tried are the
+// normals of the largest hull faces, on which the model rests flat, the
+// axes of the minimum box and an even spread over the sphere. They are
+// scored on all CPUs: the height is the hull extent along the direction,
+// the support area is counted like STLOverhang does, facets on the bed
+// left out. Ties on the goal go to the better other score.
+class STLAutoOrient {
+	public:
+		STLAutoOrient(stl_file *stl, const STLHull *hull, int32 goal, float angle);
+
+		// Turns the chosen down direction to -Z
+		const glm::mat3& Rotation(void) const { return fRotation; }
+		double Height(void) const { return fBest.height; }
+		double SupportArea(void) const { return fBest.support; }
+		double CurrentHeight(void) const { return fCurrent.height; }
+		double CurrentSupportArea(void) const { return fCurrent.support; }
+
+	private:
+		struct Score {
+			double height;
+			double support;
+		};
+
+		void Prepare(void);
+		void Candidates(std::vector<glm::vec3> &directions) const;
+		Score Evaluate(const glm::vec3 &down) const;
+		bool Better(const Score &a, const Score &b) const;
+		static glm::mat3 RotationToBottom(const glm::vec3 &down);
+
+		stl_file *fStl;
+		const STLHull *fHull;
+		int32 fGoal;
+		float fLimit;
+		float fBedTolerance;
+
+		std::vector<glm::vec3> fNormals;
+		std::vector<float> fAreas;
+
+		glm::mat3 fRotation;
+		Score fBest;
+		Score fCurrent;
+};
+
+#endif
@@ -0,0 +1,662 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "STLBVH.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BVH_BINS				12
+#define BVH_BUILD_GRAIN			16384
+#define BVH_PARALLEL_MINIMUM	65536
+
+// Barycentric slack so rays through a shared edge or vertex cannot slip
+// between the two facets to rounding
+#define BVH_EDGE_TOLERANCE	1.0e-6f
+
+// Facets this close to the nearest distance count as equally near, the
+// one facing the query point most directly wins
+#define BVH_TIE_TOLERANCE	1.0e-5f
+
+static inline float
+HalfArea(const glm::vec3 &low, const glm::vec3 &high)
+{
+	glm::vec3 size = high - low;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// Closest point on the triangle a, a + ab, a + ac, by the Voronoi region
+// of the point as in Ericson's Real-Time Collision Detection
+static glm::vec3
+ClosestOnTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &ab, const glm::vec3 &ac)
+{
+	glm::vec3 ap = p - a;
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+		return a;
+
+	glm::vec3 bp = ap - ab;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+		return a + ab;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		return a + ab * (d1 / (d1 - d3));
+
+	glm::vec3 cp = ap - ac;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+		return a + ac;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+		return a + ab + (ac - ab) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denominator = va + vb + vc;
+	if (denominator == 0.0f)
+		return a;
+
+	return a + ab * (vb / denominator) + ac * (vc / denominator);
+}
+
+STLBVH::STLBVH(stl_file *stl)
+	: fStl(stl)
+{
+	Build();
+}
+
+void
+STLBVH::Build(void)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	if (facets <= 0)
+		return;
+
+	fItems.resize(facets);
+	ParallelFor(facets, BVH_BUILD_GRAIN, [this](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			const stl_vertex *v = fStl->facet_start[i].vertex;
+			glm::vec3 a(v[0].x, v[0].y, v[0].z);
+			glm::vec3 b(v[1].x, v[1].y, v[1].z);
+			glm::vec3 c(v[2].x, v[2].y, v[2].z);
+			fItems[i].low = glm::min(glm::min(a, b), c);
+			fItems[i].high = glm::max(glm::max(a, b), c);
+			fItems[i].facet = i;
+		}
+	});
+
+	BuildRange root = {0, facets, 0, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX),
+		glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+	for (int32 i = 0; i < facets; i++) {
+		glm::vec3 center = Center(fItems[i]);
+		root.low = glm::min(root.low, fItems[i].low);
+		root.high = glm::max(root.high, fItems[i].high);
+		root.centerLow = glm::min(root.centerLow, center);
+		root.centerHigh = glm::max(root.centerHigh, center);
+	}
+
+	// A few subtrees per CPU keep the threads busy when the splits
+	// come out uneven
+	system_info info;
+	get_system_info(&info);
+	int32 parallelDepth = 0;
+	while ((1 << parallelDepth) < (int32)info.cpu_count * 4 && parallelDepth < 10)
+		parallelDepth++;
+
+	std::vector<std::pair<int32, BuildRange> > tasks;
+	fNodes.resize(1);
+	Expand(0, root, parallelDepth, tasks);
+
+	std::vector<BuildOutput> outputs(tasks.size());
+	ParallelFor(tasks.size(), 1, [this, &tasks, &outputs](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			outputs[i].nodes.resize(1);
+			BuildSubtree(outputs[i], 0, tasks[i].second);
+		}
+	});
+
+	// Subtree roots replace their placeholders, the other nodes are
+	// appended and their child and packet indices rebased
+	for (size_t i = 0; i < tasks.size(); i++) {
+		const BuildOutput &output = outputs[i];
+		int32 nodeBase = fNodes.size() - 1;
+		int32 packetBase = fPackets.size();
+		for (size_t j = 0; j < output.nodes.size(); j++) {
+			Node node = output.nodes[j];
+			node.first += node.count > 0 ? packetBase : nodeBase;
+			if (j == 0)
+				fNodes[tasks[i].first] = node;
+			else
+				fNodes.push_back(node);
+		}
+		fPackets.insert(fPackets.end(), output.packets.begin(), output.packets.end());
+		outputs[i] = BuildOutput();
+	}
+
+	std::vector<BuildItem>().swap(fItems);
+}
+
+void
+STLBVH::Expand(int32 node, const BuildRange &range, int32 parallelDepth,
+	std::vector<std::pair<int32, BuildRange> > &tasks)
+{
+	BuildRange left, right;
+	if (range.depth >= parallelDepth || range.end - range.begin < BVH_PARALLEL_MINIMUM
+		|| !Split(range, left, right)) {
+		tasks.push_back(std::make_pair(node, range));
+		return;
+	}
+
+	int32 child = fNodes.size();
+	fNodes.resize(child + 2);
+	SetBounds(fNodes[node], range);
+	fNodes[node].first = child;
+	fNodes[node].count = 0;
+
+	Expand(child, left, parallelDepth, tasks);
+	Expand(child + 1, right, parallelDepth, tasks);
+}
+
+bool
+STLBVH::Split(const BuildRange &range, BuildRange &left, BuildRange &right)
+{
+	int32 count = range.end - range.begin;
+	if (count <= BVH_LEAF_SIZE || range.depth >= BVH_MAX_DEPTH)
+		return false;
+
+	glm::vec3 extent = range.centerHigh - range.centerLow;
+	int32 axis = 0;
+	if (extent.y > extent[axis])
+		axis = 1;
+	if (extent.z > extent[axis])
+		axis = 2;
+
+	left = {range.begin, range.begin, range.depth + 1, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX),
+		glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+	right = left;
+	right.end = range.end;
+
+	if (extent[axis] > 0.0f) {
+		// Centroids are binned along the widest axis and the bin border
+		// with the lowest surface area cost becomes the split. The bins
+		// also collect the bounds, so the children need no extra pass.
+		int32 binCount[BVH_BINS] = { 0 };
+		glm::vec3 binLow[BVH_BINS], binHigh[BVH_BINS];
+		glm::vec3 binCenterLow[BVH_BINS], binCenterHigh[BVH_BINS];
+		for (int32 i = 0; i < BVH_BINS; i++) {
+			binLow[i] = binCenterLow[i] = glm::vec3(FLT_MAX);
+			binHigh[i] = binCenterHigh[i] = glm::vec3(-FLT_MAX);
+		}
+
+		float low = range.centerLow[axis];
+		float scale = BVH_BINS * 0.9999f / extent[axis];
+		auto binOf = [axis, low, scale](const BuildItem &item) {
+			return std::min((int32)((Center(item)[axis] - low) * scale), BVH_BINS - 1);
+		};
+
+		for (int32 i = range.begin; i < range.end; i++) {
+			const BuildItem &item = fItems[i];
+			glm::vec3 center = Center(item);
+			int32 bin = binOf(item);
+			binCount[bin]++;
+			binLow[bin] = glm::min(binLow[bin], item.low);
+			binHigh[bin] = glm::max(binHigh[bin], item.high);
+			binCenterLow[bin] = glm::min(binCenterLow[bin], center);
+			binCenterHigh[bin] = glm::max(binCenterHigh[bin], center);
+		}
+
+		float rightCost[BVH_BINS];
+		glm::vec3 sweepLow(FLT_MAX), sweepHigh(-FLT_MAX);
+		int32 sweepCount = 0;
+		for (int32 i = BVH_BINS - 1; i > 0; i--) {
+			sweepLow = glm::min(sweepLow, binLow[i]);
+			sweepHigh = glm::max(sweepHigh, binHigh[i]);
+			sweepCount += binCount[i];
+			rightCost[i] = sweepCount > 0 ? sweepCount * HalfArea(sweepLow, sweepHigh) : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		int32 bestBin = -1;
+		sweepLow = glm::vec3(FLT_MAX);
+		sweepHigh = glm::vec3(-FLT_MAX);
+		sweepCount = 0;
+		for (int32 i = 0; i < BVH_BINS - 1; i++) {
+			sweepLow = glm::min(sweepLow, binLow[i]);
+			sweepHigh = glm::max(sweepHigh, binHigh[i]);
+			sweepCount += binCount[i];
+			if (sweepCount == 0 || sweepCount == count)
+				continue;
+			float cost = sweepCount * HalfArea(sweepLow, sweepHigh) + rightCost[i + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestBin = i;
+			}
+		}
+
+		if (bestBin >= 0) {
+			int32 middle = std::partition(fItems.begin() + range.begin, fItems.begin() + range.end,
+				[&](const BuildItem &item) { return binOf(item) <= bestBin; }) - fItems.begin();
+
+			left.end = right.begin = middle;
+			for (int32 i = 0; i < BVH_BINS; i++) {
+				BuildRange &side = i <= bestBin ? left : right;
+				side.low = glm::min(side.low, binLow[i]);
+				side.high = glm::max(side.high, binHigh[i]);
+				side.centerLow = glm::min(side.centerLow, binCenterLow[i]);
+				side.centerHigh = glm::max(side.centerHigh, binCenterHigh[i]);
+			}
+			return true;
+		}
+	}
+
+	// Coincident centroids cannot be binned, they are split by count
+	int32 middle = range.begin + count / 2;
+	std::nth_element(fItems.begin() + range.begin, fItems.begin() + middle, fItems.begin() + range.end,
+		[axis](const BuildItem &a, const BuildItem &b) { return Center(a)[axis] < Center(b)[axis]; });
+
+	left.end = right.begin = middle;
+	for (int32 i = range.begin; i < range.end; i++) {
+		const BuildItem &item = fItems[i];
+		BuildRange &side = i < middle ? left : right;
+		side.low = glm::min(side.low, item.low);
+		side.high = glm::max(side.high, item.high);
+		side.centerLow = glm::min(side.centerLow, Center(item));
+		side.centerHigh = glm::max(side.centerHigh, Center(item));
+	}
+	return true;
+}
+
+void
+STLBVH::BuildSubtree(BuildOutput &output, int32 node, const BuildRange &range)
+{
+	SetBounds(output.nodes[node], range);
+
+	BuildRange left, right;
+	if (!Split(range, left, right)) {
+		MakeLeaf(output, node, range.begin, range.end);
+		return;
+	}
+
+	int32 child = output.nodes.size();
+	output.nodes.resize(child + 2);
+	output.nodes[node].first = child;
+	output.nodes[node].count = 0;
+
+	BuildSubtree(output, child, left);
+	BuildSubtree(output, child + 1, right);
+}
+
+void
+STLBVH::SetBounds(Node &node, const BuildRange &range)
+{
+	for (int32 i = 0; i < 3; i++) {
+		node.min[i] = range.low[i];
+		node.max[i] = range.high[i];
+	}
+}
+
+void
+STLBVH::MakeLeaf(BuildOutput &output, int32 node, int32 begin, int32 end)
+{
+	output.nodes[node].first = output.packets.size();
+	output.nodes[node].count = end - begin;
+
+	for (int32 i = begin; i < end; i += BVH_LEAF_SIZE) {
+		// Unused lanes get zero edges, which no ray can hit
+		Packet packet = {};
+		for (int32 lane = 0; lane < BVH_LEAF_SIZE; lane++) {
+			packet.facet[lane] = -1;
+			if (i + lane >= end)
+				continue;
+
+			int32 facet = fItems[i + lane].facet;
+			const stl_vertex *v = fStl->facet_start[facet].vertex;
+			packet.facet[lane] = facet;
+			packet.v0[0][lane] = v[0].x;
+			packet.v0[1][lane] = v[0].y;
+			packet.v0[2][lane] = v[0].z;
+			packet.e1[0][lane] = v[1].x - v[0].x;
+			packet.e1[1][lane] = v[1].y - v[0].y;
+			packet.e1[2][lane] = v[1].z - v[0].z;
+			packet.e2[0][lane] = v[2].x - v[0].x;
+			packet.e2[1][lane] = v[2].y - v[0].y;
+			packet.e2[2][lane] = v[2].z - v[0].z;
+		}
+		output.packets.push_back(packet);
+	}
+}
+
+void
+STLBVH::IntersectPacket(const Packet &packet, const glm::vec3 &origin,
+	const glm::vec3 &direction, float tMin, int32 ignore, float *best, int32 *facet) const
+{
+	// Moller-Trumbore against four triangles, both sides count as a hit
+#if defined(__SSE2__)
+	__m128 e1x = _mm_loadu_ps(packet.e1[0]);
+	__m128 e1y = _mm_loadu_ps(packet.e1[1]);
+	__m128 e1z = _mm_loadu_ps(packet.e1[2]);
+	__m128 e2x = _mm_loadu_ps(packet.e2[0]);
+	__m128 e2y = _mm_loadu_ps(packet.e2[1]);
+	__m128 e2z = _mm_loadu_ps(packet.e2[2]);
+	__m128 dx = _mm_set1_ps(direction.x);
+	__m128 dy = _mm_set1_ps(direction.y);
+	__m128 dz = _mm_set1_ps(direction.z);
+
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+
+	__m128 tx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_loadu_ps(packet.v0[0]));
+	__m128 ty = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_loadu_ps(packet.v0[1]));
+	__m128 tz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_loadu_ps(packet.v0[2]));
+
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+	__m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverse);
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 absDet = _mm_max_ps(det, _mm_sub_ps(zero, det));
+	__m128 hit = _mm_cmpgt_ps(absDet, _mm_set1_ps(1.0e-12f));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(u, _mm_set1_ps(-BVH_EDGE_TOLERANCE)));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(v, _mm_set1_ps(-BVH_EDGE_TOLERANCE)));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f + BVH_EDGE_TOLERANCE)));
+	hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, _mm_set1_ps(tMin)));
+	hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(*best)));
+
+	int32 mask = _mm_movemask_ps(hit);
+	if (mask == 0)
+		return;
+
+	float lanes[BVH_LEAF_SIZE];
+	_mm_storeu_ps(lanes, t);
+	for (int32 lane = 0; lane < BVH_LEAF_SIZE; lane++) {
+		if ((mask & (1 << lane)) && packet.facet[lane] != ignore && lanes[lane] < *best) {
+			*best = lanes[lane];
+			*facet = packet.facet[lane];
+		}
+	}
+#else
+	for (int32 lane = 0; lane < BVH_LEAF_SIZE; lane++) {
+		if (packet.facet[lane] < 0 || packet.facet[lane] == ignore)
+			continue;
+
+		glm::vec3 e1(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]);
+		glm::vec3 e2(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]);
+		glm::vec3 p = glm::cross(direction, e2);
+		float det = glm::dot(e1, p);
+		if (fabsf(det) <= 1.0e-12f)
+			continue;
+
+		float inverse = 1.0f / det;
+		glm::vec3 s = origin - glm::vec3(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+		float u = glm::dot(s, p) * inverse;
+		if (u < -BVH_EDGE_TOLERANCE || u > 1.0f + BVH_EDGE_TOLERANCE)
+			continue;
+
+		glm::vec3 q = glm::cross(s, e1);
+		float v = glm::dot(direction, q) * inverse;
+		if (v < -BVH_EDGE_TOLERANCE || u + v > 1.0f + BVH_EDGE_TOLERANCE)
+			continue;
+
+		float t = glm::dot(e2, q) * inverse;
+		if (t > tMin && t < *best) {
+			*best = t;
+			*facet = packet.facet[lane];
+		}
+	}
+#endif
+}
+
+bool
+STLBVH::Raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+	float tMin, float tMax, int32 ignore, float *t, int32 *facet) const
+{
+	*facet = -1;
+	if (fNodes.empty())
+		return false;
+
+	glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float best = tMax;
+
+	auto entry = [&](const Node &node, float *distance) {
+		float t1 = (node.min[0] - origin.x) * inverse.x;
+		float t2 = (node.max[0] - origin.x) * inverse.x;
+		float enter = std::min(t1, t2), leave = std::max(t1, t2);
+		t1 = (node.min[1] - origin.y) * inverse.y;
+		t2 = (node.max[1] - origin.y) * inverse.y;
+		enter = std::max(enter, std::min(t1, t2));
+		leave = std::min(leave, std::max(t1, t2));
+		t1 = (node.min[2] - origin.z) * inverse.z;
+		t2 = (node.max[2] - origin.z) * inverse.z;
+		enter = std::max(enter, std::min(t1, t2));
+		leave = std::min(leave, std::max(t1, t2));
+		*distance = enter;
+		return leave >= std::max(enter, tMin) && enter < best;
+	};
+
+	struct Entry {
+		int32 node;
+		float distance;
+	};
+	Entry stack[BVH_MAX_DEPTH * 2 + 2];
+	int32 top = 0;
+
+	float distance;
+	if (entry(fNodes[0], &distance))
+		stack[top++] = {0, distance};
+
+	while (top > 0) {
+		Entry current = stack[--top];
+		if (current.distance >= best)
+			continue;
+
+		const Node &node = fNodes[current.node];
+		if (node.count > 0) {
+			int32 packets = (node.count + BVH_LEAF_SIZE - 1) / BVH_LEAF_SIZE;
+			for (int32 i = 0; i < packets; i++)
+				IntersectPacket(fPackets[node.first + i], origin, direction, tMin, ignore, &best, facet);
+			continue;
+		}
+
+		// The nearer child goes on top so it is searched first
+		float leftDistance, rightDistance;
+		bool left = entry(fNodes[node.first], &leftDistance);
+		bool right = entry(fNodes[node.first + 1], &rightDistance);
+		if (left && right) {
+			if (leftDistance <= rightDistance) {
+				stack[top++] = {node.first + 1, rightDistance};
+				stack[top++] = {node.first, leftDistance};
+			} else {
+				stack[top++] = {node.first, leftDistance};
+				stack[top++] = {node.first + 1, rightDistance};
+			}
+		} else if (left)
+			stack[top++] = {node.first, leftDistance};
+		else if (right)
+			stack[top++] = {node.first + 1, rightDistance};
+	}
+
+	if (*facet < 0)
+		return false;
+
+	*t = best;
+	return true;
+}
+
+void
+STLBVH::ClosestPacket(const Packet &packet, const glm::vec3 &point,
+	float *best, float *facing, glm::vec3 *closest, int32 *facet) const
+{
+	for (int32 lane = 0; lane < BVH_LEAF_SIZE; lane++) {
+		if (packet.facet[lane] < 0)
+			continue;
+
+		glm::vec3 a(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+		glm::vec3 ab(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]);
+		glm::vec3 ac(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]);
+		glm::vec3 candidate = ClosestOnTriangle(point, a, ab, ac);
+		glm::vec3 offset = point - candidate;
+		float distance = glm::dot(offset, offset);
+		if (distance > *best * (1.0f + BVH_TIE_TOLERANCE))
+			continue;
+
+		// At a shared edge or corner every facet around it is as near,
+		// the sign of a distance is only meaningful for the one facing
+		// the point
+		glm::vec3 normal = glm::cross(ab, ac);
+		float scale = glm::length(normal) * sqrtf(distance);
+		float cosine = scale > 0.0f ? fabsf(glm::dot(offset, normal)) / scale : 1.0f;
+		if (distance < *best * (1.0f - BVH_TIE_TOLERANCE) || cosine > *facing) {
+			*best = distance;
+			*facing = cosine;
+			*closest = candidate;
+			*facet = packet.facet[lane];
+		}
+	}
+}
+
+bool
+STLBVH::Closest(const glm::vec3 &point, float maxDistance, glm::vec3 *closest, int32 *facet) const
+{
+	*facet = -1;
+	if (fNodes.empty())
+		return false;
+
+	// Squared distances throughout, nodes farther than the best facet
+	// so far are skipped
+	float best = maxDistance < FLT_MAX ? maxDistance * maxDistance : FLT_MAX;
+	float facing = -1.0f;
+
+	auto distance = [&point](const Node &node) {
+		float dx = std::max(std::max(node.min[0] - point.x, point.x - node.max[0]), 0.0f);
+		float dy = std::max(std::max(node.min[1] - point.y, point.y - node.max[1]), 0.0f);
+		float dz = std::max(std::max(node.min[2] - point.z, point.z - node.max[2]), 0.0f);
+		return dx * dx + dy * dy + dz * dz;
+	};
+
+	struct Entry {
+		int32 node;
+		float distance;
+	};
+	Entry stack[BVH_MAX_DEPTH * 2 + 2];
+	int32 top = 0;
+	stack[top++] = {0, distance(fNodes[0])};
+
+	while (top > 0) {
+		Entry current = stack[--top];
+		if (current.distance > best * (1.0f + BVH_TIE_TOLERANCE))
+			continue;
+
+		const Node &node = fNodes[current.node];
+		if (node.count > 0) {
+			int32 packets = (node.count + BVH_LEAF_SIZE - 1) / BVH_LEAF_SIZE;
+			for (int32 i = 0; i < packets; i++)
+				ClosestPacket(fPackets[node.first + i], point, &best, &facing, closest, facet);
+			continue;
+		}
+
+		// The nearer child goes on top so it is searched first
+		float leftDistance = distance(fNodes[node.first]);
+		float rightDistance = distance(fNodes[node.first + 1]);
+		if (leftDistance <= rightDistance) {
+			stack[top++] = {node.first + 1, rightDistance};
+			stack[top++] = {node.first, leftDistance};
+		} else {
+			stack[top++] = {node.first, leftDistance};
+			stack[top++] = {node.first + 1, rightDistance};
+		}
+	}
+
+	return *facet >= 0;
+}
+
+void
+STLBVH::Overlap(const glm::vec3 &low, const glm::vec3 &high, std::vector<int32> &facets) const
+{
+	// Leaves are tested by their own bounds only, the facets in them are
+	// returned as candidates for the caller to check
+	facets.clear();
+	if (fNodes.empty())
+		return;
+
+	auto overlaps = [&low, &high](const Node &node) {
+		return node.min[0] <= high.x && node.max[0] >= low.x
+			&& node.min[1] <= high.y && node.max[1] >= low.y
+			&& node.min[2] <= high.z && node.max[2] >= low.z;
+	};
+
+	int32 stack[BVH_MAX_DEPTH * 2 + 2];
+	int32 top = 0;
+	if (overlaps(fNodes[0]))
+		stack[top++] = 0;
+
+	while (top > 0) {
+		const Node &node = fNodes[stack[--top]];
+		if (node.count > 0) {
+			int32 packets = (node.count + BVH_LEAF_SIZE - 1) / BVH_LEAF_SIZE;
+			for (int32 i = 0; i < packets; i++) {
+				const Packet &packet = fPackets[node.first + i];
+				for (int32 lane = 0; lane < BVH_LEAF_SIZE; lane++) {
+					if (packet.facet[lane] >= 0)
+						facets.push_back(packet.facet[lane]);
+				}
+			}
+			continue;
+		}
+
+		if (overlaps(fNodes[node.first]))
+			stack[top++] = node.first;
+		if (overlaps(fNodes[node.first + 1]))
+			stack[top++] = node.first + 1;
+	}
+}
+
+void
+STLBVH::LeafOrder(std::vector<int32> &facets) const
+{
+	// Neighbouring facets end up next to each other, queries made in this
+	// order keep hitting the same nodes
+	facets.clear();
+	facets.reserve(fStl->stats.number_of_facets);
+	for (size_t i = 0; i < fPackets.size(); i++) {
+		for (int32 lane = 0; lane < BVH_LEAF_SIZE; lane++) {
+			if (fPackets[i].facet[lane] >= 0)
+				facets.push_back(fPackets[i].facet[lane]);
+		}
+	}
+}
@@ -0,0 +1,112 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_BVH
+#define STLOVER_BVH
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define BVH_LEAF_SIZE	4
+#define BVH_MAX_DEPTH	64
+
+// Bounding volume hierarchy over the facets of a mesh, built with binned
+// SAH splits. The top levels are split first and the subtrees below them
+// are built on all CPUs. Leaf triangles are stored four to a packet in SoA
+// form with precomputed edges, so one ray is tested against a whole leaf
+// at once.
+class STLBVH {
+	public:
+		STLBVH(stl_file *stl);
+
+		bool Raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+			float tMin, float tMax, int32 ignore, float *t, int32 *facet) const;
+		bool Closest(const glm::vec3 &point, float maxDistance,
+			glm::vec3 *closest, int32 *facet) const;
+		void Overlap(const glm::vec3 &low, const glm::vec3 &high,
+			std::vector<int32> &facets) const;
+		void LeafOrder(std::vector<int32> &facets) const;
+
+		stl_file* Stl(void) const { return fStl; }
+
+	private:
+		// Inner nodes keep their two children next to each other at
+		// first, leaves keep count facets in the packets from first on
+		struct Node {
+			float min[3];
+			int32 first;
+			float max[3];
+			int32 count;
+		};
+
+		struct Packet {
+			float v0[3][BVH_LEAF_SIZE];
+			float e1[3][BVH_LEAF_SIZE];
+			float e2[3][BVH_LEAF_SIZE];
+			int32 facet[BVH_LEAF_SIZE];
+		};
+
+		// Facet bounds used while building, partitioned in place so
+		// every pass over a node reads one contiguous range
+		struct BuildItem {
+			glm::vec3 low;
+			glm::vec3 high;
+			int32 facet;
+		};
+
+		struct BuildRange {
+			int32 begin;
+			int32 end;
+			int32 depth;
+			glm::vec3 low;
+			glm::vec3 high;
+			glm::vec3 centerLow;
+			glm::vec3 centerHigh;
+		};
+
+		struct BuildOutput {
+			std::vector<Node> nodes;
+			std::vector<Packet> packets;
+		};
+
+		void Build(void);
+		void Expand(int32 node, const BuildRange &range, int32 parallelDepth,
+			std::vector<std::pair<int32, BuildRange> > &tasks);
+		bool Split(const BuildRange &range, BuildRange &left, BuildRange &right);
+		void BuildSubtree(BuildOutput &output, int32 node, const BuildRange &range);
+		void MakeLeaf(BuildOutput &output, int32 node, int32 begin, int32 end);
+		void SetBounds(Node &node, const BuildRange &range);
+		static glm::vec3 Center(const BuildItem &item) { return (item.low + item.high) * 0.5f; }
+		void IntersectPacket(const Packet &packet, const glm::vec3 &origin,
+			const glm::vec3 &direction, float tMin, int32 ignore,
+			float *best, int32 *facet) const;
+		void ClosestPacket(const Packet &packet, const glm::vec3 &point,
+			float *best, float *facing, glm::vec3 *closest, int32 *facet) const;
+
+		stl_file *fStl;
+		std::vector<Node> fNodes;
+		std::vector<Packet> fPackets;
+
+		// Build state only
+		std::vector<BuildItem> fItems;
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "STLCompare.h"
+#include "STLBVH.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#define COMPARE_GRAIN	1024
+
+static inline glm::vec3
+ToVec3(const stl_vertex &v)
+{
+	return glm::vec3(v.x, v.y, v.z);
+}
+
+STLCompare::STLCompare(stl_file *stl, stl_file *reference, const glm::vec3 &offset)
+	: fStl(stl),
+	fReference(reference),
+	fOffset(offset),
+	fMaximum(0.0f),
+	fMean(0.0f),
+	fRMS(0.0f),
+	fHausdorff(0.0f)
+{
+	Measure();
+}
+
+void
+STLCompare::UniqueVertices(stl_file *stl, std::vector<glm::vec3> &vertices,
+	std::vector<int32> *corners)
+{
+	// Facets share most of their corners, every position is measured once
+	int32 count = stl->stats.number_of_facets * 3;
+	std::vector<int32> order(count);
+	for (int32 i = 0; i < count; i++)
+		order[i] = i;
+
+	auto position = [stl](int32 corner) {
+		return ToVec3(stl->facet_start[corner / 3].vertex[corner % 3]);
+	};
+	std::sort(order.begin(), order.end(), [&position](int32 a, int32 b) {
+		glm::vec3 p = position(a);
+		glm::vec3 q = position(b);
+		if (p.x != q.x)
+			return p.x < q.x;
+		if (p.y != q.y)
+			return p.y < q.y;
+		return p.z < q.z;
+	});
+
+	vertices.clear();
+	if (corners != NULL)
+		corners->resize(count);
+	for (int32 i = 0; i < count; i++) {
+		glm::vec3 p = position(order[i]);
+		if (vertices.empty() || p != vertices.back())
+			vertices.push_back(p);
+		if (corners != NULL)
+			(*corners)[order[i]] = vertices.size() - 1;
+	}
+}
+
+void
+STLCompare::Distances(stl_file *surface, const std::vector<glm::vec3> &points,
+	const glm::vec3 &offset, std::vector<float> &distances)
+{
+	STLBVH bvh(surface);
+	distances.assign(points.size(), 0.0f);
+
+	ParallelFor(points.size(), COMPARE_GRAIN, [&](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			glm::vec3 point = points[i] + offset;
+			glm::vec3 closest;
+			int32 facet;
+			if (!bvh.Closest(point, FLT_MAX, &closest, &facet))
+				continue;
+
+			// Outside is where the facet normal points, taken from the
+			// winding rather than the stored normal
+			const stl_vertex *v = surface->facet_start[facet].vertex;
+			glm::vec3 normal = glm::cross(ToVec3(v[1]) - ToVec3(v[0]), ToVec3(v[2]) - ToVec3(v[0]));
+			float distance = glm::distance(point, closest);
+			distances[i] = glm::dot(point - closest, normal) < 0.0f ? -distance : distance;
+		}
+	});
+}
+
+void
+STLCompare::Measure(void)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	if (facets <= 0 || fReference->stats.number_of_facets <= 0)
+		return;
+
+	std::vector<glm::vec3> vertices;
+	std::vector<int32> corners;
+	UniqueVertices(fStl, vertices, &corners);
+	Distances(fReference, vertices, fOffset, fDistances);
+
+	fValues.resize(facets * 3);
+	for (int32 i = 0; i < facets * 3; i++)
+		fValues[i] = fDistances[corners[i]];
+
+	double sum = 0.0;
+	double squares = 0.0;
+	for (size_t i = 0; i < fDistances.size(); i++) {
+		float distance = fabsf(fDistances[i]);
+		fMaximum = std::max(fMaximum, distance);
+		sum += distance;
+		squares += (double)distance * distance;
+	}
+	fMean = sum / fDistances.size();
+	fRMS = sqrt(squares / fDistances.size());
+
+	// The way back only needs its largest distance
+	std::vector<glm::vec3> referenceVertices;
+	std::vector<float> back;
+	UniqueVertices(fReference, referenceVertices, NULL);
+	Distances(fStl, referenceVertices, -fOffset, back);
+
+	fHausdorff = fMaximum;
+	for (size_t i = 0; i < back.size(); i++)
+		fHausdorff = std::max(fHausdorff, fabsf(back[i]));
+}
+
+float
+STLCompare::Outside(float tolerance) const
+{
+	// Share of the vertices deviating by more than the tolerance
+	if (fDistances.empty())
+		return 0.0f;
+
+	int32 count = 0;
+	for (size_t i = 0; i < fDistances.size(); i++) {
+		if (fabsf(fDistances[i]) > tolerance)
+			count++;
+	}
+	return 100.0f * count / fDistances.size();
+}
@@ -0,0 +1,66 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_COMPARE
+#define STLOVER_COMPARE
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Deviation of a mesh from a reference mesh. Every distinct vertex is
+// measured to the nearest point of the reference surface through a BVH,
+// positive outside of it and negative inside. The reference vertices are
+// measured back to the mesh as well, so a coarse mesh lying on a fine
+// reference at its vertices only still shows in the Hausdorff distance.
+// The offset moves mesh coordinates into the frame of the reference, the
+// caller either lines up the bounding boxes or undoes the centering both
+// got on load, which leaves removed or added facets from shifting the rest.
+class STLCompare {
+	public:
+		STLCompare(stl_file *stl, stl_file *reference, const glm::vec3 &offset);
+
+		// Three signed distances per facet, one for each corner
+		const std::vector<float>& Values(void) const { return fValues; }
+		float Maximum(void) const { return fMaximum; }
+		float Mean(void) const { return fMean; }
+		float RMS(void) const { return fRMS; }
+		float Hausdorff(void) const { return fHausdorff; }
+		float Outside(float tolerance) const;
+
+	private:
+		void Measure(void);
+		static void UniqueVertices(stl_file *stl, std::vector<glm::vec3> &vertices,
+			std::vector<int32> *corners);
+		static void Distances(stl_file *surface, const std::vector<glm::vec3> &points,
+			const glm::vec3 &offset, std::vector<float> &distances);
+
+		stl_file *fStl;
+		stl_file *fReference;
+		glm::vec3 fOffset;
+		std::vector<float> fValues;
+		std::vector<float> fDistances;
+		float fMaximum;
+		float fMean;
+		float fRMS;
+		float fHausdorff;
+};
+
+#endif
@@ -0,0 +1,146 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLCurvature.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+STLCurvature::STLCurvature(stl_file *stl, const STLWeld &weld)
+	: fStl(stl),
+	fCorners(weld.CornerVertices())
+{
+	Estimate(weld);
+}
+
+float
+STLCurvature::Maximum(int32 vertex) const
+{
+	float mean = fMean[vertex];
+	return fabsf(mean) + sqrtf(std::max(mean * mean - fGaussian[vertex], 0.0f));
+}
+
+bool
+STLCurvature::IsSharp(int32 vertex, float radius) const
+{
+	return IsValid(vertex) && Maximum(vertex) * radius > 1.0f;
+}
+
+int32
+STLCurvature::CountSharp(float radius, float *area) const
+{
+	int32 count = 0;
+	double sharpArea = 0.0;
+	for (int32 i = 0; i < CountVertices(); i++) {
+		if (IsSharp(i, radius)) {
+			count++;
+			sharpArea += fArea[i];
+		}
+	}
+
+	if (area != NULL)
+		*area = sharpArea;
+	return count;
+}
+
+void
+STLCurvature::CornerValues(int32 type, std::vector<float> &values) const
+{
+	const std::vector<float> &source = type == CURVATURE_GAUSSIAN ? fGaussian : fMean;
+	values.resize(fCorners.size());
+	ParallelFor(fCorners.size(), CURVATURE_GRAIN * 16, [&](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			int32 vertex = fCorners[i];
+			values[i] = IsValid(vertex) ? source[vertex] : FLT_MAX;
+		}
+	});
+}
+
+void
+STLCurvature::Estimate(const STLWeld &weld)
+{
+	int32 vertices = weld.CountVertices();
+	fMean.assign(vertices, 0.0f);
+	fGaussian.assign(vertices, 0.0f);
+	fArea.assign(vertices, 0.0f);
+
+	ParallelFor(vertices, CURVATURE_GRAIN, [this, &weld](int32 first, int32 last) {
+		for (int32 v = first; v < last; v++) {
+			if (!weld.IsClosed(v))
+				continue;
+
+			int32 count;
+			const int32 *corners = weld.Corners(v, &count);
+			glm::dvec3 laplace(0.0);
+			glm::dvec3 normal(0.0);
+			double area = 0.0;
+			double angles = 0.0;
+			bool degenerate = false;
+
+			for (int32 i = 0; i < count; i++) {
+				const stl_facet &facet = fStl->facet_start[corners[i] / 3];
+				int32 k = corners[i] % 3;
+				glm::dvec3 p0(facet.vertex[k].x, facet.vertex[k].y, facet.vertex[k].z);
+				glm::dvec3 p1(facet.vertex[(k + 1) % 3].x, facet.vertex[(k + 1) % 3].y,
+					facet.vertex[(k + 1) % 3].z);
+				glm::dvec3 p2(facet.vertex[(k + 2) % 3].x, facet.vertex[(k + 2) % 3].y,
+					facet.vertex[(k + 2) % 3].z);
+
+				glm::dvec3 e1 = p1 - p0;
+				glm::dvec3 e2 = p2 - p0;
+				glm::dvec3 cross = glm::cross(e1, e2);
+				double twice = glm::length(cross);
+				if (twice <= 0.0) {
+					degenerate = true;
+					break;
+				}
+
+				// Cotangents of the angles at the two other corners
+				double dot0 = glm::dot(e1, e2);
+				double dot1 = glm::dot(p0 - p1, p2 - p1);
+				double dot2 = glm::dot(p0 - p2, p1 - p2);
+				double cot1 = dot1 / twice;
+				double cot2 = dot2 / twice;
+
+				laplace += e1 * cot2 + e2 * cot1;
+				normal += cross;
+				angles += atan2(twice, dot0);
+
+				// Voronoi part of the facet, an obtuse facet is split at
+				// the midpoints instead
+				if (dot0 < 0.0)
+					area += twice / 4.0;
+				else if (dot1 < 0.0 || dot2 < 0.0)
+					area += twice / 8.0;
+				else
+					area += (glm::dot(e1, e1) * cot2 + glm::dot(e2, e2) * cot1) / 8.0;
+			}
+
+			double length = glm::length(normal);
+			if (degenerate || area <= 0.0 || length <= 0.0)
+				continue;
+
+			fMean[v] = -glm::dot(laplace, normal / length) / (4.0 * area);
+			fGaussian[v] = (2.0 * M_PI - angles) / area;
+			fArea[v] = area;
+		}
+	});
+}
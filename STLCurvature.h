@@ -0,0 +1,71 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_CURVATURE
+#define STLOVER_CURVATURE
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+
+#include "STLWeld.h"
+
+#define CURVATURE_MEAN			0
+#define CURVATURE_GAUSSIAN		1
+
+#define CURVATURE_GRAIN			4096
+
+// Mean and Gaussian curvature at every vertex of the welded mesh, from the
+// discrete operators of Meyer et al.: the cotangent Laplacian over the
+// mixed Voronoi area for the mean curvature and the angle defect for the
+// Gaussian one. Mean curvature is positive where the surface bulges
+// outwards. Vertices on open or non-manifold edges get no value. Every
+// vertex only reads the facets around it, so all CPUs work at once.
+class STLCurvature {
+	public:
+		STLCurvature(stl_file *stl, const STLWeld &weld);
+
+		int32 CountVertices(void) const { return fMean.size(); }
+		bool IsValid(int32 vertex) const { return fArea[vertex] > 0.0f; }
+		float Mean(int32 vertex) const { return fMean[vertex]; }
+		float Gaussian(int32 vertex) const { return fGaussian[vertex]; }
+		// Largest principal curvature by magnitude
+		float Maximum(int32 vertex) const;
+
+		// Vertices curving tighter than the radius, creases and corners
+		// included, and the facet area around them
+		bool IsSharp(int32 vertex, float radius) const;
+		int32 CountSharp(float radius, float *area = NULL) const;
+
+		// One value per facet corner for the heatmap, vertices without
+		// a value get FLT_MAX
+		void CornerValues(int32 type, std::vector<float> &values) const;
+
+	private:
+		void Estimate(const STLWeld &weld);
+
+		stl_file *fStl;
+		std::vector<int32> fCorners;
+		std::vector<float> fMean;
+		std::vector<float> fGaussian;
+		std::vector<float> fArea;
+};
+
+#endif
@@ -0,0 +1,283 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <Directory.h>
+#include <Entry.h>
+#include <Path.h>
+
+#include "STLDuplicateFinder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <numeric>
+
+STLDuplicateFinder::STLDuplicateFinder(int argc, char **argv)
+	: fTolerance(DUPLICATES_DEFAULT_TOLERANCE),
+	fJobs(0),
+	fValid(false),
+	fNextFile(0),
+	fFailed(0)
+{
+	fValid = ParseArguments(argc, argv);
+	if (!fValid)
+		PrintUsage();
+}
+
+bool
+STLDuplicateFinder::ParseArguments(int argc, char **argv)
+{
+	for (int i = 2; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--tolerance") == 0 && value != NULL) {
+			fTolerance = atof(value);
+			if (fTolerance < 0.0 || fTolerance >= 1.0)
+				return false;
+			i++;
+		} else if (strcmp(arg, "--jobs") == 0 && value != NULL) {
+			fJobs = atoi(value);
+			if (fJobs <= 0)
+				return false;
+			i++;
+		} else if (strncmp(arg, "--", 2) == 0) {
+			return false;
+		} else {
+			fRoots.push_back(arg);
+		}
+	}
+
+	return !fRoots.empty();
+}
+
+void
+STLDuplicateFinder::PrintUsage(void)
+{
+	fprintf(stderr, "Usage: STLover --find-duplicates [--tolerance T] [--jobs N]\n"
+		"                               directory|file.stl...\n");
+}
+
+void
+STLDuplicateFinder::Collect(const char *path, bool explicitly)
+{
+	// Links are followed for the paths given on the command line only,
+	// a link back up the tree would otherwise never end the walk
+	BEntry entry(path, explicitly);
+	if (entry.InitCheck() != B_OK || !entry.Exists()) {
+		fprintf(stderr, "%s: no such file or directory\n", path);
+		fFailed++;
+		return;
+	}
+
+	if (!explicitly && entry.IsSymLink())
+		return;
+
+	if (entry.IsDirectory()) {
+		BDirectory directory(&entry);
+		BEntry child;
+		while (directory.GetNextEntry(&child) == B_OK) {
+			BPath childPath;
+			if (child.GetPath(&childPath) == B_OK)
+				Collect(childPath.Path(), false);
+		}
+		return;
+	}
+
+	BString name(path);
+	if (explicitly || name.IEndsWith(".stl")) {
+		Model model;
+		model.path = path;
+		model.loaded = false;
+		fModels.push_back(model);
+	}
+}
+
+int32
+STLDuplicateFinder::Run(void)
+{
+	if (!fValid)
+		return 1;
+
+	for (size_t i = 0; i < fRoots.size(); i++)
+		Collect(fRoots[i].String(), true);
+
+	if (fJobs <= 0) {
+		system_info info;
+		get_system_info(&info);
+		fJobs = info.cpu_count;
+	}
+	if (fJobs > (int32)fModels.size())
+		fJobs = fModels.size();
+
+	std::vector<thread_id> loaders;
+	for (int32 i = 0; i < fJobs; i++) {
+		thread_id loader = spawn_thread(_IndexFunction, "duplicateIndexer", B_NORMAL_PRIORITY, (void*)this);
+		if (loader < B_OK || resume_thread(loader) != B_OK)
+			break;
+		loaders.push_back(loader);
+	}
+
+	// Without a single thread the files are still indexed, just slower
+	if (loaders.empty())
+		_IndexFunction(this);
+
+	for (size_t i = 0; i < loaders.size(); i++) {
+		status_t result;
+		wait_for_thread(loaders[i], &result);
+	}
+
+	for (size_t i = 0; i < fModels.size(); i++) {
+		if (!fModels[i].loaded) {
+			fprintf(stderr, "%s: can't open file\n", fModels[i].path.String());
+			fFailed++;
+		}
+	}
+
+	Report();
+
+	return fFailed > 0 ? 1 : 0;
+}
+
+int32
+STLDuplicateFinder::_IndexFunction(void *data)
+{
+	STLDuplicateFinder *finder = (STLDuplicateFinder*)data;
+	int32 count = finder->fModels.size();
+
+	while (true) {
+		int32 index = atomic_add(&finder->fNextFile, 1);
+		if (index >= count)
+			break;
+
+		Model &model = finder->fModels[index];
+		stl_file stl;
+		stl_open(&stl, (char*)model.path.String());
+		if (!stl_get_error(&stl)) {
+			model.fingerprint = STLFingerprint(&stl);
+			model.loaded = true;
+		}
+		stl_close(&stl);
+	}
+
+	return 0;
+}
+
+static int32
+FindRoot(std::vector<int32> &parent, int32 item)
+{
+	while (parent[item] != item) {
+		parent[item] = parent[parent[item]];
+		item = parent[item];
+	}
+	return item;
+}
+
+void
+STLDuplicateFinder::Report(void)
+{
+	std::vector<int32> order;
+	for (size_t i = 0; i < fModels.size(); i++) {
+		if (fModels[i].loaded)
+			order.push_back(i);
+	}
+
+	// Equal hashes end up next to each other, every run of them is a group
+	// of exact copies and its first model stands for it below
+	std::sort(order.begin(), order.end(), [this](int32 a, int32 b) {
+		const STLFingerprint &first = fModels[a].fingerprint;
+		const STLFingerprint &second = fModels[b].fingerprint;
+		if (first.Hash() != second.Hash())
+			return first.Hash() < second.Hash();
+		if (first.CountFacets() != second.CountFacets())
+			return first.CountFacets() < second.CountFacets();
+		return fModels[a].path < fModels[b].path;
+	});
+
+	std::vector<int32> representatives;
+	std::vector<int32> exact(fModels.size(), -1);
+	int32 exactGroups = 0;
+	for (size_t i = 0; i < order.size(); ) {
+		size_t end = i + 1;
+		while (end < order.size()
+			&& fModels[order[i]].fingerprint.Equals(fModels[order[end]].fingerprint))
+			end++;
+
+		for (size_t j = i; j < end; j++)
+			exact[order[j]] = order[i];
+		representatives.push_back(order[i]);
+
+		if (end - i > 1) {
+			printf("exact %s\n", fModels[order[i]].fingerprint.HashString().String());
+			for (size_t j = i; j < end; j++)
+				printf("\t%s\n", fModels[order[j]].path.String());
+			printf("\n");
+			exactGroups++;
+		}
+		i = end;
+	}
+
+	// Near duplicates are searched among the representatives only. Sorted
+	// by area, a model is compared with the following ones until their
+	// area is out of tolerance
+	std::sort(representatives.begin(), representatives.end(), [this](int32 a, int32 b) {
+		return fModels[a].fingerprint.Area() < fModels[b].fingerprint.Area();
+	});
+
+	std::vector<int32> parent(fModels.size());
+	std::iota(parent.begin(), parent.end(), 0);
+	for (size_t i = 0; i < representatives.size(); i++) {
+		const STLFingerprint &first = fModels[representatives[i]].fingerprint;
+		double limit = first.Area() / (1.0 - fTolerance);
+		for (size_t j = i + 1; j < representatives.size(); j++) {
+			const STLFingerprint &second = fModels[representatives[j]].fingerprint;
+			if (second.Area() > limit)
+				break;
+			if (first.Similar(second, fTolerance)) {
+				parent[FindRoot(parent, representatives[i])]
+					= FindRoot(parent, representatives[j]);
+			}
+		}
+	}
+
+	std::vector<std::vector<int32> > groups(fModels.size());
+	for (size_t i = 0; i < order.size(); i++)
+		groups[FindRoot(parent, exact[order[i]])].push_back(order[i]);
+
+	int32 nearGroups = 0;
+	for (size_t i = 0; i < groups.size(); i++) {
+		std::vector<int32> &group = groups[i];
+		if (group.empty() || exact[group.front()] == exact[group.back()])
+			continue;
+
+		std::sort(group.begin(), group.end(), [this](int32 a, int32 b) {
+			return fModels[a].path < fModels[b].path;
+		});
+		printf("near\n");
+		for (size_t j = 0; j < group.size(); j++)
+			printf("\t%s\n", fModels[group[j]].path.String());
+		printf("\n");
+		nearGroups++;
+	}
+
+	printf("%" B_PRId32 " models, %" B_PRId32 " exact and %" B_PRId32 " near duplicate groups\n",
+		(int32)order.size(), exactGroups, nearGroups);
+}
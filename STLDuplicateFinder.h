@@ -0,0 +1,66 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_DUPLICATEFINDER
+#define STLOVER_DUPLICATEFINDER
+
+#include <String.h>
+#include <OS.h>
+
+#include "STLFingerprint.h"
+
+#include <vector>
+
+#define DUPLICATES_DEFAULT_TOLERANCE 0.01
+
+// Command line mode that indexes STL files and directory trees and reports
+// models that are the same (equal fingerprint hash) or nearly the same
+// (volume, area and moments of inertia within a relative tolerance).
+// Loader threads pick the next file through an atomic counter, so a few
+// huge files do not hold up the rest of the library.
+class STLDuplicateFinder {
+	public:
+		STLDuplicateFinder(int argc, char **argv);
+
+		int32 Run(void);
+
+		static int32 _IndexFunction(void *data);
+
+	private:
+		struct Model {
+			BString path;
+			STLFingerprint fingerprint;
+			bool loaded;
+		};
+
+		bool ParseArguments(int argc, char **argv);
+		void PrintUsage(void);
+		void Collect(const char *path, bool explicitly);
+		void Report(void);
+
+		std::vector<Model> fModels;
+		std::vector<BString> fRoots;
+		double fTolerance;
+		int32 fJobs;
+		bool fValid;
+		int32 fNextFile;
+		int32 fFailed;
+};
+
+#endif
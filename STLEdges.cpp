@@ -0,0 +1,265 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "STLEdges.h"
+#include "STLParallel.h"
+
+#include <Autolock.h>
+#include <Locker.h>
+
+#include <algorithm>
+#include <cstring>
+
+// Records are counted and scattered into buckets per range of this many
+// edges, so every range writes its own slots without locking
+#define EDGES_GRAIN			65536
+#define EDGES_BUCKET_BITS	10
+#define EDGES_BUCKETS		(1 << EDGES_BUCKET_BITS)
+
+// Adding zero turns -0 into +0, so both hash like the equal values they are
+static inline glm::vec3
+ToVec3(const stl_vertex &v)
+{
+	return glm::vec3(v.x + 0.0f, v.y + 0.0f, v.z + 0.0f);
+}
+
+static inline bool
+PointLess(const glm::vec3 &a, const glm::vec3 &b)
+{
+	if (a.x != b.x)
+		return a.x < b.x;
+	if (a.y != b.y)
+		return a.y < b.y;
+	return a.z < b.z;
+}
+
+static inline bool
+PointEqual(const glm::vec3 &a, const glm::vec3 &b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+STLEdges::STLEdges(stl_file *stl)
+	: fStl(stl)
+{
+	Find();
+}
+
+void
+STLEdges::Endpoints(int32 edge, glm::vec3 &first, glm::vec3 &second) const
+{
+	const stl_facet &facet = fStl->facet_start[edge / 3];
+	first = ToVec3(facet.vertex[edge % 3]);
+	second = ToVec3(facet.vertex[(edge % 3 + 1) % 3]);
+	if (PointLess(second, first))
+		std::swap(first, second);
+}
+
+static inline uint64
+Mix(uint64 h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+void
+STLEdges::Fingerprint(const glm::vec3 &first, const glm::vec3 &second, EdgeRecord &record)
+{
+	float values[6] = { first.x, first.y, first.z, second.x, second.y, second.z };
+	uint64 words[3];
+	memcpy(words, values, sizeof(words));
+
+	// Two chains with different seeds and word order, the second one only
+	// lends its top bits to tell apart the rare equal first hashes
+	uint64 hash = Mix(0x9e3779b97f4a7c15ULL ^ words[0]);
+	hash = Mix(hash ^ words[1]);
+	hash = Mix(hash ^ words[2]);
+
+	uint64 check = Mix(0xc2b2ae3d27d4eb4fULL ^ words[2]);
+	check = Mix(check ^ words[0]);
+	check = Mix(check ^ words[1]);
+
+	record.hash = hash;
+	record.check = check >> 32;
+}
+
+bool
+STLEdges::Less(const EdgeRecord &a, const EdgeRecord &b)
+{
+	if (a.hash != b.hash)
+		return a.hash < b.hash;
+	return a.check < b.check;
+}
+
+void
+STLEdges::Find(void)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	if (facets <= 0)
+		return;
+
+	int32 count = facets * 3;
+	std::vector<EdgeRecord> records(count);
+	ParallelFor(count, EDGES_GRAIN, [this, &records](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			glm::vec3 a, b;
+			Endpoints(i, a, b);
+			Fingerprint(a, b, records[i]);
+			records[i].edge = PointEqual(a, b) ? -1 : i;
+		}
+	});
+
+	// Counts per range and bucket become the write offsets
+	int32 chunks = (count + EDGES_GRAIN - 1) / EDGES_GRAIN;
+	std::vector<int32> offsets((size_t)chunks * EDGES_BUCKETS, 0);
+	ParallelFor(count, EDGES_GRAIN, [&records, &offsets](int32 first, int32 last) {
+		int32 *row = &offsets[(size_t)(first / EDGES_GRAIN) * EDGES_BUCKETS];
+		for (int32 i = first; i < last; i++) {
+			if (records[i].edge >= 0)
+				row[records[i].hash >> (64 - EDGES_BUCKET_BITS)]++;
+		}
+	});
+
+	std::vector<int32> bucketStart;
+	int32 total = ScatterOffsets(offsets, chunks, EDGES_BUCKETS, 0, EDGES_BUCKETS,
+		offsets, bucketStart);
+
+	std::vector<EdgeRecord> buckets(total);
+	ParallelFor(count, EDGES_GRAIN, [&records, &offsets, &buckets](int32 first, int32 last) {
+		int32 *row = &offsets[(size_t)(first / EDGES_GRAIN) * EDGES_BUCKETS];
+		for (int32 i = first; i < last; i++) {
+			if (records[i].edge >= 0)
+				buckets[row[records[i].hash >> (64 - EDGES_BUCKET_BITS)]++] = records[i];
+		}
+	});
+	std::vector<EdgeRecord>().swap(records);
+
+	// Equal edges are next to each other once a bucket is sorted, the
+	// length of each run is the number of facets using that edge
+	BLocker locker("edges");
+	ParallelFor(EDGES_BUCKETS, 1, [&](int32 first, int32 last) {
+		std::vector<Edge> open;
+		std::vector<Edge> nonManifold;
+		for (int32 bucket = first; bucket < last; bucket++) {
+			EdgeRecord *begin = buckets.data() + bucketStart[bucket];
+			EdgeRecord *end = buckets.data() + bucketStart[bucket + 1];
+			std::sort(begin, end, Less);
+
+			for (EdgeRecord *run = begin; run < end;) {
+				EdgeRecord *next = run + 1;
+				while (next < end && !Less(*run, *next))
+					next++;
+
+				int32 users = next - run;
+				if (users != 2) {
+					Edge edge;
+					Endpoints(run->edge, edge.from, edge.to);
+					if (users == 1)
+						open.push_back(edge);
+					else
+						nonManifold.push_back(edge);
+				}
+				run = next;
+			}
+		}
+
+		if (!open.empty() || !nonManifold.empty()) {
+			BAutolock lock(locker);
+			fOpenEdges.insert(fOpenEdges.end(), open.begin(), open.end());
+			fNonManifoldEdges.insert(fNonManifoldEdges.end(), nonManifold.begin(), nonManifold.end());
+		}
+	});
+
+	// Threads finish in any order, sorting keeps the defect list stable
+	// between runs
+	auto edgeLess = [](const Edge &a, const Edge &b) {
+		if (!PointEqual(a.from, b.from))
+			return PointLess(a.from, b.from);
+		return PointLess(a.to, b.to);
+	};
+	std::sort(fOpenEdges.begin(), fOpenEdges.end(), edgeLess);
+	std::sort(fNonManifoldEdges.begin(), fNonManifoldEdges.end(), edgeLess);
+
+	Group(fOpenEdges, DEFECT_OPEN);
+	Group(fNonManifoldEdges, DEFECT_NON_MANIFOLD);
+
+	// Largest defects of each kind come first
+	std::sort(fDefects.begin(), fDefects.end(), [](const Defect &a, const Defect &b) {
+		if (a.type != b.type)
+			return a.type < b.type;
+		if (a.edges != b.edges)
+			return a.edges > b.edges;
+		return PointLess(a.low, b.low);
+	});
+}
+
+void
+STLEdges::Group(const std::vector<Edge> &edges, int32 type)
+{
+	if (edges.empty())
+		return;
+
+	// Union-find over the edges, edges sharing an end point are joined
+	std::vector<int32> parent(edges.size());
+	for (size_t i = 0; i < parent.size(); i++)
+		parent[i] = i;
+
+	auto root = [&parent](int32 i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	};
+
+	struct End {
+		glm::vec3 point;
+		int32 edge;
+	};
+	std::vector<End> ends;
+	ends.reserve(edges.size() * 2);
+	for (size_t i = 0; i < edges.size(); i++) {
+		ends.push_back({edges[i].from, (int32)i});
+		ends.push_back({edges[i].to, (int32)i});
+	}
+	std::sort(ends.begin(), ends.end(),
+		[](const End &a, const End &b) { return PointLess(a.point, b.point); });
+
+	for (size_t i = 1; i < ends.size(); i++) {
+		if (PointEqual(ends[i].point, ends[i - 1].point))
+			parent[root(ends[i].edge)] = root(ends[i - 1].edge);
+	}
+
+	std::vector<int32> defect(edges.size(), -1);
+	for (size_t i = 0; i < edges.size(); i++) {
+		int32 group = root(i);
+		if (defect[group] < 0) {
+			defect[group] = fDefects.size();
+			fDefects.push_back({type, 0, edges[i].from, edges[i].from});
+		}
+
+		Defect &current = fDefects[defect[group]];
+		current.edges++;
+		current.low = glm::min(current.low, glm::min(edges[i].from, edges[i].to));
+		current.high = glm::max(current.high, glm::max(edges[i].from, edges[i].to));
+	}
+}
@@ -0,0 +1,77 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_EDGES
+#define STLOVER_EDGES
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define DEFECT_OPEN				0
+#define DEFECT_NON_MANIFOLD		1
+
+// Open and non-manifold edges of a mesh. Facet edges are matched by a 96
+// bit fingerprint of their exact end points, records are spread over
+// buckets by it and every bucket is sorted and scanned on its own CPU
+// without touching the mesh again. An edge used by one facet is open, one
+// used by more than two is non-manifold. Defect edges touching each other
+// are grouped into defects, a boundary loop is one defect.
+class STLEdges {
+	public:
+		struct Edge {
+			glm::vec3 from;
+			glm::vec3 to;
+		};
+
+		struct Defect {
+			int32 type;
+			int32 edges;
+			glm::vec3 low;
+			glm::vec3 high;
+		};
+
+		STLEdges(stl_file *stl);
+
+		const std::vector<Edge>& OpenEdges(void) const { return fOpenEdges; }
+		const std::vector<Edge>& NonManifoldEdges(void) const { return fNonManifoldEdges; }
+		const std::vector<Defect>& Defects(void) const { return fDefects; }
+
+	private:
+		struct EdgeRecord {
+			uint64 hash;
+			uint32 check;
+			int32 edge;
+		};
+
+		void Find(void);
+		void Group(const std::vector<Edge> &edges, int32 type);
+		void Endpoints(int32 edge, glm::vec3 &first, glm::vec3 &second) const;
+		static void Fingerprint(const glm::vec3 &first, const glm::vec3 &second,
+			EdgeRecord &record);
+		static bool Less(const EdgeRecord &a, const EdgeRecord &b);
+
+		stl_file *fStl;
+		std::vector<Edge> fOpenEdges;
+		std::vector<Edge> fNonManifoldEdges;
+		std::vector<Defect> fDefects;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLFingerprint.h"
+#include "STLParallel.h"
+#include "STLParts.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static inline uint64
+Mix(uint64 h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+STLFingerprint::STLFingerprint()
+	: fHash(0),
+	fFacets(0),
+	fVolume(0),
+	fArea(0)
+{
+	fMoments[0] = fMoments[1] = fMoments[2] = 0;
+}
+
+STLFingerprint::STLFingerprint(stl_file *stl)
+	: fHash(0),
+	fFacets(stl->stats.number_of_facets),
+	fVolume(0),
+	fArea(0)
+{
+	fMoments[0] = fMoments[1] = fMoments[2] = 0;
+	if (fFacets <= 0)
+		return;
+
+	// Every chunk sums into its own slot, the slots are added in order so
+	// the descriptors come out the same on any number of CPUs
+	const stl_vertex origin = stl->stats.min;
+	std::vector<Sums> chunks((fFacets + FINGERPRINT_GRAIN - 1) / FINGERPRINT_GRAIN);
+	ParallelFor(fFacets, FINGERPRINT_GRAIN, [stl, &origin, &chunks](int32 first, int32 last) {
+		Sums &sums = chunks[first / FINGERPRINT_GRAIN];
+		memset(&sums, 0, sizeof(sums));
+		for (int32 i = first; i < last; i++)
+			AddFacet(stl->facet_start[i], origin, sums);
+	});
+
+	uint64 hash = 0;
+	double first[3] = { 0, 0, 0 };
+	double second[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+	for (size_t c = 0; c < chunks.size(); c++) {
+		hash += chunks[c].hash;
+		fVolume += chunks[c].volume;
+		fArea += chunks[c].area;
+		for (int i = 0; i < 3; i++) {
+			first[i] += chunks[c].first[i];
+			for (int j = 0; j < 3; j++)
+				second[i][j] += chunks[c].second[i][j];
+		}
+	}
+	fHash = Mix(hash ^ (uint64)fFacets);
+
+	// A mesh with all facets turned inside out has negative volume and
+	// moments, it is still the same shape
+	if (fVolume < 0) {
+		fVolume = -fVolume;
+		for (int i = 0; i < 3; i++) {
+			first[i] = -first[i];
+			for (int j = 0; j < 3; j++)
+				second[i][j] = -second[i][j];
+		}
+	}
+	if (fVolume <= 0)
+		return;
+
+	// Second moments about the centroid, then the inertia tensor of a solid
+	// of unit density
+	double central[3][3];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			central[i][j] = second[i][j] - first[i] * first[j] / fVolume;
+
+	double trace = central[0][0] + central[1][1] + central[2][2];
+	double inertia[3][3];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			inertia[i][j] = (i == j ? trace : 0.0) - central[i][j];
+
+	double vectors[3][3];
+	STLParts::SymmetricEigen(inertia, fMoments, vectors);
+	std::sort(fMoments, fMoments + 3);
+}
+
+void
+STLFingerprint::AddFacet(const stl_facet &facet, const stl_vertex &origin, Sums &sums)
+{
+	double v[3][3];
+	int64 q[3][3];
+	for (int k = 0; k < 3; k++) {
+		v[k][0] = (double)facet.vertex[k].x - origin.x;
+		v[k][1] = (double)facet.vertex[k].y - origin.y;
+		v[k][2] = (double)facet.vertex[k].z - origin.z;
+		for (int i = 0; i < 3; i++)
+			q[k][i] = llround(v[k][i] / FINGERPRINT_QUANTUM);
+	}
+
+	// Start at the rotation that reads smallest, the winding is kept so a
+	// flipped facet still hashes differently
+	int start = 0;
+	for (int r = 1; r < 3; r++) {
+		for (int n = 0; n < 9; n++) {
+			int64 a = q[(r + n / 3) % 3][n % 3];
+			int64 b = q[(start + n / 3) % 3][n % 3];
+			if (a != b) {
+				if (a < b)
+					start = r;
+				break;
+			}
+		}
+	}
+
+	uint64 hash = 0x9e3779b97f4a7c15ULL;
+	for (int n = 0; n < 9; n++)
+		hash = Mix(hash ^ (uint64)q[(start + n / 3) % 3][n % 3]);
+	sums.hash += hash;
+
+	double cross[3] = {
+		v[1][1] * v[2][2] - v[1][2] * v[2][1],
+		v[1][2] * v[2][0] - v[1][0] * v[2][2],
+		v[1][0] * v[2][1] - v[1][1] * v[2][0]
+	};
+	double det = v[0][0] * cross[0] + v[0][1] * cross[1] + v[0][2] * cross[2];
+
+	double edge[2][3];
+	for (int i = 0; i < 3; i++) {
+		edge[0][i] = v[1][i] - v[0][i];
+		edge[1][i] = v[2][i] - v[0][i];
+	}
+	double nx = edge[0][1] * edge[1][2] - edge[0][2] * edge[1][1];
+	double ny = edge[0][2] * edge[1][0] - edge[0][0] * edge[1][2];
+	double nz = edge[0][0] * edge[1][1] - edge[0][1] * edge[1][0];
+	sums.area += 0.5 * sqrt(nx * nx + ny * ny + nz * nz);
+
+	// Signed tetrahedron from the origin to the facet, integrals of x and
+	// x * x^T over it
+	double s[3] = { v[0][0] + v[1][0] + v[2][0], v[0][1] + v[1][1] + v[2][1],
+		v[0][2] + v[1][2] + v[2][2] };
+	sums.volume += det / 6.0;
+	for (int i = 0; i < 3; i++) {
+		sums.first[i] += det / 24.0 * s[i];
+		for (int j = 0; j < 3; j++) {
+			sums.second[i][j] += det / 120.0 * (v[0][i] * v[0][j] + v[1][i] * v[1][j]
+				+ v[2][i] * v[2][j] + s[i] * s[j]);
+		}
+	}
+}
+
+bool
+STLFingerprint::Equals(const STLFingerprint &other) const
+{
+	return fFacets > 0 && fFacets == other.fFacets && fHash == other.fHash;
+}
+
+static inline bool
+Close(double a, double b, double scale, double tolerance)
+{
+	return fabs(a - b) <= tolerance * scale;
+}
+
+bool
+STLFingerprint::Similar(const STLFingerprint &other, double tolerance) const
+{
+	if (fArea <= 0 || other.fArea <= 0)
+		return false;
+
+	if (!Close(fArea, other.fArea, std::max(fArea, other.fArea), tolerance)
+		|| !Close(fVolume, other.fVolume, std::max(fVolume, other.fVolume), tolerance))
+		return false;
+
+	// Moments are compared against the largest one, a flat part has a
+	// near zero smallest moment that would never match relatively
+	double scale = std::max(fMoments[2], other.fMoments[2]);
+	for (int i = 0; i < 3; i++) {
+		if (!Close(fMoments[i], other.fMoments[i], scale, tolerance))
+			return false;
+	}
+
+	return true;
+}
+
+BString
+STLFingerprint::HashString(void) const
+{
+	BString text;
+	text.SetToFormat("%016" B_PRIx64, fHash);
+	return text;
+}
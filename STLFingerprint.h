@@ -0,0 +1,72 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_FINGERPRINT
+#define STLOVER_FINGERPRINT
+
+#include <OS.h>
+#include <String.h>
+
+#include <admesh/stl.h>
+
+#define FINGERPRINT_QUANTUM		1.0e-3	// mm, finer than any printer resolves
+#define FINGERPRINT_GRAIN		4096
+
+// Identity of a mesh that does not depend on how the file lists it. The
+// hash sums one hash per facet, each taken over vertices quantized relative
+// to the bounding box corner and started at the smallest one, so another
+// facet order or another first corner hash the same. A moved copy usually
+// does too, unless rounding of the move pushes a vertex over a quantum.
+// The descriptors (volume, area and principal moments of inertia) do not
+// depend on position, orientation or tessellation, models that match in
+// them within a tolerance are near duplicates.
+class STLFingerprint {
+	public:
+		STLFingerprint();
+		STLFingerprint(stl_file *stl);
+
+		uint64 Hash(void) const { return fHash; }
+		int32 CountFacets(void) const { return fFacets; }
+		double Volume(void) const { return fVolume; }
+		double Area(void) const { return fArea; }
+		const double* Moments(void) const { return fMoments; }
+
+		bool Equals(const STLFingerprint &other) const;
+		bool Similar(const STLFingerprint &other, double tolerance) const;
+		BString HashString(void) const;
+
+	private:
+		struct Sums {
+			uint64 hash;
+			double volume;
+			double area;
+			double first[3];
+			double second[3][3];
+		};
+
+		static void AddFacet(const stl_facet &facet, const stl_vertex &origin, Sums &sums);
+
+		uint64 fHash;
+		int32 fFacets;
+		double fVolume;
+		double fArea;
+		double fMoments[3];
+};
+
+#endif
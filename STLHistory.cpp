@@ -0,0 +1,450 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLHistory.h"
+#include "STLParallel.h"
+#include "STLTransform.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+
+#define HISTORY_RECORD	(sizeof(stl_facet) + sizeof(stl_neighbors))
+
+size_t
+STLHistory::Entry::Size(void) const
+{
+	size_t size = sizeof(Entry) + chunks.capacity() * sizeof(Chunk);
+	for (size_t i = 0; i < chunks.size(); i++)
+		size += chunks[i].data[0].capacity() + chunks[i].data[1].capacity();
+	return size;
+}
+
+STLHistory::STLHistory(size_t budget)
+	: fBudget(budget),
+	fSize(0),
+	fPosition(0),
+	fPending(NULL)
+{
+}
+
+STLHistory::~STLHistory()
+{
+	Clear();
+}
+
+void
+STLHistory::AddTransform(const glm::mat4 &matrix, bool join)
+{
+	if (join && fPosition > 0 && fPosition == fEntries.size()
+		&& fEntries.back()->type == HISTORY_TRANSFORM) {
+		fEntries.back()->matrix = matrix * fEntries.back()->matrix;
+		return;
+	}
+
+	Entry *entry = new Entry();
+	entry->type = HISTORY_TRANSFORM;
+	entry->matrix = matrix;
+	Push(entry);
+}
+
+void
+STLHistory::AddTitle(const char *before, const char *after)
+{
+	Entry *entry = new Entry();
+	entry->type = HISTORY_TITLE;
+	snprintf(entry->title[0], sizeof(entry->title[0]), "%s", before);
+	snprintf(entry->title[1], sizeof(entry->title[1]), "%s", after);
+	Push(entry);
+}
+
+bool
+STLHistory::BeginEdit(stl_file *stl)
+{
+	delete fPending;
+	fPending = new Entry();
+	fPending->type = HISTORY_FACETS;
+	fPending->facets[0] = stl->stats.number_of_facets;
+	fPending->stats[0] = stl->stats;
+	AddChunks(fPending, 0, fPending->facets[0]);
+	if (!Compress(fPending, 0, stl)) {
+		delete fPending;
+		fPending = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool
+STLHistory::EndEdit(stl_file *stl)
+{
+	Entry *entry = fPending;
+	fPending = NULL;
+	if (entry == NULL)
+		return false;
+
+	int32 count = stl->stats.number_of_facets;
+	entry->facets[1] = count;
+	entry->stats[1] = stl->stats;
+	if (count > entry->facets[0]) {
+		size_t first = entry->chunks.size();
+		AddChunks(entry, entry->facets[0], count - entry->facets[0]);
+		for (size_t i = first; i < entry->chunks.size(); i++)
+			entry->chunks[i].count[0] = 0;
+	}
+
+	if (!Compress(entry, 1, stl)) {
+		delete entry;
+		return false;
+	}
+
+	Push(entry);
+	return true;
+}
+
+bool
+STLHistory::AddEdit(stl_file *before, stl_file *after)
+{
+	int32 count = before->stats.number_of_facets;
+	int32 afterCount = after->stats.number_of_facets;
+	int32 total = std::max(count, afterCount);
+	bool neighbors = before->neighbors_start != NULL && after->neighbors_start != NULL;
+
+	// A facet whose neighbours changed is kept too, they come back with it
+	std::vector<uint8> changed(total);
+	ParallelFor(total, HISTORY_GRAIN, [&](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			changed[i] = i >= count || i >= afterCount
+				|| memcmp(&before->facet_start[i], &after->facet_start[i], sizeof(stl_facet)) != 0
+				|| !neighbors
+				|| memcmp(&before->neighbors_start[i], &after->neighbors_start[i],
+					sizeof(stl_neighbors)) != 0;
+		}
+	});
+
+	Entry *entry = new Entry();
+	entry->type = HISTORY_FACETS;
+	entry->facets[0] = count;
+	entry->facets[1] = afterCount;
+	entry->stats[0] = before->stats;
+	entry->stats[1] = after->stats;
+	for (int32 i = 0; i < total; i++) {
+		if (!changed[i])
+			continue;
+		int32 start = i;
+		while (i < total && changed[i])
+			i++;
+		AddChunks(entry, start, i - start);
+	}
+	std::vector<uint8>().swap(changed);
+
+	if (entry->chunks.empty()) {
+		delete entry;
+		return true;
+	}
+
+	if (!Compress(entry, 0, before) || !Compress(entry, 1, after)) {
+		delete entry;
+		return false;
+	}
+
+	Push(entry);
+	return true;
+}
+
+int32
+STLHistory::Undo(stl_file *stl)
+{
+	if (!CanUndo())
+		return HISTORY_NONE;
+
+	Entry *entry = fEntries[fPosition - 1];
+	switch (entry->type) {
+		case HISTORY_TRANSFORM:
+			STLTransform(glm::inverse(entry->matrix)).Apply(stl);
+			break;
+		case HISTORY_TITLE:
+			snprintf(stl->stats.header, sizeof(stl->stats.header), "%s", entry->title[0]);
+			break;
+		case HISTORY_FACETS:
+			if (!ApplyFacets(entry, 0, stl))
+				return HISTORY_NONE;
+			break;
+	}
+
+	fPosition--;
+	return entry->type;
+}
+
+int32
+STLHistory::Redo(stl_file *stl)
+{
+	if (!CanRedo())
+		return HISTORY_NONE;
+
+	Entry *entry = fEntries[fPosition];
+	switch (entry->type) {
+		case HISTORY_TRANSFORM:
+			STLTransform(entry->matrix).Apply(stl);
+			break;
+		case HISTORY_TITLE:
+			snprintf(stl->stats.header, sizeof(stl->stats.header), "%s", entry->title[1]);
+			break;
+		case HISTORY_FACETS:
+			if (!ApplyFacets(entry, 1, stl))
+				return HISTORY_NONE;
+			break;
+	}
+
+	fPosition++;
+	return entry->type;
+}
+
+void
+STLHistory::Clear(void)
+{
+	for (size_t i = 0; i < fEntries.size(); i++)
+		delete fEntries[i];
+	fEntries.clear();
+	fSize = 0;
+	fPosition = 0;
+	delete fPending;
+	fPending = NULL;
+}
+
+void
+STLHistory::Push(Entry *entry)
+{
+	// A new step ends the redo branch
+	for (size_t i = fPosition; i < fEntries.size(); i++) {
+		fSize -= fEntries[i]->Size();
+		delete fEntries[i];
+	}
+	fEntries.resize(fPosition);
+
+	fEntries.push_back(entry);
+	fSize += entry->Size();
+	fPosition++;
+	Trim();
+}
+
+void
+STLHistory::Trim(void)
+{
+	// Only the oldest steps can go, the rest still lead back from the
+	// current mesh
+	size_t drop = 0;
+	while (fSize > fBudget && drop < fEntries.size()) {
+		fSize -= fEntries[drop]->Size();
+		delete fEntries[drop];
+		drop++;
+	}
+	fEntries.erase(fEntries.begin(), fEntries.begin() + drop);
+	fPosition -= drop;
+}
+
+static inline bool
+Close(const stl_facet &a, const stl_facet &b, float tolerance)
+{
+	for (int k = 0; k < 3; k++) {
+		if (fabsf(a.vertex[k].x - b.vertex[k].x) > tolerance
+			|| fabsf(a.vertex[k].y - b.vertex[k].y) > tolerance
+			|| fabsf(a.vertex[k].z - b.vertex[k].z) > tolerance)
+			return false;
+	}
+	return true;
+}
+
+bool
+STLHistory::ApplyFacets(const Entry *entry, int32 side, stl_file *stl) const
+{
+	int32 other = 1 - side;
+	if (stl->stats.number_of_facets != entry->facets[other])
+		return false;
+
+	// Transforms undone since the step leave the facets a few roundings
+	// off, so the facets it replaces only have to be close to the ones
+	// it left. Nothing is touched unless every one of them is.
+	const stl_vertex &min = stl->stats.min;
+	const stl_vertex &max = stl->stats.max;
+	float extent = std::max(std::max(std::max(fabsf(min.x), fabsf(max.x)),
+		std::max(fabsf(min.y), fabsf(max.y))), std::max(fabsf(min.z), fabsf(max.z)));
+	float tolerance = extent * HISTORY_TOLERANCE;
+
+	int32 chunks = entry->chunks.size();
+	int32 failed = 0;
+	ParallelFor(chunks, 1, [&](int32 first, int32 last) {
+		std::vector<uint8> buffer;
+		std::vector<uint8> left;
+		for (int32 i = first; i < last && atomic_get(&failed) == 0; i++) {
+			const Chunk &chunk = entry->chunks[i];
+			if (!Decompress(chunk, side, buffer) || !Decompress(chunk, other, left)) {
+				atomic_set(&failed, 1);
+				break;
+			}
+			for (int32 j = 0; j < chunk.count[other]; j++) {
+				stl_facet facet;
+				memcpy(&facet, left.data() + j * sizeof(stl_facet), sizeof(stl_facet));
+				if (!Close(facet, stl->facet_start[chunk.start + j], tolerance)) {
+					atomic_set(&failed, 1);
+					break;
+				}
+			}
+		}
+	});
+	if (failed != 0)
+		return false;
+
+	// The stats come back whole, only the allocation is the mesh's own
+	stl_invalidate_shared_vertices(stl);
+	int32 malloced = stl->stats.facets_malloced;
+	stl->stats = entry->stats[side];
+	stl->stats.facets_malloced = malloced;
+	stl->stats.shared_vertices = 0;
+	stl->stats.shared_malloced = 0;
+
+	int32 count = entry->facets[side];
+	stl->stats.number_of_facets = count;
+	if (count > malloced) {
+		stl_reallocate(stl);
+		if (stl_get_error(stl))
+			return false;
+	}
+
+	// A vertex the step shares with a facet it replaces takes over the
+	// rounding that facet has now, so no cracks open towards the facets
+	// the step leaves alone
+	ParallelFor(chunks, 1, [&](int32 first, int32 last) {
+		std::vector<uint8> buffer;
+		std::vector<uint8> left;
+		for (int32 i = first; i < last; i++) {
+			const Chunk &chunk = entry->chunks[i];
+			Decompress(chunk, side, buffer);
+			Decompress(chunk, other, left);
+			int32 facets = chunk.count[side];
+			for (int32 j = 0; j < facets; j++) {
+				stl_facet facet;
+				memcpy(&facet, buffer.data() + j * sizeof(stl_facet), sizeof(stl_facet));
+				stl_facet &current = stl->facet_start[chunk.start + j];
+				if (j < chunk.count[other]) {
+					stl_facet replaced;
+					memcpy(&replaced, left.data() + j * sizeof(stl_facet), sizeof(stl_facet));
+					for (int k = 0; k < 3; k++) {
+						for (int m = 0; m < 3; m++) {
+							if (memcmp(&facet.vertex[k], &replaced.vertex[m], sizeof(stl_vertex)) == 0) {
+								facet.vertex[k] = current.vertex[m];
+								break;
+							}
+						}
+					}
+				}
+				current = facet;
+			}
+			if (stl->neighbors_start != NULL) {
+				memcpy(stl->neighbors_start + chunk.start, buffer.data() + facets * sizeof(stl_facet),
+					facets * sizeof(stl_neighbors));
+			}
+		}
+	});
+
+	return true;
+}
+
+void
+STLHistory::AddChunks(Entry *entry, int32 start, int32 length)
+{
+	int32 limit = HISTORY_BLOCK / HISTORY_RECORD;
+	for (int32 offset = 0; offset < length; offset += limit) {
+		Chunk chunk;
+		chunk.start = start + offset;
+		chunk.count[0] = chunk.count[1] = std::min(limit, length - offset);
+		chunk.size[0] = chunk.size[1] = 0;
+		entry->chunks.push_back(chunk);
+	}
+}
+
+bool
+STLHistory::Compress(Entry *entry, int32 side, stl_file *stl) const
+{
+	// Read from the mesh a batch of blocks at a time, a step that does
+	// not fit is given up there and is never held uncompressed
+	int32 chunks = entry->chunks.size();
+	size_t size = entry->Size();
+	for (int32 batch = 0; batch < chunks; batch += HISTORY_BATCH) {
+		int32 end = std::min(batch + HISTORY_BATCH, chunks);
+		ParallelFor(end - batch, 1, [&](int32 first, int32 last) {
+			std::vector<uint8> raw;
+			for (int32 i = batch + first; i < batch + last; i++) {
+				Chunk &chunk = entry->chunks[i];
+				int32 count = std::max(0,
+					std::min(chunk.start + chunk.count[side], entry->facets[side]) - chunk.start);
+				chunk.count[side] = count;
+				chunk.size[side] = 0;
+				chunk.data[side].clear();
+				if (count == 0)
+					continue;
+
+				raw.resize(count * HISTORY_RECORD);
+				memcpy(raw.data(), stl->facet_start + chunk.start, count * sizeof(stl_facet));
+				uint8 *neighbors = raw.data() + count * sizeof(stl_facet);
+				if (stl->neighbors_start != NULL) {
+					memcpy(neighbors, stl->neighbors_start + chunk.start,
+						count * sizeof(stl_neighbors));
+				} else
+					memset(neighbors, 0xff, count * sizeof(stl_neighbors));
+
+				uLongf compressed = compressBound(raw.size());
+				chunk.data[side].resize(compressed);
+				if (compress2(chunk.data[side].data(), &compressed, raw.data(), raw.size(),
+						Z_BEST_SPEED) == Z_OK && compressed < raw.size()) {
+					chunk.data[side].resize(compressed);
+					chunk.data[side].shrink_to_fit();
+					chunk.size[side] = compressed;
+				} else {
+					// Kept as it is, the zero size tells it apart
+					chunk.data[side] = raw;
+				}
+			}
+		});
+
+		for (int32 i = batch; i < end; i++)
+			size += entry->chunks[i].data[side].capacity();
+		if (size > fBudget)
+			return false;
+	}
+	return true;
+}
+
+bool
+STLHistory::Decompress(const Chunk &chunk, int32 side, std::vector<uint8> &buffer)
+{
+	uLongf size = chunk.count[side] * HISTORY_RECORD;
+	buffer.resize(size);
+	if (chunk.size[side] == 0) {
+		memcpy(buffer.data(), chunk.data[side].data(), size);
+		return true;
+	}
+
+	uLongf expected = size;
+	return uncompress(buffer.data(), &size, chunk.data[side].data(), chunk.size[side]) == Z_OK
+		&& size == expected;
+}
@@ -0,0 +1,115 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_HISTORY
+#define STLOVER_HISTORY
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define HISTORY_NONE		-1
+#define HISTORY_TRANSFORM	0
+#define HISTORY_TITLE		1
+#define HISTORY_FACETS		2
+
+#define HISTORY_BUDGET		(256 << 20)	// bytes kept for undo and redo
+#define HISTORY_BLOCK		(1 << 20)	// compressed on its own, all CPUs at once
+#define HISTORY_BATCH		16			// blocks compressed before the budget is checked
+#define HISTORY_GRAIN		65536
+#define HISTORY_TOLERANCE	1.0e-5f		// of the model's extent
+
+// Undo and redo for the edited model without copies of it. Affine edits
+// are kept as their matrix and undone with its inverse. Other edits keep
+// only the facets that changed and their neighbours, before and after,
+// read straight from the meshes and zlib-compressed in blocks. The oldest
+// steps are dropped once the budget is used up, a single step larger than
+// the budget is refused as soon as it gets there and the history kept.
+// An inverse matrix does not bring every vertex back bit for bit, so a
+// facet step is put back by facet index once the facets it replaces match
+// the ones it left within a tolerance, and vertices it shares with them
+// take over their rounding.
+class STLHistory {
+	public:
+		STLHistory(size_t budget = HISTORY_BUDGET);
+		~STLHistory();
+
+		// Join adds the matrix to the last step, for edits made in two
+		// passes that undo as one
+		void AddTransform(const glm::mat4 &matrix, bool join = false);
+		void AddTitle(const char *before, const char *after);
+
+		// An edit that changes every facet keeps the whole mesh before
+		// and after it. AddEdit() compares two meshes and keeps what
+		// differs. False if the step does not fit into the budget, it is
+		// not kept then and the steps before it no longer lead back to
+		// the mesh.
+		bool BeginEdit(stl_file *stl);
+		bool EndEdit(stl_file *stl);
+		bool AddEdit(stl_file *before, stl_file *after);
+
+		bool CanUndo(void) const { return fPosition > 0; }
+		bool CanRedo(void) const { return fPosition < fEntries.size(); }
+		// Return the HISTORY_ type of the step, HISTORY_NONE if there was
+		// none or the mesh no longer fits it, the history is kept then
+		int32 Undo(stl_file *stl);
+		int32 Redo(stl_file *stl);
+		void Clear(void);
+
+		size_t Size(void) const { return fSize; }
+
+	private:
+		// Facets [start, start + count) of either side with their
+		// neighbours, compressed or as they are when size is zero
+		struct Chunk {
+			int32 start;
+			int32 count[2];
+			uint32 size[2];
+			std::vector<uint8> data[2];
+		};
+
+		struct Entry {
+			int32 type;
+			glm::mat4 matrix;
+			char title[2][81];
+			int32 facets[2];
+			stl_stats stats[2];
+			std::vector<Chunk> chunks;
+
+			size_t Size(void) const;
+		};
+
+		void Push(Entry *entry);
+		void Trim(void);
+		bool ApplyFacets(const Entry *entry, int32 side, stl_file *stl) const;
+		static void AddChunks(Entry *entry, int32 start, int32 length);
+		bool Compress(Entry *entry, int32 side, stl_file *stl) const;
+		static bool Decompress(const Chunk &chunk, int32 side, std::vector<uint8> &buffer);
+
+		size_t fBudget;
+		size_t fSize;
+		size_t fPosition;
+		std::vector<Entry*> fEntries;
+
+		Entry *fPending;
+};
+
+#endif
@@ -0,0 +1,602 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLHull.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <set>
+
+static inline glm::vec3
+Vertex(stl_file *stl, int32 index)
+{
+	const stl_vertex &v = stl->facet_start[index / 3].vertex[index % 3];
+	return glm::vec3(v.x, v.y, v.z);
+}
+
+// Index of the vertex for which score is largest, searched on all CPUs.
+// Ties go to the lower index so the result does not depend on timing.
+template<typename Score>
+static int32
+ParallelArgMax(int32 count, Score score)
+{
+	struct Best {
+		int32 index;
+		double value;
+	};
+	std::vector<Best> chunks((count + HULL_GRAIN - 1) / HULL_GRAIN);
+	ParallelFor(count, HULL_GRAIN, [&chunks, &score](int32 first, int32 last) {
+		Best best = { first, score(first) };
+		for (int32 i = first + 1; i < last; i++) {
+			double value = score(i);
+			if (value > best.value) {
+				best.index = i;
+				best.value = value;
+			}
+		}
+		chunks[first / HULL_GRAIN] = best;
+	});
+
+	Best best = chunks[0];
+	for (size_t c = 1; c < chunks.size(); c++) {
+		if (chunks[c].value > best.value)
+			best = chunks[c];
+	}
+	return best.index;
+}
+
+static inline void
+Cross(const int64 a[3], const int64 b[3], int64 result[3])
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+STLHull::STLHull(stl_file *stl)
+	: fStl(stl),
+	fScale(0),
+	fVolume(0),
+	fArea(0),
+	fBox()
+{
+	std::vector<Point> points;
+	if (!Initial(points))
+		return;
+
+	Build(points);
+
+	// Keep the live faces and the points they use only
+	std::vector<int32> remap(fPoints.size(), -1);
+	glm::dvec3 inside(0.0);
+	for (int k = 0; k < 4; k++)
+		inside += glm::dvec3(fPoints[k].position) / 4.0;
+
+	for (size_t f = 0; f < fFaces.size(); f++) {
+		const Face &face = fFaces[f];
+		if (!face.alive)
+			continue;
+
+		for (int k = 0; k < 3; k++) {
+			int32 &index = remap[face.vertex[k]];
+			if (index < 0) {
+				index = fVertices.size();
+				fVertices.push_back(fPoints[face.vertex[k]].position);
+			}
+			fTriangles.push_back(index);
+		}
+
+		glm::dvec3 a = glm::dvec3(fPoints[face.vertex[0]].position) - inside;
+		glm::dvec3 b = glm::dvec3(fPoints[face.vertex[1]].position) - inside;
+		glm::dvec3 c = glm::dvec3(fPoints[face.vertex[2]].position) - inside;
+		fArea += 0.5 * glm::length(glm::cross(b - a, c - a));
+		fVolume += glm::dot(a, glm::cross(b, c)) / 6.0;
+	}
+
+	fPoints.clear();
+	fFaces.clear();
+
+	FitBox();
+}
+
+STLHull::Point
+STLHull::Snap(int32 index) const
+{
+	Point point;
+	point.position = Vertex(fStl, index);
+	for (int i = 0; i < 3; i++)
+		point.grid[i] = llround((point.position[i] - fOrigin[i]) * fScale);
+	return point;
+}
+
+bool
+STLHull::Less(const Point &a, const Point &b)
+{
+	if (a.grid[0] != b.grid[0])
+		return a.grid[0] < b.grid[0];
+	if (a.grid[1] != b.grid[1])
+		return a.grid[1] < b.grid[1];
+	return a.grid[2] < b.grid[2];
+}
+
+int64
+STLHull::Height(const Face &face, const Point &point) const
+{
+	// Coordinates fit in 21 bits and normals in 42, the sum stays below 2^63
+	const int64 *a = fPoints[face.vertex[0]].grid;
+	return face.normal[0] * (point.grid[0] - a[0]) + face.normal[1] * (point.grid[1] - a[1])
+		+ face.normal[2] * (point.grid[2] - a[2]);
+}
+
+bool
+STLHull::Initial(std::vector<Point> &points)
+{
+	int32 count = fStl->stats.number_of_facets * 3;
+	if (count < 4)
+		return false;
+
+	// Extreme vertices along the axes give the grid and the first edge
+	int32 extreme[6];
+	for (int axis = 0; axis < 3; axis++) {
+		extreme[axis * 2] = ParallelArgMax(count, [this, axis](int32 i) {
+			return -(double)Vertex(fStl, i)[axis]; });
+		extreme[axis * 2 + 1] = ParallelArgMax(count, [this, axis](int32 i) {
+			return (double)Vertex(fStl, i)[axis]; });
+	}
+
+	double size = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		double low = Vertex(fStl, extreme[axis * 2])[axis];
+		double high = Vertex(fStl, extreme[axis * 2 + 1])[axis];
+		fOrigin[axis] = low;
+		size = std::max(size, high - low);
+	}
+	if (size <= 0)
+		return false;
+	fScale = HULL_GRID / size;
+
+	Point a, b;
+	double longest = -1;
+	for (int i = 0; i < 6; i++) {
+		for (int j = i + 1; j < 6; j++) {
+			Point p = Snap(extreme[i]);
+			Point q = Snap(extreme[j]);
+			double dx = p.grid[0] - q.grid[0];
+			double dy = p.grid[1] - q.grid[1];
+			double dz = p.grid[2] - q.grid[2];
+			double length = dx * dx + dy * dy + dz * dz;
+			if (length > longest) {
+				longest = length;
+				a = p;
+				b = q;
+			}
+		}
+	}
+
+	int64 ab[3] = { b.grid[0] - a.grid[0], b.grid[1] - a.grid[1], b.grid[2] - a.grid[2] };
+	Point c = Snap(ParallelArgMax(count, [this, &a, &ab](int32 i) {
+		Point p = Snap(i);
+		int64 ap[3] = { p.grid[0] - a.grid[0], p.grid[1] - a.grid[1], p.grid[2] - a.grid[2] };
+		int64 cross[3];
+		Cross(ab, ap, cross);
+		return (double)cross[0] * cross[0] + (double)cross[1] * cross[1]
+			+ (double)cross[2] * cross[2];
+	}));
+
+	fPoints.push_back(a);
+	fPoints.push_back(b);
+	fPoints.push_back(c);
+	AddFace(0, 1, 2);
+	const Face base = fFaces[0];
+	fFaces.clear();
+	if (base.length == 0)
+		return false;
+
+	Point d = Snap(ParallelArgMax(count, [this, &base](int32 i) {
+		return fabs((double)Height(base, Snap(i)));
+	}));
+	int64 height = Height(base, d);
+	if (height == 0)
+		return false;
+
+	// The tetrahedron faces point away from the opposite corner
+	if (height > 0)
+		std::swap(fPoints[1], fPoints[2]);
+	fPoints.push_back(d);
+
+	AddFace(0, 1, 2);
+	AddFace(0, 3, 1);
+	AddFace(1, 3, 2);
+	AddFace(2, 3, 0);
+	int32 neighbors[4][3] = { { 1, 2, 3 }, { 3, 2, 0 }, { 1, 3, 0 }, { 2, 1, 0 } };
+	for (int f = 0; f < 4; f++)
+		for (int k = 0; k < 3; k++)
+			fFaces[f].neighbor[k] = neighbors[f][k];
+
+	// Everything inside the tetrahedron can never be on the hull, that
+	// is the bulk of the vertices of most models. Chunks keep their
+	// survivors apart so the order is the same on any number of CPUs.
+	std::vector<std::vector<Point> > chunks((count + HULL_GRAIN - 1) / HULL_GRAIN);
+	ParallelFor(count, HULL_GRAIN, [this, &chunks](int32 first, int32 last) {
+		std::vector<Point> &outside = chunks[first / HULL_GRAIN];
+		for (int32 i = first; i < last; i++) {
+			Point p = Snap(i);
+			for (int f = 0; f < 4; f++) {
+				if (Height(fFaces[f], p) > 0) {
+					outside.push_back(p);
+					break;
+				}
+			}
+		}
+	});
+
+	for (size_t c = 0; c < chunks.size(); c++)
+		points.insert(points.end(), chunks[c].begin(), chunks[c].end());
+
+	// Every vertex is listed by each facet around it, and close vertices
+	// share a grid point
+	std::sort(points.begin(), points.end(), Less);
+	points.erase(std::unique(points.begin(), points.end(),
+		[](const Point &p, const Point &q) { return !Less(p, q) && !Less(q, p); }),
+		points.end());
+
+	return true;
+}
+
+void
+STLHull::Build(std::vector<Point> &points)
+{
+	std::vector<int32> candidates(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		candidates[i] = fPoints.size();
+		fPoints.push_back(points[i]);
+	}
+	std::vector<Point>().swap(points);
+
+	std::vector<int32> faces = { 0, 1, 2, 3 };
+	Assign(candidates, faces);
+
+	std::vector<int32> pending;
+	for (int32 f = 0; f < 4; f++) {
+		if (!fFaces[f].outside.empty())
+			pending.push_back(f);
+	}
+
+	// Per point scratch to link the new faces around the horizon
+	std::vector<int32> startsAt(fPoints.size(), -1);
+	std::vector<int32> endsAt(fPoints.size(), -1);
+
+	struct Horizon {
+		int32 from;
+		int32 to;
+		int32 face;
+	};
+	std::vector<Horizon> horizon;
+	std::vector<int32> visited;
+	std::vector<int32> stack;
+	std::vector<int32> visible;
+	std::vector<int32> orphans;
+	int32 stamp = 0;
+
+	while (!pending.empty()) {
+		int32 current = pending.back();
+		pending.pop_back();
+		if (!fFaces[current].alive || fFaces[current].outside.empty())
+			continue;
+
+		int32 eye = fFaces[current].farthest;
+		const Point &point = fPoints[eye];
+
+		// Walk the faces the eye point sees, the edges to faces it does
+		// not see form the horizon. The test is exact, so the faces seen
+		// always form a disc and the horizon a single loop.
+		stamp++;
+		visited.resize(fFaces.size(), 0);
+		visible.clear();
+		horizon.clear();
+		stack.assign(1, current);
+		visited[current] = stamp;
+		while (!stack.empty()) {
+			int32 f = stack.back();
+			stack.pop_back();
+			visible.push_back(f);
+			for (int k = 0; k < 3; k++) {
+				int32 n = fFaces[f].neighbor[k];
+				if (visited[n] == stamp)
+					continue;
+				if (Height(fFaces[n], point) > 0) {
+					visited[n] = stamp;
+					stack.push_back(n);
+				} else {
+					horizon.push_back({ fFaces[f].vertex[k],
+						fFaces[f].vertex[(k + 1) % 3], n });
+				}
+			}
+		}
+
+		orphans.clear();
+		for (size_t i = 0; i < visible.size(); i++) {
+			Face &face = fFaces[visible[i]];
+			face.alive = false;
+			for (size_t j = 0; j < face.outside.size(); j++) {
+				if (face.outside[j] != eye)
+					orphans.push_back(face.outside[j]);
+			}
+			std::vector<int32>().swap(face.outside);
+		}
+
+		faces.clear();
+		for (size_t i = 0; i < horizon.size(); i++) {
+			const Horizon &edge = horizon[i];
+			int32 added = AddFace(edge.from, edge.to, eye);
+			fFaces[added].neighbor[0] = edge.face;
+
+			Face &outer = fFaces[edge.face];
+			for (int k = 0; k < 3; k++) {
+				if (outer.vertex[k] == edge.to && outer.vertex[(k + 1) % 3] == edge.from)
+					outer.neighbor[k] = added;
+			}
+
+			startsAt[edge.from] = added;
+			endsAt[edge.to] = added;
+			faces.push_back(added);
+		}
+
+		for (size_t i = 0; i < faces.size(); i++) {
+			Face &face = fFaces[faces[i]];
+			face.neighbor[1] = startsAt[face.vertex[1]];
+			face.neighbor[2] = endsAt[face.vertex[0]];
+		}
+
+		for (size_t i = 0; i < horizon.size(); i++) {
+			startsAt[horizon[i].from] = -1;
+			endsAt[horizon[i].to] = -1;
+		}
+
+		Assign(orphans, faces);
+		for (size_t i = 0; i < faces.size(); i++) {
+			if (!fFaces[faces[i]].outside.empty())
+				pending.push_back(faces[i]);
+		}
+	}
+}
+
+int32
+STLHull::AddFace(int32 a, int32 b, int32 c)
+{
+	const int64 *pa = fPoints[a].grid;
+	const int64 *pb = fPoints[b].grid;
+	const int64 *pc = fPoints[c].grid;
+	int64 ab[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+	int64 ac[3] = { pc[0] - pa[0], pc[1] - pa[1], pc[2] - pa[2] };
+
+	fFaces.resize(fFaces.size() + 1);
+	Face &face = fFaces.back();
+	face.vertex[0] = a;
+	face.vertex[1] = b;
+	face.vertex[2] = c;
+	face.neighbor[0] = face.neighbor[1] = face.neighbor[2] = -1;
+	Cross(ab, ac, face.normal);
+	face.length = sqrt((double)face.normal[0] * face.normal[0]
+		+ (double)face.normal[1] * face.normal[1] + (double)face.normal[2] * face.normal[2]);
+	face.farthest = -1;
+	face.farthestHeight = 0;
+	face.alive = true;
+
+	return fFaces.size() - 1;
+}
+
+void
+STLHull::Assign(const std::vector<int32> &points, const std::vector<int32> &faces)
+{
+	// Every point goes to the face it is farthest above, points above
+	// none of them are inside the hull for good
+	std::vector<int32> target(points.size());
+	ParallelFor(points.size(), HULL_GRAIN, [this, &points, &faces, &target](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			const Point &point = fPoints[points[i]];
+			double best = 0;
+			target[i] = -1;
+			for (size_t f = 0; f < faces.size(); f++) {
+				const Face &face = fFaces[faces[f]];
+				int64 height = Height(face, point);
+				if (height > 0 && height / face.length > best) {
+					best = height / face.length;
+					target[i] = faces[f];
+				}
+			}
+		}
+	});
+
+	for (size_t i = 0; i < points.size(); i++) {
+		if (target[i] < 0)
+			continue;
+
+		Face &face = fFaces[target[i]];
+		int64 height = Height(face, fPoints[points[i]]);
+		face.outside.push_back(points[i]);
+		if (height > face.farthestHeight) {
+			face.farthestHeight = height;
+			face.farthest = points[i];
+		}
+	}
+}
+
+void
+STLHull::FitBox(void)
+{
+	if (!IsValid())
+		return;
+
+	// Face directions, largest faces first, one per direction cell. A
+	// face and its opposite give the same box, so they share a key.
+	struct Direction {
+		double area;
+		glm::dvec3 normal;
+	};
+	std::vector<Direction> directions;
+	for (size_t t = 0; t < fTriangles.size(); t += 3) {
+		glm::dvec3 a(fVertices[fTriangles[t]]);
+		glm::dvec3 b(fVertices[fTriangles[t + 1]]);
+		glm::dvec3 c(fVertices[fTriangles[t + 2]]);
+		glm::dvec3 normal = glm::cross(b - a, c - a);
+		double length = glm::length(normal);
+		if (length > 0)
+			directions.push_back({ length, normal / length });
+	}
+	std::stable_sort(directions.begin(), directions.end(),
+		[](const Direction &a, const Direction &b) { return a.area > b.area; });
+
+	size_t limit = std::min<size_t>(HULL_BOX_CANDIDATES,
+		std::max<size_t>(1, HULL_BOX_BUDGET / fVertices.size()));
+	std::vector<glm::dvec3> candidates = {
+		glm::dvec3(1, 0, 0), glm::dvec3(0, 1, 0), glm::dvec3(0, 0, 1)
+	};
+	std::set<uint64> keys;
+	for (size_t d = 0; d < directions.size() && candidates.size() < limit + 3; d++) {
+		glm::dvec3 normal = directions[d].normal;
+		int axis = fabs(normal.x) >= fabs(normal.y)
+			? (fabs(normal.x) >= fabs(normal.z) ? 0 : 2)
+			: (fabs(normal.y) >= fabs(normal.z) ? 1 : 2);
+		if (normal[axis] < 0)
+			normal = -normal;
+		uint64 key = 0;
+		for (int k = 0; k < 3; k++)
+			key = key * 1024 + (uint64)lround((normal[k] + 1.0) * 511.5);
+		if (!keys.insert(key).second)
+			continue;
+		candidates.push_back(normal);
+	}
+
+	std::vector<Box> boxes(candidates.size());
+	ParallelFor(candidates.size(), 1, [this, &candidates, &boxes](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++)
+			boxes[i] = FitBox(candidates[i]);
+	});
+
+	fBox = boxes[0];
+	for (size_t i = 1; i < boxes.size(); i++) {
+		if (boxes[i].volume < fBox.volume)
+			fBox = boxes[i];
+	}
+}
+
+STLHull::Box
+STLHull::FitBox(const glm::dvec3 &normal) const
+{
+	glm::dvec3 side = fabs(normal.x) < 0.9 ? glm::dvec3(1, 0, 0) : glm::dvec3(0, 1, 0);
+	glm::dvec3 u = glm::normalize(glm::cross(normal, side));
+	glm::dvec3 v = glm::cross(normal, u);
+
+	// Outline of the hull seen along the normal, counter-clockwise
+	struct Point2 {
+		double x, y;
+	};
+	std::vector<Point2> points(fVertices.size());
+	double low = DBL_MAX;
+	double high = -DBL_MAX;
+	for (size_t i = 0; i < fVertices.size(); i++) {
+		glm::dvec3 p(fVertices[i]);
+		points[i] = { glm::dot(p, u), glm::dot(p, v) };
+		low = std::min(low, glm::dot(p, normal));
+		high = std::max(high, glm::dot(p, normal));
+	}
+	std::sort(points.begin(), points.end(), [](const Point2 &a, const Point2 &b) {
+		return a.x < b.x || (a.x == b.x && a.y < b.y);
+	});
+
+	auto turn = [](const Point2 &o, const Point2 &a, const Point2 &b) {
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	};
+	std::vector<Point2> outline(2 * points.size());
+	size_t count = 0;
+	for (size_t i = 0; i < points.size(); i++) {
+		while (count >= 2 && turn(outline[count - 2], outline[count - 1], points[i]) <= 0)
+			count--;
+		outline[count++] = points[i];
+	}
+	for (size_t i = points.size() - 1, lower = count + 1; i-- > 0;) {
+		while (count >= lower && turn(outline[count - 2], outline[count - 1], points[i]) <= 0)
+			count--;
+		outline[count++] = points[i];
+	}
+	outline.resize(count - 1);
+	size_t n = outline.size();
+
+	Box box;
+	box.volume = DBL_MAX;
+	if (n < 3)
+		return box;
+
+	// Rotating calipers: one rectangle side on each outline edge, the
+	// points touching the other three sides only ever move forward
+	auto along = [&outline](size_t i, double ex, double ey) {
+		return outline[i].x * ex + outline[i].y * ey;
+	};
+	size_t right = 0, top = 0, left = 0;
+	for (size_t e = 0; e < n; e++) {
+		const Point2 &a = outline[e];
+		const Point2 &b = outline[(e + 1) % n];
+		double length = hypot(b.x - a.x, b.y - a.y);
+		if (length <= 0)
+			continue;
+		double ex = (b.x - a.x) / length;
+		double ey = (b.y - a.y) / length;
+
+		if (e == 0) {
+			for (size_t i = 1; i < n; i++) {
+				if (along(i, ex, ey) > along(right, ex, ey))
+					right = i;
+				if (along(i, -ey, ex) > along(top, -ey, ex))
+					top = i;
+				if (along(i, ex, ey) < along(left, ex, ey))
+					left = i;
+			}
+		} else {
+			while (along((right + 1) % n, ex, ey) > along(right, ex, ey))
+				right = (right + 1) % n;
+			while (along((top + 1) % n, -ey, ex) > along(top, -ey, ex))
+				top = (top + 1) % n;
+			while (along((left + 1) % n, ex, ey) < along(left, ex, ey))
+				left = (left + 1) % n;
+		}
+
+		double minU = along(left, ex, ey);
+		double maxU = along(right, ex, ey);
+		double minV = along(e, -ey, ex);
+		double maxV = along(top, -ey, ex);
+		double volume = (maxU - minU) * (maxV - minV) * (high - low);
+		if (volume >= box.volume)
+			continue;
+
+		glm::dvec3 axisU = u * ex + v * ey;
+		glm::dvec3 axisV = u * -ey + v * ex;
+		box.volume = volume;
+		box.center = glm::vec3(axisU * ((minU + maxU) / 2) + axisV * ((minV + maxV) / 2)
+			+ normal * ((low + high) / 2));
+		box.axes[0] = glm::vec3(axisU);
+		box.axes[1] = glm::vec3(axisV);
+		box.axes[2] = glm::vec3(normal);
+		box.size = glm::vec3(maxU - minU, maxV - minV, high - low);
+	}
+
+	return box;
+}
@@ -0,0 +1,107 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_HULL
+#define STLOVER_HULL
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define HULL_GRAIN		8192
+#define HULL_GRID		(1 << 20)
+#define HULL_BOX_CANDIDATES	1024		// face directions tried for the box
+#define HULL_BOX_BUDGET		(1 << 23)	// hull vertices projected in total
+
+// Convex hull of the mesh vertices by quickhull. Vertices are snapped to a
+// grid of HULL_GRID steps over the model size, which keeps every
+// orientation test exact in 64-bit integers, so the hull never folds over
+// itself on dense nearly flat areas. Extreme points and the initial
+// tetrahedron are found on all CPUs, which also throw out every vertex
+// inside that tetrahedron, usually almost all of them. The faces are then
+// grown one farthest point at a time, points of the faces that get
+// replaced are handed to the new faces in parallel.
+//
+// The minimum volume box is searched over orientations with one side flush
+// to a hull face, the largest faces first, plus the coordinate axes. For
+// each of them the hull is projected onto the face plane and the smallest
+// rectangle around its outline is found by rotating calipers; the
+// orientations are tried on all CPUs.
+class STLHull {
+	public:
+		struct Box {
+			glm::vec3 center;
+			glm::vec3 axes[3];
+			glm::vec3 size;
+			double volume;
+		};
+
+		STLHull(stl_file *stl);
+
+		const std::vector<glm::vec3>& Vertices(void) const { return fVertices; }
+		// Three vertex indices per face, counter-clockwise seen from outside
+		const std::vector<int32>& Triangles(void) const { return fTriangles; }
+		bool IsValid(void) const { return !fTriangles.empty(); }
+		double Volume(void) const { return fVolume; }
+		double Area(void) const { return fArea; }
+		const Box& MinimumBox(void) const { return fBox; }
+
+	private:
+		struct Point {
+			int64 grid[3];
+			glm::vec3 position;
+		};
+
+		struct Face {
+			int32 vertex[3];
+			int32 neighbor[3];
+			int64 normal[3];
+			double length;
+			std::vector<int32> outside;
+			int32 farthest;
+			int64 farthestHeight;
+			bool alive;
+		};
+
+		Point Snap(int32 index) const;
+		bool Initial(std::vector<Point> &points);
+		void Build(std::vector<Point> &points);
+		int32 AddFace(int32 a, int32 b, int32 c);
+		void Assign(const std::vector<int32> &points, const std::vector<int32> &faces);
+		int64 Height(const Face &face, const Point &point) const;
+		static bool Less(const Point &a, const Point &b);
+		void FitBox(void);
+		Box FitBox(const glm::dvec3 &normal) const;
+
+		stl_file *fStl;
+		glm::dvec3 fOrigin;
+		double fScale;
+		std::vector<Point> fPoints;
+		std::vector<Face> fFaces;
+
+		std::vector<glm::vec3> fVertices;
+		std::vector<int32> fTriangles;
+		double fVolume;
+		double fArea;
+		Box fBox;
+};
+
+#endif
@@ -114,6 +114,17 @@ STLInputWindow::AddSliderField(const char* name, const char* label, float defaul
 	fFields.push_back(field);
 }
 
+void
+STLInputWindow::AddCheckBoxField(const char* name, const char* label, bool defaultValue)
+{
+	FieldInfo field = {CHECKBOX_FIELD, name, label, defaultValue ? "1" : "0", nullptr, nullptr, 0, 0,
+			{255, 255, 255, 255}, false, true, 0};
+	BCheckBox* checkBox = new BCheckBox(name, "", new BMessage(MSG_INPUT_VALUE_UPDATED));
+	checkBox->SetValue(defaultValue ? B_CONTROL_ON : B_CONTROL_OFF);
+	field.control = checkBox;
+	fFields.push_back(field);
+}
+
 void
 STLInputWindow::AddGroup(const char* name, const char* label, int32 count)
 {
@@ -247,6 +258,9 @@ STLInputWindow::MakeMessage(uint32 what, uint32 extended)
 			case SLIDER_FIELD:
 				message->AddFloat(field.name, ((BSlider*)field.control)->Value() / 100.0);
 				break;
+			case CHECKBOX_FIELD:
+				message->AddBool(field.name, ((BCheckBox*)field.control)->Value() == B_CONTROL_ON);
+				break;
 		}
 	}
 
@@ -321,6 +335,10 @@ STLInputWindow::MessageReceived(BMessage* message)
 				case SLIDER_FIELD:
 					SetSliderFieldValue(field.name, atof(field.defaultValue));
 					break;
+				case CHECKBOX_FIELD:
+					((BCheckBox*)field.control)->SetValue(field.defaultValue == "1"
+						? B_CONTROL_ON : B_CONTROL_OFF);
+					break;
 				}
 			}
 			fTargetMessenger.SendMessage(MakeMessage(MSG_INPUT_VALUE_UPDATED, message->what));
@@ -414,6 +432,20 @@ STLInputWindow::SetSliderFieldValue(const char* name, float value)
 	}
 }
 
+void
+STLInputWindow::SetCheckBoxFieldValue(const char* name, bool value)
+{
+	if (LockWithTimeout(1000) == B_OK) {
+		FieldInfo* field = FindField(name);
+		if (field && field->type == CHECKBOX_FIELD) {
+			BCheckBox* checkBox = dynamic_cast<BCheckBox*>(field->control);
+			if (checkBox)
+				checkBox->SetValue(value ? B_CONTROL_ON : B_CONTROL_OFF);
+		}
+		UnlockLooper();
+	}
+}
+
 void
 STLInputWindow::SetFieldBackgroundColor(const char* name, rgb_color color)
 {
@@ -469,6 +501,8 @@ STLInputWindow::ApplyFieldEditable(BView* control, bool editable)
 			slider->SetEnabled(editable);
 		} else if (BSpinner* spinner = dynamic_cast<BSpinner*>(control)) {
 			spinner->TextView()->MakeEditable(editable);
+		} else if (BCheckBox* checkBox = dynamic_cast<BCheckBox*>(control)) {
+			checkBox->SetEnabled(editable);
 		}
 	}
 }
@@ -490,6 +524,7 @@ STLInputWindow::IsValid()
 			case TEXT_FIELD:
 			case INTEGER_FIELD:
 			case SLIDER_FIELD:
+			case CHECKBOX_FIELD:
 				break;
 		}
 		if (!allFieldsValid)
@@ -25,6 +25,7 @@
 #include <View.h>
 #include <Window.h>
 #include <Button.h>
+#include <CheckBox.h>
 #include <String.h>
 #include <StringList.h>
 #include <TextControl.h>
@@ -50,6 +51,7 @@ enum FieldType {
 	INTEGER_FIELD,
 	FLOAT_FIELD,
 	SLIDER_FIELD,
+	CHECKBOX_FIELD,
 	GROUP_FIELD
 };
 
@@ -95,12 +97,14 @@ class STLInputWindow : public BWindow {
 				float minValue = -FLT_MAX, float maxValue = FLT_MAX);
 		void AddSliderField(const char* name, const char* label, float defaultValue = 0.0f,
 				float minValue = 0.0f, float maxValue = 100.0f);
+		void AddCheckBoxField(const char* name, const char* label, bool defaultValue = false);
 		void AddGroup(const char* name, const char* label, int32 count);
 
 		void SetTextFieldValue(const char* name, const char* value);
 		void SetIntegerFieldValue(const char* name, int value);
 		void SetFloatFieldValue(const char* name, float value);
 		void SetSliderFieldValue(const char* name, float value);
+		void SetCheckBoxFieldValue(const char* name, bool value);
 
 		void SetFieldBackgroundColor(const char* name, rgb_color color);
 		void SetFieldEditable(const char*name, bool editable);
@@ -0,0 +1,541 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "STLIntersections.h"
+#include "STLBVH.h"
+#include "STLParallel.h"
+
+#include <Autolock.h>
+#include <Locker.h>
+
+#include <algorithm>
+#include <cmath>
+
+#define INTERSECTIONS_GRAIN		4096
+
+// Rounding error bounds of the plain orient3d and orient2d determinants,
+// relative to the sum of the magnitudes of their terms (Shewchuk). Results
+// inside the bound are recomputed exactly.
+#define ORIENT3D_ERROR_BOUND	7.7715611723761027e-16
+#define ORIENT2D_ERROR_BOUND	3.3306690738754716e-16
+
+struct Point3 {
+	double x, y, z;
+};
+
+struct Point2 {
+	double u, v;
+};
+
+static inline Point3
+ToPoint(const stl_vertex &v)
+{
+	return {v.x, v.y, v.z};
+}
+
+// Dekker's split, so the exact path does not depend on a hardware FMA
+static inline void
+Split(double a, double &high, double &low)
+{
+	double c = 134217729.0 * a;
+	high = c - (c - a);
+	low = a - high;
+}
+
+static inline void
+TwoProduct(double a, double b, double &x, double &y)
+{
+	double aHigh, aLow, bHigh, bLow;
+	x = a * b;
+	Split(a, aHigh, aLow);
+	Split(b, bHigh, bLow);
+	y = aLow * bLow - (((x - aHigh * bHigh) - aLow * bHigh) - aHigh * bLow);
+}
+
+static inline void
+TwoSum(double a, double b, double &x, double &y)
+{
+	x = a + b;
+	double bVirtual = x - a;
+	double aVirtual = x - bVirtual;
+	y = (a - aVirtual) + (b - bVirtual);
+}
+
+static inline void
+FastTwoSum(double a, double b, double &x, double &y)
+{
+	x = a + b;
+	y = b - (x - a);
+}
+
+static inline void
+TwoDiff(double a, double b, double &x, double &y)
+{
+	x = a - b;
+	double bVirtual = a - x;
+	double aVirtual = x + bVirtual;
+	y = (a - aVirtual) + (bVirtual - b);
+}
+
+// The expansions below are nonoverlapping, kept in increasing magnitude
+// and free of zeros, so the last component carries the sign
+
+// Adds b to the expansion e in place
+static void
+GrowExpansion(double *e, int32 &length, double b)
+{
+	double q = b;
+	int32 count = 0;
+	for (int32 i = 0; i < length; i++) {
+		double sum, error;
+		TwoSum(q, e[i], sum, error);
+		q = sum;
+		if (error != 0.0)
+			e[count++] = error;
+	}
+	if (q != 0.0 || count == 0)
+		e[count++] = q;
+	length = count;
+}
+
+// Product of the expansion e and b, at most twice as long as e
+static int32
+ScaleExpansion(const double *e, int32 length, double b, double *h)
+{
+	double q, error;
+	int32 count = 0;
+	TwoProduct(e[0], b, q, error);
+	if (error != 0.0)
+		h[count++] = error;
+	for (int32 i = 1; i < length; i++) {
+		double high, low, sum;
+		TwoProduct(e[i], b, high, low);
+		TwoSum(q, low, sum, error);
+		if (error != 0.0)
+			h[count++] = error;
+		FastTwoSum(high, sum, q, error);
+		if (error != 0.0)
+			h[count++] = error;
+	}
+	if (q != 0.0 || count == 0)
+		h[count++] = q;
+	return count;
+}
+
+// Product of two expansions, e scaled by every component of f and summed.
+// The scaled parts hold up to 32 components.
+static int32
+MultiplyExpansions(const double *e, int32 eLength, const double *f, int32 fLength,
+	double *h)
+{
+	double scaled[32];
+	int32 length = 0;
+	for (int32 i = 0; i < fLength; i++) {
+		int32 count = ScaleExpansion(e, eLength, f[i], scaled);
+		for (int32 j = 0; j < count; j++)
+			GrowExpansion(h, length, scaled[j]);
+	}
+	return length;
+}
+
+static inline int32
+ExpansionSign(const double *e, int32 length)
+{
+	double top = e[length - 1];
+	return top > 0.0 ? 1 : (top < 0.0 ? -1 : 0);
+}
+
+// Coordinate differences are taken as two-component expansions, so the
+// whole determinant is exact even when the coordinates are far apart
+static inline int32
+Difference(double a, double b, double *e)
+{
+	double high, low;
+	TwoDiff(a, b, high, low);
+	int32 length = 0;
+	if (low != 0.0)
+		e[length++] = low;
+	e[length++] = high;
+	return length;
+}
+
+// p * q - r * s of differences, up to 16 components
+static int32
+Minor(const double *p, int32 pLength, const double *q, int32 qLength,
+	const double *r, int32 rLength, const double *s, int32 sLength, double *h)
+{
+	double product[8];
+	int32 length = MultiplyExpansions(p, pLength, q, qLength, h);
+	int32 count = MultiplyExpansions(r, rLength, s, sLength, product);
+	for (int32 i = 0; i < count; i++)
+		GrowExpansion(h, length, -product[i]);
+	return length;
+}
+
+// Shewchuk's orient3d evaluated exactly, every product through TwoProduct
+// and every sum as an expansion
+static int32
+Orient3dExact(const Point3 &o, const Point3 &a, const Point3 &b, const Point3 &c)
+{
+	double ax[2], ay[2], az[2], bx[2], by[2], bz[2], cx[2], cy[2], cz[2];
+	int32 axLength = Difference(a.x, o.x, ax);
+	int32 ayLength = Difference(a.y, o.y, ay);
+	int32 azLength = Difference(a.z, o.z, az);
+	int32 bxLength = Difference(b.x, o.x, bx);
+	int32 byLength = Difference(b.y, o.y, by);
+	int32 bzLength = Difference(b.z, o.z, bz);
+	int32 cxLength = Difference(c.x, o.x, cx);
+	int32 cyLength = Difference(c.y, o.y, cy);
+	int32 czLength = Difference(c.z, o.z, cz);
+
+	double minor[16];
+	double term[64];
+	double det[192];
+	int32 length = 0;
+
+	int32 minorLength = Minor(by, byLength, cz, czLength, bz, bzLength, cy, cyLength, minor);
+	int32 termLength = MultiplyExpansions(minor, minorLength, ax, axLength, term);
+	for (int32 i = 0; i < termLength; i++)
+		GrowExpansion(det, length, term[i]);
+
+	minorLength = Minor(bz, bzLength, cx, cxLength, bx, bxLength, cz, czLength, minor);
+	termLength = MultiplyExpansions(minor, minorLength, ay, ayLength, term);
+	for (int32 i = 0; i < termLength; i++)
+		GrowExpansion(det, length, term[i]);
+
+	minorLength = Minor(bx, bxLength, cy, cyLength, by, byLength, cx, cxLength, minor);
+	termLength = MultiplyExpansions(minor, minorLength, az, azLength, term);
+	for (int32 i = 0; i < termLength; i++)
+		GrowExpansion(det, length, term[i]);
+
+	return ExpansionSign(det, length);
+}
+
+// Sign of the volume of the tetrahedron o, a, b, c
+static int32
+Orient3d(const Point3 &o, const Point3 &a, const Point3 &b, const Point3 &c)
+{
+	double ax = a.x - o.x, ay = a.y - o.y, az = a.z - o.z;
+	double bx = b.x - o.x, by = b.y - o.y, bz = b.z - o.z;
+	double cx = c.x - o.x, cy = c.y - o.y, cz = c.z - o.z;
+
+	double det = ax * (by * cz - bz * cy) + ay * (bz * cx - bx * cz) + az * (bx * cy - by * cx);
+	double permanent = (fabs(by * cz) + fabs(bz * cy)) * fabs(ax)
+		+ (fabs(bz * cx) + fabs(bx * cz)) * fabs(ay)
+		+ (fabs(bx * cy) + fabs(by * cx)) * fabs(az);
+	double bound = ORIENT3D_ERROR_BOUND * permanent;
+	if (det > bound)
+		return 1;
+	if (det < -bound)
+		return -1;
+
+	return Orient3dExact(o, a, b, c);
+}
+
+static int32
+Orient2dExact(const Point2 &a, const Point2 &b, const Point2 &c)
+{
+	double bu[2], bv[2], cu[2], cv[2];
+	int32 buLength = Difference(b.u, a.u, bu);
+	int32 bvLength = Difference(b.v, a.v, bv);
+	int32 cuLength = Difference(c.u, a.u, cu);
+	int32 cvLength = Difference(c.v, a.v, cv);
+
+	double det[16];
+	int32 length = Minor(bu, buLength, cv, cvLength, bv, bvLength, cu, cuLength, det);
+	return ExpansionSign(det, length);
+}
+
+// Sign of the area of the triangle a, b, c
+static inline int32
+Orient2d(const Point2 &a, const Point2 &b, const Point2 &c)
+{
+	double left = (b.u - a.u) * (c.v - a.v);
+	double right = (b.v - a.v) * (c.u - a.u);
+	double det = left - right;
+	double bound = ORIENT2D_ERROR_BOUND * (fabs(left) + fabs(right));
+	if (det > bound)
+		return 1;
+	if (det < -bound)
+		return -1;
+
+	return Orient2dExact(a, b, c);
+}
+
+static inline bool
+SameSide(int32 a, int32 b, int32 c)
+{
+	return (a >= 0 && b >= 0 && c >= 0) || (a <= 0 && b <= 0 && c <= 0);
+}
+
+static Point3
+Normal(const Point3 *t)
+{
+	double ax = t[1].x - t[0].x, ay = t[1].y - t[0].y, az = t[1].z - t[0].z;
+	double bx = t[2].x - t[0].x, by = t[2].y - t[0].y, bz = t[2].z - t[0].z;
+	return {ay * bz - az * by, az * bx - ax * bz, ax * by - ay * bx};
+}
+
+// Coplanar tests drop the coordinate the plane is steepest along
+static int32
+DominantAxis(const Point3 &normal)
+{
+	double x = fabs(normal.x), y = fabs(normal.y), z = fabs(normal.z);
+	if (x >= y && x >= z)
+		return 0;
+	return y >= z ? 1 : 2;
+}
+
+static inline Point2
+Project(const Point3 &p, int32 axis)
+{
+	if (axis == 0)
+		return {p.y, p.z};
+	if (axis == 1)
+		return {p.z, p.x};
+	return {p.x, p.y};
+}
+
+static bool
+SegmentsIntersect2d(const Point2 &p1, const Point2 &p2, const Point2 &q1, const Point2 &q2)
+{
+	int32 d1 = Orient2d(q1, q2, p1);
+	int32 d2 = Orient2d(q1, q2, p2);
+	int32 d3 = Orient2d(p1, p2, q1);
+	int32 d4 = Orient2d(p1, p2, q2);
+
+	if (d1 == 0 && d2 == 0 && d3 == 0 && d4 == 0) {
+		return std::max(std::min(p1.u, p2.u), std::min(q1.u, q2.u))
+				<= std::min(std::max(p1.u, p2.u), std::max(q1.u, q2.u))
+			&& std::max(std::min(p1.v, p2.v), std::min(q1.v, q2.v))
+				<= std::min(std::max(p1.v, p2.v), std::max(q1.v, q2.v));
+	}
+
+	return d1 * d2 <= 0 && d3 * d4 <= 0;
+}
+
+static inline bool
+PointInTriangle2d(const Point2 &p, const Point2 *t)
+{
+	return SameSide(Orient2d(t[0], t[1], p), Orient2d(t[1], t[2], p), Orient2d(t[2], t[0], p));
+}
+
+static bool
+SegmentTriangle2d(const Point2 &s, const Point2 &e, const Point2 *t)
+{
+	for (int32 i = 0; i < 3; i++) {
+		if (SegmentsIntersect2d(s, e, t[i], t[(i + 1) % 3]))
+			return true;
+	}
+	return PointInTriangle2d(s, t);
+}
+
+static bool
+TrianglesIntersect2d(const Point2 *a, const Point2 *b)
+{
+	for (int32 i = 0; i < 3; i++) {
+		for (int32 j = 0; j < 3; j++) {
+			if (SegmentsIntersect2d(a[i], a[(i + 1) % 3], b[j], b[(j + 1) % 3]))
+				return true;
+		}
+	}
+	return PointInTriangle2d(a[0], b) || PointInTriangle2d(b[0], a);
+}
+
+// The segment s, e against the closed triangle t, with ds and de the sides
+// of the triangle plane its ends are on
+static bool
+SegmentTriangle3d(const Point3 &s, const Point3 &e, int32 ds, int32 de, const Point3 *t, int32 axis)
+{
+	if (ds == 0 && de == 0) {
+		Point2 triangle[3] = { Project(t[0], axis), Project(t[1], axis), Project(t[2], axis) };
+		return SegmentTriangle2d(Project(s, axis), Project(e, axis), triangle);
+	}
+
+	if (ds * de > 0)
+		return false;
+
+	return SameSide(Orient3d(s, e, t[0], t[1]), Orient3d(s, e, t[1], t[2]), Orient3d(s, e, t[2], t[0]));
+}
+
+STLIntersections::STLIntersections(stl_file *stl)
+	: fStl(stl)
+{
+	Find();
+}
+
+void
+STLIntersections::Find(void)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	if (facets < 2)
+		return;
+
+	STLBVH bvh(fStl);
+	BLocker locker("intersections");
+
+	std::vector<int32> order;
+	bvh.LeafOrder(order);
+
+	ParallelFor(order.size(), INTERSECTIONS_GRAIN, [&](int32 first, int32 last) {
+		std::vector<int32> candidates;
+		std::vector<std::pair<int32, int32> > found;
+		for (int32 k = first; k < last; k++) {
+			int32 i = order[k];
+			const stl_vertex *v = fStl->facet_start[i].vertex;
+			glm::vec3 low(std::min(std::min(v[0].x, v[1].x), v[2].x),
+				std::min(std::min(v[0].y, v[1].y), v[2].y),
+				std::min(std::min(v[0].z, v[1].z), v[2].z));
+			glm::vec3 high(std::max(std::max(v[0].x, v[1].x), v[2].x),
+				std::max(std::max(v[0].y, v[1].y), v[2].y),
+				std::max(std::max(v[0].z, v[1].z), v[2].z));
+
+			// Each pair is only tested from its lower facet
+			bvh.Overlap(low, high, candidates);
+			for (size_t c = 0; c < candidates.size(); c++) {
+				int32 j = candidates[c];
+				if (j <= i)
+					continue;
+
+				const stl_vertex *w = fStl->facet_start[j].vertex;
+				if (std::max(std::max(w[0].x, w[1].x), w[2].x) < low.x
+					|| std::min(std::min(w[0].x, w[1].x), w[2].x) > high.x
+					|| std::max(std::max(w[0].y, w[1].y), w[2].y) < low.y
+					|| std::min(std::min(w[0].y, w[1].y), w[2].y) > high.y
+					|| std::max(std::max(w[0].z, w[1].z), w[2].z) < low.z
+					|| std::min(std::min(w[0].z, w[1].z), w[2].z) > high.z)
+					continue;
+
+				if (Intersect(i, j))
+					found.push_back(std::make_pair(i, j));
+			}
+		}
+
+		if (!found.empty()) {
+			BAutolock lock(locker);
+			fPairs.insert(fPairs.end(), found.begin(), found.end());
+		}
+	});
+
+	std::sort(fPairs.begin(), fPairs.end());
+	for (size_t i = 0; i < fPairs.size(); i++) {
+		fFacets.push_back(fPairs[i].first);
+		fFacets.push_back(fPairs[i].second);
+	}
+	std::sort(fFacets.begin(), fFacets.end());
+	fFacets.erase(std::unique(fFacets.begin(), fFacets.end()), fFacets.end());
+}
+
+bool
+STLIntersections::Intersect(int32 first, int32 second) const
+{
+	Point3 a[3], b[3];
+	for (int32 i = 0; i < 3; i++) {
+		a[i] = ToPoint(fStl->facet_start[first].vertex[i]);
+		b[i] = ToPoint(fStl->facet_start[second].vertex[i]);
+	}
+
+	// Slivers without area have no plane to decide sides against
+	Point3 normalA = Normal(a);
+	Point3 normalB = Normal(b);
+	if ((normalA.x == 0.0 && normalA.y == 0.0 && normalA.z == 0.0)
+		|| (normalB.x == 0.0 && normalB.y == 0.0 && normalB.z == 0.0))
+		return false;
+
+	int32 sharedA = -1, sharedB = -1, shared = 0;
+	int32 matchedA = 0, matchedB = 0;
+	for (int32 i = 0; i < 3; i++) {
+		for (int32 j = 0; j < 3; j++) {
+			if (a[i].x == b[j].x && a[i].y == b[j].y && a[i].z == b[j].z) {
+				sharedA = i;
+				sharedB = j;
+				matchedA |= 1 << i;
+				matchedB |= 1 << j;
+				shared++;
+				break;
+			}
+		}
+	}
+
+	// The same facet twice
+	if (shared >= 3)
+		return true;
+
+	// Edge neighbours only overlap when folded flat onto each other
+	if (shared == 2) {
+		int32 freeA = matchedA == 3 ? 2 : (matchedA == 5 ? 1 : 0);
+		int32 freeB = matchedB == 3 ? 2 : (matchedB == 5 ? 1 : 0);
+		const Point3 &p = a[(freeA + 1) % 3];
+		const Point3 &q = a[(freeA + 2) % 3];
+		if (Orient3d(p, q, a[freeA], b[freeB]) != 0)
+			return false;
+
+		int32 axis = DominantAxis(normalA);
+		return Orient2d(Project(p, axis), Project(q, axis), Project(a[freeA], axis))
+			* Orient2d(Project(p, axis), Project(q, axis), Project(b[freeB], axis)) > 0;
+	}
+
+	// Shared corners lie in both planes, the exact path is not needed
+	// to find that out
+	int32 sideA[3], sideB[3];
+	for (int32 i = 0; i < 3; i++)
+		sideA[i] = (matchedA & (1 << i)) != 0 ? 0 : Orient3d(b[0], b[1], b[2], a[i]);
+	if ((sideA[0] > 0 && sideA[1] > 0 && sideA[2] > 0)
+		|| (sideA[0] < 0 && sideA[1] < 0 && sideA[2] < 0))
+		return false;
+
+	for (int32 i = 0; i < 3; i++)
+		sideB[i] = (matchedB & (1 << i)) != 0 ? 0 : Orient3d(a[0], a[1], a[2], b[i]);
+	if ((sideB[0] > 0 && sideB[1] > 0 && sideB[2] > 0)
+		|| (sideB[0] < 0 && sideB[1] < 0 && sideB[2] < 0))
+		return false;
+
+	int32 axisA = DominantAxis(normalA);
+	int32 axisB = DominantAxis(normalB);
+
+	// Vertex neighbours always touch at the shared corner, they cross only
+	// where the edge facing that corner meets the other facet
+	if (shared == 1) {
+		int32 i = (sharedA + 1) % 3, j = (sharedA + 2) % 3;
+		if (SegmentTriangle3d(a[i], a[j], sideA[i], sideA[j], b, axisB))
+			return true;
+		i = (sharedB + 1) % 3;
+		j = (sharedB + 2) % 3;
+		return SegmentTriangle3d(b[i], b[j], sideB[i], sideB[j], a, axisA);
+	}
+
+	if (sideA[0] == 0 && sideA[1] == 0 && sideA[2] == 0) {
+		Point2 projectedA[3], projectedB[3];
+		for (int32 i = 0; i < 3; i++) {
+			projectedA[i] = Project(a[i], axisA);
+			projectedB[i] = Project(b[i], axisA);
+		}
+		return TrianglesIntersect2d(projectedA, projectedB);
+	}
+
+	// Two facets in different planes meet iff an edge of one meets the other
+	for (int32 i = 0; i < 3; i++) {
+		int32 j = (i + 1) % 3;
+		if (SegmentTriangle3d(a[i], a[j], sideA[i], sideA[j], b, axisB))
+			return true;
+		if (SegmentTriangle3d(b[i], b[j], sideB[i], sideB[j], a, axisA))
+			return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,48 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_INTERSECTIONS
+#define STLOVER_INTERSECTIONS
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <utility>
+#include <vector>
+
+// Pairs of facets that cross each other. Candidates come from box queries
+// against an STLBVH on all CPUs, each one is then decided with exact
+// orientation predicates, so neighbours that only share a vertex or an
+// edge are never reported and crossings are never lost to rounding.
+class STLIntersections {
+	public:
+		STLIntersections(stl_file *stl);
+
+		const std::vector<std::pair<int32, int32> >& Pairs(void) const { return fPairs; }
+		const std::vector<int32>& Facets(void) const { return fFacets; }
+
+	private:
+		void Find(void);
+		bool Intersect(int32 first, int32 second) const;
+
+		stl_file *fStl;
+		std::vector<std::pair<int32, int32> > fPairs;
+		std::vector<int32> fFacets;
+};
+
+#endif
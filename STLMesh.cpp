@@ -0,0 +1,305 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLMesh.h"
+#include "STLParts.h"
+#include "STLHull.h"
+#include "STLCurvature.h"
+#include "STLWeld.h"
+#include "STLWindow.h"
+
+#include <Autolock.h>
+#include <Node.h>
+
+#include <string.h>
+
+BLocker STLMesh::sLock("STLMesh");
+std::map<BString, STLMesh*> STLMesh::sMeshes;
+
+STLMesh::STLMesh(stl_file *stl)
+	: fStl(stl),
+	fParts(NULL),
+	fHull(NULL),
+	fCurvature(NULL),
+	fWeld(NULL),
+	fRevision(0),
+	fZDepth(-5.0f),
+	fMaxExtent(10.0f),
+	fShift(0.0f),
+	fReferences(1)
+{
+	// Taken from the coordinates as the file has them, centering rounds
+	// every vertex again and the hash would no longer match the one the
+	// duplicate finder gets for the file
+	fFingerprint = STLFingerprint(fStl);
+
+	stl_vertex min = fStl->stats.min;
+	STLWindow::TransformPosition(fStl, &fZDepth, &fMaxExtent);
+	fShift = glm::vec3(fStl->stats.min.x - min.x, fStl->stats.min.y - min.y,
+		fStl->stats.min.z - min.z);
+	stl_calculate_volume(fStl);
+	fParts = new STLParts(fStl);
+}
+
+STLMesh::STLMesh(stl_file *stl, float zDepth, float maxExtent, const glm::vec3 &shift,
+	STLParts *parts, const STLFingerprint &fingerprint)
+	: fStl(stl),
+	fParts(parts),
+	fFingerprint(fingerprint),
+	fHull(NULL),
+	fCurvature(NULL),
+	fWeld(NULL),
+	fRevision(0),
+	fZDepth(zDepth),
+	fMaxExtent(maxExtent),
+	fShift(shift),
+	fReferences(1)
+{
+}
+
+STLMesh::~STLMesh()
+{
+	delete fHull;
+	delete fCurvature;
+	delete fWeld;
+	delete fParts;
+	stl_close(fStl);
+	delete fStl;
+}
+
+STLMesh*
+STLMesh::Acquire(const char *path)
+{
+	// A file rewritten on disk gets a new key, windows still holding the
+	// old geometry keep it until they let go
+	time_t modified = 0;
+	BNode node(path);
+	if (node.InitCheck() != B_OK || node.GetModificationTime(&modified) != B_OK)
+		return NULL;
+
+	BString key;
+	key.SetToFormat("%s:%ld", path, (long)modified);
+
+	{
+		BAutolock locker(sLock);
+		std::map<BString, STLMesh*>::iterator found = sMeshes.find(key);
+		if (found != sMeshes.end()) {
+			found->second->fReferences++;
+			return found->second;
+		}
+	}
+
+	// Parse outside the lock so other windows are not held up, if two
+	// windows race for the same file the first one to finish wins
+	stl_file *stl = new stl_file;
+	stl_open(stl, (char*)path);
+	if (stl_get_error(stl)) {
+		stl_close(stl);
+		delete stl;
+		return NULL;
+	}
+	stl_fix_normal_values(stl);
+
+	STLMesh *mesh = new STLMesh(stl);
+
+	BAutolock locker(sLock);
+	std::map<BString, STLMesh*>::iterator found = sMeshes.find(key);
+	if (found != sMeshes.end()) {
+		found->second->fReferences++;
+		delete mesh;
+		return found->second;
+	}
+	mesh->fKey = key;
+	sMeshes[key] = mesh;
+
+	return mesh;
+}
+
+void
+STLMesh::AcquireReference(void)
+{
+	BAutolock locker(sLock);
+	fReferences++;
+}
+
+void
+STLMesh::ReleaseReference(void)
+{
+	BAutolock locker(sLock);
+	if (--fReferences > 0)
+		return;
+
+	if (fKey.Length() > 0)
+		sMeshes.erase(fKey);
+	delete this;
+}
+
+bool
+STLMesh::IsShared(void)
+{
+	BAutolock locker(sLock);
+	return fReferences > 1;
+}
+
+bool
+STLMesh::MakePrivate(void)
+{
+	// Checked and unregistered in one go, an Acquire() in between would
+	// otherwise share a mesh that is about to change
+	BAutolock locker(sLock);
+	if (fReferences > 1)
+		return false;
+
+	if (fKey.Length() > 0) {
+		sMeshes.erase(fKey);
+		fKey = "";
+	}
+	return true;
+}
+
+STLMesh*
+STLMesh::Copy(void)
+{
+	stl_file *stl = new stl_file;
+	stl_initialize(stl);
+	stl->stats = fStl->stats;
+	stl->stats.shared_vertices = 0;
+	stl->stats.shared_malloced = 0;
+	stl_allocate(stl);
+	if (stl_get_error(stl)) {
+		stl_close(stl);
+		delete stl;
+		return NULL;
+	}
+
+	int32 facets = fStl->stats.number_of_facets;
+	memcpy(stl->facet_start, fStl->facet_start, facets * sizeof(stl_facet));
+	memcpy(stl->neighbors_start, fStl->neighbors_start, facets * sizeof(stl_neighbors));
+
+	// Copies made on a job thread race with an edit dropping the parts
+	BAutolock locker(sLock);
+	STLParts *parts = fParts != NULL ? new STLParts(*fParts, stl) : NULL;
+	return new STLMesh(stl, fZDepth, fMaxExtent, fShift, parts, fFingerprint);
+}
+
+void
+STLMesh::Changed(void)
+{
+	// Parts, fingerprint, hull, curvature and weld all describe the old
+	// geometry. The new fingerprint comes from the centered coordinates, it
+	// matches the hash of a file holding the edited model only as far as a
+	// moved copy does.
+	BAutolock locker(sLock);
+	delete fParts;
+	fParts = NULL;
+	fFingerprint = STLFingerprint();
+	delete fHull;
+	fHull = NULL;
+	delete fCurvature;
+	fCurvature = NULL;
+	delete fWeld;
+	fWeld = NULL;
+	fRevision++;
+}
+
+STLParts*
+STLMesh::Parts(void)
+{
+	BAutolock locker(sLock);
+	return fParts;
+}
+
+const STLFingerprint&
+STLMesh::Fingerprint(void)
+{
+	BAutolock locker(sLock);
+	return fFingerprint;
+}
+
+void
+STLMesh::SetParts(STLParts *parts, const STLFingerprint &fingerprint, int32 revision)
+{
+	BAutolock locker(sLock);
+	if (fParts != NULL || revision != fRevision) {
+		delete parts;
+		return;
+	}
+	fParts = parts;
+	fFingerprint = fingerprint;
+}
+
+STLHull*
+STLMesh::Hull(void)
+{
+	BAutolock locker(sLock);
+	return fHull;
+}
+
+void
+STLMesh::SetHull(STLHull *hull, int32 revision)
+{
+	// Windows sharing the mesh may both have built one, the first is kept
+	BAutolock locker(sLock);
+	if (fHull != NULL || revision != fRevision) {
+		delete hull;
+		return;
+	}
+	fHull = hull;
+}
+
+STLCurvature*
+STLMesh::Curvature(void)
+{
+	BAutolock locker(sLock);
+	return fCurvature;
+}
+
+void
+STLMesh::SetCurvature(STLCurvature *curvature, int32 revision)
+{
+	BAutolock locker(sLock);
+	if (fCurvature != NULL || revision != fRevision) {
+		delete curvature;
+		return;
+	}
+	fCurvature = curvature;
+}
+
+STLWeld*
+STLMesh::TakeWeld(int32 revision)
+{
+	BAutolock locker(sLock);
+	if (revision != fRevision)
+		return NULL;
+
+	STLWeld *weld = fWeld;
+	fWeld = NULL;
+	return weld;
+}
+
+void
+STLMesh::SetWeld(STLWeld *weld, int32 revision)
+{
+	BAutolock locker(sLock);
+	if (fWeld != NULL || revision != fRevision) {
+		delete weld;
+		return;
+	}
+	fWeld = weld;
+}
@@ -0,0 +1,103 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_MESH
+#define STLOVER_MESH
+
+#include <Locker.h>
+#include <String.h>
+#include <OS.h>
+
+#include <admesh/stl.h>
+
+#include "STLFingerprint.h"
+
+#include <map>
+#include <glm/glm.hpp>
+
+class STLParts;
+class STLHull;
+class STLCurvature;
+class STLWeld;
+
+// Loaded STL geometry shared between windows. Opening a file that another
+// window already shows hands out the same stl_file instead of parsing it
+// again, the geometry is read-only while it has more than one user and a
+// window takes a private Copy() before its first edit. A sole user edits in
+// place after MakePrivate(), which drops the mesh from the file registry so
+// nobody opening the file later is handed the unsaved geometry.
+class STLMesh {
+	public:
+		STLMesh(stl_file *stl);
+
+		static STLMesh* Acquire(const char *path);
+		void AcquireReference(void);
+		void ReleaseReference(void);
+		bool IsShared(void);
+		bool MakePrivate(void);
+
+		STLMesh* Copy(void);
+
+		stl_file* Stl(void) { return fStl; }
+		int32 Revision(void) { return fRevision; }
+		void Changed(void);
+
+		// Both are built again off the window thread after an edit, until
+		// then there are no parts and the fingerprint is empty
+		STLParts* Parts(void);
+		const STLFingerprint& Fingerprint(void);
+		void SetParts(STLParts *parts, const STLFingerprint &fingerprint, int32 revision);
+
+		STLHull* Hull(void);
+		void SetHull(STLHull *hull, int32 revision);
+		STLCurvature* Curvature(void);
+		void SetCurvature(STLCurvature *curvature, int32 revision);
+		// The welded vertices are kept until an edit. A job takes them out
+		// while it works with them and hands them back, NULL when there are
+		// none for that revision yet.
+		STLWeld* TakeWeld(int32 revision);
+		void SetWeld(STLWeld *weld, int32 revision);
+		float ZDepth(void) { return fZDepth; }
+		float MaxExtent(void) { return fMaxExtent; }
+		// Added to the file coordinates when the mesh was centered on load
+		const glm::vec3& Shift(void) { return fShift; }
+
+	private:
+		STLMesh(stl_file *stl, float zDepth, float maxExtent, const glm::vec3 &shift,
+			STLParts *parts, const STLFingerprint &fingerprint);
+		~STLMesh();
+
+		static BLocker sLock;
+		static std::map<BString, STLMesh*> sMeshes;
+
+		stl_file *fStl;
+		STLParts *fParts;
+		STLFingerprint fFingerprint;
+		STLHull *fHull;
+		STLCurvature *fCurvature;
+		STLWeld *fWeld;
+		int32 fRevision;
+		float fZDepth;
+		float fMaxExtent;
+		glm::vec3 fShift;
+		int32 fReferences;
+		BString fKey;
+};
+
+#endif
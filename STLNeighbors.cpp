@@ -0,0 +1,290 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLNeighbors.h"
+#include "STLParallel.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+struct EdgeKey {
+	uint32 words[6];
+	int32 edge;
+	bool backwards;
+};
+
+// Same as admesh's stl_load_edge_exact(): the end further along the axis
+// of the largest difference goes first, an edge stored the other way
+// round is backwards
+static inline float
+LoadEdge(const stl_file *stl, int32 edge, EdgeKey *key)
+{
+	const stl_facet &facet = stl->facet_start[edge / 3];
+	const stl_vertex *a = &facet.vertex[edge % 3];
+	const stl_vertex *b = &facet.vertex[(edge % 3 + 1) % 3];
+
+	float diffX = fabsf(a->x - b->x);
+	float diffY = fabsf(a->y - b->y);
+	float diffZ = fabsf(a->z - b->z);
+	float maxDiff = diffX > diffY ? diffX : diffY;
+	maxDiff = diffZ > maxDiff ? diffZ : maxDiff;
+
+	bool forward;
+	if (diffX == maxDiff)
+		forward = a->x > b->x;
+	else if (diffY == maxDiff)
+		forward = a->y > b->y;
+	else
+		forward = a->z > b->z;
+
+	memcpy(key->words, forward ? a : b, sizeof(stl_vertex));
+	memcpy(key->words + 3, forward ? b : a, sizeof(stl_vertex));
+	key->edge = edge;
+	key->backwards = !forward;
+
+	return maxDiff;
+}
+
+// The top bits pick the bucket, the low bits the slot inside it
+static inline uint64
+Hash(const EdgeKey &key)
+{
+	uint64 h = 0;
+	for (int k = 0; k < 6; k++)
+		h = (h ^ key.words[k]) * 0x9e3779b97f4a7c15ULL;
+	h ^= h >> 32;
+	h *= 0xd6e8feb86659fd93ULL;
+	return h ^ (h >> 32);
+}
+
+static inline uint32
+Bucket(uint64 hash)
+{
+	return hash >> (64 - NEIGHBORS_BUCKET_BITS);
+}
+
+static inline bool
+SameKey(const EdgeKey &a, const EdgeKey &b)
+{
+	return memcmp(a.words, b.words, sizeof(a.words)) == 0;
+}
+
+// Same as admesh's stl_record_neighbors(), a is the edge met first
+static inline void
+Link(stl_file *stl, const EdgeKey &a, const EdgeKey &b)
+{
+	stl_neighbors &na = stl->neighbors_start[a.edge / 3];
+	stl_neighbors &nb = stl->neighbors_start[b.edge / 3];
+	na.neighbor[a.edge % 3] = b.edge / 3;
+	na.which_vertex_not[a.edge % 3] = (b.edge % 3 + 2) % 3;
+	nb.neighbor[b.edge % 3] = a.edge / 3;
+	nb.which_vertex_not[b.edge % 3] = (a.edge % 3 + 2) % 3;
+
+	// Both stored the same way round means the facets face opposite
+	// sides, their normals are probably wrong
+	if (a.backwards == b.backwards) {
+		na.which_vertex_not[a.edge % 3] += 3;
+		nb.which_vertex_not[b.edge % 3] += 3;
+	}
+}
+
+void
+STLNeighbors::CheckExact(stl_file *stl)
+{
+	if (stl_get_error(stl))
+		return;
+
+	stl->stats.connected_edges = 0;
+	stl->stats.connected_facets_1_edge = 0;
+	stl->stats.connected_facets_2_edge = 0;
+	stl->stats.connected_facets_3_edge = 0;
+
+	// Only the links are reset, admesh leaves which_vertex_not alone too.
+	// It does so before dropping degenerate facets, which then have no
+	// links to take off the counts.
+	ParallelFor(stl->stats.number_of_facets, NEIGHBORS_GRAIN, [stl](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			for (int k = 0; k < 3; k++)
+				stl->neighbors_start[i].neighbor[k] = -1;
+		}
+	});
+
+	RemoveDegenerate(stl);
+
+	int32 facets = stl->stats.number_of_facets;
+	int32 count = facets * 3;
+	stl->stats.malloced = 0;
+	stl->stats.freed = 0;
+	stl->stats.collisions = 0;
+	if (count <= 0)
+		return;
+
+	int32 chunks = (count + NEIGHBORS_GRAIN - 1) / NEIGHBORS_GRAIN;
+	std::vector<int32> counts((size_t)chunks * NEIGHBORS_BUCKETS, 0);
+	std::vector<uint16> edgeBucket(count);
+	std::vector<float> shortest(chunks, stl->stats.shortest_edge);
+	ParallelFor(count, NEIGHBORS_GRAIN, [stl, &counts, &edgeBucket, &shortest](int32 first, int32 last) {
+		int32 chunk = first / NEIGHBORS_GRAIN;
+		int32 *row = &counts[(size_t)chunk * NEIGHBORS_BUCKETS];
+		float edge = shortest[chunk];
+		for (int32 i = first; i < last; i++) {
+			EdgeKey key;
+			float length = LoadEdge(stl, i, &key);
+			edge = length < edge ? length : edge;
+			edgeBucket[i] = Bucket(Hash(key));
+			row[edgeBucket[i]]++;
+		}
+		shortest[chunk] = edge;
+	});
+
+	for (int32 chunk = 0; chunk < chunks; chunk++) {
+		if (shortest[chunk] < stl->stats.shortest_edge)
+			stl->stats.shortest_edge = shortest[chunk];
+	}
+
+	std::vector<int32> bucketSize(NEIGHBORS_BUCKETS, 0);
+	for (int32 chunk = 0; chunk < chunks; chunk++) {
+		for (int32 bucket = 0; bucket < NEIGHBORS_BUCKETS; bucket++)
+			bucketSize[bucket] += counts[(size_t)chunk * NEIGHBORS_BUCKETS + bucket];
+	}
+
+	std::vector<EdgeKey> keys;
+	std::vector<int32> bucketPairs(NEIGHBORS_BUCKETS, 0);
+	for (int32 begin = 0; begin < NEIGHBORS_BUCKETS;) {
+		// Whole buckets up to the pass limit, at least one
+		int32 end = begin;
+		int32 total = 0;
+		while (end < NEIGHBORS_BUCKETS
+			&& (end == begin || total + bucketSize[end] <= NEIGHBORS_PASS_EDGES))
+			total += bucketSize[end++];
+		int32 span = end - begin;
+
+		// Counts per range and bucket become the write offsets
+		std::vector<int32> offsets;
+		std::vector<int32> bucketStart;
+		total = ScatterOffsets(counts, chunks, NEIGHBORS_BUCKETS, begin, span,
+			offsets, bucketStart);
+
+		// The ranges are written in order, so every bucket lists its
+		// edges in the order admesh inserts them
+		keys.resize(total);
+		ParallelFor(count, NEIGHBORS_GRAIN, [&](int32 first, int32 last) {
+			int32 *row = &offsets[(size_t)(first / NEIGHBORS_GRAIN) * span];
+			for (int32 i = first; i < last; i++) {
+				int32 bucket = edgeBucket[i] - begin;
+				if (bucket >= 0 && bucket < span)
+					LoadEdge(stl, i, &keys[row[bucket]++]);
+			}
+		});
+
+		// A small open addressing table per bucket does what the admesh
+		// table does: a key with an open edge closes it, otherwise the
+		// edge waits. A slot keeps its key after closing and holds the
+		// position of the last edge, the low bit tells whether it is open.
+		// Every edge is in at most one pair, so the pairs write disjoint
+		// slots and the buckets need no locking.
+		ParallelFor(span, 1, [&](int32 first, int32 last) {
+			std::vector<int32> table;
+			for (int32 bucket = first; bucket < last; bucket++) {
+				const EdgeKey *start = keys.data() + bucketStart[bucket];
+				int32 size = bucketStart[bucket + 1] - bucketStart[bucket];
+				uint32 mask = 15;
+				while (mask < (uint32)size * 2)
+					mask = mask * 2 + 1;
+				table.assign(mask + 1, -1);
+
+				int32 pairs = 0;
+				for (int32 i = 0; i < size; i++) {
+					uint32 slot = Hash(start[i]) & mask;
+					while (table[slot] != -1 && !SameKey(start[table[slot] >> 1], start[i]))
+						slot = (slot + 1) & mask;
+
+					if (table[slot] != -1 && (table[slot] & 1) != 0) {
+						Link(stl, start[table[slot] >> 1], start[i]);
+						table[slot] &= ~1;
+						pairs++;
+					} else
+						table[slot] = i * 2 + 1;
+				}
+				bucketPairs[begin + bucket] = pairs;
+			}
+		});
+
+		begin = end;
+	}
+
+	int32 pairs = 0;
+	for (int32 bucket = 0; bucket < NEIGHBORS_BUCKETS; bucket++)
+		pairs += bucketPairs[bucket];
+	stl->stats.connected_edges = pairs * 2;
+	stl->stats.malloced = count - pairs;
+	stl->stats.freed = count - pairs;
+
+	// admesh counts a facet each time it gains a link, which adds up to
+	// the number of facets with at least one, two and three links
+	int32 facetChunks = (facets + NEIGHBORS_GRAIN - 1) / NEIGHBORS_GRAIN;
+	std::vector<int32> connected((size_t)facetChunks * 3, 0);
+	ParallelFor(facets, NEIGHBORS_GRAIN, [stl, &connected](int32 first, int32 last) {
+		int32 *row = &connected[(size_t)(first / NEIGHBORS_GRAIN) * 3];
+		for (int32 i = first; i < last; i++) {
+			const stl_neighbors &neighbors = stl->neighbors_start[i];
+			int32 links = (neighbors.neighbor[0] != -1) + (neighbors.neighbor[1] != -1)
+				+ (neighbors.neighbor[2] != -1);
+			for (int32 k = 0; k < links; k++)
+				row[k]++;
+		}
+	});
+
+	for (int32 chunk = 0; chunk < facetChunks; chunk++) {
+		stl->stats.connected_facets_1_edge += connected[(size_t)chunk * 3];
+		stl->stats.connected_facets_2_edge += connected[(size_t)chunk * 3 + 1];
+		stl->stats.connected_facets_3_edge += connected[(size_t)chunk * 3 + 2];
+	}
+}
+
+void
+STLNeighbors::RemoveDegenerate(stl_file *stl)
+{
+	// Rare enough to stay serial, the order of removals decides which
+	// facet ends up where
+	for (int32 i = 0; i < stl->stats.number_of_facets; i++) {
+		const stl_vertex *v = stl->facet_start[i].vertex;
+		if (memcmp(&v[0], &v[1], sizeof(stl_vertex)) == 0
+			|| memcmp(&v[1], &v[2], sizeof(stl_vertex)) == 0
+			|| memcmp(&v[0], &v[2], sizeof(stl_vertex)) == 0) {
+			stl->stats.degenerate_facets++;
+			RemoveFacet(stl, i);
+			i--;
+		}
+	}
+}
+
+void
+STLNeighbors::RemoveFacet(stl_file *stl, int32 facet)
+{
+	// admesh's stl_remove_facet() also takes the connection counts down
+	// by the links of the facet, all of them are open at this point
+	stl->stats.facets_removed++;
+
+	int32 last = stl->stats.number_of_facets - 1;
+	stl->facet_start[facet] = stl->facet_start[last];
+	stl->neighbors_start[facet] = stl->neighbors_start[last];
+	stl->stats.number_of_facets--;
+}
@@ -0,0 +1,51 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_NEIGHBORS
+#define STLOVER_NEIGHBORS
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+
+#define NEIGHBORS_GRAIN			65536
+#define NEIGHBORS_BUCKET_BITS	12
+#define NEIGHBORS_BUCKETS		(1 << NEIGHBORS_BUCKET_BITS)
+#define NEIGHBORS_PASS_EDGES	(1 << 22)	// edge keys held at once, 32 bytes each
+
+// Drop-in for stl_check_facets_exact() that uses all CPUs. admesh pushes
+// every edge through one hash table with chained buckets, here the edge
+// keys are spread over buckets by their hash and every bucket gets its
+// own small table on its own CPU. The keys are copied out while streaming
+// over the facets, a pass at a time when there are many, so matching
+// never reaches back into the mesh. Within a bucket the edges come in the
+// order admesh inserts them and pair up the same way, first with second,
+// third with fourth, so the neighbor table, the connection counts and the
+// shortest edge come out the same. Only the hash table statistics differ,
+// there are no chains and so no collisions.
+class STLNeighbors {
+	public:
+		static void CheckExact(stl_file *stl);
+
+	private:
+		static void RemoveDegenerate(stl_file *stl);
+		static void RemoveFacet(stl_file *stl, int32 facet);
+};
+
+#endif
@@ -0,0 +1,119 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLNormals.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+STLNormals::STLNormals(stl_file *stl, const STLWeld &weld, float creaseAngle)
+	: fStl(stl),
+	fCreaseAngle(creaseAngle)
+{
+	Compute(weld);
+}
+
+void
+STLNormals::Compute(const STLWeld &weld)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	if (facets <= 0)
+		return;
+
+	fNormals.resize(facets * 3);
+	float limit = cosf(fCreaseAngle * M_PI / 180.0f);
+
+	// Facets around a vertex that share an edge flatter than the crease
+	// angle are joined into one group, found by sorting the far ends of
+	// the edges, and every group gets one normal. Each vertex costs about
+	// its valence instead of its square.
+	const std::vector<int32> &cornerVertex = weld.CornerVertices();
+	ParallelFor(weld.CountVertices(), NORMALS_GRAIN, [this, &weld, &cornerVertex, limit](int32 first, int32 last) {
+		std::vector<glm::vec3> normals;
+		std::vector<float> weights;
+		std::vector<int32> groups;
+		std::vector<glm::vec3> sums;
+		std::vector<std::pair<int32, int32> > ends;
+		for (int32 v = first; v < last; v++) {
+			int32 count;
+			const int32 *corners = weld.Corners(v, &count);
+			normals.resize(count);
+			weights.resize(count);
+			groups.resize(count);
+			sums.assign(count, glm::vec3(0.0f));
+			ends.resize(count * 2);
+
+			for (int32 i = 0; i < count; i++) {
+				const stl_facet &facet = fStl->facet_start[corners[i] / 3];
+				int32 k = corners[i] % 3;
+				glm::vec3 p0(facet.vertex[k].x, facet.vertex[k].y, facet.vertex[k].z);
+				glm::vec3 e1 = glm::vec3(facet.vertex[(k + 1) % 3].x, facet.vertex[(k + 1) % 3].y,
+					facet.vertex[(k + 1) % 3].z) - p0;
+				glm::vec3 e2 = glm::vec3(facet.vertex[(k + 2) % 3].x, facet.vertex[(k + 2) % 3].y,
+					facet.vertex[(k + 2) % 3].z) - p0;
+				glm::vec3 normal = glm::cross(e1, e2);
+				float length = glm::length(normal);
+				normals[i] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+				weights[i] = length > 0.0f ? atan2f(length, glm::dot(e1, e2)) : 0.0f;
+				groups[i] = i;
+
+				int32 base = corners[i] - k;
+				ends[i * 2] = std::make_pair(cornerVertex[base + (k + 1) % 3], i);
+				ends[i * 2 + 1] = std::make_pair(cornerVertex[base + (k + 2) % 3], i);
+			}
+
+			// Facets listed next to each other under the same far end
+			// share that edge
+			std::sort(ends.begin(), ends.end());
+			for (int32 e = 1; e < count * 2; e++) {
+				int32 i = ends[e - 1].second;
+				int32 j = ends[e].second;
+				if (ends[e - 1].first != ends[e].first || i == j
+					|| glm::dot(normals[i], normals[j]) < limit)
+					continue;
+				while (groups[i] != i)
+					i = groups[i] = groups[groups[i]];
+				while (groups[j] != j)
+					j = groups[j] = groups[groups[j]];
+				groups[std::max(i, j)] = std::min(i, j);
+			}
+
+			for (int32 i = 0; i < count; i++) {
+				int32 root = i;
+				while (groups[root] != root)
+					root = groups[root];
+				groups[i] = root;
+				sums[root] += normals[i] * weights[i];
+			}
+
+			for (int32 i = 0; i < count; i++) {
+				// Degenerate facets keep the stored normal
+				glm::vec3 sum = sums[groups[i]];
+				float length = glm::length(sum);
+				if (length > 0.0f) {
+					fNormals[corners[i]] = sum / length;
+				} else {
+					const stl_normal &stored = fStl->facet_start[corners[i] / 3].normal;
+					fNormals[corners[i]] = glm::vec3(stored.x, stored.y, stored.z);
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,56 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_NORMALS
+#define STLOVER_NORMALS
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "STLWeld.h"
+
+#define NORMALS_GRAIN		4096
+
+// Per corner normals for smooth shading. Around every welded vertex the
+// facet normals are averaged, weighted by the angle of each facet at the
+// vertex, over the facets a facet reaches around the vertex without
+// crossing an edge sharper than the crease angle. Scanned surfaces shade
+// smoothly while hard edges stay sharp. Every vertex is handled on its own, so all CPUs work
+// at once. The weld only depends on the geometry and is passed in, a new
+// crease angle redoes the averaging alone.
+class STLNormals {
+	public:
+		STLNormals(stl_file *stl, const STLWeld &weld, float creaseAngle);
+
+		float CreaseAngle(void) const { return fCreaseAngle; }
+		// Three per facet, in facet order
+		const std::vector<glm::vec3>& Values(void) const { return fNormals; }
+
+	private:
+		void Compute(const STLWeld &weld);
+
+		stl_file *fStl;
+		float fCreaseAngle;
+		std::vector<glm::vec3> fNormals;
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "STLOverhang.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static inline void
+AnalyzeFacet(const stl_facet &facet, float bedZ, float *value, float *area)
+{
+	const stl_vertex *v = facet.vertex;
+	float e1x = v[1].x - v[0].x, e1y = v[1].y - v[0].y, e1z = v[1].z - v[0].z;
+	float e2x = v[2].x - v[0].x, e2y = v[2].y - v[0].y, e2z = v[2].z - v[0].z;
+	float nx = e1y * e2z - e1z * e2y;
+	float ny = e1z * e2x - e1x * e2z;
+	float nz = e1x * e2y - e1y * e2x;
+	float length = sqrtf(nx * nx + ny * ny + nz * nz);
+
+	*area = length * 0.5f;
+	*value = length > 0.0f ? -nz / length : 0.0f;
+	if (std::max(std::max(v[0].z, v[1].z), v[2].z) <= bedZ)
+		*value = -1.0f;
+}
+
+STLOverhang::STLOverhang(stl_file *stl)
+	: fStl(stl)
+{
+	Analyze();
+}
+
+float
+STLOverhang::Limit(float angle)
+{
+	return sinf(angle * M_PI / 180.0f);
+}
+
+void
+STLOverhang::Analyze(void)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	if (facets <= 0)
+		return;
+
+	fValues.resize(facets);
+	fAreas.resize(facets);
+
+	float bedZ = fStl->stats.min.z + std::max(std::max(fStl->stats.size.x, fStl->stats.size.y),
+		fStl->stats.size.z) * OVERHANG_BED_TOLERANCE;
+
+	const stl_facet *facet = fStl->facet_start;
+	int32 i = 0;
+
+#if defined(__SSE2__)
+	// Facets are packed 50 byte records, four of them are gathered into
+	// one register per coordinate and the normals are taken from the
+	// vertices since the stored ones are not always trustworthy
+	__m128 bed = _mm_set1_ps(bedZ);
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 minusOne = _mm_set1_ps(-1.0f);
+
+	for (; i + 4 <= facets; i += 4) {
+		const stl_facet *f = facet + i;
+		__m128 coord[9];
+		for (int32 j = 0; j < 3; j++) {
+			coord[j * 3] = _mm_set_ps(f[3].vertex[j].x, f[2].vertex[j].x, f[1].vertex[j].x, f[0].vertex[j].x);
+			coord[j * 3 + 1] = _mm_set_ps(f[3].vertex[j].y, f[2].vertex[j].y, f[1].vertex[j].y, f[0].vertex[j].y);
+			coord[j * 3 + 2] = _mm_set_ps(f[3].vertex[j].z, f[2].vertex[j].z, f[1].vertex[j].z, f[0].vertex[j].z);
+		}
+
+		__m128 e1x = _mm_sub_ps(coord[3], coord[0]);
+		__m128 e1y = _mm_sub_ps(coord[4], coord[1]);
+		__m128 e1z = _mm_sub_ps(coord[5], coord[2]);
+		__m128 e2x = _mm_sub_ps(coord[6], coord[0]);
+		__m128 e2y = _mm_sub_ps(coord[7], coord[1]);
+		__m128 e2z = _mm_sub_ps(coord[8], coord[2]);
+
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+		__m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx),
+			_mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+
+		// Degenerate facets divide by zero, the mask clears them to zero
+		__m128 valid = _mm_cmpgt_ps(length, zero);
+		__m128 value = _mm_and_ps(valid, _mm_div_ps(_mm_sub_ps(zero, nz), length));
+
+		__m128 top = _mm_max_ps(_mm_max_ps(coord[2], coord[5]), coord[8]);
+		__m128 onBed = _mm_cmple_ps(top, bed);
+		value = _mm_or_ps(_mm_and_ps(onBed, minusOne), _mm_andnot_ps(onBed, value));
+
+		_mm_storeu_ps(&fValues[i], value);
+		_mm_storeu_ps(&fAreas[i], _mm_mul_ps(length, half));
+	}
+#endif
+
+	for (; i < facets; i++)
+		AnalyzeFacet(facet[i], bedZ, &fValues[i], &fAreas[i]);
+}
+
+float
+STLOverhang::Area(float angle) const
+{
+	float limit = Limit(angle);
+	int32 facets = fValues.size();
+	double area = 0.0;
+	int32 i = 0;
+
+#if defined(__SSE2__)
+	// Lanes are flushed into the double total every block so a large
+	// mesh does not lose its small facets to float rounding
+	__m128 threshold = _mm_set1_ps(limit);
+	while (i + 4 <= facets) {
+		__m128 sum = _mm_setzero_ps();
+		int32 blockEnd = std::min(facets & ~3, i + 4096);
+		for (; i < blockEnd; i += 4) {
+			__m128 mask = _mm_cmpgt_ps(_mm_loadu_ps(&fValues[i]), threshold);
+			sum = _mm_add_ps(sum, _mm_and_ps(mask, _mm_loadu_ps(&fAreas[i])));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, sum);
+		area += (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+#endif
+
+	for (; i < facets; i++) {
+		if (fValues[i] > limit)
+			area += fAreas[i];
+	}
+
+	return area;
+}
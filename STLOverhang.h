@@ -0,0 +1,53 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_OVERHANG
+#define STLOVER_OVERHANG
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+
+// Facets this close to the lowest point, relative to the model size,
+// count as resting on the bed
+#define OVERHANG_BED_TOLERANCE	1.0e-4f
+
+// Per-facet overhang analysis against the +Z build direction. The value of
+// a facet is the sine of its tilt away from a vertical wall, so 1.0 is a
+// ceiling facing straight down and anything at or below zero faces up.
+// Facets lying on the bed do not need support and are left out.
+class STLOverhang {
+	public:
+		STLOverhang(stl_file *stl);
+
+		// One per facet, in facet order
+		const std::vector<float>& Values(void) const { return fValues; }
+		float Area(float angle) const;
+
+		static float Limit(float angle);
+
+	private:
+		void Analyze(void);
+
+		stl_file *fStl;
+		std::vector<float> fValues;
+		std::vector<float> fAreas;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLPNGWriter.h"
+
+#include <setjmp.h>
+#include <unistd.h>
+
+STLPNGWriter::STLPNGWriter()
+	: fFile(NULL),
+	fPng(NULL),
+	fInfo(NULL),
+	fWidth(0),
+	fHeight(0),
+	fRowsWritten(0)
+{
+}
+
+STLPNGWriter::~STLPNGWriter()
+{
+	Abort();
+}
+
+status_t
+STLPNGWriter::Open(const char *path, int32 width, int32 height)
+{
+	if (fFile != NULL || width <= 0 || height <= 0)
+		return B_BAD_VALUE;
+
+	fFile = fopen(path, "wb");
+	if (fFile == NULL)
+		return B_ERROR;
+	fPath = path;
+
+	fPng = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (fPng != NULL)
+		fInfo = png_create_info_struct(fPng);
+	if (fInfo == NULL) {
+		Abort();
+		return B_NO_MEMORY;
+	}
+
+	if (setjmp(png_jmpbuf(fPng))) {
+		Abort();
+		return B_ERROR;
+	}
+
+	png_init_io(fPng, fFile);
+	png_set_IHDR(fPng, fInfo, width, height, 8, PNG_COLOR_TYPE_RGB,
+		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(fPng, fInfo);
+
+	// B_RGB32 is BGRX in memory, the fourth byte is dropped by the encoder
+	png_set_bgr(fPng);
+	png_set_filler(fPng, 0, PNG_FILLER_AFTER);
+
+	fWidth = width;
+	fHeight = height;
+	fRowsWritten = 0;
+
+	return B_OK;
+}
+
+status_t
+STLPNGWriter::WriteRows(const uint8 *rows, int32 count, int32 bytesPerRow)
+{
+	if (fPng == NULL || count < 0 || fRowsWritten + count > fHeight)
+		return B_BAD_VALUE;
+
+	if (setjmp(png_jmpbuf(fPng))) {
+		Abort();
+		return B_ERROR;
+	}
+
+	for (int32 y = 0; y < count; y++)
+		png_write_row(fPng, (png_bytep)(rows + y * bytesPerRow));
+	fRowsWritten += count;
+
+	return B_OK;
+}
+
+status_t
+STLPNGWriter::Close(void)
+{
+	if (fPng == NULL)
+		return B_NO_INIT;
+
+	if (fRowsWritten != fHeight) {
+		Abort();
+		return B_BAD_VALUE;
+	}
+
+	if (setjmp(png_jmpbuf(fPng))) {
+		Abort();
+		return B_ERROR;
+	}
+
+	png_write_end(fPng, NULL);
+	png_destroy_write_struct(&fPng, &fInfo);
+
+	status_t status = fclose(fFile) == 0 ? B_OK : B_ERROR;
+	fFile = NULL;
+	if (status != B_OK)
+		unlink(fPath.String());
+	fPath = "";
+
+	return status;
+}
+
+void
+STLPNGWriter::Abort(void)
+{
+	if (fPng != NULL)
+		png_destroy_write_struct(&fPng, fInfo != NULL ? &fInfo : NULL);
+	fPng = NULL;
+	fInfo = NULL;
+
+	// Whatever was written is no valid image
+	if (fFile != NULL) {
+		fclose(fFile);
+		unlink(fPath.String());
+	}
+	fFile = NULL;
+	fPath = "";
+}
@@ -0,0 +1,56 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_PNGWRITER
+#define STLOVER_PNGWRITER
+
+#include <OS.h>
+#include <String.h>
+#include <stdio.h>
+
+#include <png.h>
+
+// Row-streaming PNG encoder. Rows are handed over top to bottom as 32 bit
+// B_RGB32 pixels and compressed straight away, so the whole image never
+// has to be held in memory. A file that is not finished with Close() is
+// removed again.
+class STLPNGWriter {
+	public:
+		STLPNGWriter();
+		~STLPNGWriter();
+
+		status_t Open(const char *path, int32 width, int32 height);
+		status_t WriteRows(const uint8 *rows, int32 count, int32 bytesPerRow);
+		status_t Close(void);
+
+		int32 RowsWritten(void) { return fRowsWritten; }
+
+	private:
+		void Abort(void);
+
+		FILE *fFile;
+		BString fPath;
+		png_structp fPng;
+		png_infop fInfo;
+		int32 fWidth;
+		int32 fHeight;
+		int32 fRowsWritten;
+};
+
+#endif
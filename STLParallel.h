@@ -0,0 +1,103 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_PARALLEL
+#define STLOVER_PARALLEL
+
+#include <OS.h>
+
+#include <algorithm>
+#include <vector>
+
+// Runs func(first, last) over [0, count) on every CPU. Ranges of grain
+// items are handed out through an atomic counter, so threads that get
+// cheap items pick up more of them. The calling thread works as well.
+template<typename Func>
+void
+ParallelFor(int32 count, int32 grain, Func func)
+{
+	if (count <= 0)
+		return;
+
+	struct Context {
+		Func *func;
+		int32 count;
+		int32 grain;
+		int32 next;
+	};
+	Context context = {&func, count, std::max(grain, (int32)1), 0};
+
+	thread_func worker = [](void *data) -> int32 {
+		Context *context = (Context*)data;
+		for (;;) {
+			int32 first = atomic_add(&context->next, context->grain);
+			if (first >= context->count)
+				break;
+			(*context->func)(first, std::min(first + context->grain, context->count));
+		}
+		return 0;
+	};
+
+	system_info info;
+	get_system_info(&info);
+	int32 chunks = (count + context.grain - 1) / context.grain;
+	int32 threads = std::min((int32)info.cpu_count, chunks);
+
+	std::vector<thread_id> workers;
+	for (int32 i = 0; i < threads - 1; i++) {
+		thread_id thread = spawn_thread(worker, "parallelWorker", B_NORMAL_PRIORITY, &context);
+		if (thread < B_OK || resume_thread(thread) != B_OK)
+			break;
+		workers.push_back(thread);
+	}
+
+	worker(&context);
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		status_t result;
+		wait_for_thread(workers[i], &result);
+	}
+}
+
+// Turns the counts per range and bucket of a ParallelFor pass into the
+// write offsets of a scatter pass. counts has a row of stride buckets per
+// range, buckets [first, first + span) are laid out bucket major so every
+// bucket ends up contiguous. offsets gets a row of span per range and may
+// be counts itself when the whole row is laid out. Returns the total.
+inline int32
+ScatterOffsets(const std::vector<int32> &counts, int32 ranges, int32 stride,
+	int32 first, int32 span, std::vector<int32> &offsets,
+	std::vector<int32> &bucketStart)
+{
+	offsets.resize((size_t)ranges * span);
+	bucketStart.resize(span + 1);
+
+	int32 total = 0;
+	for (int32 bucket = 0; bucket < span; bucket++) {
+		bucketStart[bucket] = total;
+		for (int32 range = 0; range < ranges; range++) {
+			int32 size = counts[(size_t)range * stride + first + bucket];
+			offsets[(size_t)range * span + bucket] = total;
+			total += size;
+		}
+	}
+	bucketStart[span] = total;
+	return total;
+}
+
+#endif
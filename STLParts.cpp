@@ -0,0 +1,404 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLParts.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
+// Relative tolerances for comparing components, in units of the
+// component size. Copies written by slicers differ by float rounding only.
+#define PARTS_MOMENT_TOLERANCE	1.0e-3f
+#define PARTS_POINT_TOLERANCE	1.0e-4f
+#define PARTS_SAMPLE_POINTS		32
+
+static inline glm::vec3
+ToVec3(const stl_vertex &v)
+{
+	return glm::vec3(v.x, v.y, v.z);
+}
+
+static inline bool
+VertexLess(const stl_vertex &a, const stl_vertex &b)
+{
+	if (a.x != b.x)
+		return a.x < b.x;
+	if (a.y != b.y)
+		return a.y < b.y;
+	return a.z < b.z;
+}
+
+static inline bool
+VertexEqual(const stl_vertex &a, const stl_vertex &b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static int32
+FindRoot(std::vector<int32> &parent, int32 i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+// Cyclic Jacobi rotations for a symmetric 3x3 matrix, converges in a few
+// sweeps. Eigenvectors end up in the columns of vectors.
+void
+STLParts::SymmetricEigen(double matrix[3][3], double values[3], double vectors[3][3])
+{
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			vectors[i][j] = i == j ? 1.0 : 0.0;
+
+	for (int sweep = 0; sweep < 32; sweep++) {
+		double off = fabs(matrix[0][1]) + fabs(matrix[0][2]) + fabs(matrix[1][2]);
+		if (off < 1.0e-30)
+			break;
+
+		for (int p = 0; p < 2; p++) {
+			for (int q = p + 1; q < 3; q++) {
+				if (fabs(matrix[p][q]) < 1.0e-300)
+					continue;
+				double theta = (matrix[q][q] - matrix[p][p]) / (2.0 * matrix[p][q]);
+				double t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+				double c = 1.0 / sqrt(t * t + 1.0);
+				double s = t * c;
+				for (int k = 0; k < 3; k++) {
+					double kp = matrix[k][p];
+					double kq = matrix[k][q];
+					matrix[k][p] = c * kp - s * kq;
+					matrix[k][q] = s * kp + c * kq;
+				}
+				for (int k = 0; k < 3; k++) {
+					double pk = matrix[p][k];
+					double qk = matrix[q][k];
+					matrix[p][k] = c * pk - s * qk;
+					matrix[q][k] = s * pk + c * qk;
+				}
+				for (int k = 0; k < 3; k++) {
+					double kp = vectors[k][p];
+					double kq = vectors[k][q];
+					vectors[k][p] = c * kp - s * kq;
+					vectors[k][q] = s * kp + c * kq;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+		values[i] = matrix[i][i];
+}
+
+STLParts::STLParts(const STLParts &other, stl_file *stl)
+	: fStl(stl),
+	fComponents(other.fComponents),
+	fUnique(other.fUnique),
+	fParts(other.fParts)
+{
+}
+
+STLParts::STLParts(stl_file *stl)
+	: fStl(stl),
+	fComponents(0),
+	fUnique(0)
+{
+	if (fStl->stats.number_of_facets <= 0)
+		return;
+
+	std::vector<int32> component;
+	std::vector<int32> start;
+	FindComponents(component, start);
+	fComponents = start.size() - 1;
+
+	struct Reference {
+		int32 component;
+		Frame frame;
+		float tolerance;
+		std::vector<glm::vec3> points;
+		std::vector<glm::mat4> instances;
+	};
+
+	std::vector<Reference> references;
+	std::unordered_map<uint64, std::vector<int32> > buckets;
+
+	for (int32 c = 0; c < fComponents; c++) {
+		const int32 *facets = &component[start[c]];
+		int32 count = start[c + 1] - start[c];
+		Frame frame = CanonicalFrame(facets, count);
+		float size = glm::length(frame.moments);
+		float tolerance = std::max(size * PARTS_POINT_TOLERANCE, 1.0e-6f);
+
+		// Candidates must agree on facet count and, up to rounding, on the
+		// surface area; the bucket only narrows the search
+		int32 areaBucket = (int32)floorf(log2f(std::max(frame.area, 1.0e-30f)) * 64.0f);
+		uint64 key = ((uint64)(uint32)count << 32) | (uint32)areaBucket;
+
+		bool matched = false;
+		for (int32 delta = -1; delta <= 1 && !matched; delta++) {
+			uint64 probe = ((uint64)(uint32)count << 32) | (uint32)(areaBucket + delta);
+			std::unordered_map<uint64, std::vector<int32> >::iterator bucket = buckets.find(probe);
+			if (bucket == buckets.end())
+				continue;
+
+			for (size_t i = 0; i < bucket->second.size() && !matched; i++) {
+				Reference &reference = references[bucket->second[i]];
+				const Frame &other = reference.frame;
+				if (fabsf(other.area - frame.area) > other.area * PARTS_MOMENT_TOLERANCE
+					|| glm::length(other.moments - frame.moments) > size * PARTS_MOMENT_TOLERANCE)
+					continue;
+
+				// Canonical points of the reference are only built once a
+				// second component looks like a copy
+				if (reference.points.empty()) {
+					const int32 *refFacets = &component[start[reference.component]];
+					glm::mat3 toCanonical = glm::transpose(other.axes);
+					reference.points.reserve(count * 3);
+					for (int32 f = 0; f < count; f++) {
+						for (int32 v = 0; v < 3; v++) {
+							reference.points.push_back(toCanonical
+								* (ToVec3(fStl->facet_start[refFacets[f]].vertex[v]) - other.center));
+						}
+					}
+					std::sort(reference.points.begin(), reference.points.end(),
+						[](const glm::vec3 &a, const glm::vec3 &b) { return a.x < b.x; });
+				}
+
+				glm::mat3 rotation;
+				if (!Matches(facets, count, frame, other, reference.points, reference.tolerance, rotation))
+					continue;
+
+				glm::mat4 instance(rotation);
+				glm::vec3 offset = frame.center - rotation * other.center;
+				instance[3] = glm::vec4(offset, 1.0f);
+				reference.instances.push_back(instance);
+				matched = true;
+			}
+		}
+
+		if (matched)
+			continue;
+
+		Reference reference;
+		reference.component = c;
+		reference.frame = frame;
+		reference.tolerance = tolerance;
+		reference.instances.push_back(glm::mat4(1.0f));
+		buckets[key].push_back(references.size());
+		references.push_back(reference);
+	}
+
+	fUnique = references.size();
+
+	// Parts without copies are merged into one identity part so a mesh of
+	// many distinct pieces still draws in a single call
+	Part single;
+	single.instances.push_back(glm::mat4(1.0f));
+	for (size_t i = 0; i < references.size(); i++) {
+		const int32 *facets = &component[start[references[i].component]];
+		int32 count = start[references[i].component + 1] - start[references[i].component];
+		if (references[i].instances.size() == 1) {
+			single.facets.insert(single.facets.end(), facets, facets + count);
+			continue;
+		}
+		Part part;
+		part.facets.assign(facets, facets + count);
+		part.instances.swap(references[i].instances);
+		fParts.push_back(part);
+	}
+	if (!single.facets.empty())
+		fParts.insert(fParts.begin(), single);
+}
+
+void
+STLParts::FindComponents(std::vector<int32> &component, std::vector<int32> &start)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	stl_facet *facet = fStl->facet_start;
+
+	// Facets sharing a bit-identical vertex belong to the same component
+	std::vector<int32> corners(facets * 3);
+	std::iota(corners.begin(), corners.end(), 0);
+	std::sort(corners.begin(), corners.end(), [facet](int32 a, int32 b) {
+		return VertexLess(facet[a / 3].vertex[a % 3], facet[b / 3].vertex[b % 3]);
+	});
+
+	std::vector<int32> parent(facets);
+	std::iota(parent.begin(), parent.end(), 0);
+	for (int32 i = 1; i < facets * 3; i++) {
+		int32 a = corners[i - 1];
+		int32 b = corners[i];
+		if (!VertexEqual(facet[a / 3].vertex[a % 3], facet[b / 3].vertex[b % 3]))
+			continue;
+		int32 rootA = FindRoot(parent, a / 3);
+		int32 rootB = FindRoot(parent, b / 3);
+		if (rootA != rootB)
+			parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+	}
+	std::vector<int32>().swap(corners);
+
+	// Number the roots in facet order and bucket the facets by component
+	std::vector<int32> id(facets, -1);
+	std::vector<int32> label(facets);
+	int32 count = 0;
+	for (int32 i = 0; i < facets; i++) {
+		int32 root = FindRoot(parent, i);
+		if (id[root] < 0)
+			id[root] = count++;
+		label[i] = id[root];
+	}
+
+	start.assign(count + 1, 0);
+	for (int32 i = 0; i < facets; i++)
+		start[label[i] + 1]++;
+	for (int32 i = 0; i < count; i++)
+		start[i + 1] += start[i];
+
+	component.resize(facets);
+	std::vector<int32> fill(start.begin(), start.end() - 1);
+	for (int32 i = 0; i < facets; i++)
+		component[fill[label[i]]++] = i;
+}
+
+STLParts::Frame
+STLParts::CanonicalFrame(const int32 *facets, int32 count)
+{
+	// Area weighted centroid and second moments of the surface
+	double area = 0;
+	double sum[3] = { 0, 0, 0 };
+	double second[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+
+	for (int32 f = 0; f < count; f++) {
+		const stl_facet &facet = fStl->facet_start[facets[f]];
+		glm::vec3 a = ToVec3(facet.vertex[0]);
+		glm::vec3 b = ToVec3(facet.vertex[1]);
+		glm::vec3 c = ToVec3(facet.vertex[2]);
+		double weight = 0.5 * glm::length(glm::cross(b - a, c - a));
+		glm::vec3 s = a + b + c;
+		area += weight;
+		for (int i = 0; i < 3; i++) {
+			sum[i] += weight * s[i] / 3.0;
+			for (int j = 0; j < 3; j++) {
+				second[i][j] += weight / 12.0 * ((double)a[i] * a[j] + (double)b[i] * b[j]
+					+ (double)c[i] * c[j] + (double)s[i] * s[j]);
+			}
+		}
+	}
+
+	Frame frame;
+	frame.area = area;
+	if (area <= 0.0)
+		area = 1.0;
+
+	double center[3];
+	double covariance[3][3];
+	for (int i = 0; i < 3; i++)
+		center[i] = sum[i] / area;
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			covariance[i][j] = second[i][j] / area - center[i] * center[j];
+
+	double values[3];
+	double vectors[3][3];
+	SymmetricEigen(covariance, values, vectors);
+
+	int order[3] = { 0, 1, 2 };
+	std::sort(order, order + 3, [&values](int a, int b) { return values[a] > values[b]; });
+
+	frame.center = glm::vec3(center[0], center[1], center[2]);
+	for (int i = 0; i < 3; i++) {
+		int k = order[i];
+		frame.axes[i] = glm::vec3(vectors[0][k], vectors[1][k], vectors[2][k]);
+		frame.moments[i] = sqrt(std::max(values[k], 0.0));
+	}
+
+	// Orient the two major axes by the skew of the surface along them,
+	// the third one follows so the frame is always right handed
+	for (int i = 0; i < 2; i++) {
+		double skew = 0;
+		for (int32 f = 0; f < count; f++) {
+			const stl_facet &facet = fStl->facet_start[facets[f]];
+			glm::vec3 a = ToVec3(facet.vertex[0]);
+			glm::vec3 b = ToVec3(facet.vertex[1]);
+			glm::vec3 c = ToVec3(facet.vertex[2]);
+			double weight = 0.5 * glm::length(glm::cross(b - a, c - a));
+			double d = glm::dot((a + b + c) / 3.0f - frame.center, frame.axes[i]);
+			skew += weight * d * d * d;
+		}
+		if (skew < 0)
+			frame.axes[i] = -frame.axes[i];
+	}
+	frame.axes[2] = glm::cross(frame.axes[0], frame.axes[1]);
+
+	return frame;
+}
+
+bool
+STLParts::Matches(const int32 *facets, int32 count, const Frame &frame,
+	const Frame &reference, const std::vector<glm::vec3> &points,
+	float tolerance, glm::mat3 &rotation)
+{
+	// Symmetric parts have no reliable skew, so every right handed sign
+	// choice of the axes is tried before the candidate is rejected
+	static const float signs[4][2] = { { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 } };
+
+	int32 corners = count * 3;
+	int32 step = std::max(corners / PARTS_SAMPLE_POINTS, (int32)1);
+
+	auto contains = [&points, tolerance](const glm::vec3 &p) {
+		std::vector<glm::vec3>::const_iterator it = std::lower_bound(points.begin(), points.end(),
+			p.x - tolerance, [](const glm::vec3 &a, float x) { return a.x < x; });
+		for (; it != points.end() && it->x <= p.x + tolerance; ++it) {
+			if (fabsf(it->y - p.y) <= tolerance && fabsf(it->z - p.z) <= tolerance)
+				return true;
+		}
+		return false;
+	};
+
+	for (int s = 0; s < 4; s++) {
+		glm::mat3 axes = frame.axes;
+		axes[0] = axes[0] * signs[s][0];
+		axes[1] = axes[1] * signs[s][1];
+		axes[2] = glm::cross(axes[0], axes[1]);
+		glm::mat3 toCanonical = glm::transpose(axes);
+
+		// A few spread out corners first, the full check only runs for
+		// the sign choice that survives them
+		bool match = true;
+		for (int32 pass = 0; pass < 2 && match; pass++) {
+			for (int32 i = 0; i < corners && match; i += pass == 0 ? step : 1) {
+				const stl_vertex &v = fStl->facet_start[facets[i / 3]].vertex[i % 3];
+				match = contains(toCanonical * (ToVec3(v) - frame.center));
+			}
+		}
+
+		if (match) {
+			rotation = axes * glm::transpose(reference.axes);
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,71 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_PARTS
+#define STLOVER_PARTS
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Splits a mesh into connected components and groups the components that
+// are rigid copies of each other. Every component is brought into a
+// canonical frame (area centroid and principal axes), components with the
+// same facet count and principal moments are then compared vertex by
+// vertex in that frame. Copies can be drawn as instances of one part.
+class STLParts {
+	public:
+		STLParts(stl_file *stl);
+		// The same parts for a copy of the mesh
+		STLParts(const STLParts &other, stl_file *stl);
+
+		struct Part {
+			std::vector<int32> facets;
+			std::vector<glm::mat4> instances;
+		};
+
+		int32 CountComponents(void) { return fComponents; }
+		int32 CountUnique(void) { return fUnique; }
+		const std::vector<Part>& Parts(void) { return fParts; }
+
+		static void SymmetricEigen(double matrix[3][3], double values[3], double vectors[3][3]);
+
+	private:
+		struct Frame {
+			glm::vec3 center;
+			glm::mat3 axes;
+			glm::vec3 moments;
+			float area;
+		};
+
+		void FindComponents(std::vector<int32> &component, std::vector<int32> &start);
+		Frame CanonicalFrame(const int32 *facets, int32 count);
+		bool Matches(const int32 *facets, int32 count, const Frame &frame,
+			const Frame &reference, const std::vector<glm::vec3> &points,
+			float tolerance, glm::mat3 &rotation);
+
+		stl_file *fStl;
+		int32 fComponents;
+		int32 fUnique;
+		std::vector<Part> fParts;
+};
+
+#endif
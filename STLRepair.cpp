@@ -0,0 +1,139 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLRepair.h"
+#include "STLNeighbors.h"
+
+STLRepair::STLRepair(const BMessage *options)
+	: fExactFlag(options->FindInt32("exactFlag")),
+	fNearbyFlag(options->FindInt32("nearbyFlag")),
+	fRemoveUnconnectedFlag(options->FindInt32("removeUnconnectedFlag")),
+	fFillHolesFlag(options->FindInt32("fillHolesFlag")),
+	fNormalDirectionsFlag(options->FindInt32("normalDirectionsFlag")),
+	fNormalValuesFlag(options->FindInt32("normalValuesFlag")),
+	fReverseAllFlag(options->FindInt32("reverseAllFlag")),
+	fIterations(options->FindInt32("iterationsValue")),
+	fTolerance(options->FindFloat("toleranceValue")),
+	fIncrement(options->FindFloat("incrementValue")),
+	fWhat(0),
+	fCancel(NULL),
+	fPhases(0),
+	fPhase(0)
+{
+}
+
+status_t
+STLRepair::Run(stl_file *stl, const BMessenger &progress, uint32 what, int32 *cancel)
+{
+	if (stl_get_error(stl))
+		return B_ERROR;
+
+	fProgress = progress;
+	fWhat = what;
+	fCancel = cancel;
+
+	// Same order and conditions as stl_repair() with fixall off, the
+	// exact check is needed by every step that walks neighbors
+	bool exact = fExactFlag || fNearbyFlag || fRemoveUnconnectedFlag
+		|| fFillHolesFlag || fNormalDirectionsFlag;
+	bool unconnected = fRemoveUnconnectedFlag || fFillHolesFlag;
+	bool normals = fReverseAllFlag || fNormalDirectionsFlag || fNormalValuesFlag;
+
+	fPhases = (exact ? 1 : 0) + (fNearbyFlag ? 1 : 0) + (unconnected ? 1 : 0)
+		+ (fFillHolesFlag ? 1 : 0) + (normals ? 1 : 0);
+	fPhase = 0;
+
+	if (exact) {
+		if (!Report(REPAIR_EXACT, 0.0f))
+			return B_CANCELED;
+		STLNeighbors::CheckExact(stl);
+		stl->stats.facets_w_1_bad_edge = stl->stats.connected_facets_2_edge
+			- stl->stats.connected_facets_3_edge;
+		stl->stats.facets_w_2_bad_edge = stl->stats.connected_facets_1_edge
+			- stl->stats.connected_facets_2_edge;
+		stl->stats.facets_w_3_bad_edge = stl->stats.number_of_facets
+			- stl->stats.connected_facets_1_edge;
+		fPhase++;
+	}
+
+	if (fNearbyFlag) {
+		float tolerance = fTolerance;
+		for (int32 i = 0; i < fIterations; i++) {
+			if (stl->stats.connected_facets_3_edge >= stl->stats.number_of_facets)
+				break;
+			if (!Report(REPAIR_NEARBY, (float)i / fIterations))
+				return B_CANCELED;
+			stl_check_facets_nearby(stl, tolerance);
+			tolerance += fIncrement;
+		}
+		fPhase++;
+	}
+
+	if (unconnected) {
+		if (!Report(REPAIR_UNCONNECTED, 0.0f))
+			return B_CANCELED;
+		if (stl->stats.connected_facets_3_edge < stl->stats.number_of_facets)
+			stl_remove_unconnected_facets(stl);
+		fPhase++;
+	}
+
+	if (fFillHolesFlag) {
+		if (!Report(REPAIR_HOLES, 0.0f))
+			return B_CANCELED;
+		if (stl->stats.connected_facets_3_edge < stl->stats.number_of_facets)
+			stl_fill_holes(stl);
+		fPhase++;
+	}
+
+	if (normals) {
+		if (!Report(REPAIR_NORMALS, 0.0f))
+			return B_CANCELED;
+		if (fReverseAllFlag)
+			stl_reverse_all_facets(stl);
+		if (fNormalDirectionsFlag)
+			stl_fix_normal_directions(stl);
+		if (fNormalValuesFlag)
+			stl_fix_normal_values(stl);
+		fPhase++;
+	}
+
+	// Last chance to back out, the caller swaps the result in after this
+	if (fCancel != NULL && atomic_get(fCancel) != 0)
+		return B_CANCELED;
+
+	stl_calculate_volume(stl);
+	if (exact)
+		stl_verify_neighbors(stl);
+
+	return stl_get_error(stl) ? B_ERROR : B_OK;
+}
+
+bool
+STLRepair::Report(int32 phase, float done)
+{
+	if (fCancel != NULL && atomic_get(fCancel) != 0)
+		return false;
+
+	BMessage message(fWhat);
+	message.AddInt32("phase", phase);
+	message.AddFloat("progress", (fPhase + done) / fPhases);
+	fProgress.SendMessage(&message);
+
+	return true;
+}
@@ -0,0 +1,71 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_REPAIR
+#define STLOVER_REPAIR
+
+#include <Message.h>
+#include <Messenger.h>
+#include <OS.h>
+
+#include <admesh/stl.h>
+
+#define REPAIR_EXACT		0
+#define REPAIR_NEARBY		1
+#define REPAIR_UNCONNECTED	2
+#define REPAIR_HOLES		3
+#define REPAIR_NORMALS		4
+#define REPAIR_PHASES		5
+
+// Runs the steps of stl_repair() one at a time so a background thread can
+// tell how far it got and stop early. The options are read with the keys
+// the repair dialog sends. After each phase and each nearby iteration a
+// progress message with "phase" and "progress" (0..1 over the phases that
+// run) goes to the given target, and the cancel flag is checked there.
+// The exact check is the parallel one from STLNeighbors. A cancelled run
+// leaves the mesh half repaired, so run it on a copy.
+class STLRepair {
+	public:
+		STLRepair(const BMessage *options);
+
+		status_t Run(stl_file *stl, const BMessenger &progress, uint32 what,
+			int32 *cancel);
+
+	private:
+		bool Report(int32 phase, float done);
+
+		int32 fExactFlag;
+		int32 fNearbyFlag;
+		int32 fRemoveUnconnectedFlag;
+		int32 fFillHolesFlag;
+		int32 fNormalDirectionsFlag;
+		int32 fNormalValuesFlag;
+		int32 fReverseAllFlag;
+		int32 fIterations;
+		float fTolerance;
+		float fIncrement;
+
+		BMessenger fProgress;
+		uint32 fWhat;
+		int32 *fCancel;
+		int32 fPhases;
+		int32 fPhase;
+};
+
+#endif
@@ -18,6 +18,7 @@
  
 #include "STLApp.h"
 #include "STLRepairWindow.h"
+#include "STLRepair.h"
 
 #undef  B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT          "STLoverRepairWindow"
@@ -27,7 +28,8 @@ STLRepairWindow::STLRepairWindow(BWindow* target, uint32 messageId, BMessage *op
 	B_NOT_ZOOMABLE | B_NOT_RESIZABLE | B_ASYNCHRONOUS_CONTROLS | B_AUTO_UPDATE_SIZE_LIMITS | B_CLOSE_ON_ESCAPE),
 	fTarget(target),
 	fMessageId(messageId),
-	fOptions(options)
+	fOptions(options),
+	fRunning(false)
 {	
 	fExactCheckBox = new BCheckBox(B_TRANSLATE("Only check for perfectly matched edges"));
 	fExactCheckBox->SetValue(options->FindInt32("exactFlag"));
@@ -67,6 +69,9 @@ STLRepairWindow::STLRepairWindow(BWindow* target, uint32 messageId, BMessage *op
 	fOkButton = new BButton(B_TRANSLATE("OK"), new BMessage(MSG_INPUT_OK));
 	fOkButton->SetEnabled(true);
 
+	fStatusBar = new BStatusBar("progress");
+	fStatusBar->SetMaxValue(100.0f);
+
 	BButton* cancelButton = new BButton(B_TRANSLATE("Cancel"), new BMessage(B_QUIT_REQUESTED));
 
 	float padding = be_control_look->DefaultItemSpacing();
@@ -82,11 +87,13 @@ STLRepairWindow::STLRepairWindow(BWindow* target, uint32 messageId, BMessage *op
 		.Add(fNormalDirectionsCheckBox, 0, 7, 3, 1)
 		.Add(fNormalValuesCheckBox, 0, 8, 3, 1)
 		.Add(fReverseCheckBox, 0, 9, 3, 1)
-		.Add(BSpaceLayoutItem::CreateGlue(), 0, 10)
-		.Add(cancelButton, 2, 10)
-		.Add(fOkButton, 3, 10);
+		.Add(fStatusBar, 0, 10, 4, 1)
+		.Add(BSpaceLayoutItem::CreateGlue(), 0, 11)
+		.Add(cancelButton, 2, 11)
+		.Add(fOkButton, 3, 11);
 
 	fOkButton->MakeDefault(true);
+	fStatusBar->Hide();
 
 	ResizeToPreferred();
 	BRect parentRect = target->Frame();
@@ -102,10 +109,32 @@ STLRepairWindow::STLRepairWindow(BWindow* target, uint32 messageId, BMessage *op
 bool
 STLRepairWindow::QuitRequested()
 {
-	fTarget.SendMessage(MSG_INPUT_CANCEL);
+	// Also sent while the repair runs, the owner stops it then
+	fTarget.SendMessage(MSG_TOOLS_REPAIR_CANCEL);
 	return true;
 }
 
+void
+STLRepairWindow::SetRunning(void)
+{
+	fRunning = true;
+
+	fExactCheckBox->SetEnabled(false);
+	fNearbyCheckBox->SetEnabled(false);
+	fRemoveUnconnectedCheckBox->SetEnabled(false);
+	fAddFacetsCheckBox->SetEnabled(false);
+	fNormalDirectionsCheckBox->SetEnabled(false);
+	fNormalValuesCheckBox->SetEnabled(false);
+	fReverseCheckBox->SetEnabled(false);
+	fIterationsTextControl->SetEnabled(false);
+	fIncrementTextControl->SetEnabled(false);
+	fToleranceTextControl->SetEnabled(false);
+	fOkButton->SetEnabled(false);
+
+	fStatusBar->SetTo(0.0f, B_TRANSLATE("Starting" B_UTF8_ELLIPSIS));
+	fStatusBar->Show();
+}
+
 void
 STLRepairWindow::MessageReceived(BMessage* message)
 {
@@ -124,9 +153,25 @@ STLRepairWindow::MessageReceived(BMessage* message)
 			msg->AddFloat("toleranceValue", atof(fToleranceTextControl->Text()));
 			msg->AddFloat("incrementValue", atof(fIncrementTextControl->Text()));
 			fTarget.SendMessage(msg);
+			delete msg;
 
-			delete fOptions;
-			PostMessage(B_QUIT_REQUESTED);
+			// The owner closes the window once the result is in
+			SetRunning();
+			break;
+		}
+		case MSG_TOOLS_REPAIR_PROGRESS:
+		{
+			const char *phases[REPAIR_PHASES] = {
+				B_TRANSLATE("Checking for perfectly matched edges"),
+				B_TRANSLATE("Connecting nearby facets"),
+				B_TRANSLATE("Removing unconnected facets"),
+				B_TRANSLATE("Filling holes"),
+				B_TRANSLATE("Fixing normals")
+			};
+			int32 phase = message->FindInt32("phase");
+			float progress = message->FindFloat("progress");
+			if (fRunning && phase >= 0 && phase < REPAIR_PHASES)
+				fStatusBar->SetTo(progress * 100.0f, phases[phase]);
 			break;
 		}
 		default:
@@ -27,18 +27,21 @@
 #include <String.h>
 #include <TextControl.h>
 #include <CheckBox.h>
+#include <StatusBar.h>
 #include <LayoutBuilder.h>
 #include <ControlLook.h>
 
 class STLRepairWindow : public BWindow {
 	public:
 		STLRepairWindow(BWindow* target, uint32 messageId, BMessage *options);
-		virtual ~STLRepairWindow() { };
+		virtual ~STLRepairWindow() { delete fOptions; };
 
 		virtual bool QuitRequested();
 		virtual void MessageReceived(BMessage* message);
 
 	private:
+		void SetRunning(void);
+
 		BMessenger fTarget;
 		BMessage *fOptions;
 		uint32 fMessageId;
@@ -56,6 +59,8 @@ class STLRepairWindow : public BWindow {
 		BTextControl *fToleranceTextControl;
 
 		BButton *fOkButton;
+		BStatusBar *fStatusBar;
+		bool fRunning;
 };
 
 #endif
@@ -0,0 +1,291 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLSection.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// One slab per square root of the facet count keeps a cut at a few
+// thousand facets on the 10M facet meshes while most facets land in a
+// single slab. Small cuts are not worth starting threads for.
+#define SECTION_MAX_SLABS			65536
+#define SECTION_FACETS_PER_THREAD	16384
+
+bool
+STLSection::EdgeKey::operator<(const EdgeKey &other) const
+{
+	return memcmp(v, other.v, sizeof(v)) < 0;
+}
+
+bool
+STLSection::EdgeKey::operator==(const EdgeKey &other) const
+{
+	return memcmp(v, other.v, sizeof(v)) == 0;
+}
+
+STLSection::STLSection(stl_file *stl)
+	: fStl(stl),
+	fMinZ(0.0f),
+	fSlabHeight(1.0f),
+	fHeight(0.0f),
+	fArea(0.0f)
+{
+	Build();
+}
+
+void
+STLSection::Build(void)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	if (facets <= 0)
+		return;
+
+	float maxZ = -FLT_MAX;
+	fMinZ = FLT_MAX;
+	for (int32 i = 0; i < facets; i++) {
+		for (int32 j = 0; j < 3; j++) {
+			fMinZ = std::min(fMinZ, fStl->facet_start[i].vertex[j].z);
+			maxZ = std::max(maxZ, fStl->facet_start[i].vertex[j].z);
+		}
+	}
+
+	int32 slabs = std::min(std::max((int32)sqrtf(facets), 1), SECTION_MAX_SLABS);
+	fSlabHeight = (maxZ - fMinZ) / slabs;
+	if (fSlabHeight <= 0.0f) {
+		slabs = 1;
+		fSlabHeight = 1.0f;
+	}
+
+	auto slabOf = [this, slabs](float z) {
+		return std::min(std::max((int32)((z - fMinZ) / fSlabHeight), 0), slabs - 1);
+	};
+
+	fSlabStart.assign(slabs + 1, 0);
+	for (int32 i = 0; i < facets; i++) {
+		const stl_facet &facet = fStl->facet_start[i];
+		float low = std::min(std::min(facet.vertex[0].z, facet.vertex[1].z), facet.vertex[2].z);
+		float high = std::max(std::max(facet.vertex[0].z, facet.vertex[1].z), facet.vertex[2].z);
+		for (int32 slab = slabOf(low); slab <= slabOf(high); slab++)
+			fSlabStart[slab + 1]++;
+	}
+
+	for (int32 i = 0; i < slabs; i++)
+		fSlabStart[i + 1] += fSlabStart[i];
+
+	std::vector<uint32> fill(fSlabStart.begin(), fSlabStart.end() - 1);
+	fFacets.resize(fSlabStart[slabs]);
+	for (int32 i = 0; i < facets; i++) {
+		const stl_facet &facet = fStl->facet_start[i];
+		float low = std::min(std::min(facet.vertex[0].z, facet.vertex[1].z), facet.vertex[2].z);
+		float high = std::max(std::max(facet.vertex[0].z, facet.vertex[1].z), facet.vertex[2].z);
+		for (int32 slab = slabOf(low); slab <= slabOf(high); slab++)
+			fFacets[fill[slab]++] = i;
+	}
+}
+
+void
+STLSection::Cut(float height)
+{
+	fHeight = height;
+	fArea = 0.0f;
+	fContours.clear();
+
+	if (fFacets.empty())
+		return;
+
+	int32 slabs = fSlabStart.size() - 1;
+	float offset = (height - fMinZ) / fSlabHeight;
+	if (offset < 0.0f || offset > slabs)
+		return;
+
+	int32 slab = std::min((int32)offset, slabs - 1);
+	const uint32 *facets = fFacets.data() + fSlabStart[slab];
+	uint32 count = fSlabStart[slab + 1] - fSlabStart[slab];
+
+	system_info info;
+	get_system_info(&info);
+	uint32 threads = std::min((uint32)info.cpu_count, count / SECTION_FACETS_PER_THREAD);
+	if (threads < 1)
+		threads = 1;
+
+	std::vector<CutJob> jobs(threads);
+	std::vector<thread_id> workers;
+	for (uint32 i = 0; i < threads; i++) {
+		uint32 first = (uint64)count * i / threads;
+		uint32 last = (uint64)count * (i + 1) / threads;
+		jobs[i].section = this;
+		jobs[i].facets = facets + first;
+		jobs[i].count = last - first;
+		jobs[i].height = height;
+
+		// The calling thread takes the last range itself
+		if (i + 1 < threads) {
+			thread_id worker = spawn_thread(_CutFunction, "sectionWorker", B_NORMAL_PRIORITY, &jobs[i]);
+			if (worker >= B_OK && resume_thread(worker) == B_OK)
+				workers.push_back(worker);
+			else
+				CutFacets(&jobs[i]);
+		} else
+			CutFacets(&jobs[i]);
+	}
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		status_t result;
+		wait_for_thread(workers[i], &result);
+	}
+
+	std::vector<Segment> segments;
+	for (uint32 i = 0; i < threads; i++)
+		segments.insert(segments.end(), jobs[i].segments.begin(), jobs[i].segments.end());
+
+	LinkSegments(segments);
+}
+
+void
+STLSection::CutFacets(CutJob *job)
+{
+	float height = job->height;
+
+	for (uint32 i = 0; i < job->count; i++) {
+		const stl_facet &facet = fStl->facet_start[job->facets[i]];
+
+		// Vertices on the plane count as above it, every edge is then
+		// either crossed or not and both facets of an edge agree on it
+		bool above[3];
+		int32 aboveCount = 0;
+		for (int32 j = 0; j < 3; j++) {
+			above[j] = facet.vertex[j].z >= height;
+			aboveCount += above[j];
+		}
+		if (aboveCount == 0 || aboveCount == 3)
+			continue;
+
+		// The edge crossed upwards ends the segment and the one crossed
+		// downwards starts it. The neighbour walks a shared edge the other
+		// way round, so the segments chain in the facet winding order.
+		Segment segment;
+		for (int32 j = 0; j < 3; j++) {
+			int32 k = (j + 1) % 3;
+			if (above[j] == above[k])
+				continue;
+
+			const stl_vertex &low = above[j] ? facet.vertex[k] : facet.vertex[j];
+			const stl_vertex &high = above[j] ? facet.vertex[j] : facet.vertex[k];
+			float t = (height - low.z) / (high.z - low.z);
+			glm::vec3 point(low.x + (high.x - low.x) * t, low.y + (high.y - low.y) * t, height);
+			EdgeKey key = {{low.x, low.y, low.z, high.x, high.y, high.z}};
+
+			if (above[j]) {
+				segment.from = key;
+				segment.start = point;
+			} else {
+				segment.to = key;
+				segment.end = point;
+			}
+		}
+		job->segments.push_back(segment);
+	}
+}
+
+void
+STLSection::LinkSegments(const std::vector<Segment> &segments)
+{
+	int32 count = segments.size();
+
+	std::vector<int32> order(count);
+	for (int32 i = 0; i < count; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&segments](int32 a, int32 b) {
+		return segments[a].from < segments[b].from;
+	});
+
+	std::vector<int32> next(count, -1);
+	std::vector<bool> hasPrevious(count, false);
+	for (int32 i = 0; i < count; i++) {
+		auto found = std::lower_bound(order.begin(), order.end(), segments[i].to,
+			[&segments](int32 a, const EdgeKey &key) { return segments[a].from < key; });
+		if (found != order.end() && segments[*found].from == segments[i].to) {
+			next[i] = *found;
+			hasPrevious[*found] = true;
+		}
+	}
+
+	std::vector<bool> visited(count, false);
+	auto trace = [&](int32 first) {
+		Contour contour;
+		contour.closed = false;
+		contour.points.push_back(segments[first].start);
+
+		for (int32 current = first;;) {
+			visited[current] = true;
+			int32 following = next[current];
+			if (following == first) {
+				contour.closed = true;
+				break;
+			}
+
+			// Cuts through a vertex give zero length segments
+			if (segments[current].end != contour.points.back())
+				contour.points.push_back(segments[current].end);
+			if (following < 0 || visited[following])
+				break;
+			current = following;
+		}
+
+		if (contour.points.size() < 2)
+			return;
+
+		if (contour.closed && contour.points.size() > 2) {
+			// Holes wind against the outline, so the signed sum leaves
+			// exactly the material area
+			double area = 0.0;
+			for (size_t i = 0; i < contour.points.size(); i++) {
+				const glm::vec3 &a = contour.points[i];
+				const glm::vec3 &b = contour.points[(i + 1) % contour.points.size()];
+				area += (double)a.x * b.y - (double)b.x * a.y;
+			}
+			fArea += area / 2.0;
+		}
+
+		fContours.push_back(contour);
+	};
+
+	// Open chains first so they are traced from their real start
+	for (int32 i = 0; i < count; i++) {
+		if (!visited[i] && !hasPrevious[i])
+			trace(i);
+	}
+	for (int32 i = 0; i < count; i++) {
+		if (!visited[i])
+			trace(i);
+	}
+
+	fArea = fabs(fArea);
+}
+
+int32
+STLSection::_CutFunction(void *data)
+{
+	CutJob *job = (CutJob*)data;
+	job->section->CutFacets(job);
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_SECTION
+#define STLOVER_SECTION
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Horizontal cross-sections of a mesh. Facets are bucketed into Z slabs
+// once, a cut only visits the slab holding the plane. The facets crossing
+// the plane give one segment each, segments are chained through the mesh
+// edge they start and end on, so the contours close exactly wherever the
+// mesh is closed.
+class STLSection {
+	public:
+		STLSection(stl_file *stl);
+
+		struct Contour {
+			std::vector<glm::vec3> points;
+			bool closed;
+		};
+
+		void Cut(float height);
+
+		float Height(void) { return fHeight; }
+		float Area(void) { return fArea; }
+		const std::vector<Contour>& Contours(void) { return fContours; }
+
+	private:
+		struct EdgeKey {
+			float v[6];
+			bool operator<(const EdgeKey &other) const;
+			bool operator==(const EdgeKey &other) const;
+		};
+
+		struct Segment {
+			EdgeKey from;
+			EdgeKey to;
+			glm::vec3 start;
+			glm::vec3 end;
+		};
+
+		struct CutJob {
+			STLSection *section;
+			const uint32 *facets;
+			uint32 count;
+			float height;
+			std::vector<Segment> segments;
+		};
+
+		void Build(void);
+		void CutFacets(CutJob *job);
+		void LinkSegments(const std::vector<Segment> &segments);
+
+		static int32 _CutFunction(void *data);
+
+		stl_file *fStl;
+		float fMinZ;
+		float fSlabHeight;
+		std::vector<uint32> fSlabStart;
+		std::vector<uint32> fFacets;
+
+		float fHeight;
+		float fArea;
+		std::vector<Contour> fContours;
+};
+
+#endif
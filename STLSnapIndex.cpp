@@ -0,0 +1,214 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "STLSnapIndex.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+// Query boxes are clamped to this many cells per axis, so a far zoomed out
+// view of a dense scan never walks thousands of cells per mouse move.
+#define SNAP_MAX_CELL_SPAN 12
+
+static inline glm::vec3
+ToVec3(const stl_vertex &v)
+{
+	return glm::vec3(v.x, v.y, v.z);
+}
+
+STLSnapIndex::STLSnapIndex(const std::vector<SnapObject> &objects)
+	: fObjects(objects),
+	fCellSize(1.0f),
+	fTableMask(0)
+{
+	Build();
+}
+
+void
+STLSnapIndex::EdgePoints(uint32 edge, glm::vec3 &a, glm::vec3 &b) const
+{
+	size_t object = std::upper_bound(fFirstEdge.begin(), fFirstEdge.end(), edge)
+		- fFirstEdge.begin() - 1;
+	const SnapObject &snap = fObjects[object];
+	edge -= fFirstEdge[object];
+	const stl_facet &facet = snap.stl->facet_start[edge / 3];
+	a = glm::vec3(snap.transform * glm::vec4(ToVec3(facet.vertex[edge % 3]), 1.0f));
+	b = glm::vec3(snap.transform * glm::vec4(ToVec3(facet.vertex[(edge + 1) % 3]), 1.0f));
+}
+
+uint32
+STLSnapIndex::CellHash(int32 x, int32 y, int32 z) const
+{
+	uint32 hash = ((uint32)x * 73856093u) ^ ((uint32)y * 19349663u) ^ ((uint32)z * 83492791u);
+	return hash & fTableMask;
+}
+
+template<typename Func>
+void
+STLSnapIndex::ForEachEdgeCell(uint32 edge, Func func) const
+{
+	glm::vec3 a, b;
+	EdgePoints(edge, a, b);
+
+	// Sample at half a cell so the segment cannot jump over a cell it crosses
+	int32 steps = (int32)ceilf(2.0f * glm::distance(a, b) / fCellSize);
+	if (steps < 1)
+		steps = 1;
+
+	int32 lastX = INT_MIN, lastY = INT_MIN, lastZ = INT_MIN;
+	for (int32 i = 0; i <= steps; i++) {
+		glm::vec3 p = a + (b - a) * ((float)i / steps);
+		int32 x = (int32)floorf(p.x / fCellSize);
+		int32 y = (int32)floorf(p.y / fCellSize);
+		int32 z = (int32)floorf(p.z / fCellSize);
+		if (x == lastX && y == lastY && z == lastZ)
+			continue;
+		func(CellHash(x, y, z));
+		lastX = x;
+		lastY = y;
+		lastZ = z;
+	}
+}
+
+void
+STLSnapIndex::Build()
+{
+	uint32 edges = 0;
+	float diameter = 0.0f;
+	fFirstEdge.resize(fObjects.size());
+	for (size_t i = 0; i < fObjects.size(); i++) {
+		fFirstEdge[i] = edges;
+		edges += std::max(fObjects[i].stl->stats.number_of_facets, 0) * 3;
+		diameter = std::max(diameter, glm::length(ToVec3(fObjects[i].stl->stats.size)));
+	}
+	if (edges == 0)
+		return;
+
+	double edgeLength = 0;
+	for (uint32 i = 0; i < edges; i++) {
+		glm::vec3 a, b;
+		EdgePoints(i, a, b);
+		edgeLength += glm::distance(a, b);
+	}
+
+	fCellSize = std::max((float)(edgeLength / edges), diameter * 1.0e-4f);
+	if (fCellSize <= 0.0f)
+		fCellSize = 1.0f;
+
+	uint32 tableSize = 1024;
+	while (tableSize < edges)
+		tableSize <<= 1;
+	fTableMask = tableSize - 1;
+
+	fCellStart.assign(tableSize + 1, 0);
+	for (uint32 i = 0; i < edges; i++)
+		ForEachEdgeCell(i, [this](uint32 cell) { fCellStart[cell + 1]++; });
+
+	for (uint32 i = 0; i < tableSize; i++)
+		fCellStart[i + 1] += fCellStart[i];
+
+	std::vector<uint32> fill(fCellStart.begin(), fCellStart.end() - 1);
+	fEdges.resize(fCellStart[tableSize]);
+	for (uint32 i = 0; i < edges; i++)
+		ForEachEdgeCell(i, [this, &fill, i](uint32 cell) { fEdges[fill[cell]++] = i; });
+}
+
+SnapType
+STLSnapIndex::Find(const glm::vec3 &point, float radius, glm::vec3 &result,
+	snap_visible_func visible, void *cookie) const
+{
+	if (fEdges.empty() || radius <= 0.0f)
+		return SNAP_NONE;
+
+	radius = std::min(radius, fCellSize * SNAP_MAX_CELL_SPAN / 2.0f);
+
+	glm::vec3 low = (point - glm::vec3(radius)) / fCellSize;
+	glm::vec3 high = (point + glm::vec3(radius)) / fCellSize;
+
+	float bestPoint = radius;
+	float bestEdge = radius;
+	SnapType pointType = SNAP_NONE;
+	glm::vec3 pointResult;
+	glm::vec3 edgeResult;
+
+	// Only asked about a candidate that would win, which are few
+	auto isVisible = [visible, cookie](const glm::vec3 &candidate) {
+		return visible == NULL || visible(candidate, cookie);
+	};
+
+	for (int32 x = (int32)floorf(low.x); x <= (int32)floorf(high.x); x++) {
+		for (int32 y = (int32)floorf(low.y); y <= (int32)floorf(high.y); y++) {
+			for (int32 z = (int32)floorf(low.z); z <= (int32)floorf(high.z); z++) {
+				uint32 cell = CellHash(x, y, z);
+				for (uint32 i = fCellStart[cell]; i < fCellStart[cell + 1]; i++) {
+					glm::vec3 a, b;
+					EdgePoints(fEdges[i], a, b);
+
+					float distance = glm::distance(point, a);
+					if (distance < bestPoint && isVisible(a)) {
+						bestPoint = distance;
+						pointResult = a;
+						pointType = SNAP_VERTEX;
+					}
+
+					distance = glm::distance(point, b);
+					if (distance < bestPoint && isVisible(b)) {
+						bestPoint = distance;
+						pointResult = b;
+						pointType = SNAP_VERTEX;
+					}
+
+					glm::vec3 middle = (a + b) * 0.5f;
+					distance = glm::distance(point, middle);
+					if (distance < bestPoint && isVisible(middle)) {
+						bestPoint = distance;
+						pointResult = middle;
+						pointType = SNAP_MIDPOINT;
+					}
+
+					glm::vec3 ab = b - a;
+					float length2 = glm::dot(ab, ab);
+					if (length2 > 0.0f) {
+						float t = glm::clamp(glm::dot(point - a, ab) / length2, 0.0f, 1.0f);
+						glm::vec3 closest = a + ab * t;
+						distance = glm::distance(point, closest);
+						if (distance < bestEdge && isVisible(closest)) {
+							bestEdge = distance;
+							edgeResult = closest;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Vertices and midpoints win over plain edges, the cursor only slides
+	// along an edge when no point-like feature is inside the radius
+	if (pointType != SNAP_NONE) {
+		result = pointResult;
+		return pointType;
+	}
+
+	if (bestEdge < radius) {
+		result = edgeResult;
+		return SNAP_EDGE;
+	}
+
+	return SNAP_NONE;
+}
@@ -0,0 +1,70 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_SNAPINDEX
+#define STLOVER_SNAPINDEX
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+enum SnapType {
+	SNAP_NONE = 0,
+	SNAP_VERTEX,
+	SNAP_MIDPOINT,
+	SNAP_EDGE
+};
+
+// Tells whether a candidate can be seen, hidden ones are passed over
+typedef bool (*snap_visible_func)(const glm::vec3 &point, void *cookie);
+
+// A mesh of the scene and where it is placed
+struct SnapObject {
+	stl_file *stl;
+	glm::mat4 transform;
+};
+
+// Spatial hash over the edges of every mesh in the scene, each one in
+// place. Every facet edge is registered in each cell it passes through,
+// so one lookup answers vertex, midpoint and edge queries without
+// touching the rest of the scene.
+class STLSnapIndex {
+	public:
+		STLSnapIndex(const std::vector<SnapObject> &objects);
+
+		SnapType Find(const glm::vec3 &point, float radius, glm::vec3 &result,
+			snap_visible_func visible = NULL, void *cookie = NULL) const;
+
+	private:
+		void Build();
+		uint32 CellHash(int32 x, int32 y, int32 z) const;
+		// Edges are numbered across the objects, three per facet
+		void EdgePoints(uint32 edge, glm::vec3 &a, glm::vec3 &b) const;
+		template<typename Func> void ForEachEdgeCell(uint32 edge, Func func) const;
+
+		std::vector<SnapObject> fObjects;
+		std::vector<uint32> fFirstEdge;
+		float fCellSize;
+		uint32 fTableMask;
+		std::vector<uint32> fCellStart;
+		std::vector<uint32> fEdges;
+};
+
+#endif
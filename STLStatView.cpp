@@ -47,6 +47,7 @@ STLStatView::STLStatView(BRect frame)
 	view->AddChild(new BStringView("filename", B_TRANSLATE("Name:")));
 	view->AddChild(new BStringView("type", B_TRANSLATE("STL Type:")));
 	view->AddChild(new BStringView("title", B_TRANSLATE("Title:")));
+	view->AddChild(new BStringView("fingerprint", B_TRANSLATE("Fingerprint:")));
 
 	BStringView *sizeTitle = new BStringView("size", B_TRANSLATE("Object size"));
 	sizeTitle->SetAlignment(B_ALIGN_CENTER);
@@ -63,6 +64,8 @@ STLStatView::STLStatView(BRect frame)
 	view->AddChild(new BStringView("length", B_TRANSLATE("Length:")));
 	view->AddChild(new BStringView("height", B_TRANSLATE("Height:")));
 	view->AddChild(new BStringView("volume", B_TRANSLATE("Volume:")));
+	view->AddChild(new BStringView("hull_volume", B_TRANSLATE("Hull volume:")));
+	view->AddChild(new BStringView("solidity", B_TRANSLATE("Solidity:")));
 
 	BStringView *facetsTitle = new BStringView("facets", B_TRANSLATE("Facet status"));
 	facetsTitle->SetAlignment(B_ALIGN_CENTER);
@@ -71,6 +74,8 @@ STLStatView::STLStatView(BRect frame)
 
 	view->AddChild(new BStringView("num_facets", B_TRANSLATE("Facets:")));
 	view->AddChild(new BStringView("num_disconnected_facets", B_TRANSLATE("Disconnected:")));
+	view->AddChild(new BStringView("components", B_TRANSLATE("Components:")));
+	view->AddChild(new BStringView("unique_parts", B_TRANSLATE("Unique parts:")));
 
 	BStringView *processingTitle = new BStringView("processing", B_TRANSLATE("Processing"));
 	processingTitle->SetAlignment(B_ALIGN_CENTER);
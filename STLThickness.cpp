@@ -0,0 +1,111 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "STLThickness.h"
+#include "STLBVH.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Rays start this far from their own facet, relative to the model size,
+// so neighbours sharing an edge are not reported as zero thickness
+#define THICKNESS_RAY_OFFSET	1.0e-6f
+#define THICKNESS_GRAIN			1024
+#define THICKNESS_MAX_STEPS		4
+
+STLThickness::STLThickness(stl_file *stl)
+	: fStl(stl),
+	fMinimum(-1.0f)
+{
+	Analyze();
+}
+
+void
+STLThickness::Analyze(void)
+{
+	int32 facets = fStl->stats.number_of_facets;
+	if (facets <= 0)
+		return;
+
+	fValues.assign(facets, -1.0f);
+	fAreas.assign(facets, 0.0f);
+
+	STLBVH bvh(fStl);
+	glm::vec3 size(fStl->stats.size.x, fStl->stats.size.y, fStl->stats.size.z);
+	float offset = glm::length(size) * THICKNESS_RAY_OFFSET;
+
+	ParallelFor(facets, THICKNESS_GRAIN, [&](int32 first, int32 last) {
+		for (int32 i = first; i < last; i++) {
+			const stl_vertex *v = fStl->facet_start[i].vertex;
+			glm::vec3 a(v[0].x, v[0].y, v[0].z);
+			glm::vec3 b(v[1].x, v[1].y, v[1].z);
+			glm::vec3 c(v[2].x, v[2].y, v[2].z);
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			if (length <= 0.0f)
+				continue;
+
+			fAreas[i] = length * 0.5f;
+
+			// The opposite wall is left through its back side. Front
+			// sides met first belong to folds around the start point,
+			// the ray steps over them.
+			glm::vec3 direction = -normal / length;
+			glm::vec3 origin = (a + b + c) / 3.0f;
+			int32 ignore = i;
+			float travelled = 0.0f;
+			for (int32 step = 0; step < THICKNESS_MAX_STEPS; step++) {
+				float t;
+				int32 facet;
+				if (!bvh.Raycast(origin, direction, offset, FLT_MAX, ignore, &t, &facet))
+					break;
+
+				const stl_vertex *w = fStl->facet_start[facet].vertex;
+				glm::vec3 hitNormal = glm::cross(
+					glm::vec3(w[1].x - w[0].x, w[1].y - w[0].y, w[1].z - w[0].z),
+					glm::vec3(w[2].x - w[0].x, w[2].y - w[0].y, w[2].z - w[0].z));
+				travelled += t;
+				if (glm::dot(hitNormal, direction) >= 0.0f) {
+					fValues[i] = travelled;
+					break;
+				}
+
+				origin += direction * t;
+				ignore = facet;
+			}
+		}
+	});
+
+	for (int32 i = 0; i < facets; i++) {
+		if (fValues[i] >= 0.0f && (fMinimum < 0.0f || fValues[i] < fMinimum))
+			fMinimum = fValues[i];
+	}
+}
+
+float
+STLThickness::Area(float limit) const
+{
+	double area = 0.0;
+	for (size_t i = 0; i < fValues.size(); i++) {
+		if (fValues[i] >= 0.0f && fValues[i] < limit)
+			area += fAreas[i];
+	}
+	return area;
+}
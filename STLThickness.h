@@ -0,0 +1,48 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_THICKNESS
+#define STLOVER_THICKNESS
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+
+// Wall thickness per facet, measured by casting a ray from the facet
+// centroid against its outward normal and taking the distance to the
+// first other facet it meets. Rays that leave an open mesh without a hit
+// give -1.
+class STLThickness {
+	public:
+		STLThickness(stl_file *stl);
+
+		const std::vector<float>& Values(void) const { return fValues; }
+		float Minimum(void) const { return fMinimum; }
+		float Area(float limit) const;
+
+	private:
+		void Analyze(void);
+
+		stl_file *fStl;
+		std::vector<float> fValues;
+		std::vector<float> fAreas;
+		float fMinimum;
+};
+
+#endif
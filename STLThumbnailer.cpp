@@ -0,0 +1,310 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <BitmapStream.h>
+#include <Directory.h>
+#include <File.h>
+#include <NodeInfo.h>
+#include <Path.h>
+#include <TranslatorFormats.h>
+#include <TranslatorRoster.h>
+
+#include "STLApp.h"
+#include "STLView.h"
+#include "STLWindow.h"
+#include "STLThumbnailer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+STLThumbnailer::STLThumbnailer(int argc, char **argv)
+	: BApplication(THUMBNAILER_SIGNATURE),
+	fWindow(NULL),
+	fView(NULL),
+	fWidth(THUMBNAILER_DEFAULT_SIZE),
+	fHeight(THUMBNAILER_DEFAULT_SIZE),
+	fPreset(MSG_VIEWMODE_ISO),
+	fJobs(0),
+	fValid(false),
+	fQueueLock("thumbnailer queue"),
+	fQueueItems(-1),
+	fQueueSlots(-1),
+	fNextFile(0),
+	fLoaders(0),
+	fFailed(0)
+{
+	fValid = ParseArguments(argc, argv);
+	if (!fValid) {
+		PrintUsage();
+		fFailed = 1;
+	}
+}
+
+STLThumbnailer::~STLThumbnailer()
+{
+	delete_sem(fQueueItems);
+	delete_sem(fQueueSlots);
+}
+
+bool
+STLThumbnailer::ParseArguments(int argc, char **argv)
+{
+	for (int i = 2; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--size") == 0 && value != NULL) {
+			if (sscanf(value, "%" B_SCNd32 "x%" B_SCNd32, &fWidth, &fHeight) == 1)
+				fHeight = fWidth;
+			if (fWidth <= 0 || fHeight <= 0)
+				return false;
+			i++;
+		} else if (strcmp(arg, "--view") == 0 && value != NULL) {
+			if (strcmp(value, "front") == 0)
+				fPreset = MSG_VIEWMODE_FRONT;
+			else if (strcmp(value, "top") == 0)
+				fPreset = MSG_VIEWMODE_TOP;
+			else if (strcmp(value, "right") == 0)
+				fPreset = MSG_VIEWMODE_RIGHT;
+			else if (strcmp(value, "iso") == 0)
+				fPreset = MSG_VIEWMODE_ISO;
+			else
+				return false;
+			i++;
+		} else if (strcmp(arg, "--output") == 0 && value != NULL) {
+			fOutputDirectory = value;
+			i++;
+		} else if (strcmp(arg, "--jobs") == 0 && value != NULL) {
+			fJobs = atoi(value);
+			if (fJobs <= 0)
+				return false;
+			i++;
+		} else if (strncmp(arg, "--", 2) == 0) {
+			return false;
+		} else {
+			fFiles.push_back(arg);
+		}
+	}
+
+	return !fFiles.empty();
+}
+
+void
+STLThumbnailer::PrintUsage(void)
+{
+	fprintf(stderr, "Usage: STLover --thumbnails [--size N|WxH] [--view front|top|right|iso]\n"
+		"                          [--output directory] [--jobs N] file.stl...\n");
+}
+
+void
+STLThumbnailer::ReadyToRun()
+{
+	if (!fValid) {
+		PostMessage(B_QUIT_REQUESTED);
+		return;
+	}
+
+	if (fJobs <= 0) {
+		system_info info;
+		get_system_info(&info);
+		fJobs = info.cpu_count > 1 ? info.cpu_count - 1 : 1;
+	}
+	if (fJobs > (int32)fFiles.size())
+		fJobs = fFiles.size();
+
+	fQueueItems = create_sem(0, "thumbnailer items");
+	fQueueSlots = create_sem(fJobs * THUMBNAILER_QUEUE_DEPTH, "thumbnailer slots");
+
+	// The window is never shown, it only hosts the GL context of the view
+	fWindow = new BWindow(BRect(0, 0, fWidth - 1, fHeight - 1), "Thumbnailer",
+		B_TITLED_WINDOW, B_NOT_RESIZABLE | B_NOT_ZOOMABLE);
+	fView = new STLView(fWindow->Bounds(), BGL_RGB | BGL_DOUBLE | BGL_DEPTH);
+	fWindow->AddChild(fView);
+	fWindow->Hide();
+	fWindow->Show();
+
+	// Without the renderer nothing gets done, every file counts as failed
+	thread_id renderer = spawn_thread(_RenderFunction, "thumbnailRenderer", B_NORMAL_PRIORITY, (void*)this);
+	if (renderer < B_OK) {
+		fprintf(stderr, "Can't start the renderer: %s\n", strerror(renderer));
+		fFailed += fFiles.size();
+		PostMessage(B_QUIT_REQUESTED);
+		return;
+	}
+
+	// The renderer loads the files itself if no loader could be started
+	for (int32 i = 0; i < fJobs; i++) {
+		thread_id loader = spawn_thread(_LoaderFunction, "thumbnailLoader", B_NORMAL_PRIORITY, (void*)this);
+		if (loader < B_OK)
+			continue;
+		fLoaders++;
+		resume_thread(loader);
+	}
+
+	resume_thread(renderer);
+}
+
+BString
+STLThumbnailer::OutputPath(const char *input)
+{
+	BPath path(input);
+	BString name(path.Leaf());
+	if (name.IEndsWith(".stl"))
+		name.Truncate(name.Length() - 4);
+	name << ".png";
+
+	BPath output;
+	if (fOutputDirectory.Length() > 0)
+		output.SetTo(fOutputDirectory.String(), name.String());
+	else {
+		path.GetParent(&output);
+		output.Append(name.String());
+	}
+
+	return output.Path();
+}
+
+STLThumbnailer::LoadedFile
+STLThumbnailer::LoadFile(int32 index)
+{
+	LoadedFile loaded = { index, new stl_file, -5.0f, 10.0f };
+	stl_open(loaded.stl, (char*)fFiles[index].String());
+	if (stl_get_error(loaded.stl)) {
+		stl_close(loaded.stl);
+		delete loaded.stl;
+		loaded.stl = NULL;
+	} else {
+		stl_fix_normal_values(loaded.stl);
+		STLWindow::TransformPosition(loaded.stl, &loaded.zDepth, &loaded.maxExtent);
+	}
+	return loaded;
+}
+
+status_t
+STLThumbnailer::WritePNG(BBitmap *bitmap, const char *path)
+{
+	BFile file(path, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	status_t status = file.InitCheck();
+	if (status != B_OK)
+		return status;
+
+	BBitmapStream stream(bitmap);
+	status = BTranslatorRoster::Default()->Translate(&stream, NULL, NULL, &file, B_PNG_FORMAT);
+
+	BBitmap *detached = NULL;
+	stream.DetachBitmap(&detached);
+
+	if (status == B_OK) {
+		BNodeInfo info(&file);
+		info.SetType("image/png");
+	}
+
+	return status;
+}
+
+int32
+STLThumbnailer::_LoaderFunction(void *data)
+{
+	STLThumbnailer *thumbnailer = (STLThumbnailer*)data;
+	int32 count = thumbnailer->fFiles.size();
+
+	while (true) {
+		int32 index = atomic_add(&thumbnailer->fNextFile, 1);
+		if (index >= count)
+			break;
+
+		if (acquire_sem(thumbnailer->fQueueSlots) != B_OK)
+			break;
+
+		LoadedFile loaded = thumbnailer->LoadFile(index);
+
+		thumbnailer->fQueueLock.Lock();
+		thumbnailer->fQueue.push_back(loaded);
+		thumbnailer->fQueueLock.Unlock();
+		release_sem(thumbnailer->fQueueItems);
+	}
+
+	return 0;
+}
+
+int32
+STLThumbnailer::_RenderFunction(void *data)
+{
+	STLThumbnailer *thumbnailer = (STLThumbnailer*)data;
+	STLView *view = thumbnailer->fView;
+	int32 count = thumbnailer->fFiles.size();
+
+	BBitmap *bitmap = new BBitmap(BRect(0, 0, thumbnailer->fWidth - 1, thumbnailer->fHeight - 1), B_RGBA32);
+
+	for (int32 i = 0; i < count; i++) {
+		LoadedFile loaded;
+		if (thumbnailer->fLoaders == 0) {
+			acquire_sem(thumbnailer->fQueueSlots);
+			loaded = thumbnailer->LoadFile(i);
+		} else {
+			if (acquire_sem(thumbnailer->fQueueItems) != B_OK)
+				break;
+
+			thumbnailer->fQueueLock.Lock();
+			loaded = thumbnailer->fQueue.front();
+			thumbnailer->fQueue.pop_front();
+			thumbnailer->fQueueLock.Unlock();
+		}
+
+		const char *input = thumbnailer->fFiles[loaded.index].String();
+
+		if (loaded.stl == NULL) {
+			fprintf(stderr, "%s: can't open file\n", input);
+			thumbnailer->fFailed++;
+			release_sem(thumbnailer->fQueueSlots);
+			continue;
+		}
+
+		view->SetSTL(loaded.stl, loaded.zDepth, loaded.maxExtent);
+		view->SetViewPreset(thumbnailer->fPreset);
+
+		BString output = thumbnailer->OutputPath(input);
+		status_t status = view->RenderOffscreen(bitmap);
+		if (status == B_OK)
+			status = thumbnailer->WritePNG(bitmap, output.String());
+
+		if (status == B_OK) {
+			printf("%s\n", output.String());
+		} else {
+			fprintf(stderr, "%s: %s\n", output.String(), strerror(status));
+			thumbnailer->fFailed++;
+		}
+
+		view->SetSTL(NULL);
+		stl_close(loaded.stl);
+		delete loaded.stl;
+
+		release_sem(thumbnailer->fQueueSlots);
+	}
+
+	delete bitmap;
+
+	// Loaders blocked on a slot wake up with an error and exit
+	delete_sem(thumbnailer->fQueueSlots);
+	thumbnailer->fQueueSlots = -1;
+
+	thumbnailer->PostMessage(B_QUIT_REQUESTED);
+
+	return 0;
+}
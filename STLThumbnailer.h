@@ -0,0 +1,90 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef STLOVER_THUMBNAILER
+#define STLOVER_THUMBNAILER
+
+#include <Application.h>
+#include <Bitmap.h>
+#include <Locker.h>
+#include <String.h>
+#include <Window.h>
+#include <OS.h>
+
+#include <admesh/stl.h>
+
+#include <deque>
+#include <vector>
+
+#define THUMBNAILER_SIGNATURE "application/x-vnd.stlover-thumbnailer"
+#define THUMBNAILER_DEFAULT_SIZE 256
+#define THUMBNAILER_QUEUE_DEPTH 2
+
+class STLView;
+
+// Command line mode that renders PNG thumbnails for a list of STL files.
+// Rendering goes through one hidden STLView and its offscreen framebuffer,
+// so a single GL context is reused for the whole batch while loader threads
+// keep reading the next files in parallel.
+class STLThumbnailer : public BApplication {
+	public:
+		STLThumbnailer(int argc, char **argv);
+		~STLThumbnailer();
+
+		virtual void ReadyToRun();
+
+		int32 Result(void) { return fFailed > 0 ? 1 : 0; }
+
+		static int32 _RenderFunction(void *data);
+		static int32 _LoaderFunction(void *data);
+
+	private:
+		struct LoadedFile {
+			int32 index;
+			stl_file *stl;
+			float zDepth;
+			float maxExtent;
+		};
+
+		bool ParseArguments(int argc, char **argv);
+		void PrintUsage(void);
+		LoadedFile LoadFile(int32 index);
+		BString OutputPath(const char *input);
+		status_t WritePNG(BBitmap *bitmap, const char *path);
+
+		BWindow *fWindow;
+		STLView *fView;
+
+		std::vector<BString> fFiles;
+		BString fOutputDirectory;
+		int32 fWidth;
+		int32 fHeight;
+		uint32 fPreset;
+		int32 fJobs;
+		bool fValid;
+
+		BLocker fQueueLock;
+		std::deque<LoadedFile> fQueue;
+		sem_id fQueueItems;
+		sem_id fQueueSlots;
+		int32 fNextFile;
+		int32 fLoaders;
+		int32 fFailed;
+};
+
+#endif
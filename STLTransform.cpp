@@ -0,0 +1,255 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLTransform.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct Bounds {
+	glm::vec3 low;
+	glm::vec3 high;
+};
+
+// Reversing every facet swaps its first two vertices. The edges after
+// the first trade places and the vertices named by the neighbour table
+// are renumbered, the orientation flag stays as both sides turn over.
+static inline void
+ReverseNeighbors(stl_neighbors &neighbors)
+{
+	static const int renumber[3] = { 1, 0, 2 };
+
+	std::swap(neighbors.neighbor[1], neighbors.neighbor[2]);
+	std::swap(neighbors.which_vertex_not[1], neighbors.which_vertex_not[2]);
+	for (int k = 0; k < 3; k++) {
+		int vnot = neighbors.which_vertex_not[k];
+		if (neighbors.neighbor[k] < 0 || vnot < 0)
+			continue;
+		neighbors.which_vertex_not[k] = renumber[vnot % 3] + (vnot >= 3 ? 3 : 0);
+	}
+}
+
+STLTransform::STLTransform(void)
+	: fMatrix(1.0f)
+{
+}
+
+STLTransform::STLTransform(const glm::mat4 &matrix)
+	: fMatrix(matrix)
+{
+}
+
+STLTransform&
+STLTransform::Translate(float x, float y, float z)
+{
+	fMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z)) * fMatrix;
+	return *this;
+}
+
+STLTransform&
+STLTransform::Scale(float x, float y, float z)
+{
+	fMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(x, y, z)) * fMatrix;
+	return *this;
+}
+
+STLTransform&
+STLTransform::RotateX(float angle)
+{
+	fMatrix = glm::rotate(glm::mat4(1.0f), (float)(angle * M_PI / 180.0), glm::vec3(1, 0, 0)) * fMatrix;
+	return *this;
+}
+
+STLTransform&
+STLTransform::RotateY(float angle)
+{
+	fMatrix = glm::rotate(glm::mat4(1.0f), (float)(angle * M_PI / 180.0), glm::vec3(0, 1, 0)) * fMatrix;
+	return *this;
+}
+
+STLTransform&
+STLTransform::RotateZ(float angle)
+{
+	fMatrix = glm::rotate(glm::mat4(1.0f), (float)(angle * M_PI / 180.0), glm::vec3(0, 0, 1)) * fMatrix;
+	return *this;
+}
+
+STLTransform&
+STLTransform::Multiply(const glm::mat4 &matrix)
+{
+	fMatrix = matrix * fMatrix;
+	return *this;
+}
+
+STLTransform
+STLTransform::MoveTo(stl_file *stl, float x, float y, float z)
+{
+	STLTransform transform;
+	transform.Translate(x - stl->stats.min.x, y - stl->stats.min.y, z - stl->stats.min.z);
+	return transform;
+}
+
+bool
+STLTransform::IsMirroring(void) const
+{
+	return glm::determinant(glm::mat3(fMatrix)) < 0.0f;
+}
+
+void
+STLTransform::Apply(stl_file *stl) const
+{
+	int32 facets = stl->stats.number_of_facets;
+	if (facets <= 0)
+		return;
+
+	glm::mat3 linear(fMatrix);
+	float determinant = glm::determinant(linear);
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+	bool mirror = determinant < 0.0f;
+	bool neighbors = mirror && stl->neighbors_start != NULL;
+
+	int32 chunks = (facets + TRANSFORM_GRAIN - 1) / TRANSFORM_GRAIN;
+	std::vector<Bounds> bounds(chunks);
+
+	ParallelFor(facets, TRANSFORM_GRAIN, [&](int32 first, int32 last) {
+		glm::vec3 low(FLT_MAX);
+		glm::vec3 high(-FLT_MAX);
+
+#if defined(__SSE2__)
+		// Facets are packed with two bytes of padding, so every vector
+		// is loaded first and stored in address order, each wide store
+		// spilling into the next one before that is written
+		__m128 c0 = _mm_setr_ps(fMatrix[0][0], fMatrix[0][1], fMatrix[0][2], 0.0f);
+		__m128 c1 = _mm_setr_ps(fMatrix[1][0], fMatrix[1][1], fMatrix[1][2], 0.0f);
+		__m128 c2 = _mm_setr_ps(fMatrix[2][0], fMatrix[2][1], fMatrix[2][2], 0.0f);
+		__m128 c3 = _mm_setr_ps(fMatrix[3][0], fMatrix[3][1], fMatrix[3][2], 0.0f);
+		__m128 n0 = _mm_setr_ps(normalMatrix[0][0], normalMatrix[0][1], normalMatrix[0][2], 0.0f);
+		__m128 n1 = _mm_setr_ps(normalMatrix[1][0], normalMatrix[1][1], normalMatrix[1][2], 0.0f);
+		__m128 n2 = _mm_setr_ps(normalMatrix[2][0], normalMatrix[2][1], normalMatrix[2][2], 0.0f);
+		__m128 lowest = _mm_set1_ps(FLT_MAX);
+		__m128 highest = _mm_set1_ps(-FLT_MAX);
+
+		for (int32 i = first; i < last; i++) {
+			stl_facet &facet = stl->facet_start[i];
+			__m128 in[4];
+			in[0] = _mm_loadu_ps(&facet.normal.x);
+			in[1] = _mm_loadu_ps(&facet.vertex[0].x);
+			in[2] = _mm_loadu_ps(&facet.vertex[1].x);
+			in[3] = _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double*)&facet.vertex[2].x)),
+				_mm_load_ss(&facet.vertex[2].z));
+
+			__m128 out[4];
+			out[0] = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(n0, _mm_shuffle_ps(in[0], in[0], 0x00)),
+				_mm_mul_ps(n1, _mm_shuffle_ps(in[0], in[0], 0x55))),
+				_mm_mul_ps(n2, _mm_shuffle_ps(in[0], in[0], 0xAA)));
+			for (int k = 1; k < 4; k++) {
+				out[k] = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(c0, _mm_shuffle_ps(in[k], in[k], 0x00)),
+					_mm_mul_ps(c1, _mm_shuffle_ps(in[k], in[k], 0x55))),
+					_mm_add_ps(_mm_mul_ps(c2, _mm_shuffle_ps(in[k], in[k], 0xAA)), c3));
+				lowest = _mm_min_ps(lowest, out[k]);
+				highest = _mm_max_ps(highest, out[k]);
+			}
+
+			__m128 squared = _mm_mul_ps(out[0], out[0]);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_shuffle_ps(squared, squared, 0x00),
+				_mm_shuffle_ps(squared, squared, 0x55)), _mm_shuffle_ps(squared, squared, 0xAA)));
+			__m128 valid = _mm_cmpgt_ps(length, _mm_setzero_ps());
+			out[0] = _mm_and_ps(_mm_div_ps(out[0], _mm_max_ps(length, _mm_set1_ps(FLT_MIN))), valid);
+
+			_mm_storeu_ps(&facet.normal.x, out[0]);
+			_mm_storeu_ps(&facet.vertex[0].x, mirror ? out[2] : out[1]);
+			_mm_storeu_ps(&facet.vertex[1].x, mirror ? out[1] : out[2]);
+			_mm_store_sd((double*)&facet.vertex[2].x, _mm_castps_pd(out[3]));
+			_mm_store_ss(&facet.vertex[2].z, _mm_movehl_ps(out[3], out[3]));
+
+			if (neighbors)
+				ReverseNeighbors(stl->neighbors_start[i]);
+		}
+
+		float lanes[4];
+		_mm_storeu_ps(lanes, lowest);
+		low = glm::vec3(lanes[0], lanes[1], lanes[2]);
+		_mm_storeu_ps(lanes, highest);
+		high = glm::vec3(lanes[0], lanes[1], lanes[2]);
+#else
+		for (int32 i = first; i < last; i++) {
+			stl_facet &facet = stl->facet_start[i];
+			glm::vec3 vertices[3];
+			for (int k = 0; k < 3; k++) {
+				vertices[k] = glm::vec3(fMatrix * glm::vec4(facet.vertex[k].x, facet.vertex[k].y,
+					facet.vertex[k].z, 1.0f));
+				low = glm::min(low, vertices[k]);
+				high = glm::max(high, vertices[k]);
+			}
+			if (mirror)
+				std::swap(vertices[0], vertices[1]);
+			for (int k = 0; k < 3; k++) {
+				facet.vertex[k].x = vertices[k].x;
+				facet.vertex[k].y = vertices[k].y;
+				facet.vertex[k].z = vertices[k].z;
+			}
+
+			glm::vec3 normal = normalMatrix * glm::vec3(facet.normal.x, facet.normal.y, facet.normal.z);
+			float length = glm::length(normal);
+			normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+			facet.normal.x = normal.x;
+			facet.normal.y = normal.y;
+			facet.normal.z = normal.z;
+
+			if (neighbors)
+				ReverseNeighbors(stl->neighbors_start[i]);
+		}
+#endif
+
+		bounds[first / TRANSFORM_GRAIN] = { low, high };
+	});
+
+	glm::vec3 low = bounds[0].low;
+	glm::vec3 high = bounds[0].high;
+	for (int32 i = 1; i < chunks; i++) {
+		low = glm::min(low, bounds[i].low);
+		high = glm::max(high, bounds[i].high);
+	}
+
+	stl->stats.min.x = low.x;
+	stl->stats.min.y = low.y;
+	stl->stats.min.z = low.z;
+	stl->stats.max.x = high.x;
+	stl->stats.max.y = high.y;
+	stl->stats.max.z = high.z;
+	stl->stats.size.x = high.x - low.x;
+	stl->stats.size.y = high.y - low.y;
+	stl->stats.size.z = high.z - low.z;
+	stl->stats.bounding_diameter = glm::length(high - low);
+	if (stl->stats.volume > 0.0)
+		stl->stats.volume *= fabs(determinant);
+
+	stl_invalidate_shared_vertices(stl);
+}
@@ -0,0 +1,65 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_TRANSFORM
+#define STLOVER_TRANSFORM
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <glm/glm.hpp>
+
+#define TRANSFORM_GRAIN		16384
+
+// Collects moves, scales, rotations and mirrors into one affine matrix,
+// each operation applied after the ones before it, and applies it to a
+// mesh in a single pass on all CPUs. Vertices go through the matrix and
+// normals through its inverse transpose, and the bounding box is gathered
+// on the way. A mirroring matrix also reverses the facets, so they keep
+// facing outwards as admesh's mirror functions do.
+class STLTransform {
+	public:
+		STLTransform(void);
+		STLTransform(const glm::mat4 &matrix);
+
+		// Angles are in degrees, as admesh takes them
+		STLTransform& Translate(float x, float y, float z);
+		STLTransform& Scale(float x, float y, float z);
+		STLTransform& Scale(float factor) { return Scale(factor, factor, factor); }
+		STLTransform& RotateX(float angle);
+		STLTransform& RotateY(float angle);
+		STLTransform& RotateZ(float angle);
+		STLTransform& MirrorXY(void) { return Scale(1.0f, 1.0f, -1.0f); }
+		STLTransform& MirrorYZ(void) { return Scale(-1.0f, 1.0f, 1.0f); }
+		STLTransform& MirrorXZ(void) { return Scale(1.0f, -1.0f, 1.0f); }
+		STLTransform& Multiply(const glm::mat4 &matrix);
+
+		// Translations that take the bounding box corner to a point
+		static STLTransform MoveTo(stl_file *stl, float x, float y, float z);
+
+		const glm::mat4& Matrix(void) const { return fMatrix; }
+		bool IsMirroring(void) const;
+
+		void Apply(stl_file *stl) const;
+
+	private:
+		glm::mat4 fMatrix;
+};
+
+#endif
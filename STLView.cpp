@@ -20,15 +20,20 @@
 #define GL_GLEXT_PROTOTYPES 1
 
 #include <GL/gl.h>
-#include <GL/glu.h>
-#include <GL/glut.h>
 #include <GL/glext.h>
 #include <GLView.h>
 
 #include "STLApp.h"
 #include "STLView.h"
-#include "STLWindow.h"
-
+#include "STLPNGWriter.h"
+#include "STLParts.h"
+#include "STLSection.h"
+#include "STLOverhang.h"
+#include "STLEdges.h"
+#include "STLHull.h"
+
+#include <algorithm>
+#include <cfloat>
 #include <cstring>
 #include <iostream>
 #include <vector>
@@ -65,8 +70,14 @@ STLView::STLView(BRect frame, uint32 type)
 STLView::~STLView()
 {
 	CleanupBuffers();
+	delete snapIndex;
 	delete appIcon;
 	glDeleteProgram(shaderProgram);
+	glDeleteProgram(lineShaderProgram);
+	glDeleteProgram(gridShaderProgram);
+	glDeleteBuffers(1, &frameUBO);
+	glDeleteVertexArrays(1, &gridVAO);
+	CleanupOffscreen();
 	delete moveCursor;
 	delete crossCursor;
 	delete rotateCursor;
@@ -80,16 +91,32 @@ STLView::InitShaders()
 		#version 330 core
 		layout (location = 0) in vec3 aPos;
 		layout (location = 1) in vec3 aNormal;
+		layout (location = 2) in float aAnalysis;
+		layout (location = 3) in mat4 aInstance;
 		out vec3 FragPos;
 		out vec3 Normal;
+		flat out float Analysis;
+		out float Deviation;
+		noperspective out vec3 Barycentric;
+		layout (std140) uniform Frame
+		{
+			mat4 view;
+			mat4 projection;
+			vec4 viewPos;
+		};
 		uniform mat4 model;
-		uniform mat4 view;
-		uniform mat4 projection;
+		uniform mat3 normalMatrix;
+		uniform vec4 clipPlane;
 		void main()
 		{
-			FragPos = vec3(model * vec4(aPos, 1.0));
-			Normal = mat3(transpose(inverse(model))) * aNormal;
+			int corner = gl_VertexID % 3;
+			Barycentric = vec3(corner == 0, corner == 1, corner == 2);
+			FragPos = vec3(model * aInstance * vec4(aPos, 1.0));
+			Normal = normalMatrix * mat3(aInstance) * aNormal;
+			Analysis = aAnalysis;
+			Deviation = aAnalysis;
 			gl_Position = projection * view * vec4(FragPos, 1.0);
+			gl_ClipDistance[0] = dot(vec4(FragPos, 1.0), clipPlane);
 		}
 	)";
 
@@ -97,17 +124,37 @@ STLView::InitShaders()
 		#version 330 core
 		in vec3 FragPos;
 		in vec3 Normal;
+		flat in float Analysis;
+		in float Deviation;
+		noperspective in vec3 Barycentric;
 		out vec4 FragColor;
 
+		layout (std140) uniform Frame
+		{
+			mat4 view;
+			mat4 projection;
+			vec4 viewPos;
+		};
 		uniform vec4 objectColor;
-		uniform vec3 viewPos;
+		uniform int edgeMode;
+		uniform vec3 edgeColor;
+		uniform float edgeWidth;
+		uniform bool showOverhang;
+		uniform float overhangLimit;
+		uniform bool showThickness;
+		uniform float thicknessLimit;
+		uniform bool showIntersections;
+		uniform bool showDeviation;
+		uniform float deviationLimit;
+		uniform bool showCurvature;
+		uniform float curvatureLimit;
 
 		void main()
 		{
 			vec3 lightPos = vec3(0.0, 200.0, 0.0);
 			vec3 norm = normalize(Normal);
 			vec3 lightDir = normalize(lightPos - FragPos);
-			vec3 viewDir = normalize(viewPos - FragPos);
+			vec3 viewDir = normalize(viewPos.xyz - FragPos);
 
 			float ambientStrength = 0.6;
 			vec3 ambient = ambientStrength * vec3(1.0);
@@ -118,9 +165,65 @@ STLView::InitShaders()
 
 			float backLight = max(-dot(norm, lightDir), 0.0) * 1.5;
 
-			vec3 result = (ambient + diffuse + backLight) * objectColor.rgb;
+			// Overhangs past the limit go from yellow to red as they
+			// approach a flat ceiling
+			vec3 color = objectColor.rgb;
+			if (showOverhang && Analysis > overhangLimit) {
+				float strength = (Analysis - overhangLimit) / max(1.0 - overhangLimit, 1e-4);
+				color = mix(vec3(1.0, 0.85, 0.1), vec3(0.9, 0.1, 0.1), strength);
+			}
+
+			// Walls thinner than the limit turn red as they get thinner,
+			// facets without a measured wall keep the object color
+			if (showThickness && Analysis >= 0.0 && Analysis < thicknessLimit) {
+				float strength = 1.0 - Analysis / max(thicknessLimit, 1e-4);
+				color = mix(vec3(1.0, 0.85, 0.1), vec3(0.9, 0.1, 0.1), strength);
+			}
+
+			if (showIntersections && Analysis > 0.5)
+				color = vec3(0.9, 0.1, 0.1);
+
+			// Green on the reference, red outside of it and blue inside,
+			// full strength from the tolerance on. Objects that were not
+			// compared carry a huge value and keep their color.
+			if (showDeviation && abs(Deviation) < 1.0e30) {
+				float strength = clamp(Deviation / max(deviationLimit, 1e-6), -1.0, 1.0);
+				if (strength >= 0.0)
+					color = mix(vec3(0.2, 0.8, 0.3), vec3(0.9, 0.1, 0.1), strength);
+				else
+					color = mix(vec3(0.2, 0.8, 0.3), vec3(0.1, 0.3, 0.9), -strength);
+			}
+
+			// Convex red and concave blue, full strength at the limit,
+			// vertices without a value keep the object color
+			if (showCurvature && abs(Deviation) < 1.0e30) {
+				float strength = clamp(Deviation / max(curvatureLimit, 1e-12), -1.0, 1.0);
+				if (strength >= 0.0)
+					color = mix(vec3(0.85), vec3(0.9, 0.25, 0.1), strength);
+				else
+					color = mix(vec3(0.85), vec3(0.1, 0.4, 0.9), -strength);
+			}
+
+			vec3 result = (ambient + diffuse + backLight) * color;
+
+			if (edgeMode == 0) {
+				FragColor = vec4(result, objectColor.a);
+				return;
+			}
 
-			FragColor = vec4(result, objectColor.a);
+			// Distance to the nearest triangle edge in pixels, taken from the
+			// screen-space derivatives of the barycentric coordinates
+			vec3 width = fwidth(Barycentric) * edgeWidth;
+			vec3 factor = smoothstep(vec3(0.0), width, Barycentric);
+			float edge = 1.0 - min(min(factor.x, factor.y), factor.z);
+
+			if (edgeMode == 1) {
+				FragColor = vec4(mix(result, edgeColor, edge), objectColor.a);
+			} else {
+				if (edge <= 0.0)
+					discard;
+				FragColor = vec4(result, objectColor.a * edge);
+			}
 		}
 	)";
 
@@ -129,12 +232,20 @@ STLView::InitShaders()
 		layout (location = 0) in vec3 aPos;
 		layout (location = 1) in vec3 aColor;
 		out vec3 Color;
+		layout (std140) uniform Frame
+		{
+			mat4 view;
+			mat4 projection;
+			vec4 viewPos;
+		};
 		uniform mat4 model;
-		uniform mat4 view;
-		uniform mat4 projection;
+		uniform bool screenSpace;
 		void main()
 		{
-			gl_Position = projection * view * model * vec4(aPos, 1.0);
+			if (screenSpace)
+				gl_Position = vec4(aPos, 1.0);
+			else
+				gl_Position = projection * view * model * vec4(aPos, 1.0);
 			Color = aColor;
 		}
 	)";
@@ -149,6 +260,71 @@ STLView::InitShaders()
 		}
 	)";
 
+	const char* gridVertexShaderSource = R"(
+		#version 330 core
+		out vec2 GridPos;
+		layout (std140) uniform Frame
+		{
+			mat4 view;
+			mat4 projection;
+			vec4 viewPos;
+		};
+		uniform float gridExtent;
+		const vec2 corners[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0),
+			vec2(-1.0, 1.0), vec2(1.0, 1.0));
+		void main()
+		{
+			GridPos = corners[gl_VertexID] * gridExtent;
+			gl_Position = projection * view * vec4(GridPos, 0.0, 1.0);
+		}
+	)";
+
+	const char* gridFragmentShaderSource = R"(
+		#version 330 core
+		in vec2 GridPos;
+		out vec4 FragColor;
+		uniform float gridExtent;
+		uniform bool showGrid;
+		uniform bool showAxes;
+
+		float gridLines(float spacing)
+		{
+			vec2 coord = GridPos / spacing;
+			vec2 line = abs(fract(coord - 0.5) - 0.5) / fwidth(coord);
+			return 1.0 - min(min(line.x, line.y), 1.0);
+		}
+
+		void main()
+		{
+			vec2 derivative = fwidth(GridPos);
+
+			// Pick the power of ten spacing that keeps the finest lines at
+			// least 8 pixels apart and fade it out as it gets denser
+			float lod = log(max(max(derivative.x, derivative.y) * 8.0, 1e-6)) / log(10.0);
+			float spacing = pow(10.0, floor(lod));
+			float fine = gridLines(spacing) * (1.0 - fract(lod));
+			float minor = gridLines(spacing * 10.0);
+			float major = gridLines(spacing * 100.0);
+
+			vec4 color = vec4(0.0);
+			if (showGrid)
+				color = vec4(0.0, 0.0, 1.0, max(max(fine * 0.35, minor * 0.6), major));
+
+			if (showAxes) {
+				vec2 axis = 1.0 - min(abs(GridPos) / (derivative * 1.5), 1.0);
+				color = mix(color, vec4(0.0, 1.0, 0.0, 1.0), axis.x);
+				color = mix(color, vec4(1.0, 0.0, 0.0, 1.0), axis.y);
+			}
+
+			float border = max(abs(GridPos.x), abs(GridPos.y)) / gridExtent;
+			color.a *= 1.0 - smoothstep(0.8, 1.0, border);
+			if (color.a <= 0.0)
+				discard;
+
+			FragColor = color;
+		}
+	)";
+
 	shaderProgram = CreateShaderProgram(vertexShaderSource, fragmentShaderSource);
 	if (shaderProgram == 0) {
 		std::cerr << "Failed to create shader program: shaderProgram" << std::endl;
@@ -161,11 +337,53 @@ STLView::InitShaders()
 		return;
 	}
 
+	gridShaderProgram = CreateShaderProgram(gridVertexShaderSource, gridFragmentShaderSource);
+	if (gridShaderProgram == 0) {
+		std::cerr << "Failed to create shader program: gridShaderProgram" << std::endl;
+		return;
+	}
+
 	modelLoc = glGetUniformLocation(shaderProgram, "model");
-	viewLoc = glGetUniformLocation(shaderProgram, "view");
-	projLoc = glGetUniformLocation(shaderProgram, "projection");
+	normalMatrixLoc = glGetUniformLocation(shaderProgram, "normalMatrix");
 	colorLoc = glGetUniformLocation(shaderProgram, "objectColor");
-	viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
+	edgeModeLoc = glGetUniformLocation(shaderProgram, "edgeMode");
+	clipPlaneLoc = glGetUniformLocation(shaderProgram, "clipPlane");
+	showOverhangLoc = glGetUniformLocation(shaderProgram, "showOverhang");
+	overhangLimitLoc = glGetUniformLocation(shaderProgram, "overhangLimit");
+	showThicknessLoc = glGetUniformLocation(shaderProgram, "showThickness");
+	thicknessLimitLoc = glGetUniformLocation(shaderProgram, "thicknessLimit");
+	showIntersectionsLoc = glGetUniformLocation(shaderProgram, "showIntersections");
+	showDeviationLoc = glGetUniformLocation(shaderProgram, "showDeviation");
+	deviationLimitLoc = glGetUniformLocation(shaderProgram, "deviationLimit");
+	showCurvatureLoc = glGetUniformLocation(shaderProgram, "showCurvature");
+	curvatureLimitLoc = glGetUniformLocation(shaderProgram, "curvatureLimit");
+	lineModelLoc = glGetUniformLocation(lineShaderProgram, "model");
+	lineScreenSpaceLoc = glGetUniformLocation(lineShaderProgram, "screenSpace");
+	gridExtentLoc = glGetUniformLocation(gridShaderProgram, "gridExtent");
+	gridShowGridLoc = glGetUniformLocation(gridShaderProgram, "showGrid");
+	gridShowAxesLoc = glGetUniformLocation(gridShaderProgram, "showAxes");
+
+	glUniformBlockBinding(shaderProgram,
+		glGetUniformBlockIndex(shaderProgram, "Frame"), FRAME_UNIFORM_BINDING);
+	glUniformBlockBinding(lineShaderProgram,
+		glGetUniformBlockIndex(lineShaderProgram, "Frame"), FRAME_UNIFORM_BINDING);
+	glUniformBlockBinding(gridShaderProgram,
+		glGetUniformBlockIndex(gridShaderProgram, "Frame"), FRAME_UNIFORM_BINDING);
+
+	// The grid quad is generated from gl_VertexID, the VAO stays empty
+	glGenVertexArrays(1, &gridVAO);
+
+	glGenBuffers(1, &frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frameUBO);
+
+	// Edge style never changes, only the mode does
+	glUseProgram(shaderProgram);
+	glUniform3f(glGetUniformLocation(shaderProgram, "edgeColor"), 0.1f, 0.1f, 0.15f);
+	glUniform1f(glGetUniformLocation(shaderProgram, "edgeWidth"), 1.2f);
+	glUseProgram(0);
 }
 
 GLuint
@@ -236,24 +454,61 @@ STLView::CleanupBuffers()
 		glDeleteBuffers(1, &stlNormalVBO);
 		stlNormalVBO = 0;
 	}
+	if (stlSmoothNormalVBO) {
+		glDeleteBuffers(1, &stlSmoothNormalVBO);
+		stlSmoothNormalVBO = 0;
+	}
+	stlNormalSize = 0;
+	stlObjectFacets.clear();
+	if (stlAnalysisVBO) {
+		glDeleteBuffers(1, &stlAnalysisVBO);
+		stlAnalysisVBO = 0;
+	}
+	if (stlInstanceVBO) {
+		glDeleteBuffers(1, &stlInstanceVBO);
+		stlInstanceVBO = 0;
+	}
+	sceneGeometry.clear();
 	if (boxVAO) {
 		glDeleteVertexArrays(1, &boxVAO);
 		glDeleteBuffers(1, &boxVBO);
 		boxVAO = 0;
 		boxVBO = 0;
 	}
-	if (axesVAO) {
-		glDeleteVertexArrays(1, &axesVAO);
-		glDeleteBuffers(1, &axesVBO);
-		axesVAO = 0;
-		axesVBO = 0;
+	if (overlayVAO) {
+		glDeleteVertexArrays(1, &overlayVAO);
+		glDeleteBuffers(1, &overlayVBO);
+		overlayVAO = 0;
+		overlayVBO = 0;
+	}
+	if (sectionVAO) {
+		glDeleteVertexArrays(1, &sectionVAO);
+		glDeleteBuffers(1, &sectionVBO);
+		sectionVAO = 0;
+		sectionVBO = 0;
+	}
+	sectionChanged = true;
+	if (defectsVAO) {
+		glDeleteVertexArrays(1, &defectsVAO);
+		glDeleteBuffers(1, &defectsVBO);
+		defectsVAO = 0;
+		defectsVBO = 0;
+	}
+	defectsChanged = true;
+	if (hullVAO) {
+		glDeleteVertexArrays(1, &hullVAO);
+		glDeleteBuffers(1, &hullVBO);
+		hullVAO = 0;
+		hullVBO = 0;
 	}
-	if (oxyVAO) {
-		glDeleteVertexArrays(1, &oxyVAO);
-		glDeleteBuffers(1, &oxyVBO);
-		oxyVAO = 0;
-		oxyVBO = 0;
+	hullChanged = true;
+	if (minimumBoxVAO) {
+		glDeleteVertexArrays(1, &minimumBoxVAO);
+		glDeleteBuffers(1, &minimumBoxVBO);
+		minimumBoxVAO = 0;
+		minimumBoxVBO = 0;
 	}
+	minimumBoxChanged = true;
 
 	m_buffersInitialized = false;
 }
@@ -264,30 +519,172 @@ STLView::InitializeBuffers()
 	if (m_buffersInitialized || !stlObject)
 		return;
 
-	// STL
+	measurePickDirty = true;
+
+	// STL: every distinct mesh of the scene is stored once in a shared
+	// vertex buffer. Meshes with congruent parts store one copy of each
+	// part, objects showing the same mesh become instances of it. What is
+	// shown only once is moved into place while uploading and drawn by a
+	// single call, whichever mesh it comes from.
 	glGenVertexArrays(1, &stlVAO);
 	glGenBuffers(1, &stlVertexVBO);
 	glGenBuffers(1, &stlNormalVBO);
+	glGenBuffers(1, &stlInstanceVBO);
 
 	glBindVertexArray(stlVAO);
 
+	bool heatmap = showOverhang || showThickness || showIntersections || showDeviation || showCurvature;
+
+	// A run of facets of one mesh and where the scene shows it
+	struct Piece {
+		stl_file *stl;
+		const int32 *facets;
+		int32 count;
+		const float *analysis;
+		std::vector<glm::mat4> instances;
+		GLsizei firstObjectInstances;
+	};
+	std::vector<Piece> pieces;
+	std::vector<std::vector<float> > analysisData;
+	std::vector<stl_file*> meshes;
+
+	auto addPiece = [&](stl_file *stl, const int32 *facets, int32 count, const float *analysis,
+		const glm::mat4 *partInstances, int32 partCount) {
+		Piece piece = { stl, facets, count, analysis, std::vector<glm::mat4>(), 0 };
+		for (size_t i = 0; i < sceneObjects.size(); i++) {
+			if (sceneObjects[i].stl != stl)
+				continue;
+			if (i == 0)
+				piece.firstObjectInstances = partCount;
+			for (int32 j = 0; j < partCount; j++)
+				piece.instances.push_back(sceneObjects[i].transform * partInstances[j]);
+		}
+		pieces.push_back(piece);
+	};
+
+	// Reserved up front, the pieces point into it
+	analysisData.reserve(sceneObjects.size());
+	for (size_t i = 0; i < sceneObjects.size(); i++) {
+		stl_file *stl = sceneObjects[i].stl;
+		if (std::find(meshes.begin(), meshes.end(), stl) != meshes.end())
+			continue;
+		meshes.push_back(stl);
+		int32 facets = stl->stats.number_of_facets;
+
+		// The heatmap value belongs to the facet's own orientation, rotated
+		// copies cannot share it, so meshes are uploaded whole while it is on
+		const float *analysis = NULL;
+		if (heatmap) {
+			analysisData.push_back(std::vector<float>());
+			std::vector<float> &values = analysisData.back();
+			if (showOverhang || showThickness || showIntersections) {
+				// All three are only found on the edited model
+				bool measured = i == 0 && analysisValues.size() == (size_t)facets;
+				for (int32 f = 0; f < facets; f++)
+					values.insert(values.end(), 3, measured ? analysisValues[f] : -1.0f);
+			} else {
+				bool measured = i == 0 && analysisValues.size() == (size_t)facets * 3;
+				if (measured)
+					values = analysisValues;
+				else
+					values.assign(facets * 3, FLT_MAX);
+			}
+			analysis = values.data();
+		}
+
+		STLParts *parts = sceneObjects[i].parts;
+		if (parts == NULL || parts->Parts().empty() || heatmap) {
+			glm::mat4 identity(1.0f);
+			addPiece(stl, NULL, facets, analysis, &identity, 1);
+			continue;
+		}
+
+		const std::vector<STLParts::Part> &list = parts->Parts();
+		for (size_t p = 0; p < list.size(); p++) {
+			addPiece(stl, list[p].facets.data(), list[p].facets.size(), NULL,
+				list[p].instances.data(), list[p].instances.size());
+		}
+	}
+
 	std::vector<float> vertices;
 	std::vector<float> normals;
-	stlVertexCount = stlObject->stats.number_of_facets * 3;
-	vertices.reserve(stlVertexCount * 3);
-	normals.reserve(stlVertexCount * 3);
+	std::vector<float> analysis;
+	std::vector<glm::mat4> instances;
+
+	auto addFacets = [&](const Piece &piece, const glm::mat4 *bake) {
+		glm::mat3 normalMatrix = bake != NULL
+			? glm::transpose(glm::inverse(glm::mat3(*bake))) : glm::mat3(1.0f);
+		for (int32 i = 0; i < piece.count; i++) {
+			int32 index = piece.facets != NULL ? piece.facets[i] : i;
+			const stl_facet &facet = piece.stl->facet_start[index];
+			if (piece.stl == stlObject)
+				stlObjectFacets.push_back(index);
+
+			glm::vec3 normal(facet.normal.x, facet.normal.y, facet.normal.z);
+			if (bake != NULL) {
+				normal = normalMatrix * normal;
+				float length = glm::length(normal);
+				if (length > 0.0f)
+					normal /= length;
+			}
+			for (int j = 0; j < 3; j++) {
+				glm::vec3 vertex(facet.vertex[j].x, facet.vertex[j].y, facet.vertex[j].z);
+				if (bake != NULL)
+					vertex = glm::vec3(*bake * glm::vec4(vertex, 1.0f));
+				vertices.insert(vertices.end(), { vertex.x, vertex.y, vertex.z });
+				normals.insert(normals.end(), { normal.x, normal.y, normal.z });
+			}
+			if (piece.analysis != NULL)
+				analysis.insert(analysis.end(), piece.analysis + index * 3, piece.analysis + index * 3 + 3);
+		}
+	};
 
-	for (size_t i = 0; i < stlObject->stats.number_of_facets; i++) {
-		for (int j = 0; j < 3; j++) {
-			vertices.push_back(stlObject->facet_start[i].vertex[j].x);
-			vertices.push_back(stlObject->facet_start[i].vertex[j].y);
-			vertices.push_back(stlObject->facet_start[i].vertex[j].z);
+	// The batch holds the pieces shown once, the edited model's last so
+	// its facets stay in one range with its instanced parts that follow
+	SceneGeometry batch = { NULL, 0, 0, 0, 1, 0, 0, 0 };
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t i = 0; i < pieces.size(); i++) {
+			const Piece &piece = pieces[i];
+			if (piece.instances.size() != 1 || (piece.stl == stlObject) != (pass == 1))
+				continue;
+			if (pass == 1 && batch.firstObjectInstances == 0) {
+				batch.firstObjectInstances = 1;
+				batch.firstObjectFirst = vertices.size() / 3;
+				stlObjectFirst = batch.firstObjectFirst;
+			}
+			bool placed = piece.instances[0] != glm::mat4(1.0f);
+			addFacets(piece, placed ? &piece.instances[0] : NULL);
 		}
+	}
+	batch.count = vertices.size() / 3;
+	batch.firstObjectCount = batch.count - batch.firstObjectFirst;
+	if (batch.count > 0) {
+		instances.push_back(glm::mat4(1.0f));
+		sceneGeometry.push_back(batch);
+	}
 
-		for (int j = 0; j < 3; j++) {
-			normals.push_back(stlObject->facet_start[i].normal.x);
-			normals.push_back(stlObject->facet_start[i].normal.y);
-			normals.push_back(stlObject->facet_start[i].normal.z);
+	// Instance transforms are grouped per piece so each one is a single
+	// instanced draw over a contiguous range, the edited model comes first
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t i = 0; i < pieces.size(); i++) {
+			const Piece &piece = pieces[i];
+			if (piece.instances.size() <= 1 || (piece.stl == stlObject) != (pass == 0))
+				continue;
+			if (piece.stl == stlObject && batch.firstObjectInstances == 0 && stlObjectFacets.empty())
+				stlObjectFirst = vertices.size() / 3;
+
+			SceneGeometry geometry;
+			geometry.stl = piece.stl;
+			geometry.first = vertices.size() / 3;
+			geometry.count = piece.count * 3;
+			geometry.baseInstance = instances.size();
+			geometry.instanceCount = piece.instances.size();
+			geometry.firstObjectInstances = piece.firstObjectInstances;
+			geometry.firstObjectFirst = geometry.first;
+			geometry.firstObjectCount = geometry.count;
+			instances.insert(instances.end(), piece.instances.begin(), piece.instances.end());
+			addFacets(piece, NULL);
+			sceneGeometry.push_back(geometry);
 		}
 	}
 
@@ -300,37 +697,74 @@ STLView::InitializeBuffers()
 	glBindBuffer(GL_ARRAY_BUFFER, stlNormalVBO);
 	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float),
 				normals.data(), GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	stlNormalSize = normals.size() * sizeof(float);
+	UploadSmoothNormals();
+	BindNormals();
 	glEnableVertexAttribArray(1);
 
-	glBindVertexArray(0);
+	// Only uploaded for a heatmap, the attribute reads as zero otherwise
+	if (heatmap) {
+		glGenBuffers(1, &stlAnalysisVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, stlAnalysisVBO);
+		glBufferData(GL_ARRAY_BUFFER, analysis.size() * sizeof(float),
+					analysis.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(ANALYSIS_ATTRIB_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+		glEnableVertexAttribArray(ANALYSIS_ATTRIB_LOCATION);
+	}
 
-	// Axes
-	axisVertices = {
-		0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,  // X
-		0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,  // Y
-		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f   // Z
-	};
+	glBindBuffer(GL_ARRAY_BUFFER, stlInstanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::mat4),
+				instances.data(), GL_STATIC_DRAW);
+	for (int i = 0; i < 4; i++) {
+		glEnableVertexAttribArray(INSTANCE_ATTRIB_LOCATION + i);
+		glVertexAttribDivisor(INSTANCE_ATTRIB_LOCATION + i, 1);
+	}
 
-	glGenVertexArrays(1, &axesVAO);
-	glGenBuffers(1, &axesVBO);
-	glBindVertexArray(axesVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, axesVBO);
-	glBufferData(GL_ARRAY_BUFFER, axisVertices.size() * sizeof(float),
-			axisVertices.data(), GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
 	glBindVertexArray(0);
 
 	// Box
 	GenerateBoxBuffers();
 
-	// OXY
-	GenerateOXYGridBuffers();
-
 	m_buffersInitialized = true;
 }
 
+void
+STLView::UploadSmoothNormals(void)
+{
+	if (smoothNormals.size() != (size_t)stlObject->stats.number_of_facets * 3
+		|| stlObjectFacets.empty())
+		return;
+
+	// Starts as a copy of the flat normals made on the GPU, appended
+	// objects keep those, only the edited model's range is replaced
+	if (stlSmoothNormalVBO == 0) {
+		glGenBuffers(1, &stlSmoothNormalVBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, stlSmoothNormalVBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, stlNormalSize, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, stlNormalVBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, stlNormalSize);
+	}
+
+	std::vector<glm::vec3> normals(stlObjectFacets.size() * 3);
+	for (size_t i = 0; i < stlObjectFacets.size(); i++) {
+		for (int j = 0; j < 3; j++)
+			normals[i * 3 + j] = smoothNormals[stlObjectFacets[i] * 3 + j];
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, stlSmoothNormalVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, stlObjectFirst * sizeof(glm::vec3),
+		normals.size() * sizeof(glm::vec3), normals.data());
+}
+
+void
+STLView::BindNormals(void)
+{
+	// Expects the scene VAO to be bound
+	bool smooth = smoothShading && stlSmoothNormalVBO != 0;
+	glBindBuffer(GL_ARRAY_BUFFER, smooth ? stlSmoothNormalVBO : stlNormalVBO);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+}
+
 void
 STLView::GenerateBoxBuffers()
 {
@@ -371,57 +805,15 @@ STLView::GenerateBoxBuffers()
 	glBindVertexArray(0);
 }
 
-void
-STLView::GenerateOXYGridBuffers()
-{
-	oxyVertices.clear();
-
-	float margin = 30.0f;
-	float xMin = round((stlObject->stats.min.x - margin) / 10.0) * 10.0;
-	float xMax = round((stlObject->stats.max.x + margin) / 10.0) * 10.0;
-	float yMin = round((stlObject->stats.min.y - margin) / 10.0) * 10.0;
-	float yMax = round((stlObject->stats.max.y + margin) / 10.0) * 10.0;
-
-	auto addLine = [this](float x1, float y1, float x2, float y2) {
-		if (std::abs(x1) < 0.001f && std::abs(x2) < 0.001f && showAxes && showAxesPlane) {
-			oxyVertices.push_back({x1, y1, 0.0f, 0.0f, 1.0f, 0.0f});
-			oxyVertices.push_back({x2, y2, 0.0f, 0.0f, 1.0f, 0.0f});
-		} else if (std::abs(y1) < 0.001f && std::abs(y2) < 0.001f && showAxes && showAxesPlane) {
-			oxyVertices.push_back({x1, y1, 0.0f, 1.0f, 0.0f, 0.0f});
-			oxyVertices.push_back({x2, y2, 0.0f, 1.0f, 0.0f, 0.0f});
-		} else if (showOXY) {
-			oxyVertices.push_back({x1, y1, 0.0f, 0.0f, 0.0f, 1.0f});
-			oxyVertices.push_back({x2, y2, 0.0f, 0.0f, 0.0f, 1.0f});
-		}
-	};
-
-	for (float x = xMin; x <= xMax; x += 10)
-		addLine(x, yMin, x, yMax);
-
-	for (float y = yMin; y <= yMax; y += 10)
-		addLine(xMin, y, xMax, y);
-
-	glGenVertexArrays(1, &oxyVAO);
-	glGenBuffers(1, &oxyVBO);
-	glBindVertexArray(oxyVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, oxyVBO);
-	glBufferData(GL_ARRAY_BUFFER, oxyVertices.size() * sizeof(ColoredVertex), oxyVertices.data(), GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glBindVertexArray(0);
-}
-
 void
 STLView::MessageReceived(BMessage *message)
 {
 	switch (message->what) {
 		case B_MOUSE_WHEEL_CHANGED:
 		{
-			if (stlWindow->IsLoaded()) {
+			if (stlObject != NULL) {
 				float dy = message->FindFloat("be:wheel_delta_y");
-				scaleFactor += ((dy * (tanf(0.26179939) * (stlWindow->GetZDepth() + scaleFactor)))) * 0.3;
+				scaleFactor += ((dy * (tanf(0.26179939) * (zDepth + scaleFactor)))) * 0.3;
 				needUpdate = true;
 			}
 			break;
@@ -435,33 +827,47 @@ STLView::MessageReceived(BMessage *message)
 void
 STLView::AttachedToWindow(void)
 {
-	stlWindow = (STLWindow*)Window();
-
 	LockGL();
 	BGLView::AttachedToWindow();
 	boundRect = Bounds();
 	InitShaders();
 	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glClearColor(0.12f, 0.12f, 0.2f, 1.0f);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glCullFace(GL_BACK);
+	glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 	SetupProjection();
 	UnlockGL();
 }
 
 void STLView::SetupProjection(void)
 {
+	// Only rebuild when something the projection depends on has changed,
+	// the ortho zoom is the only per-frame input and only in ortho mode
+	float state[PROJECTION_STATE_SIZE] = {
+		boundRect.Width(), boundRect.Height(),
+		zDepth, bigExtent,
+		viewOrtho ? 1.0f : 0.0f, viewOrtho ? scaleFactor : 0.0f
+	};
+	if (std::equal(state, state + PROJECTION_STATE_SIZE, projectionState))
+		return;
+	std::copy(state, state + PROJECTION_STATE_SIZE, projectionState);
+
 	glViewport(0, 0, boundRect.Width(), boundRect.Height());
 
 	float aspectRatio = boundRect.Width() / boundRect.Height();
 	
 	if (viewOrtho) {
-		float w = stlWindow->GetBigExtent() / 2.0f;
-		float tmp = (stlWindow->GetZDepth() + scaleFactor) / stlWindow->GetZDepth();
+		float w = bigExtent / 2.0f;
+		float tmp = (zDepth + scaleFactor) / zDepth;
 		w = w * tmp;
 		projectionMatrix = glm::ortho(-w * aspectRatio, w * aspectRatio, -w, w, 0.1f,
-			(-stlWindow->GetZDepth() + stlWindow->GetBigExtent()) * 2.0f);
+			(-zDepth + bigExtent) * 2.0f);
 	} else {
 		float fov = glm::radians((float)FOV);
 		float nearPlane = 0.1f;
-		float farPlane = stlWindow->GetZDepth() + stlWindow->GetBigExtent();
+		float farPlane = zDepth + bigExtent;
 		projectionMatrix = glm::perspective(fov, aspectRatio, nearPlane, farPlane);
 	}
 }
@@ -473,6 +879,7 @@ STLView::FrameResized(float Width, float Height)
 	BGLView::FrameResized(Width, Height);
 	boundRect = Bounds();
 	SetupProjection();
+	measurePickDirty = true;
 	needUpdate = true;
 	UnlockGL();
 	Render();
@@ -484,6 +891,8 @@ STLView::MouseMoved(BPoint p, uint32 transit, const BMessage *message)
 	uint32 buttons = 0;
 	GetMouse(&p, &buttons, false);
 
+	measurePickDirty = true;
+
 	if (measureMode && !isMeasureSkip) {
 		if (measureStartPointValid && buttons & B_PRIMARY_MOUSE_BUTTON) {
 			measureEndPointValid = lastMousePos3dValid;
@@ -515,8 +924,8 @@ STLView::MouseMoved(BPoint p, uint32 transit, const BMessage *message)
 		needUpdate = true;
 	}
 	if (buttons & B_SECONDARY_MOUSE_BUTTON && lastMouseButtons != 0) {
-		xPan += ((lastMousePos.x - p.x) * (tanf(0.26179939) * (stlWindow->GetZDepth() + scaleFactor))) * 0.0025;
-		yPan -= ((lastMousePos.y - p.y) * (tanf(0.26179939) * (stlWindow->GetZDepth() + scaleFactor))) * 0.0025;
+		xPan += ((lastMousePos.x - p.x) * (tanf(0.26179939) * (zDepth + scaleFactor))) * 0.0025;
+		yPan -= ((lastMousePos.y - p.y) * (tanf(0.26179939) * (zDepth + scaleFactor))) * 0.0025;
 		lastMousePos = p;
 		needUpdate = true;
 	}
@@ -591,17 +1000,61 @@ STLView::Reset(bool scale, bool rotate, bool pan)
 }
 
 void
-STLView::SetSTL(stl_file *stl)
+STLView::SetSTL(stl_file *stl, float depth, float extent, STLParts *parts)
 {
 	LockGL();
 	CleanupBuffers();
+	delete snapIndex;
+	snapIndex = NULL;
 	stlObject = stl;
+	sceneObjects.clear();
+	if (stl != NULL)
+		sceneObjects.push_back({stl, glm::mat4(1.0f), parts});
+	zDepth = depth;
+	bigExtent = extent;
 	SetupProjection();
 	InitializeBuffers();
 	Reset();
 	UnlockGL();
 }
 
+void
+STLView::ReplaceSTL(stl_file *stl, STLParts *parts)
+{
+	// Same geometry in a different object, the GL buffers stay valid
+	// and are regrouped by the next Reload()
+	LockGL();
+	if (stl != stlObject) {
+		delete snapIndex;
+		snapIndex = NULL;
+	}
+	stlObject = stl;
+	if (!sceneObjects.empty()) {
+		sceneObjects[0].stl = stl;
+		sceneObjects[0].parts = parts;
+	}
+	UnlockGL();
+}
+
+void
+STLView::AddObject(stl_file *stl, const glm::mat4 &transform, STLParts *parts)
+{
+	LockGL();
+	sceneObjects.push_back({stl, transform, parts});
+	CleanupBuffers();
+	InitializeBuffers();
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetExtent(float depth, float extent)
+{
+	zDepth = depth;
+	bigExtent = extent;
+	needUpdate = true;
+}
+
 void
 STLView::Reload(void)
 {
@@ -614,294 +1067,858 @@ STLView::Reload(void)
 void
 STLView::DrawBox()
 {
-	glUseProgram(lineShaderProgram);
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-
 	glBindVertexArray(boxVAO);
 	glDrawArrays(GL_LINES, 0, boxVertices.size());
-	glBindVertexArray(0);
-	glUseProgram(0);
 }
 
 void
 STLView::DrawOXY()
 {
-	glUseProgram(lineShaderProgram);
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+	stl_vertex min = stlObject->stats.min;
+	stl_vertex max = stlObject->stats.max;
+	float extent = std::max(std::max(std::abs(min.x), std::abs(max.x)),
+		std::max(std::abs(min.y), std::abs(max.y))) * 1.5f;
+
+	glUniform1f(gridExtentLoc, extent > 0.0f ? extent : 10.0f);
+	glUniform1i(gridShowGridLoc, showOXY);
+	glUniform1i(gridShowAxesLoc, showAxes && showAxesPlane);
+
+	// Transparent grid pixels must not hide the box lines drawn after it
+	glDepthMask(GL_FALSE);
+	glBindVertexArray(gridVAO);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glDepthMask(GL_TRUE);
+}
 
-	glBindVertexArray(oxyVAO);
-	glDrawArrays(GL_LINES, 0, oxyVertices.size());
-	glBindVertexArray(0);
-	glUseProgram(0);
+glm::vec3
+STLView::ProjectToScreen(const glm::vec3 &point)
+{
+	glm::vec4 clip = projectionMatrix * viewMatrix * modelMatrix * glm::vec4(point, 1.0f);
+	return glm::vec3(clip) / clip.w;
 }
 
 void
-STLView::DrawAxis()
+STLView::AddOverlayLine(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color)
 {
-	glUseProgram(0);
-	glPushAttrib(GL_ALL_ATTRIB_BITS);
-	glMatrixMode(GL_PROJECTION);
-	glPushMatrix();
-	glMatrixMode(GL_MODELVIEW);
-	glPushMatrix();
+	overlayLines.push_back({from.x, from.y, from.z, color.r, color.g, color.b});
+	overlayLines.push_back({to.x, to.y, to.z, color.r, color.g, color.b});
+}
+
+void
+STLView::AddOverlayDashedLine(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color)
+{
+	// Same 4 on / 4 off pixel pattern the 0x0F0F line stipple used to give
+	glm::vec2 pixels = glm::vec2(to - from) * 0.5f * glm::vec2(boundRect.Width(), boundRect.Height());
+	float length = glm::length(pixels);
+	int32 dashes = (int32)(length / 8.0f);
+
+	if (dashes < 1) {
+		AddOverlayLine(from, to, color);
+		return;
+	}
+
+	for (int32 i = 0; i <= dashes; i++) {
+		float start = i * 8.0f / length;
+		float end = std::min((i * 8.0f + 4.0f) / length, 1.0f);
+		if (start >= 1.0f)
+			break;
+		AddOverlayLine(glm::mix(from, to, start), glm::mix(from, to, end), color);
+	}
+}
 
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
+void
+STLView::AddOverlayPoint(const glm::vec3 &point, const glm::vec3 &color)
+{
+	overlayPoints.push_back({point.x, point.y, point.z, color.r, color.g, color.b});
+}
+
+void
+STLView::AddOverlayGlyph(char glyph, const glm::vec3 &origin, float height, const glm::vec3 &color)
+{
+	// Stroke glyphs in a unit box with the origin at the bottom center,
+	// only the axis letters are ever drawn
+	static const float strokesX[] = { -0.35f, 0.0f, 0.35f, 1.0f, -0.35f, 1.0f, 0.35f, 0.0f };
+	static const float strokesY[] = { -0.35f, 1.0f, 0.0f, 0.5f, 0.35f, 1.0f, 0.0f, 0.5f, 0.0f, 0.5f, 0.0f, 0.0f };
+	static const float strokesZ[] = { -0.35f, 1.0f, 0.35f, 1.0f, 0.35f, 1.0f, -0.35f, 0.0f, -0.35f, 0.0f, 0.35f, 0.0f };
+
+	const float *strokes = NULL;
+	int32 count = 0;
+	switch (glyph) {
+		case 'X':
+			strokes = strokesX;
+			count = sizeof(strokesX) / sizeof(float) / 4;
+			break;
+		case 'Y':
+			strokes = strokesY;
+			count = sizeof(strokesY) / sizeof(float) / 4;
+			break;
+		case 'Z':
+			strokes = strokesZ;
+			count = sizeof(strokesZ) / sizeof(float) / 4;
+			break;
+		default:
+			return;
+	}
+
+	float aspect = boundRect.Width() / boundRect.Height();
+	glm::vec3 scale(height / aspect, height, 0.0f);
+	for (int32 i = 0; i < count; i++) {
+		const float *stroke = strokes + i * 4;
+		AddOverlayLine(origin + glm::vec3(stroke[0], stroke[1], 0.0f) * scale,
+			origin + glm::vec3(stroke[2], stroke[3], 0.0f) * scale, color);
+	}
+}
 
+void
+STLView::BuildAxisOverlay(void)
+{
+	// The compass lives in the bottom right corner of an orthographic
+	// -aspect..aspect x -1..1 space, which maps to NDC by dividing x by aspect
 	float aspect = boundRect.Width() / boundRect.Height();
-	float fx = aspect * 0.8f;;
-	float fy = -0.8f;
-	glOrtho(-aspect, aspect, -1, 1, 0.01, 1000);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
+	glm::vec3 center(0.8f, -0.8f, 0.0f);
 
-	glTranslatef(fx, fy, -1);
-	glScalef(0.1f, 0.1f, 0.1f);
-	glRotatef(xRotate, 1.0f, 0.0f, 0.0f);
-	glRotatef(yRotate, 0.0f, 0.0f, 1.0f);
+	glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(xRotate), glm::vec3(1.0f, 0.0f, 0.0f));
+	rotation = glm::rotate(rotation, glm::radians(yRotate), glm::vec3(0.0f, 0.0f, 1.0f));
 
-	glDisable(GL_DEPTH_TEST);
+	auto toScreen = [&](const glm::vec3 &axis) {
+		glm::vec3 direction = glm::vec3(rotation * glm::vec4(axis * 0.1f, 0.0f));
+		return center + glm::vec3(direction.x / aspect, direction.y, 0.0f);
+	};
 
-	glBindVertexArray(axesVAO);
-	glColor3f(1.0f, 0.0f, 0.0f);
-	glDrawArrays(GL_LINES, 0, 2);
-	glColor3f(0.0f, 1.0f, 0.0f);
-	glDrawArrays(GL_LINES, 2, 2);
-	glColor3f(0.0f, 0.0f, 1.0f);
-	glDrawArrays(GL_LINES, 4, 2);
-	glBindVertexArray(0);
+	const glm::vec3 red(1.0f, 0.0f, 0.0f);
+	const glm::vec3 green(0.0f, 1.0f, 0.0f);
+	const glm::vec3 blue(0.0f, 0.0f, 1.0f);
+
+	AddOverlayLine(center, toScreen(glm::vec3(1.0f, 0.0f, 0.0f)), red);
+	AddOverlayLine(center, toScreen(glm::vec3(0.0f, 1.0f, 0.0f)), green);
+	AddOverlayLine(center, toScreen(glm::vec3(0.0f, 0.0f, 1.0f)), blue);
 
 	double alpha = std::abs(cos(xRotate * M_PI / 180.0));
 	double beta = std::abs(cos(yRotate * M_PI / 180.0));
 	double eps = 0.035;
+	float labelHeight = 0.03f;
 
 	if (beta > eps * 2.0f|| alpha > eps * 2.0f)
-		DrawAxisLabel(1.2f, 0.0f, 0.0f, "X", 1.0f, 0.0f, 0.0f);
+		AddOverlayGlyph('X', toScreen(glm::vec3(1.2f, 0.0f, 0.0f)), labelHeight, red);
 
 	if (std::abs(1.0 - beta) > eps || alpha > eps)
-		DrawAxisLabel(0.0f, 1.2f, 0.0f, "Y", 0.0f, 1.0f, 0.0f);
+		AddOverlayGlyph('Y', toScreen(glm::vec3(0.0f, 1.2f, 0.0f)), labelHeight, green);
 
 	if (std::abs(1.0 - alpha) > eps)
-		DrawAxisLabel(0.0f, 0.0f, 1.2f, "Z", 0.0f, 0.0f, 1.0f);
+		AddOverlayGlyph('Z', toScreen(glm::vec3(0.0f, 0.0f, 1.2f)), labelHeight, blue);
+}
+
+void
+STLView::BuildMeasureOverlay(void)
+{
+	glm::vec3 start = ProjectToScreen(measureStartPoint);
+	glm::vec3 end = ProjectToScreen(measureEndPoint);
+
+	if (measureStartPointValid && measureEndPointValid)
+		AddOverlayDashedLine(start, end, glm::vec3(1.0f, 1.0f, 0.0f));
+
+	if (measureStartPointValid)
+		AddOverlayPoint(start, glm::vec3(0.0f, 1.0f, 0.0f));
+
+	if (measureEndPointValid)
+		AddOverlayPoint(end, glm::vec3(1.0f, 0.0f, 0.0f));
 
-	glMatrixMode(GL_PROJECTION);
-	glPopMatrix();
-	glMatrixMode(GL_MODELVIEW);
-	glPopMatrix();
-	glPopAttrib();
+	if (lastMousePos3dValid && (lastMouseButtons == 0) && !isMeasureSkip) {
+		glm::vec3 color(1.0f, 1.0f, 0.0f);
+		switch (lastMouseSnap) {
+			case SNAP_VERTEX:
+				color = glm::vec3(0.0f, 1.0f, 1.0f);
+				break;
+			case SNAP_MIDPOINT:
+				color = glm::vec3(1.0f, 0.0f, 1.0f);
+				break;
+			case SNAP_EDGE:
+				color = glm::vec3(1.0f, 0.5f, 0.0f);
+				break;
+			default:
+				break;
+		}
+
+		glm::vec3 hover = ProjectToScreen(lastMousePos3d);
+		AddOverlayPoint(hover, color);
+
+		// Snapped points get a small frame around them
+		if (lastMouseSnap != SNAP_NONE) {
+			float dx = 12.0f / boundRect.Width();
+			float dy = 12.0f / boundRect.Height();
+			glm::vec3 corners[4] = {
+				hover + glm::vec3(-dx, -dy, 0.0f), hover + glm::vec3(dx, -dy, 0.0f),
+				hover + glm::vec3(dx, dy, 0.0f), hover + glm::vec3(-dx, dy, 0.0f)
+			};
+			for (int32 i = 0; i < 4; i++)
+				AddOverlayLine(corners[i], corners[(i + 1) % 4], color);
+		}
+	}
 }
 
 void
-STLView::DrawMeasure(void)
+STLView::DrawOverlay(void)
 {
-	glUseProgram(0);
-	glPushAttrib(GL_ALL_ATTRIB_BITS);
-	glMatrixMode(GL_PROJECTION);
-	glPushMatrix();
-	glLoadMatrixf(glm::value_ptr(projectionMatrix));
-	glMatrixMode(GL_MODELVIEW);
-	glPushMatrix();
-	glLoadMatrixf(glm::value_ptr(viewMatrix * modelMatrix));
+	overlayLines.clear();
+	overlayPoints.clear();
 
-	glm::vec3 pickedPoint;
-	lastMousePos3dValid = ScreenToPoint3d(lastMousePos, pickedPoint);
-	if (lastMousePos3dValid)
-		lastMousePos3d = pickedPoint;
+	if (measureMode)
+		BuildMeasureOverlay();
 
-	glDisable(GL_DEPTH_TEST);
+	if (showAxes && showAxesCompass)
+		BuildAxisOverlay();
 
-	if (measureStartPointValid && measureEndPointValid) {
-		glEnable(GL_LINE_STIPPLE);
-		glLineStipple(1, 0x0F0F);
-		glColor3f(1.0f, 1.0f, 0.0f);
-		glLineWidth(1.5f);
-		glBegin(GL_LINES);
-		glVertex3fv(glm::value_ptr(measureStartPoint));
-		glVertex3fv(glm::value_ptr(measureEndPoint));
-		glEnd();
-		glDisable(GL_LINE_STIPPLE);
-	}
-	if (measureStartPointValid) {
-		glColor3f(0.0f, 1.0f, 0.0f);
-		glPointSize(6.0f);
-		glBegin(GL_POINTS);
-		glVertex3fv(glm::value_ptr(measureStartPoint));
-		glEnd();
+	size_t lineCount = overlayLines.size();
+	size_t pointCount = overlayPoints.size();
+	if (lineCount + pointCount == 0)
+		return;
+
+	overlayLines.insert(overlayLines.end(), overlayPoints.begin(), overlayPoints.end());
+
+	if (overlayVAO == 0) {
+		glGenVertexArrays(1, &overlayVAO);
+		glGenBuffers(1, &overlayVBO);
+		glBindVertexArray(overlayVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, overlayVBO);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+	} else {
+		glBindVertexArray(overlayVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, overlayVBO);
 	}
-	if (measureEndPointValid) {
-		glColor3f(1.0f, 0.0f, 0.0f);
+
+	glBufferData(GL_ARRAY_BUFFER, overlayLines.size() * sizeof(ColoredVertex),
+		overlayLines.data(), GL_STREAM_DRAW);
+
+	// Overlay vertices are already in normalized device coordinates and
+	// it is drawn last, so depth testing is left off until the next frame
+	glUniform1i(lineScreenSpaceLoc, GL_TRUE);
+	glDisable(GL_DEPTH_TEST);
+	glLineWidth(1.5f);
+	glDrawArrays(GL_LINES, 0, lineCount);
+	glLineWidth(1.0f);
+	if (pointCount > 0) {
 		glPointSize(6.0f);
-		glBegin(GL_POINTS);
-		glVertex3fv(glm::value_ptr(measureEndPoint));
-		glEnd();
+		glDrawArrays(GL_POINTS, lineCount, pointCount);
 	}
-	if (lastMousePos3dValid && (lastMouseButtons == 0) && !isMeasureSkip) {
-		glColor3f(1.0f, 1.0f, 0.0f);
-		glPointSize(6.0f);
-		glBegin(GL_POINTS);
-		glVertex3fv(glm::value_ptr(lastMousePos3d));
-		glEnd();
+	glUniform1i(lineScreenSpaceLoc, GL_FALSE);
+}
+
+void
+STLView::DrawSection(bool cap)
+{
+	if (sectionChanged) {
+		// The cap is one quad on the plane over the whole scene, the
+		// stencil cuts it down to the inside of the solids
+		glm::vec3 low(FLT_MAX);
+		glm::vec3 high(-FLT_MAX);
+		for (size_t i = 0; i < sceneObjects.size(); i++) {
+			const stl_stats &stats = sceneObjects[i].stl->stats;
+			for (int32 corner = 0; corner < 8; corner++) {
+				glm::vec4 point(corner & 1 ? stats.max.x : stats.min.x,
+					corner & 2 ? stats.max.y : stats.min.y,
+					corner & 4 ? stats.max.z : stats.min.z, 1.0f);
+				point = sceneObjects[i].transform * point;
+				low = glm::min(low, glm::vec3(point));
+				high = glm::max(high, glm::vec3(point));
+			}
+		}
+		glm::vec3 margin = (high - low) * 0.05f + glm::vec3(0.1f);
+		low -= margin;
+		high += margin;
+
+		std::vector<ColoredVertex> vertices;
+		vertices.push_back({low.x, low.y, sectionHeight, 0.8f, 0.3f, 0.25f});
+		vertices.push_back({high.x, low.y, sectionHeight, 0.8f, 0.3f, 0.25f});
+		vertices.push_back({low.x, high.y, sectionHeight, 0.8f, 0.3f, 0.25f});
+		vertices.push_back({high.x, high.y, sectionHeight, 0.8f, 0.3f, 0.25f});
+		vertices.insert(vertices.end(), sectionLines.begin(), sectionLines.end());
+
+		if (sectionVAO == 0) {
+			glGenVertexArrays(1, &sectionVAO);
+			glGenBuffers(1, &sectionVBO);
+			glBindVertexArray(sectionVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, sectionVBO);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)0);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)(3 * sizeof(float)));
+			glEnableVertexAttribArray(1);
+		} else {
+			glBindVertexArray(sectionVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, sectionVBO);
+		}
+
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(ColoredVertex),
+			vertices.data(), GL_DYNAMIC_DRAW);
+		sectionChanged = false;
 	}
 
-	glEnable(GL_DEPTH_TEST);
+	glBindVertexArray(sectionVAO);
+
+	if (cap) {
+		// Pushed back a little so the contours on the same plane stay on top
+		glStencilFunc(GL_NOTEQUAL, 0, 1);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(1.0f, 1.0f);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glDisable(GL_STENCIL_TEST);
+	}
 
-	glMatrixMode(GL_PROJECTION);
-	glPopMatrix();
-	glMatrixMode(GL_MODELVIEW);
-	glPopMatrix();
-	glPopAttrib();
+	if (!sectionLines.empty()) {
+		glLineWidth(2.0f);
+		glDrawArrays(GL_LINES, 4, sectionLines.size());
+		glLineWidth(1.0f);
+	}
 }
 
 void
-STLView::DrawAxisLabel(float x, float y, float z, const char* label, float r, float g, float b)
+STLView::UploadLines(GLuint &vao, GLuint &vbo, const std::vector<ColoredVertex> &lines)
 {
-	   glPushMatrix();
-	   glTranslatef(x, y, z);
-	   Billboard();
-	   glColor3f(r, g, b);
-	   float scaleText = 0.00025f;
-	   float textWidth = 0.0f;
-	   for (const char* c = label; *c != '\0'; c++) {
-			textWidth += glutStrokeWidth(GLUT_STROKE_ROMAN, *c);
-	   }
-	   textWidth *= scaleText;
-	   glTranslatef(-textWidth / 2.0f, 0.0f, 0.0f);
-	   glScalef(scaleText, scaleText, scaleText);
-	   for (const char* c = label; *c != '\0'; c++) {
-			glutStrokeCharacter(GLUT_STROKE_ROMAN, *c);
-	   }
-	   glPopMatrix();
+	if (vao == 0) {
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+	} else {
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	}
+
+	glBufferData(GL_ARRAY_BUFFER, lines.size() * sizeof(ColoredVertex),
+		lines.data(), GL_DYNAMIC_DRAW);
 }
 
 void
-STLView::Billboard()
+STLView::DrawDefects(void)
 {
-	float modelview[16];
-	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
-
-	for(int i = 0; i < 3; i++) {
-		for(int j = 0; j < 3; j++) {
-			modelview[i*4+j] = (i == j) ? 1.0f : 0.0f;
-		}
+	if (defectsChanged) {
+		UploadLines(defectsVAO, defectsVBO, defectLines);
+		defectsChanged = false;
 	}
 
-	glLoadMatrixf(modelview);
+	// Drawn through the model, a hole on the far side is still found
+	glBindVertexArray(defectsVAO);
+	glDisable(GL_DEPTH_TEST);
+	glLineWidth(2.0f);
+	glDrawArrays(GL_LINES, 0, defectLines.size());
+	glLineWidth(1.0f);
+	glEnable(GL_DEPTH_TEST);
 }
 
 void
-STLView::DrawSTL(rgb_color color, float alpha)
+STLView::DrawHull(void)
 {
-	if (!m_buffersInitialized)
-		return;
-
-	glUseProgram(shaderProgram);
+	if (hullChanged) {
+		UploadLines(hullVAO, hullVBO, hullLines);
+		hullChanged = false;
+	}
 
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-	glUniform4f(colorLoc, color.red / 255.0f, color.green / 255.0f, color.blue / 255.0f, alpha);
-	glm::vec3 viewPos(0.0f, 0.0f, stlWindow->GetZDepth() + scaleFactor);
-	glUniform3fv(viewPosLoc, 1, glm::value_ptr(viewPos));
+	// Depth tested, the hull edges in front of the model stay readable
+	// against the ones behind it
+	glBindVertexArray(hullVAO);
+	glDrawArrays(GL_LINES, 0, hullLines.size());
+}
 
-	glBindVertexArray(stlVAO);
+void
+STLView::DrawMinimumBox(void)
+{
+	if (minimumBoxChanged) {
+		UploadLines(minimumBoxVAO, minimumBoxVBO, minimumBoxLines);
+		minimumBoxChanged = false;
+	}
 
-    if (viewMode == MSG_VIEWMODE_POINTS && !measureMode)
-        glDrawArrays(GL_POINTS, 0, stlVertexCount);
-    else
-        glDrawArrays(GL_TRIANGLES, 0, stlVertexCount);
+	glBindVertexArray(minimumBoxVAO);
+	glLineWidth(2.0f);
+	glDrawArrays(GL_LINES, 0, minimumBoxLines.size());
+	glLineWidth(1.0f);
+}
 
-	glBindVertexArray(0);
+void
+STLView::UpdateMeasurePoint(void)
+{
+	// Reading the depth back stalls the pipeline, the point under the
+	// cursor is only picked again once the cursor, the view or the
+	// geometry changed
+	glm::mat4 matrix = projectionMatrix * viewMatrix * modelMatrix;
+	if (!measurePickDirty && matrix == measurePickMatrix)
+		return;
+	measurePickDirty = false;
+	measurePickMatrix = matrix;
 
-	glUseProgram(0);
+	glm::vec3 pickedPoint;
+	lastMousePos3dValid = ScreenToPoint3d(lastMousePos, pickedPoint);
+	lastMouseSnap = SNAP_NONE;
+	if (lastMousePos3dValid) {
+		lastMousePos3d = pickedPoint;
+		if (!(modifiers() & B_SHIFT_KEY))
+			SnapPoint(lastMousePos3d);
+	}
 }
 
 void
-STLView::Render(void)
+STLView::DrawSTL(rgb_color color, float alpha, bool firstObjectOnly)
 {
-	if (!needUpdate)
+	if (!m_buffersInitialized)
 		return;
 
-	if (stlWindow->IsLoaded()) {
-		LockGL();
-		SetupProjection();
-		needUpdate = false;
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+	glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+	glUniform4f(colorLoc, color.red / 255.0f, color.green / 255.0f, color.blue / 255.0f, alpha);
 
-		glEnable(GL_DEPTH_TEST);
+	int32 edgeMode = EDGE_MODE_NONE;
+	if (!measureMode && !legacyWireframe) {
+		if (viewMode == MSG_VIEWMODE_SOLID_EDGES)
+			edgeMode = EDGE_MODE_SHADED;
+		else if (viewMode == MSG_VIEWMODE_WIREFRAME)
+			edgeMode = EDGE_MODE_WIRE;
+	}
+	glUniform1i(edgeModeLoc, edgeMode);
+	glUniform1i(showOverhangLoc, showOverhang && !measureMode);
+	glUniform1f(overhangLimitLoc, STLOverhang::Limit(overhangAngle));
+	glUniform1i(showThicknessLoc, showThickness && !measureMode);
+	glUniform1f(thicknessLimitLoc, thicknessLimit);
+	glUniform1i(showIntersectionsLoc, showIntersections && !measureMode);
+	glUniform1i(showDeviationLoc, showDeviation && !measureMode);
+	glUniform1f(deviationLimitLoc, deviationLimit);
+	glUniform1i(showCurvatureLoc, showCurvature && !measureMode);
+	glUniform1f(curvatureLimitLoc, curvatureLimit);
 
-		if (viewMode == MSG_VIEWMODE_SOLID && !measureMode) {
-			glEnable(GL_CULL_FACE);
-			glCullFace(GL_BACK);
-		} else {
-			glDisable(GL_CULL_FACE);
+	glBindVertexArray(stlVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, stlInstanceVBO);
+
+	GLenum mode = (viewMode == MSG_VIEWMODE_POINTS && !measureMode) ? GL_POINTS : GL_TRIANGLES;
+
+	// One draw for everything shown once, one instanced draw per part with
+	// copies. The instance attribute is pointed at the range of each since
+	// GL 3.3 has no base instance.
+	for (size_t i = 0; i < sceneGeometry.size(); i++) {
+		const SceneGeometry &geometry = sceneGeometry[i];
+		GLsizei count = firstObjectOnly ? geometry.firstObjectInstances : geometry.instanceCount;
+		if (count == 0)
+			continue;
+		for (int j = 0; j < 4; j++) {
+			glVertexAttribPointer(INSTANCE_ATTRIB_LOCATION + j, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+				(void*)((geometry.baseInstance * 4 + j) * sizeof(glm::vec4)));
 		}
+		if (firstObjectOnly)
+			glDrawArraysInstanced(mode, geometry.firstObjectFirst, geometry.firstObjectCount, count);
+		else
+			glDrawArraysInstanced(mode, geometry.first, geometry.count, count);
+	}
+}
 
-		glClearColor(0.12f, 0.12f, 0.2f, 1.0f);
-		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+void
+STLView::UpdateFrameUniforms(void)
+{
+	FrameUniforms frame;
+	frame.view = viewMatrix;
+	frame.projection = tileMatrix * projectionMatrix;
+	frame.viewPos = glm::vec4(0.0f, 0.0f, zDepth + scaleFactor, 1.0f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
 
-		viewMatrix = glm::mat4(1.0f);
-		if (viewOrtho)
-			viewMatrix = glm::translate(viewMatrix, glm::vec3(xPan, yPan, stlWindow->GetZDepth()));
-		else
-			viewMatrix = glm::translate(viewMatrix, glm::vec3(xPan, yPan, stlWindow->GetZDepth() + scaleFactor));
+void
+STLView::Render(void)
+{
+	if (!needUpdate)
+		return;
+
+	if (stlObject != NULL && m_buffersInitialized) {
+		LockGL();
+		needUpdate = false;
+		RenderScene();
+		SwapBuffers();
+		UnlockGL();
+	}
+}
 
-		viewMatrix = glm::rotate(viewMatrix, glm::radians(xRotate), glm::vec3(1.0f, 0.0f, 0.0f));
-		viewMatrix = glm::rotate(viewMatrix, glm::radians(yRotate), glm::vec3(0.0f, 0.0f, 1.0f));
+void
+STLView::RenderScene(void)
+{
+	SetupProjection();
 
-		modelMatrix = glm::mat4(1.0f);
+	viewMatrix = glm::mat4(1.0f);
+	if (viewOrtho)
+		viewMatrix = glm::translate(viewMatrix, glm::vec3(xPan, yPan, zDepth));
+	else
+		viewMatrix = glm::translate(viewMatrix, glm::vec3(xPan, yPan, zDepth + scaleFactor));
 
-		if (viewMode == MSG_VIEWMODE_SOLID || measureMode) {
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		} else if (viewMode == MSG_VIEWMODE_WIREFRAME && !measureMode) {
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		} else if (viewMode == MSG_VIEWMODE_POINTS && !measureMode) {
-			glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
-			glPointSize(2.0f);
-		}
+	viewMatrix = glm::rotate(viewMatrix, glm::radians(xRotate), glm::vec3(1.0f, 0.0f, 0.0f));
+	viewMatrix = glm::rotate(viewMatrix, glm::radians(yRotate), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	modelMatrix = glm::mat4(1.0f);
+
+	UpdateFrameUniforms();
+
+	glEnable(GL_DEPTH_TEST);
+	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+	// Mesh pass: one program, polygon mode and culling set once
+
+	// Wireframe is drawn as filled triangles by the edge shader, the
+	// GL_LINE polygon mode is only kept around for the benchmark
+	GLenum polygonMode = GL_FILL;
+	if (viewMode == MSG_VIEWMODE_WIREFRAME && legacyWireframe && !measureMode) {
+		polygonMode = GL_LINE;
+	} else if (viewMode == MSG_VIEWMODE_POINTS && !measureMode) {
+		polygonMode = GL_POINT;
+		glPointSize(2.0f);
+	}
+	if (polygonMode != GL_FILL)
+		glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
+
+	bool cullFace = (viewMode == MSG_VIEWMODE_SOLID || viewMode == MSG_VIEWMODE_SOLID_EDGES)
+		&& !measureMode;
+	if (cullFace)
+		glEnable(GL_CULL_FACE);
+
+	glUseProgram(shaderProgram);
+
+	// Section view clips everything above the plane, the cut is capped
+	// through the stencil buffer once the mesh pass is done
+	if (sectionEnabled) {
+		glUniform4f(clipPlaneLoc, 0.0f, 0.0f, -1.0f, sectionHeight);
+		glEnable(GL_CLIP_DISTANCE0);
+	}
+
+	if (fShowPreview) {
+		DrawSTL();
+		glm::mat4 matrix = modelMatrix;
+		glm::mat4 previewMatrix = glm::make_mat4(fPreviewMatrix);
+		modelMatrix = previewMatrix * modelMatrix;
+		DrawSTL({128, 101, 0}, 0.3, true);
+		modelMatrix = matrix;
+	} else {
+		if (measureMode)
+			DrawSTL({128, 128, 128}, 0.3);
+		else
+			DrawSTL();
+	}
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if (polygonMode != GL_FILL)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	if (cullFace)
+		glDisable(GL_CULL_FACE);
 
-		if (fShowPreview) {
+	if (sectionEnabled) {
+		// Every surface left below the plane flips the stencil bit, so it
+		// stays set where the view looks into the solid through the cut.
+		// Wireframe and points discard fragments and get no cap.
+		bool cap = (viewMode == MSG_VIEWMODE_SOLID || viewMode == MSG_VIEWMODE_SOLID_EDGES)
+			&& !measureMode;
+		if (cap) {
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			glDepthMask(GL_FALSE);
+			glDisable(GL_DEPTH_TEST);
+			glEnable(GL_STENCIL_TEST);
+			glClear(GL_STENCIL_BUFFER_BIT);
+			glStencilFunc(GL_ALWAYS, 0, 1);
+			glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
 			DrawSTL();
-			glm::mat4 matrix = modelMatrix;
-			glm::mat4 previewMatrix = glm::make_mat4(fPreviewMatrix);
-			modelMatrix = previewMatrix * modelMatrix;
-			DrawSTL({128, 101, 0}, 0.3);
-			modelMatrix = matrix;
-		} else {
-			if (measureMode)
-				DrawSTL({128, 128, 128}, 0.3);
-			else
-				DrawSTL();
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthMask(GL_TRUE);
+			glEnable(GL_DEPTH_TEST);
 		}
+		glDisable(GL_CLIP_DISTANCE0);
 
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glEnable(GL_POINT_SMOOTH);
-		glEnable(GL_LINE_SMOOTH);
-		glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+		glUseProgram(lineShaderProgram);
+		glUniformMatrix4fv(lineModelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+		DrawSection(cap);
+	}
 
-		if (measureMode)
-			DrawMeasure();
+	if (measureMode && !tiledRender)
+		UpdateMeasurePoint();
 
+	// Procedural ground grid, skipped when neither grid nor axes are shown
+
+	if (showOXY || (showAxes && showAxesPlane)) {
+		glUseProgram(gridShaderProgram);
 		DrawOXY();
+	}
 
-		if (showBox)
-			DrawBox();
+	// Line pass: box and the screen-space overlay share one program
 
-		if (showAxes && showAxesCompass)
-			DrawAxis();
+	glEnable(GL_POINT_SMOOTH);
+	glEnable(GL_LINE_SMOOTH);
 
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_LINE_SMOOTH);
-		glDisable(GL_POINT_SMOOTH);
-		glDisable(GL_BLEND);
+	glUseProgram(lineShaderProgram);
+	glUniformMatrix4fv(lineModelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
 
-		SwapBuffers();
+	if (showBox)
+		DrawBox();
+
+	if (showHull && !hullLines.empty())
+		DrawHull();
+
+	if (showMinimumBox && !minimumBoxLines.empty())
+		DrawMinimumBox();
+
+	if (showDefects && !defectLines.empty())
+		DrawDefects();
+
+	// Compass and measure marks live in window pixels and are left
+	// out of tiled renders
+	if (!tiledRender)
+		DrawOverlay();
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+
+	glDisable(GL_LINE_SMOOTH);
+	glDisable(GL_POINT_SMOOTH);
+}
+
+status_t
+STLView::RenderOffscreen(BBitmap *bitmap)
+{
+	if (bitmap == NULL || bitmap->ColorSpace() != B_RGBA32)
+		return B_BAD_VALUE;
+
+	int32 width = bitmap->Bounds().IntegerWidth() + 1;
+	int32 height = bitmap->Bounds().IntegerHeight() + 1;
+
+	LockGL();
+	if (stlObject == NULL || !m_buffersInitialized) {
+		UnlockGL();
+		return B_NO_INIT;
+	}
+
+	status_t status = PrepareOffscreen(width, height);
+	if (status != B_OK) {
+		UnlockGL();
+		return status;
+	}
+
+	// Render at the bitmap size, the window projection is restored by the
+	// next on-screen frame since the projection cache sees the size change
+	BRect savedRect = boundRect;
+	boundRect = BRect(0, 0, width, height);
+	RenderScene();
+	boundRect = savedRect;
+
+	// GL rows start at the bottom, bitmap rows at the top
+	uint8 *bits = (uint8*)bitmap->Bits();
+	int32 bytesPerRow = bitmap->BytesPerRow();
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glPixelStorei(GL_PACK_ROW_LENGTH, bytesPerRow / 4);
+	for (int32 y = 0; y < height; y++)
+		glReadPixels(0, height - 1 - y, width, 1, GL_BGRA, GL_UNSIGNED_BYTE, bits + y * bytesPerRow);
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	needUpdate = true;
+	UnlockGL();
+
+	return B_OK;
+}
+
+status_t
+STLView::RenderTiled(const char *path, int32 width, int32 height)
+{
+	if (width <= 0 || height <= 0)
+		return B_BAD_VALUE;
+
+	STLPNGWriter writer;
+	status_t status = writer.Open(path, width, height);
+	if (status != B_OK)
+		return status;
+
+	LockGL();
+	if (stlObject == NULL || !m_buffersInitialized) {
+		UnlockGL();
+		return B_NO_INIT;
+	}
+
+	GLint maxSize = SCREENSHOT_TILE_SIZE;
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+	int32 tileSize = std::min((int32)SCREENSHOT_TILE_SIZE, (int32)maxSize);
+	int32 tileWidth = std::min(tileSize, width);
+	int32 tileHeight = std::min(tileSize, height);
+
+	status = PrepareOffscreen(tileWidth, tileHeight);
+	if (status != B_OK) {
 		UnlockGL();
+		return status;
+	}
+
+	// Two pack buffers in flight: while one tile is being read back by the
+	// driver the next one is already rendering, only a single band of
+	// tiles is ever kept on the CPU side before it goes to the encoder
+	GLuint pbo[2];
+	glGenBuffers(2, pbo);
+	for (int32 i = 0; i < 2; i++) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, tileWidth * tileHeight * 4, NULL, GL_STREAM_READ);
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	int32 bandBytesPerRow = width * 4;
+	std::vector<uint8> band(bandBytesPerRow * tileHeight);
+
+	int32 columns = (width + tileWidth - 1) / tileWidth;
+	int32 rows = (height + tileHeight - 1) / tileHeight;
+	int32 count = columns * rows;
+
+	// The projection is built for the whole image, each tile then gets
+	// its part of clip space scaled up to fill the viewport
+	BRect savedRect = boundRect;
+	boundRect = BRect(0, 0, width, height);
+	SetupProjection();
+	tiledRender = true;
+
+	for (int32 i = 0; i <= count && status == B_OK; i++) {
+		if (i < count) {
+			int32 x = (i % columns) * tileWidth;
+			int32 top = (i / columns) * tileHeight;
+			int32 w = std::min(tileWidth, width - x);
+			int32 h = std::min(tileHeight, height - top);
+			int32 y = height - top - h;
+
+			float sx = (float)width / w;
+			float sy = (float)height / h;
+			float cx = (2.0f * x + w) / width - 1.0f;
+			float cy = (2.0f * y + h) / height - 1.0f;
+			tileMatrix = glm::mat4(1.0f);
+			tileMatrix[0][0] = sx;
+			tileMatrix[1][1] = sy;
+			tileMatrix[3][0] = -sx * cx;
+			tileMatrix[3][1] = -sy * cy;
+
+			glViewport(0, 0, w, h);
+			RenderScene();
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i % 2]);
+			glReadPixels(0, 0, w, h, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+		}
+
+		if (i == 0)
+			continue;
+
+		int32 previous = i - 1;
+		int32 x = (previous % columns) * tileWidth;
+		int32 top = (previous / columns) * tileHeight;
+		int32 w = std::min(tileWidth, width - x);
+		int32 h = std::min(tileHeight, height - top);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[previous % 2]);
+		const uint8 *pixels = (const uint8*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+		if (pixels == NULL) {
+			status = B_ERROR;
+			break;
+		}
+
+		// GL rows start at the bottom, image rows at the top
+		for (int32 row = 0; row < h; row++)
+			memcpy(&band[(h - 1 - row) * bandBytesPerRow + x * 4], pixels + row * w * 4, w * 4);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		if (previous % columns == columns - 1)
+			status = writer.WriteRows(band.data(), h, bandBytesPerRow);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glDeleteBuffers(2, pbo);
+
+	tiledRender = false;
+	tileMatrix = glm::mat4(1.0f);
+	boundRect = savedRect;
+	projectionState[0] = -1.0f;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	needUpdate = true;
+	UnlockGL();
+
+	if (status == B_OK)
+		status = writer.Close();
+
+	return status;
+}
+
+status_t
+STLView::PrepareOffscreen(int32 width, int32 height)
+{
+	if (offscreenFBO != 0 && width == offscreenWidth && height == offscreenHeight) {
+		glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+		return B_OK;
+	}
+
+	CleanupOffscreen();
+
+	glGenFramebuffers(1, &offscreenFBO);
+	glGenRenderbuffers(1, &offscreenColorRBO);
+	glGenRenderbuffers(1, &offscreenDepthRBO);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreenColorRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColorRBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepthRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreenDepthRBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		CleanupOffscreen();
+		return B_ERROR;
+	}
+
+	offscreenWidth = width;
+	offscreenHeight = height;
+
+	return B_OK;
+}
+
+void
+STLView::CleanupOffscreen(void)
+{
+	if (offscreenFBO) {
+		glDeleteFramebuffers(1, &offscreenFBO);
+		glDeleteRenderbuffers(1, &offscreenColorRBO);
+		glDeleteRenderbuffers(1, &offscreenDepthRBO);
+		offscreenFBO = 0;
+		offscreenColorRBO = 0;
+		offscreenDepthRBO = 0;
+	}
+	offscreenWidth = 0;
+	offscreenHeight = 0;
+}
+
+void
+STLView::SetViewPreset(uint32 preset)
+{
+	switch (preset) {
+		case MSG_VIEWMODE_FRONT:
+			Reset(true, false, true);
+			SetXRotate(-90);
+			SetYRotate(0);
+			break;
+		case MSG_VIEWMODE_TOP:
+			Reset(true, false, true);
+			SetXRotate(0);
+			SetYRotate(0);
+			break;
+		case MSG_VIEWMODE_RIGHT:
+			Reset(true, false, true);
+			SetXRotate(-90);
+			SetYRotate(-90);
+			break;
+		case MSG_VIEWMODE_ISO:
+		default:
+			Reset();
+			break;
 	}
 }
 
@@ -913,42 +1930,434 @@ STLView::ShowPreview(float *matrix)
 	RenderUpdate();
 }
 
+bigtime_t
+STLView::Benchmark(uint32 mode, bool legacy, int32 frames)
+{
+	// The GL lock is held throughout, the render thread waits on it so
+	// no other frame is drawn in between. -1 if there is nothing to draw.
+	LockGL();
+	if (stlObject == NULL || !m_buffersInitialized) {
+		UnlockGL();
+		return -1;
+	}
+
+	uint32 savedMode = viewMode;
+	float savedRotate = yRotate;
+
+	viewMode = mode;
+	legacyWireframe = legacy;
+
+	RenderScene();
+	SwapBuffers();
+	glFinish();
+
+	bigtime_t start = system_time();
+	for (int32 i = 0; i < frames; i++) {
+		yRotate += 360.0f / frames;
+		RenderScene();
+		SwapBuffers();
+	}
+	glFinish();
+	bigtime_t elapsed = system_time() - start;
+
+	viewMode = savedMode;
+	yRotate = savedRotate;
+	legacyWireframe = false;
+	needUpdate = true;
+	UnlockGL();
+
+	return elapsed / (frames > 0 ? frames : 1);
+}
+
 void
 STLView::SetMeasureMode(bool enable)
 {
 	measureMode = enable;
 	isMeasureSkip = false;
 	lastMousePos3dValid = false;
+	measurePickDirty = true;
 	measureStartPointValid = false;
 	measureEndPointValid = false;
 	needUpdate = true;
 	SetViewCursor(enable ? crossCursor : B_CURSOR_SYSTEM_DEFAULT);
 }
 
+void
+STLView::SetSnapIndex(STLSnapIndex *index)
+{
+	LockGL();
+	delete snapIndex;
+	snapIndex = index;
+	measurePickDirty = true;
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetSection(bool enable, float height)
+{
+	LockGL();
+	sectionEnabled = enable;
+	sectionHeight = height;
+	sectionChanged = true;
+	measurePickDirty = true;
+	if (!enable)
+		sectionLines.clear();
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetSectionContours(STLSection *section)
+{
+	LockGL();
+	sectionLines.clear();
+	if (section != NULL) {
+		const std::vector<STLSection::Contour> &contours = section->Contours();
+		for (size_t i = 0; i < contours.size(); i++) {
+			const std::vector<glm::vec3> &points = contours[i].points;
+			size_t count = contours[i].closed ? points.size() : points.size() - 1;
+			for (size_t j = 0; j < count; j++) {
+				const glm::vec3 &from = points[j];
+				const glm::vec3 &to = points[(j + 1) % points.size()];
+				sectionLines.push_back({from.x, from.y, from.z, 1.0f, 0.85f, 0.1f});
+				sectionLines.push_back({to.x, to.y, to.z, 1.0f, 0.85f, 0.1f});
+			}
+		}
+	}
+	sectionChanged = true;
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetOverhang(bool enable, float angle, const std::vector<float> *values)
+{
+	// The angle is only a uniform, the buffers are rebuilt for new facet
+	// values or when the heatmap attribute is switched on or off
+	LockGL();
+	overhangAngle = angle;
+	bool rebuild = enable != showOverhang || values != NULL;
+	showOverhang = enable;
+	if (values != NULL)
+		analysisValues = *values;
+	else if (!enable)
+		analysisValues.clear();
+	if (rebuild && m_buffersInitialized) {
+		CleanupBuffers();
+		InitializeBuffers();
+	}
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetThickness(bool enable, float limit, const std::vector<float> *values)
+{
+	// New facet values or switching the heatmap rebuild the buffers, a
+	// moved limit is only a uniform
+	LockGL();
+	thicknessLimit = limit;
+	bool rebuild = enable != showThickness || values != NULL;
+	showThickness = enable;
+	if (values != NULL)
+		analysisValues = *values;
+	else if (!enable)
+		analysisValues.clear();
+	if (rebuild && m_buffersInitialized) {
+		CleanupBuffers();
+		InitializeBuffers();
+	}
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetIntersections(bool enable, const std::vector<int32> *facets)
+{
+	LockGL();
+	showIntersections = enable;
+	analysisValues.clear();
+	if (enable && facets != NULL && stlObject != NULL) {
+		analysisValues.assign(stlObject->stats.number_of_facets, 0.0f);
+		for (size_t i = 0; i < facets->size(); i++)
+			analysisValues[(*facets)[i]] = 1.0f;
+	}
+	if (m_buffersInitialized) {
+		CleanupBuffers();
+		InitializeBuffers();
+	}
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetDeviation(bool enable, float tolerance, const std::vector<float> *values)
+{
+	// Works like the thickness heatmap, only the values are per corner
+	LockGL();
+	deviationLimit = tolerance;
+	bool rebuild = enable != showDeviation || values != NULL;
+	showDeviation = enable;
+	if (values != NULL)
+		analysisValues = *values;
+	else if (!enable)
+		analysisValues.clear();
+	if (rebuild && m_buffersInitialized) {
+		CleanupBuffers();
+		InitializeBuffers();
+	}
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetCurvature(bool enable, float limit, const std::vector<float> *values)
+{
+	// Per corner values like the deviation, shared corners carry the
+	// same value so the colors blend smoothly across the facets
+	LockGL();
+	curvatureLimit = limit;
+	bool rebuild = enable != showCurvature || values != NULL;
+	showCurvature = enable;
+	if (values != NULL)
+		analysisValues = *values;
+	else if (!enable)
+		analysisValues.clear();
+	if (rebuild && m_buffersInitialized) {
+		CleanupBuffers();
+		InitializeBuffers();
+	}
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetSmoothNormals(const std::vector<glm::vec3> *normals)
+{
+	// Only the smooth buffer is refilled, the scene stays as it is
+	LockGL();
+	if (normals != NULL) {
+		smoothNormals = *normals;
+	} else {
+		std::vector<glm::vec3>().swap(smoothNormals);
+		if (stlSmoothNormalVBO) {
+			glDeleteBuffers(1, &stlSmoothNormalVBO);
+			stlSmoothNormalVBO = 0;
+		}
+	}
+	if (m_buffersInitialized) {
+		glBindVertexArray(stlVAO);
+		UploadSmoothNormals();
+		BindNormals();
+		glBindVertexArray(0);
+	}
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetSmoothShading(bool enable)
+{
+	// Switching only points the normal attribute at the other buffer
+	LockGL();
+	smoothShading = enable;
+	if (m_buffersInitialized) {
+		glBindVertexArray(stlVAO);
+		BindNormals();
+		glBindVertexArray(0);
+	}
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetDefects(STLEdges *edges)
+{
+	LockGL();
+	defectLines.clear();
+	if (edges != NULL) {
+		const std::vector<STLEdges::Edge> &open = edges->OpenEdges();
+		for (size_t i = 0; i < open.size(); i++) {
+			defectLines.push_back({open[i].from.x, open[i].from.y, open[i].from.z, 1.0f, 0.55f, 0.0f});
+			defectLines.push_back({open[i].to.x, open[i].to.y, open[i].to.z, 1.0f, 0.55f, 0.0f});
+		}
+
+		const std::vector<STLEdges::Edge> &nonManifold = edges->NonManifoldEdges();
+		for (size_t i = 0; i < nonManifold.size(); i++) {
+			const STLEdges::Edge &edge = nonManifold[i];
+			defectLines.push_back({edge.from.x, edge.from.y, edge.from.z, 0.9f, 0.2f, 0.9f});
+			defectLines.push_back({edge.to.x, edge.to.y, edge.to.z, 0.9f, 0.2f, 0.9f});
+		}
+	}
+	defectsChanged = true;
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::SetHull(STLHull *hull)
+{
+	LockGL();
+	hullLines.clear();
+	if (hull != NULL) {
+		// Every edge is shared by two faces running it in opposite
+		// directions, taking the ascending one draws it once
+		const std::vector<glm::vec3> &vertices = hull->Vertices();
+		const std::vector<int32> &triangles = hull->Triangles();
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				int32 from = triangles[i + k];
+				int32 to = triangles[i + (k + 1) % 3];
+				if (from > to)
+					continue;
+				hullLines.push_back({vertices[from].x, vertices[from].y, vertices[from].z, 0.3f, 0.7f, 1.0f});
+				hullLines.push_back({vertices[to].x, vertices[to].y, vertices[to].z, 0.3f, 0.7f, 1.0f});
+			}
+		}
+	}
+	hullChanged = true;
+
+	// Corner k sits on the positive side of axis j when bit j is set,
+	// an edge joins two corners one bit apart
+	minimumBoxLines.clear();
+	if (hull != NULL && hull->IsValid()) {
+		const STLHull::Box &box = hull->MinimumBox();
+		glm::vec3 corners[8];
+		for (int k = 0; k < 8; k++) {
+			corners[k] = box.center;
+			for (int j = 0; j < 3; j++)
+				corners[k] += box.axes[j] * (box.size[j] * ((k & (1 << j)) ? 0.5f : -0.5f));
+		}
+		for (int k = 0; k < 8; k++) {
+			for (int j = 0; j < 3; j++) {
+				if (k & (1 << j))
+					continue;
+				const glm::vec3 &from = corners[k];
+				const glm::vec3 &to = corners[k | (1 << j)];
+				minimumBoxLines.push_back({from.x, from.y, from.z, 1.0f, 0.85f, 0.2f});
+				minimumBoxLines.push_back({to.x, to.y, to.z, 1.0f, 0.85f, 0.2f});
+			}
+		}
+	}
+	minimumBoxChanged = true;
+	needUpdate = true;
+	UnlockGL();
+}
+
+void
+STLView::FocusOn(const glm::vec3 &low, const glm::vec3 &high)
+{
+	// Pans the box center onto the view axis and zooms until the box
+	// fills about two thirds of the view, the rotation is kept
+	glm::vec3 center = (low + high) * 0.5f;
+	float radius = std::max(glm::length(high - low) * 0.5f, bigExtent * 0.01f);
+
+	glm::mat4 rotation(1.0f);
+	rotation = glm::rotate(rotation, glm::radians(xRotate), glm::vec3(1.0f, 0.0f, 0.0f));
+	rotation = glm::rotate(rotation, glm::radians(yRotate), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::vec3 rotated = glm::vec3(rotation * glm::vec4(center, 1.0f));
+
+	xPan = -rotated.x;
+	yPan = -rotated.y;
+
+	if (viewOrtho) {
+		// Half the view height is bigExtent / 2 scaled by the zoom ratio
+		scaleFactor = zDepth * (3.0f * radius / bigExtent - 1.0f);
+	} else {
+		float distance = radius * 1.5f / tanf(glm::radians((float)FOV) / 2.0f);
+		scaleFactor = -distance - rotated.z - zDepth;
+	}
+
+	needUpdate = true;
+}
+
+void
+STLView::SnapPoint(glm::vec3 &point)
+{
+	// The index is built by the window off the render thread, there is
+	// nothing to snap to until it arrives
+	if (snapIndex == NULL)
+		return;
+
+	glm::mat4 modelView = viewMatrix * modelMatrix;
+	glm::vec4 viewport(0.0f, 0.0f, boundRect.Width(), boundRect.Height());
+	glm::vec3 window = glm::project(point, modelView, projectionMatrix, viewport);
+	glm::vec3 border = glm::unProject(window + glm::vec3(MEASURE_SNAP_RADIUS, 0.0f, 0.0f),
+		modelView, projectionMatrix, viewport);
+	float radius = glm::distance(point, border);
+	measurePixelSize = radius / MEASURE_SNAP_RADIUS;
+
+	glm::vec3 snapped;
+	lastMouseSnap = snapIndex->Find(point, radius, snapped, _SnapVisibleFunction, this);
+	if (lastMouseSnap != SNAP_NONE)
+		point = snapped;
+}
+
 bool
-STLView::ScreenToPoint3d(BPoint screenPoint, glm::vec3& point3d)
+STLView::IsSnapVisible(const glm::vec3 &point)
+{
+	// A candidate behind the surface shown at its pixel is hidden. The
+	// farthest depth of the pixels around it is taken, so edges on the
+	// outline and between facets stay visible.
+	glm::mat4 modelView = viewMatrix * modelMatrix;
+	glm::vec4 viewport(0.0f, 0.0f, boundRect.Width(), boundRect.Height());
+	glm::vec3 window = glm::project(point, modelView, projectionMatrix, viewport);
+	int32 x = (int32)floorf(window.x) - measureDepthLeft;
+	int32 y = (int32)floorf(window.y) - measureDepthBottom;
+
+	float depth = -1.0f;
+	for (int32 j = std::max(y - 1, (int32)0); j <= std::min(y + 1, measureDepthHeight - 1); j++) {
+		for (int32 i = std::max(x - 1, (int32)0); i <= std::min(x + 1, measureDepthWidth - 1); i++)
+			depth = std::max(depth, measureDepth[j * measureDepthWidth + i]);
+	}
+	if (depth < 0.0f)
+		return false;
+	if (depth >= 1.0f)
+		return true;
+
+	glm::vec3 surface = glm::unProject(glm::vec3(window.x, window.y, depth), modelView,
+		projectionMatrix, viewport);
+	float candidateDistance = -(modelView * glm::vec4(point, 1.0f)).z;
+	float surfaceDistance = -(modelView * glm::vec4(surface, 1.0f)).z;
+	return candidateDistance <= surfaceDistance + measurePixelSize * 2.0f;
+}
+
+bool
+STLView::_SnapVisibleFunction(const glm::vec3 &point, void *cookie)
 {
-	GLint viewport[4];
-	GLdouble modelview[16], projection[16];
-	GLfloat winX, winY, winZ;
-	GLdouble posX, posY, posZ;
+	return ((STLView*)cookie)->IsSnapVisible(point);
+}
 
-	glGetIntegerv(GL_VIEWPORT, viewport);
-	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
-	glGetDoublev(GL_PROJECTION_MATRIX, projection);
+bool
+STLView::ScreenToPoint3d(BPoint screenPoint, glm::vec3& point3d)
+{
+	glm::vec4 viewport(0.0f, 0.0f, boundRect.Width(), boundRect.Height());
 
 	screenPoint -= BPoint(1, 1);
 
-	winX = screenPoint.x;
-	winY = viewport[3] - screenPoint.y;
-
-	glReadPixels(int(winX), int(winY), 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ);
+	int32 winX = (int32)screenPoint.x;
+	int32 winY = (int32)(viewport[3] - screenPoint.y);
+	if (winX < 0 || winY < 0 || winX > (int32)viewport[2] || winY > (int32)viewport[3])
+		return false;
 
+	// The depths around the cursor come back in one read, snapping then
+	// checks its candidates against them
+	int32 reach = MEASURE_SNAP_RADIUS + 2;
+	measureDepthLeft = std::max(winX - reach, (int32)0);
+	measureDepthBottom = std::max(winY - reach, (int32)0);
+	measureDepthWidth = std::min(winX + reach, (int32)viewport[2]) - measureDepthLeft + 1;
+	measureDepthHeight = std::min(winY + reach, (int32)viewport[3]) - measureDepthBottom + 1;
+	measureDepth.resize(measureDepthWidth * measureDepthHeight);
+	glReadPixels(measureDepthLeft, measureDepthBottom, measureDepthWidth, measureDepthHeight,
+		GL_DEPTH_COMPONENT, GL_FLOAT, measureDepth.data());
+
+	float winZ = measureDepth[(winY - measureDepthBottom) * measureDepthWidth
+		+ winX - measureDepthLeft];
 	if (winZ == 1.0f)
 		return false;
 
-	gluUnProject(winX, winY, winZ, modelview, projection, viewport, &posX, &posY, &posZ);
-
-	point3d = glm::vec3(posX, posY, posZ);
+	point3d = glm::unProject(glm::vec3(winX, winY, winZ), viewMatrix * modelMatrix,
+		projectionMatrix, viewport);
 	return true;
 }
@@ -28,12 +28,27 @@
 #include <Cursor.h>
 
 #include <admesh/stl.h>
+#include "STLSnapIndex.h"
+
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-class STLWindow;
+class STLParts;
+class STLSection;
+class STLEdges;
+class STLHull;
+
+#define EDGE_MODE_NONE		0
+#define EDGE_MODE_SHADED	1
+#define EDGE_MODE_WIRE		2
+
+#define FRAME_UNIFORM_BINDING	0
+#define PROJECTION_STATE_SIZE	6
+#define SCREENSHOT_TILE_SIZE	1024
+#define ANALYSIS_ATTRIB_LOCATION	2
+#define INSTANCE_ATTRIB_LOCATION	3
 
 class STLView : public BGLView {
 	public:
@@ -47,7 +62,10 @@ class STLView : public BGLView {
 		virtual void MouseUp(BPoint point);
 		virtual void MouseMoved(BPoint p, uint32 transit, const BMessage *message);
 
-		void SetSTL(stl_file *stl);
+		void SetSTL(stl_file *stl, float depth = -5.0f, float extent = 10.0f, STLParts *parts = NULL);
+		void ReplaceSTL(stl_file *stl, STLParts *parts = NULL);
+		void AddObject(stl_file *stl, const glm::mat4 &transform, STLParts *parts = NULL);
+		void SetExtent(float depth, float extent);
 		void Reload(void);
 		void Reset(bool scale = true, bool rotate = true, bool pan = true);
 		void ShowAxes(bool show, bool plane, bool compass)
@@ -55,19 +73,20 @@ class STLView : public BGLView {
 			showAxes = show;
 			showAxesPlane = plane;
 			showAxesCompass = compass;
-			if (m_buffersInitialized)
-				Reload();
+			needUpdate = true;
 		}
 		void ShowBoundingBox(bool show) { showBox = show; }
 		void ShowOXY(bool show)
 		{
 			showOXY = show;
-			if (m_buffersInitialized)
-				Reload();
+			needUpdate = true;
 		}
 		void SetViewMode(uint32 mode) { viewMode = mode; }
-		void SetOrthographic(bool ortho) { viewOrtho = ortho; SetupProjection(); };
+		void SetOrthographic(bool ortho) { viewOrtho = ortho; needUpdate = true; };
 		void Render(void);
+		status_t RenderOffscreen(BBitmap *bitmap);
+		status_t RenderTiled(const char *path, int32 width, int32 height);
+		void SetViewPreset(uint32 preset);
 		void RenderUpdate() { needUpdate = true; }
 
 		float XRotate() { return xRotate; }
@@ -78,10 +97,40 @@ class STLView : public BGLView {
 		void SetYRotate(float value) { yRotate = value; needUpdate = true; }
 		void SetScaleFactor(float value) { scaleFactor = value; needUpdate = true; }
 		void SetMeasureMode(bool enable);
+		void SetSnapIndex(STLSnapIndex *index);
+		void SetSection(bool enable, float height);
+		void SetSectionContours(STLSection *section);
+		void SetOverhang(bool enable, float angle, const std::vector<float> *values = NULL);
+		void SetThickness(bool enable, float limit, const std::vector<float> *values = NULL);
+		void SetIntersections(bool enable, const std::vector<int32> *facets = NULL);
+		void SetDeviation(bool enable, float tolerance, const std::vector<float> *values = NULL);
+		void SetCurvature(bool enable, float limit, const std::vector<float> *values = NULL);
+		void SetSmoothNormals(const std::vector<glm::vec3> *normals);
+		void SetSmoothShading(bool enable);
+		void SetDefects(STLEdges *edges);
+		void ShowDefects(bool show)
+		{
+			showDefects = show;
+			needUpdate = true;
+		}
+		void SetHull(STLHull *hull);
+		void ShowHull(bool show)
+		{
+			showHull = show;
+			needUpdate = true;
+		}
+		void ShowMinimumBox(bool show)
+		{
+			showMinimumBox = show;
+			needUpdate = true;
+		}
+		void FocusOn(const glm::vec3 &low, const glm::vec3 &high);
 
 		void ShowPreview(float *matrix);
 		void HidePreview() { fShowPreview = false; }
 
+		bigtime_t Benchmark(uint32 mode, bool legacy, int32 frames);
+
 	private:
 		void InitShaders();
 		GLuint CompileShader(GLenum type, const char* source);
@@ -90,54 +139,142 @@ class STLView : public BGLView {
 		void InitializeBuffers();
 		void CleanupBuffers();
 		void GenerateBoxBuffers();
-		void GenerateOXYGridBuffers();
+		void UploadSmoothNormals(void);
+		void BindNormals(void);
 
 		void DrawBox(void);
-		void DrawAxis(void);
-		void DrawMeasure(void);
 		void DrawOXY(void);
-		void DrawAxisLabel(float x, float y, float z,
-				const char* label, float r, float g, float b);
+		void DrawOverlay(void);
+		void DrawSection(bool cap);
+		void DrawDefects(void);
+		void DrawHull(void);
+		void DrawMinimumBox(void);
+		void BuildAxisOverlay(void);
+		void BuildMeasureOverlay(void);
+		void AddOverlayLine(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color);
+		void AddOverlayDashedLine(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color);
+		void AddOverlayPoint(const glm::vec3 &point, const glm::vec3 &color);
+		void AddOverlayGlyph(char glyph, const glm::vec3 &origin, float height, const glm::vec3 &color);
+		glm::vec3 ProjectToScreen(const glm::vec3 &point);
+		void UpdateMeasurePoint(void);
 		void DrawSTL() { DrawSTL({128,128,128}); }
-		void DrawSTL(rgb_color color, float alpha = 1.0);
+		void DrawSTL(rgb_color color, float alpha = 1.0, bool firstObjectOnly = false);
 
-		void Billboard();
 		void SetupProjection(void);
+		void RenderScene(void);
+		status_t PrepareOffscreen(int32 width, int32 height);
+		void CleanupOffscreen(void);
+		void UpdateFrameUniforms(void);
 		bool ScreenToPoint3d(BPoint screenPoint, glm::vec3& point3d);
+		void SnapPoint(glm::vec3& point);
+		bool IsSnapVisible(const glm::vec3 &point);
+		static bool _SnapVisibleFunction(const glm::vec3 &point, void *cookie);
 
 		GLuint boxVAO = 0;
 		GLuint boxVBO = 0;
-		GLuint axesVAO = 0;
-		GLuint axesVBO = 0;
-		GLuint oxyVAO = 0;
-		GLuint oxyVBO = 0;
+		GLuint overlayVAO = 0;
+		GLuint overlayVBO = 0;
+		GLuint gridVAO = 0;
+		GLuint sectionVAO = 0;
+		GLuint sectionVBO = 0;
+		GLuint defectsVAO = 0;
+		GLuint defectsVBO = 0;
+		GLuint hullVAO = 0;
+		GLuint hullVBO = 0;
+		GLuint minimumBoxVAO = 0;
+		GLuint minimumBoxVBO = 0;
+		GLuint offscreenFBO = 0;
+		GLuint offscreenColorRBO = 0;
+		GLuint offscreenDepthRBO = 0;
+		int32 offscreenWidth = 0;
+		int32 offscreenHeight = 0;
 		GLuint stlVAO = 0;
 		GLuint stlVertexVBO = 0;
 		GLuint stlNormalVBO = 0;
-		size_t stlVertexCount = 0;
+		GLuint stlSmoothNormalVBO = 0;
+		GLsizeiptr stlNormalSize = 0;
+		GLuint stlAnalysisVBO = 0;
+		GLuint stlInstanceVBO = 0;
+
+		// The first object is the edited model, appended ones follow
+		struct SceneObject {
+			stl_file *stl;
+			glm::mat4 transform;
+			STLParts *parts;
+		};
+
+		// Either the batch of everything shown once, already in place, or
+		// a part drawn once per instance. Drawing only the edited model
+		// takes its own range.
+		struct SceneGeometry {
+			stl_file *stl;
+			GLint first;
+			GLsizei count;
+			GLsizei baseInstance;
+			GLsizei instanceCount;
+			GLsizei firstObjectInstances;
+			GLint firstObjectFirst;
+			GLsizei firstObjectCount;
+		};
+
+		std::vector<SceneObject> sceneObjects;
+		std::vector<SceneGeometry> sceneGeometry;
 
 		struct ColoredVertex {
 			float x, y, z;
 			float r, g, b;
 		};
 
+		void UploadLines(GLuint &vao, GLuint &vbo, const std::vector<ColoredVertex> &lines);
+
 		std::vector<ColoredVertex> boxVertices;
-		std::vector<ColoredVertex> oxyVertices;
-		std::vector<float> axisVertices;
+		std::vector<ColoredVertex> overlayLines;
+		std::vector<ColoredVertex> overlayPoints;
+		std::vector<ColoredVertex> sectionLines;
+		std::vector<ColoredVertex> defectLines;
+		std::vector<ColoredVertex> hullLines;
+		std::vector<ColoredVertex> minimumBoxLines;
 
 		bool m_buffersInitialized = false;
 
+		// Matches the std140 "Frame" block shared by both programs
+		struct FrameUniforms {
+			glm::mat4 view;
+			glm::mat4 projection;
+			glm::vec4 viewPos;
+		};
+
 		GLuint shaderProgram;
 		GLuint lineShaderProgram;
+		GLuint gridShaderProgram;
+		GLuint frameUBO = 0;
 		GLint modelLoc;
-		GLint viewLoc;
-		GLint projLoc;
+		GLint normalMatrixLoc;
 		GLint colorLoc;
-		GLint viewPosLoc;
+		GLint edgeModeLoc;
+		GLint clipPlaneLoc;
+		GLint showOverhangLoc;
+		GLint overhangLimitLoc;
+		GLint showThicknessLoc;
+		GLint thicknessLimitLoc;
+		GLint showIntersectionsLoc;
+		GLint showDeviationLoc;
+		GLint deviationLimitLoc;
+		GLint showCurvatureLoc;
+		GLint curvatureLimitLoc;
+		GLint lineModelLoc;
+		GLint lineScreenSpaceLoc;
+		GLint gridExtentLoc;
+		GLint gridShowGridLoc;
+		GLint gridShowAxesLoc;
+
+		float projectionState[PROJECTION_STATE_SIZE] = { -1.0f };
 
 		glm::mat4 modelMatrix;
 		glm::mat4 viewMatrix;
 		glm::mat4 projectionMatrix;
+		glm::mat4 tileMatrix = glm::mat4(1.0f);
+		bool tiledRender = false;
 
 		bool measureMode;
 		bool isMeasureSkip = false;
@@ -146,9 +283,54 @@ class STLView : public BGLView {
 		glm::vec3 measureEndPoint;
 		glm::vec3 lastMousePos3d;
 		bool lastMousePos3dValid;
+		bool measurePickDirty = true;
+		glm::mat4 measurePickMatrix = glm::mat4(1.0f);
+		std::vector<float> measureDepth;
+		int32 measureDepthLeft = 0;
+		int32 measureDepthBottom = 0;
+		int32 measureDepthWidth = 0;
+		int32 measureDepthHeight = 0;
+		float measurePixelSize = 0.0f;
+		SnapType lastMouseSnap = SNAP_NONE;
+		STLSnapIndex *snapIndex = NULL;
 		bool measureStartPointValid;
 		bool measureEndPointValid;
 
+		bool sectionEnabled = false;
+		bool sectionChanged = false;
+		float sectionHeight = 0.0f;
+
+		bool showOverhang = false;
+		float overhangAngle = 45.0f;
+
+		bool showThickness = false;
+		float thicknessLimit = 1.0f;
+		bool showIntersections = false;
+		bool showDeviation = false;
+		float deviationLimit = 0.1f;
+		bool showCurvature = false;
+		float curvatureLimit = 1.0f;
+
+		// Per corner normals of the edited model, stlObjectFacets tells
+		// which facet each uploaded one of it came from so the smooth
+		// buffer can be refilled without touching the positions
+		bool smoothShading = false;
+		std::vector<glm::vec3> smoothNormals;
+		std::vector<int32> stlObjectFacets;
+		GLint stlObjectFirst = 0;
+
+		bool showDefects = false;
+		bool defectsChanged = false;
+		bool showHull = false;
+		bool hullChanged = false;
+		bool showMinimumBox = false;
+		bool minimumBoxChanged = false;
+
+		// Per facet values of the edited model for the thickness or
+		// intersection heatmap, per corner ones for the deviation and
+		// curvature heatmaps, whichever is shown
+		std::vector<float> analysisValues;
+
 		BRect boundRect;
 		BBitmap *appIcon;
 		BPoint iconPos;
@@ -161,8 +343,9 @@ class STLView : public BGLView {
 		BCursor *crossCursor;
 		BBitmap *rotateCursorBitmap;
 
-		STLWindow *stlWindow;
-		stl_file* stlObject;
+		stl_file* stlObject = NULL;
+		float zDepth = -5.0f;
+		float bigExtent = 10.0f;
 
 		float xRotate;
 		float yRotate;
@@ -171,6 +354,7 @@ class STLView : public BGLView {
 		float scaleFactor;
 
 		uint32 viewMode;
+		bool legacyWireframe = false;
 		bool needUpdate;
 		bool showBox;
 		bool showAxes;
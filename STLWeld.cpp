@@ -0,0 +1,211 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "STLWeld.h"
+#include "STLParallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Adding zero turns -0 into +0, so both weld like the equal values they are
+static inline glm::vec3
+Corner(stl_file *stl, int32 corner)
+{
+	const stl_vertex &v = stl->facet_start[corner / 3].vertex[corner % 3];
+	return glm::vec3(v.x + 0.0f, v.y + 0.0f, v.z + 0.0f);
+}
+
+static inline uint32
+Bucket(const glm::vec3 &point)
+{
+	uint32 words[3];
+	memcpy(words, &point.x, sizeof(float));
+	memcpy(words + 1, &point.y, sizeof(float));
+	memcpy(words + 2, &point.z, sizeof(float));
+
+	uint64 h = 0x9e3779b97f4a7c15ULL;
+	for (int k = 0; k < 3; k++) {
+		h ^= words[k];
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+	}
+	return h >> (64 - WELD_BUCKET_BITS);
+}
+
+STLWeld::STLWeld(stl_file *stl)
+	: fStl(stl)
+{
+	Build();
+}
+
+glm::vec3
+STLWeld::Position(int32 vertex) const
+{
+	return Corner(fStl, fCorners[fVertexStart[vertex]]);
+}
+
+bool
+STLWeld::IsClosed(int32 vertex) const
+{
+	// Each facet adds its two edges out of the vertex by the far end, in
+	// a closed fan every far end is reached from exactly two facets
+	int32 count;
+	const int32 *corners = Corners(vertex, &count);
+	if (count < 2)
+		return false;
+
+	struct End {
+		int32 vertex;
+		int32 facet;
+		bool operator<(const End &other) const {
+			if (vertex != other.vertex)
+				return vertex < other.vertex;
+			return facet < other.facet;
+		}
+	};
+	End stack[64];
+	std::vector<End> heap;
+	End *ends = stack;
+	if (count * 2 > 64) {
+		heap.resize(count * 2);
+		ends = heap.data();
+	}
+
+	for (int32 i = 0; i < count; i++) {
+		int32 facet = corners[i] / 3 * 3;
+		int32 k = corners[i] % 3;
+		ends[i * 2] = { fCornerVertex[facet + (k + 1) % 3], i };
+		ends[i * 2 + 1] = { fCornerVertex[facet + (k + 2) % 3], i };
+	}
+	std::sort(ends, ends + count * 2);
+
+	for (int32 i = 0; i < count * 2; i += 2) {
+		if (ends[i].vertex != ends[i + 1].vertex || ends[i].vertex == vertex
+			|| ends[i].facet == ends[i + 1].facet
+			|| (i + 2 < count * 2 && ends[i + 2].vertex == ends[i].vertex))
+			return false;
+	}
+
+	// Two fans pinched together at the vertex pass the test above as
+	// well, so walk around from the first facet, a single fan comes back
+	// to it only after visiting all of them
+	int32 facet = 0;
+	int32 end = fCornerVertex[corners[0] / 3 * 3 + (corners[0] % 3 + 1) % 3];
+	for (int32 step = 1;; step++) {
+		End key = { end, -1 };
+		End *pair = std::lower_bound(ends, ends + count * 2, key);
+		facet = pair[0].facet == facet ? pair[1].facet : pair[0].facet;
+		if (facet == 0)
+			return step == count;
+
+		int32 corner = corners[facet] / 3 * 3;
+		int32 k = corners[facet] % 3;
+		int32 next = fCornerVertex[corner + (k + 1) % 3];
+		end = next == end ? fCornerVertex[corner + (k + 2) % 3] : next;
+	}
+}
+
+void
+STLWeld::Build(void)
+{
+	int32 count = fStl->stats.number_of_facets * 3;
+	fVertexStart.assign(1, 0);
+	if (count <= 0)
+		return;
+
+	// Counts per range and bucket become the write offsets
+	int32 chunks = (count + WELD_GRAIN - 1) / WELD_GRAIN;
+	std::vector<int32> offsets((size_t)chunks * WELD_BUCKETS, 0);
+	ParallelFor(count, WELD_GRAIN, [this, &offsets](int32 first, int32 last) {
+		int32 *row = &offsets[(size_t)(first / WELD_GRAIN) * WELD_BUCKETS];
+		for (int32 i = first; i < last; i++)
+			row[Bucket(Corner(fStl, i))]++;
+	});
+
+	std::vector<int32> bucketStart;
+	ScatterOffsets(offsets, chunks, WELD_BUCKETS, 0, WELD_BUCKETS, offsets, bucketStart);
+
+	fCorners.resize(count);
+	ParallelFor(count, WELD_GRAIN, [this, &offsets](int32 first, int32 last) {
+		int32 *row = &offsets[(size_t)(first / WELD_GRAIN) * WELD_BUCKETS];
+		for (int32 i = first; i < last; i++)
+			fCorners[row[Bucket(Corner(fStl, i))]++] = i;
+	});
+	std::vector<int32>().swap(offsets);
+
+	// A bucket is sorted by position in a local copy, which keeps the
+	// comparisons in cache, equal positions then form the vertices
+	struct Record {
+		glm::vec3 point;
+		int32 corner;
+	};
+	fCornerVertex.resize(count);
+	std::vector<int32> bucketVertices(WELD_BUCKETS + 1, 0);
+	ParallelFor(WELD_BUCKETS, 1, [&](int32 first, int32 last) {
+		std::vector<Record> records;
+		for (int32 bucket = first; bucket < last; bucket++) {
+			int32 begin = bucketStart[bucket];
+			int32 end = bucketStart[bucket + 1];
+			records.clear();
+			for (int32 i = begin; i < end; i++)
+				records.push_back({ Corner(fStl, fCorners[i]), fCorners[i] });
+			std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+				if (a.point.x != b.point.x)
+					return a.point.x < b.point.x;
+				if (a.point.y != b.point.y)
+					return a.point.y < b.point.y;
+				if (a.point.z != b.point.z)
+					return a.point.z < b.point.z;
+				return a.corner < b.corner;
+			});
+
+			int32 vertex = -1;
+			for (size_t i = 0; i < records.size(); i++) {
+				if (i == 0 || !(records[i].point == records[i - 1].point))
+					vertex++;
+				fCorners[begin + i] = records[i].corner;
+				fCornerVertex[records[i].corner] = vertex;
+			}
+			bucketVertices[bucket + 1] = vertex + 1;
+		}
+	});
+
+	for (int32 bucket = 0; bucket < WELD_BUCKETS; bucket++)
+		bucketVertices[bucket + 1] += bucketVertices[bucket];
+
+	int32 vertices = bucketVertices[WELD_BUCKETS];
+	fVertexStart.resize(vertices + 1);
+	fVertexStart[vertices] = count;
+	ParallelFor(WELD_BUCKETS, 1, [&](int32 first, int32 last) {
+		for (int32 bucket = first; bucket < last; bucket++) {
+			int32 base = bucketVertices[bucket];
+			int32 previous = -1;
+			for (int32 i = bucketStart[bucket]; i < bucketStart[bucket + 1]; i++) {
+				int32 &vertex = fCornerVertex[fCorners[i]];
+				if (vertex != previous)
+					fVertexStart[vertex + base] = i;
+				previous = vertex;
+				vertex += base;
+			}
+		}
+	});
+}
@@ -0,0 +1,66 @@
+/*  STLover - A powerful tool for viewing and manipulating 3D STL models
+ *  Copyright (C) 2020 Gerasim Troeglazov <3dEyes@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef STLOVER_WELD
+#define STLOVER_WELD
+
+#include <OS.h>
+
+#include <admesh/stl.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define WELD_GRAIN			65536
+#define WELD_BUCKET_BITS	12
+#define WELD_BUCKETS		(1 << WELD_BUCKET_BITS)
+
+// Joins the facet corners of a mesh into vertices by their exact position.
+// Corners are spread over buckets by a hash of the position and every
+// bucket is sorted on its own CPU, runs of equal positions become the
+// vertices. Corners are numbered 3 * facet + k, the corners of one vertex
+// are kept next to each other, so the facets around a vertex are walked
+// without any search.
+class STLWeld {
+	public:
+		STLWeld(stl_file *stl);
+
+		int32 CountVertices(void) const { return fVertexStart.size() - 1; }
+		int32 Vertex(int32 corner) const { return fCornerVertex[corner]; }
+		const std::vector<int32>& CornerVertices(void) const { return fCornerVertex; }
+		const int32* Corners(int32 vertex, int32 *count) const
+		{
+			*count = fVertexStart[vertex + 1] - fVertexStart[vertex];
+			return &fCorners[fVertexStart[vertex]];
+		}
+		glm::vec3 Position(int32 vertex) const;
+
+		// Every edge out of the vertex is shared by exactly two of its
+		// facets and the facets close a single fan around it
+		bool IsClosed(int32 vertex) const;
+
+	private:
+		void Build(void);
+
+		stl_file *fStl;
+		std::vector<int32> fCornerVertex;
+		std::vector<int32> fCorners;
+		std::vector<int32> fVertexStart;
+};
+
+#endif
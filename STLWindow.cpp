@@ -18,6 +18,21 @@
 
 #include "STLApp.h"
 #include "STLView.h"
+#include "STLMesh.h"
+#include "STLParts.h"
+#include "STLSection.h"
+#include "STLOverhang.h"
+#include "STLThickness.h"
+#include "STLIntersections.h"
+#include "STLCompare.h"
+#include "STLEdges.h"
+#include "STLHull.h"
+#include "STLAutoOrient.h"
+#include "STLTransform.h"
+#include "STLRepair.h"
+#include "STLHistory.h"
+#include "STLCurvature.h"
+#include "STLNormals.h"
 #include "STLWindow.h"
 #include "STLLogoView.h"
 #include "STLStatView.h"
@@ -25,6 +40,12 @@
 #include "STLRepairWindow.h"
 #include "STLToolBar.h"
 
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
@@ -36,6 +57,14 @@ STLWindow::STLWindow()
 	fOpenFilePanel(NULL),
 	fSaveFilePanel(NULL),
 	fMeasureWindow(NULL),
+	fSectionWindow(NULL),
+	fOverhangWindow(NULL),
+	fThicknessWindow(NULL),
+	fIntersectionsWindow(NULL),
+	fCompareWindow(NULL),
+	fCurvatureWindow(NULL),
+	fCreaseWindow(NULL),
+	fRepairWindow(NULL),
 	fStlModified(false),
 	fStlLoading(false),
 	fShowStat(false),
@@ -44,9 +73,38 @@ STLWindow::STLWindow()
 	fShowAxesPlane(false),
 	fShowAxesCompass(true),
 	fShowOXY(false),
+	fShowDefects(false),
+	fShowHull(false),
+	fShowMinimumBox(false),
+	fSmoothShading(false),
+	fSmoothRunning(false),
+	fSmoothValid(false),
 	fViewOrtho(false),
 	fShowMode(MSG_VIEWMODE_SOLID),
 	fMeasureMode(false),
+	fSnapRunning(false),
+	fSnapValid(false),
+	fSectionMode(false),
+	fOverhangMode(false),
+	fThicknessMode(false),
+	fThicknessRunning(false),
+	fIntersectionsMode(false),
+	fIntersectionsRunning(false),
+	fCompareMode(false),
+	fCompareRunning(false),
+	fCurvatureMode(false),
+	fCurvatureRunning(false),
+	fEdgesRunning(false),
+	fHullRunning(false),
+	fPartsRunning(false),
+	fOrientRunning(false),
+	fRepairRunning(false),
+	fRepairCancel(NULL),
+	fBenchmarkRunning(false),
+	fBenchmarkAbort(0),
+	fScreenshotRunning(false),
+	fScreenshotWidth(7680),
+	fScreenshotHeight(4320),
 	fExactFlag(false),
 	fNearbyFlag(false),
 	fRemoveUnconnectedFlag(false),
@@ -57,20 +115,40 @@ STLWindow::STLWindow()
 	fIterationsValue(2),
 	fStlValid(false),
 	fStlObject(NULL),
+	fMesh(NULL),
+	fSection(NULL),
+	fOverhang(NULL),
+	fOverhangAngle(45.0f),
+	fThickness(NULL),
+	fThicknessLimit(1.0f),
+	fIntersections(NULL),
+	fCompare(NULL),
+	fCompareReference(NULL),
+	fCompareTolerance(0.1f),
+	fCompareAlign(false),
+	fCurvatureType(CURVATURE_MEAN),
+	fCurvatureRadius(1.0f),
+	fCreaseAngle(30.0f),
+	fEdges(NULL),
+	fDefectIndex(-1),
 	fErrorTimeCounter(0),
 	fRenderWork(true),
 	fZDepth(-5),
-	fMaxExtent(10)
+	fMaxExtent(10),
+	fHistory(new STLHistory())
 {
 	fMenuBar = new BMenuBar(BRect(0, 0, Bounds().Width(), 22), "menubar");
 	fMenuFile = new BMenu(B_TRANSLATE("File"));
 	fMenuFileSaveAs = new BMenu(B_TRANSLATE("Save as" B_UTF8_ELLIPSIS));
+	fMenuEdit = new BMenu(B_TRANSLATE("Edit"));
 	fMenuView = new BMenu(B_TRANSLATE("View"));
 	fMenuAxes = new BMenu(B_TRANSLATE("Axes"));
 	fMenuTools = new BMenu(B_TRANSLATE("Tools"));
 	fMenuToolsMirror = new BMenu(B_TRANSLATE("Mirror"));
 	fMenuToolsScale = new BMenu(B_TRANSLATE("Scale"));
 	fMenuToolsMove = new BMenu(B_TRANSLATE("Move"));
+	fMenuToolsOrient = new BMenu(B_TRANSLATE("Auto orient"));
+	fMenuToolsCurvature = new BMenu(B_TRANSLATE("Curvature"));
 	fMenuHelp = new BMenu(B_TRANSLATE("Help"));
 
 	fMenuFileSaveAs->AddItem(new BMenuItem(B_TRANSLATE("STL (ASCII)"), new BMessage(MSG_FILE_EXPORT_STLA)));
@@ -84,6 +162,8 @@ STLWindow::STLWindow()
 		NULL, NULL, be_app, 9, true, NULL, APP_SIGNATURE), new BMessage(MSG_FILE_OPEN));
 	fMenuItemOpen->SetShortcut('O', 0);
 	fMenuFile->AddItem(fMenuItemOpen);
+	fMenuItemAppend = new BMenuItem(B_TRANSLATE("Append" B_UTF8_ELLIPSIS), new BMessage(MSG_FILE_APPEND));
+	fMenuFile->AddItem(fMenuItemAppend);
 	fMenuItemReload = new BMenuItem(B_TRANSLATE("Reload"), new BMessage(MSG_FILE_RELOAD), 'L');
 	fMenuFile->AddItem(fMenuItemReload);
 	fMenuFile->AddSeparatorItem();
@@ -91,6 +171,8 @@ STLWindow::STLWindow()
 	fMenuFile->AddItem(fMenuItemSave);
 	fMenuFile->AddItem(fMenuFileSaveAs);
 	fMenuFileSaveAs->SetTargetForItems(this);
+	fMenuItemScreenshot = new BMenuItem(B_TRANSLATE("Save screenshot" B_UTF8_ELLIPSIS), new BMessage(MSG_FILE_SCREENSHOT));
+	fMenuFile->AddItem(fMenuItemScreenshot);
 	fMenuFile->AddSeparatorItem();
 	fMenuItemClose = new BMenuItem(B_TRANSLATE("Close"), new BMessage(MSG_FILE_CLOSE));
 	fMenuFile->AddItem(fMenuItemClose);
@@ -98,6 +180,13 @@ STLWindow::STLWindow()
 	fMenuBar->AddItem(fMenuFile);
 	fMenuFile->SetTargetForItems(this);
 
+	fMenuItemUndo = new BMenuItem(B_TRANSLATE("Undo"), new BMessage(MSG_EDIT_UNDO), 'Z');
+	fMenuEdit->AddItem(fMenuItemUndo);
+	fMenuItemRedo = new BMenuItem(B_TRANSLATE("Redo"), new BMessage(MSG_EDIT_REDO), 'Z', B_SHIFT_KEY);
+	fMenuEdit->AddItem(fMenuItemRedo);
+	fMenuBar->AddItem(fMenuEdit);
+	fMenuEdit->SetTargetForItems(this);
+
 	fMenuItemShowAxesPlane = new BMenuItem(B_TRANSLATE("Plane"), new BMessage(MSG_VIEWMODE_AXES_PLANE));
 	fMenuAxes->AddItem(fMenuItemShowAxesPlane);
 	fMenuItemShowAxesCompass = new BMenuItem(B_TRANSLATE("Compass"), new BMessage(MSG_VIEWMODE_AXES_COMPASS));
@@ -110,9 +199,15 @@ STLWindow::STLWindow()
 	fMenuView->AddItem(fMenuItemWireframe);
 	fMenuItemSolid = new BMenuItem(B_TRANSLATE("Solid"), new BMessage(MSG_VIEWMODE_SOLID));
 	fMenuView->AddItem(fMenuItemSolid);
+	fMenuItemSolidEdges = new BMenuItem(B_TRANSLATE("Solid with edges"), new BMessage(MSG_VIEWMODE_SOLID_EDGES));
+	fMenuView->AddItem(fMenuItemSolidEdges);
 	fMenuView->AddSeparatorItem();
 	fMenuItemOrthographicView = new BMenuItem(B_TRANSLATE("Orthographic projection"), new BMessage(MSG_VIEWMODE_ORTHO));
 	fMenuView->AddItem(fMenuItemOrthographicView);
+	fMenuItemSmoothShading = new BMenuItem(B_TRANSLATE("Smooth shading"), new BMessage(MSG_VIEWMODE_SMOOTH));
+	fMenuView->AddItem(fMenuItemSmoothShading);
+	fMenuItemCreaseAngle = new BMenuItem(B_TRANSLATE("Crease angle" B_UTF8_ELLIPSIS), new BMessage(MSG_VIEWMODE_CREASE));
+	fMenuView->AddItem(fMenuItemCreaseAngle);
 	fMenuView->AddSeparatorItem();
 	fMenuItemShowAxes = new BMenuItem(fMenuAxes, new BMessage(MSG_VIEWMODE_AXES));
 	fMenuView->AddItem(fMenuItemShowAxes);
@@ -120,6 +215,14 @@ STLWindow::STLWindow()
 	fMenuView->AddItem(fMenuItemShowOXY);
 	fMenuItemShowBox = new BMenuItem(B_TRANSLATE("Bounding box"), new BMessage(MSG_VIEWMODE_BOUNDING_BOX));
 	fMenuView->AddItem(fMenuItemShowBox);
+	fMenuItemShowHull = new BMenuItem(B_TRANSLATE("Convex hull"), new BMessage(MSG_VIEWMODE_HULL));
+	fMenuView->AddItem(fMenuItemShowHull);
+	fMenuItemShowMinimumBox = new BMenuItem(B_TRANSLATE("Minimum bounding box"), new BMessage(MSG_VIEWMODE_MIN_BOX));
+	fMenuView->AddItem(fMenuItemShowMinimumBox);
+	fMenuItemShowDefects = new BMenuItem(B_TRANSLATE("Mesh defects"), new BMessage(MSG_VIEWMODE_DEFECTS));
+	fMenuView->AddItem(fMenuItemShowDefects);
+	fMenuItemNextDefect = new BMenuItem(B_TRANSLATE("Zoom to next defect"), new BMessage(MSG_VIEWMODE_NEXT_DEFECT), 'D');
+	fMenuView->AddItem(fMenuItemNextDefect);
 	fMenuView->AddSeparatorItem();
 	fMenuItemStat = new BMenuItem(B_TRANSLATE("Statistics"), new BMessage(MSG_VIEWMODE_STAT), 'I');
 	fMenuView->AddItem(fMenuItemStat);
@@ -143,6 +246,10 @@ STLWindow::STLWindow()
 	fMenuToolsMove->AddItem(new BMenuItem(B_TRANSLATE("To top of OXY plane"), new BMessage(MSG_TOOLS_MOVE_MIDDLE)));
 	fMenuToolsMove->SetTargetForItems(this);
 
+	fMenuToolsOrient->AddItem(new BMenuItem(B_TRANSLATE("Minimize height"), new BMessage(MSG_TOOLS_ORIENT_HEIGHT)));
+	fMenuToolsOrient->AddItem(new BMenuItem(B_TRANSLATE("Minimize supports"), new BMessage(MSG_TOOLS_ORIENT_SUPPORT)));
+	fMenuToolsOrient->SetTargetForItems(this);
+
 	fMenuItemEditTitle = new BMenuItem(B_TRANSLATE("Edit title" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_EDIT_TITLE));
 	fMenuTools->AddItem(fMenuItemEditTitle);
 	fMenuTools->AddSeparatorItem();
@@ -151,12 +258,32 @@ STLWindow::STLWindow()
 	fMenuTools->AddItem(fMenuToolsMirror);
 	fMenuItemRotate = new BMenuItem(B_TRANSLATE("Rotate" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_ROTATE));
 	fMenuTools->AddItem(fMenuItemRotate);
+	fMenuTools->AddItem(fMenuToolsOrient);
 	fMenuTools->AddSeparatorItem();
 	fMenuItemRepair = new BMenuItem(B_TRANSLATE("Repair" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_REPAIR));
 	fMenuTools->AddItem(fMenuItemRepair);
 	fMenuTools->AddSeparatorItem();
 	fMenuItemMeasure = new BMenuItem(B_TRANSLATE("Measure" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_MEASURE));
 	fMenuTools->AddItem(fMenuItemMeasure);
+	fMenuItemSection = new BMenuItem(B_TRANSLATE("Section view" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_SECTION));
+	fMenuTools->AddItem(fMenuItemSection);
+	fMenuItemOverhang = new BMenuItem(B_TRANSLATE("Overhangs" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_OVERHANG));
+	fMenuTools->AddItem(fMenuItemOverhang);
+	fMenuItemThickness = new BMenuItem(B_TRANSLATE("Wall thickness" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_THICKNESS));
+	fMenuTools->AddItem(fMenuItemThickness);
+	fMenuItemIntersections = new BMenuItem(B_TRANSLATE("Self-intersections" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_INTERSECTIONS));
+	fMenuTools->AddItem(fMenuItemIntersections);
+	fMenuItemCompare = new BMenuItem(B_TRANSLATE("Compare with" B_UTF8_ELLIPSIS), new BMessage(MSG_TOOLS_COMPARE));
+	fMenuTools->AddItem(fMenuItemCompare);
+
+	BMessage *meanMessage = new BMessage(MSG_TOOLS_CURVATURE);
+	meanMessage->AddInt32("type", CURVATURE_MEAN);
+	fMenuToolsCurvature->AddItem(new BMenuItem(B_TRANSLATE("Mean" B_UTF8_ELLIPSIS), meanMessage));
+	BMessage *gaussianMessage = new BMessage(MSG_TOOLS_CURVATURE);
+	gaussianMessage->AddInt32("type", CURVATURE_GAUSSIAN);
+	fMenuToolsCurvature->AddItem(new BMenuItem(B_TRANSLATE("Gaussian" B_UTF8_ELLIPSIS), gaussianMessage));
+	fMenuToolsCurvature->SetTargetForItems(this);
+	fMenuTools->AddItem(fMenuToolsCurvature);
 
 	fMenuBar->AddItem(fMenuView);
 	fMenuView->SetTargetForItems(this);
@@ -228,7 +355,7 @@ STLWindow::STLWindow()
 	BRect stlRect = Bounds();
 	stlRect.top = fToolBar->Frame().bottom + 1;
 	stlRect.left =fViewToolBar->Frame().right + 1;
-	fStlView = new STLView(stlRect, BGL_RGB | BGL_DOUBLE | BGL_DEPTH);
+	fStlView = new STLView(stlRect, BGL_RGB | BGL_DOUBLE | BGL_DEPTH | BGL_STENCIL);
 	AddChild(fStlView);
 	fStlView->Hide();
 
@@ -264,6 +391,7 @@ STLWindow::~STLWindow()
 	wait_for_thread(fRendererThread, &exitValue);
 
 	CloseFile();
+	delete fHistory;
 
 	if (fOpenFilePanel != NULL)
 		fOpenFilePanel->Window()->PostMessage(B_QUIT_REQUESTED);
@@ -298,6 +426,10 @@ STLWindow::LoadSettings(void)
 		bool _fShowAxesCompass = true;
 		bool _showStat = false;
 		bool _fShowOXY = false;
+		bool _fShowDefects = false;
+		bool _fShowHull = false;
+		bool _fShowMinimumBox = false;
+		bool _fSmoothShading = false;
 		bool _fOrthoProj = false;
 		uint32 _fShowMode = MSG_VIEWMODE_SOLID;
 		BRect _windowRect(100, 100, 100 + 800, 100 + 640);
@@ -308,6 +440,11 @@ STLWindow::LoadSettings(void)
 		file.ReadAttr("ShowAxesCompass", B_BOOL_TYPE, 0, &_fShowAxesCompass, sizeof(bool));
 		file.ReadAttr("ShowOXY", B_BOOL_TYPE, 0, &_fShowOXY, sizeof(bool));
 		file.ReadAttr("ShowBoundingBox", B_BOOL_TYPE, 0, &_fShowBoundingBox, sizeof(bool));
+		file.ReadAttr("ShowDefects", B_BOOL_TYPE, 0, &_fShowDefects, sizeof(bool));
+		file.ReadAttr("ShowHull", B_BOOL_TYPE, 0, &_fShowHull, sizeof(bool));
+		file.ReadAttr("ShowMinimumBox", B_BOOL_TYPE, 0, &_fShowMinimumBox, sizeof(bool));
+		file.ReadAttr("SmoothShading", B_BOOL_TYPE, 0, &_fSmoothShading, sizeof(bool));
+		file.ReadAttr("CreaseAngle", B_FLOAT_TYPE, 0, &fCreaseAngle, sizeof(float));
 		file.ReadAttr("ShowStat", B_BOOL_TYPE, 0, &_showStat, sizeof(bool));
 		file.ReadAttr("ShowMode", B_UINT32_TYPE, 0, &_fShowMode, sizeof(uint32));
 		file.ReadAttr("OrthographicProjection", B_BOOL_TYPE, 0, &_fOrthoProj, sizeof(bool));
@@ -334,6 +471,18 @@ STLWindow::LoadSettings(void)
 		fShowOXY = _fShowOXY;
 		fStlView->ShowOXY(fShowOXY);
 
+		fShowDefects = _fShowDefects;
+		fStlView->ShowDefects(fShowDefects);
+
+		fShowHull = _fShowHull;
+		fStlView->ShowHull(fShowHull);
+
+		fShowMinimumBox = _fShowMinimumBox;
+		fStlView->ShowMinimumBox(fShowMinimumBox);
+
+		fSmoothShading = _fSmoothShading;
+		fStlView->SetSmoothShading(fSmoothShading);
+
 		fShowMode = _fShowMode;
 		fStlView->SetViewMode(fShowMode);
 
@@ -370,6 +519,11 @@ STLWindow::SaveSettings(void)
 		file.WriteAttr("ShowAxesCompass", B_BOOL_TYPE, 0, &fShowAxesCompass, sizeof(bool));
 		file.WriteAttr("ShowOXY", B_BOOL_TYPE, 0, &fShowOXY, sizeof(bool));
 		file.WriteAttr("ShowBoundingBox", B_BOOL_TYPE, 0, &fShowBoundingBox, sizeof(bool));
+		file.WriteAttr("ShowDefects", B_BOOL_TYPE, 0, &fShowDefects, sizeof(bool));
+		file.WriteAttr("ShowHull", B_BOOL_TYPE, 0, &fShowHull, sizeof(bool));
+		file.WriteAttr("ShowMinimumBox", B_BOOL_TYPE, 0, &fShowMinimumBox, sizeof(bool));
+		file.WriteAttr("SmoothShading", B_BOOL_TYPE, 0, &fSmoothShading, sizeof(bool));
+		file.WriteAttr("CreaseAngle", B_FLOAT_TYPE, 0, &fCreaseAngle, sizeof(float));
 		file.WriteAttr("ShowStat", B_BOOL_TYPE, 0, &fShowStat, sizeof(bool));
 		file.WriteAttr("ShowMode", B_UINT32_TYPE, 0, &fShowMode, sizeof(uint32));
 		file.WriteAttr("OrthographicProjection", B_BOOL_TYPE, 0, &fViewOrtho, sizeof(bool));
@@ -400,6 +554,14 @@ STLWindow::WindowActivated(bool active)
 bool
 STLWindow::QuitRequested()
 {
+	// A running benchmark is stopped first, it closes the window when done
+	if (fBenchmarkRunning) {
+		atomic_set(&fBenchmarkAbort, 1);
+		return false;
+	}
+	if (fScreenshotRunning)
+		return false;
+
 	if (fStlModified) {
 		BPath path(fOpenedFileName);
 		BString alertText(B_TRANSLATE("Save changes to document '%filename%' ?"));
@@ -417,10 +579,12 @@ STLWindow::QuitRequested()
 			default:
 			{
 				BPath path(fOpenedFileName);
-				if (fStlObject->stats.type == binary)
-					stl_write_binary(fStlObject, path.Path(), fStlObject->stats.header);
+				stl_file *stl = SceneSTL();
+				if (stl->stats.type == binary)
+					stl_write_binary(stl, path.Path(), stl->stats.header);
 				else
-					stl_write_ascii(fStlObject, path.Path(), fStlObject->stats.header);
+					stl_write_ascii(stl, path.Path(), stl->stats.header);
+				ReleaseSceneSTL(stl);
 
 				fStlModified = false;
 				return true;
@@ -509,13 +673,66 @@ STLWindow::MessageReceived(BMessage *message)
 			fOpenFilePanel->Show();
 			break;
 		}
+		case MSG_FILE_APPEND:
+		{
+			if (!message->HasRef("refs")) {
+				if (fOpenFilePanel == NULL) {
+					fOpenFilePanel = new BFilePanel(B_OPEN_PANEL, NULL, NULL,
+						B_FILE_NODE, true, NULL, NULL, false, true);
+					fOpenFilePanel->SetTarget(this);
+				}
+
+				BMessage *appendMsg = new BMessage(MSG_FILE_APPEND);
+				fOpenFilePanel->SetMessage(appendMsg);
+				delete appendMsg;
+
+				fOpenFilePanel->Show();
+				break;
+			}
+
+			entry_ref ref;
+			for (int32 i = 0; message->FindRef("refs", i, &ref) == B_OK; i++) {
+				BPath path(&ref);
+				if (path.InitCheck() != B_OK)
+					continue;
+				AppendFile(path.Path());
+			}
+			break;
+		}
+		case MSG_FILE_APPENDED:
+		{
+			STLMesh *mesh = NULL;
+			if (message->FindPointer("mesh", (void**)&mesh) != B_OK || mesh == NULL)
+				break;
+
+			if (!IsLoaded()) {
+				mesh->ReleaseReference();
+				break;
+			}
+
+			AddObject(mesh);
+			fStlModified = true;
+			UpdateUI();
+			break;
+		}
+		case MSG_FILE_APPEND_FAILED:
+		{
+			BString alertText(B_TRANSLATE("Unable to append '%filename%'."));
+			alertText.ReplaceFirst("%filename%", BPath(message->FindString("path")).Leaf());
+			BAlert *alert = new BAlert(B_TRANSLATE("Append"), alertText, B_TRANSLATE("OK"),
+				NULL, NULL, B_WIDTH_AS_USUAL, B_STOP_ALERT);
+			alert->Go(NULL);
+			break;
+		}
 		case MSG_FILE_SAVE:
 		{
 			BPath path(fOpenedFileName);
-			if (fStlObject->stats.type == binary)
-				stl_write_binary(fStlObject, path.Path(), fStlObject->stats.header);
+			stl_file *stl = SceneSTL();
+			if (stl->stats.type == binary)
+				stl_write_binary(stl, path.Path(), stl->stats.header);
 			else
-				stl_write_ascii(fStlObject, path.Path(), fStlObject->stats.header);
+				stl_write_ascii(stl, path.Path(), stl->stats.header);
+			ReleaseSceneSTL(stl);
 			BNode node(path.Path());
 			BNodeInfo nodeInfo(&node);
 			nodeInfo.SetType("application/sla");
@@ -563,6 +780,42 @@ STLWindow::MessageReceived(BMessage *message)
 			delete fileMsg;
 			break;
 		}
+		case MSG_FILE_SCREENSHOT:
+		{
+			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("Save screenshot"), this, MSG_FILE_SCREENSHOT_SET);
+			input->AddIntegerField("width", B_TRANSLATE("Width:"), fScreenshotWidth, 1, 65535);
+			input->AddIntegerField("height", B_TRANSLATE("Height:"), fScreenshotHeight, 1, 65535);
+			input->Show();
+			UpdateUIStates(false);
+			break;
+		}
+		case MSG_FILE_SCREENSHOT_SET:
+		{
+			fScreenshotWidth = message->FindInt32("width");
+			fScreenshotHeight = message->FindInt32("height");
+			UpdateUI();
+
+			BMessage *fileMsg = new BMessage(B_SAVE_REQUESTED);
+			fileMsg->AddInt32("format", MSG_FILE_SCREENSHOT);
+
+			if (fSaveFilePanel == NULL) {
+				fSaveFilePanel = new BFilePanel(B_SAVE_PANEL, NULL, NULL,
+					B_FILE_NODE, true, fileMsg, NULL, false, true);
+				fSaveFilePanel->SetTarget(this);
+			} else {
+				fSaveFilePanel->SetMessage(fileMsg);
+			}
+			BPath openedFile(fOpenedFileName);
+			BString name(openedFile.Leaf());
+			if (name.IEndsWith(".stl"))
+				name.Truncate(name.Length() - 4);
+			name << ".png";
+			fSaveFilePanel->SetSaveText(name.String());
+			fSaveFilePanel->Window()->SetTitle(B_TRANSLATE("Save screenshot as" B_UTF8_ELLIPSIS));
+			fSaveFilePanel->Show();
+			delete fileMsg;
+			break;
+		}
 		case MSG_FILE_CLOSE:
 		{
 			CloseFile();
@@ -570,19 +823,22 @@ STLWindow::MessageReceived(BMessage *message)
 		}
 		case MSG_FILE_OPENED:
 		{
-			fZDepth = -5;
-			fMaxExtent = 10;
-
 			BPath path(fOpenedFileName);
 			SetTitle(path.Leaf());
 
-			TransformPosition();
-			fStlView->SetSTL(fStlObject);
+			fZDepth = fMesh->ZDepth();
+			fMaxExtent = fMesh->MaxExtent();
+			fStlView->SetSTL(fStlObject, fZDepth, fMaxExtent, fMesh->Parts());
 
 			fErrorTimeCounter = 0;
 			fStlLoading = false;
 			fStlModified = false;
 			fStlValid = true;
+			fSnapValid = false;
+			StartEdges();
+			StartHull();
+			StartSmoothNormals();
+			StartSnapIndex();
 			UpdateUI();
 
 			fStlLogoView->Hide();
@@ -640,37 +896,60 @@ STLWindow::MessageReceived(BMessage *message)
 				BString filename = message->FindString("name");
 				path.Append(filename);
 				uint32 format = message->FindInt32("format");
+				if (format == MSG_FILE_SCREENSHOT) {
+					if (fScreenshotRunning || !IsLoaded())
+						break;
+					fScreenshotPath.SetTo(path.Path());
+					fScreenshotRunning = true;
+					UpdateUI();
+					thread_id screenshotThread = spawn_thread(_ScreenshotFunction, "screenshotThread", B_NORMAL_PRIORITY, (void*)this);
+					if (screenshotThread < B_OK) {
+						fScreenshotRunning = false;
+						UpdateUI();
+						break;
+					}
+					resume_thread(screenshotThread);
+					break;
+				}
+				// Exports that repair the mesh first work on a copy, the
+				// model and its undo history stay as they are
+				bool repair = format == MSG_FILE_EXPORT_VRML || format == MSG_FILE_EXPORT_OFF
+					|| format == MSG_FILE_EXPORT_OBJ;
+				stl_file *stl = SceneSTL(repair);
+				if (repair && stl == fStlObject)
+					break;
 				BString mime("application/sla");
 				switch (format) {
 					case MSG_FILE_EXPORT_STLA:
-						stl_write_ascii(fStlObject, path.Path(), fStlObject->stats.header);
+						stl_write_ascii(stl, path.Path(), stl->stats.header);
 						break;
 					case MSG_FILE_EXPORT_STLB:
-						stl_write_binary(fStlObject, path.Path(), fStlObject->stats.header);
+						stl_write_binary(stl, path.Path(), stl->stats.header);
 						break;
 					case MSG_FILE_EXPORT_DXF:
-						stl_write_dxf(fStlObject, (char*)path.Path(), fStlObject->stats.header);
+						stl_write_dxf(stl, (char*)path.Path(), stl->stats.header);
 						mime.SetTo("application/dxf");
 						break;
 					case MSG_FILE_EXPORT_VRML:
-						stl_repair(fStlObject, 1, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1);
-						stl_generate_shared_vertices(fStlObject);
-						stl_write_vrml(fStlObject, (char*)path.Path());
+						stl_repair(stl, 1, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1);
+						stl_generate_shared_vertices(stl);
+						stl_write_vrml(stl, (char*)path.Path());
 						mime.SetTo("text/plain");
 						break;
 					case MSG_FILE_EXPORT_OFF:
-						stl_repair(fStlObject, 1, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1);
-						stl_generate_shared_vertices(fStlObject);
-						stl_write_off(fStlObject, (char*)path.Path());
+						stl_repair(stl, 1, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1);
+						stl_generate_shared_vertices(stl);
+						stl_write_off(stl, (char*)path.Path());
 						mime.SetTo("text/plain");
 						break;
 					case MSG_FILE_EXPORT_OBJ:
-						stl_repair(fStlObject, 1, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1);
-						stl_generate_shared_vertices(fStlObject);
-						stl_write_obj(fStlObject, (char*)path.Path());
+						stl_repair(stl, 1, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1);
+						stl_generate_shared_vertices(stl);
+						stl_write_obj(stl, (char*)path.Path());
 						mime.SetTo("text/plain");
 						break;
 				}
+				ReleaseSceneSTL(stl);
 				BNode node(path.Path());
 				BNodeInfo nodeInfo(&node);
 				nodeInfo.SetType(mime.String());
@@ -747,6 +1026,157 @@ STLWindow::MessageReceived(BMessage *message)
 			UpdateUI();
 			break;
 		}
+		case MSG_VIEWMODE_HULL:
+		{
+			fShowHull = !fShowHull;
+			fStlView->ShowHull(fShowHull);
+			UpdateUI();
+			break;
+		}
+		case MSG_VIEWMODE_HULL_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLHull *hull = NULL;
+			int32 revision = -1;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("hull", (void**)&hull);
+			message->FindInt32("revision", &revision);
+			fHullRunning = false;
+
+			// The mesh may have been edited in place while the hull was built
+			if (IsLoaded() && mesh == fMesh && revision == fMesh->Revision()) {
+				fMesh->SetHull(hull, revision);
+				fStlView->SetHull(fMesh->Hull());
+				UpdateUI();
+			} else {
+				delete hull;
+				if (IsLoaded())
+					StartHull();
+			}
+
+			mesh->ReleaseReference();
+			break;
+		}
+		case MSG_VIEWMODE_PARTS_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLParts *parts = NULL;
+			STLFingerprint *fingerprint = NULL;
+			int32 revision = -1;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("parts", (void**)&parts);
+			message->FindPointer("fingerprint", (void**)&fingerprint);
+			message->FindInt32("revision", &revision);
+			fPartsRunning = false;
+
+			if (IsLoaded() && mesh == fMesh && revision == fMesh->Revision()) {
+				fMesh->SetParts(parts, *fingerprint, revision);
+				fStlView->ReplaceSTL(fStlObject, fMesh->Parts());
+				fStlView->Reload();
+				UpdateUI();
+			} else {
+				delete parts;
+				if (IsLoaded())
+					StartParts();
+			}
+
+			delete fingerprint;
+			mesh->ReleaseReference();
+			break;
+		}
+		case MSG_VIEWMODE_MIN_BOX:
+		{
+			fShowMinimumBox = !fShowMinimumBox;
+			fStlView->ShowMinimumBox(fShowMinimumBox);
+			UpdateUI();
+			break;
+		}
+		case MSG_VIEWMODE_SMOOTH:
+		{
+			// The normals are kept when switched off, turning it back on
+			// only points the view at them again
+			fSmoothShading = !fSmoothShading;
+			fStlView->SetSmoothShading(fSmoothShading);
+			StartSmoothNormals();
+			UpdateUI();
+			break;
+		}
+		case MSG_VIEWMODE_SMOOTH_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLNormals *normals = NULL;
+			int32 revision = -1;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("normals", (void**)&normals);
+			message->FindInt32("revision", &revision);
+			fSmoothRunning = false;
+
+			// The slider may have moved on while they were computed
+			if (IsLoaded() && mesh == fMesh && revision == fMesh->Revision()
+				&& normals->CreaseAngle() == fCreaseAngle) {
+				fStlView->SetSmoothNormals(&normals->Values());
+				fSmoothValid = true;
+			}
+			delete normals;
+			StartSmoothNormals();
+
+			mesh->ReleaseReference();
+			break;
+		}
+		case MSG_VIEWMODE_CREASE:
+		{
+			if (fCreaseWindow != NULL) {
+				fCreaseWindow->Activate();
+				break;
+			}
+
+			fCreaseWindow = new STLInputWindow(B_TRANSLATE("Crease angle"), this,
+				MSG_VIEWMODE_CREASE_DROP, BUTTON_CLOSE);
+			fCreaseWindow->AddSliderField("angle", B_TRANSLATE("Angle:"), fCreaseAngle, 0, 180);
+			fCreaseWindow->Show();
+			break;
+		}
+		case MSG_VIEWMODE_CREASE_DROP:
+		{
+			fCreaseWindow = NULL;
+			break;
+		}
+		case MSG_VIEWMODE_DEFECTS:
+		{
+			fShowDefects = !fShowDefects;
+			fStlView->ShowDefects(fShowDefects);
+			UpdateUI();
+			break;
+		}
+		case MSG_VIEWMODE_NEXT_DEFECT:
+		{
+			NextDefect();
+			UpdateUI();
+			break;
+		}
+		case MSG_VIEWMODE_DEFECTS_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLEdges *edges = NULL;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("edges", (void**)&edges);
+			fEdgesRunning = false;
+
+			if (IsLoaded() && mesh == fMesh) {
+				delete fEdges;
+				fEdges = edges;
+				fDefectIndex = -1;
+				fStlView->SetDefects(fEdges);
+				UpdateUI();
+			} else {
+				delete edges;
+				if (IsLoaded())
+					StartEdges();
+			}
+
+			mesh->ReleaseReference();
+			break;
+		}
 		case MSG_VIEWMODE_RESETPOS:
 		{
 			fStlView->Reset();
@@ -776,22 +1206,15 @@ STLWindow::MessageReceived(BMessage *message)
 			break;
 		}
 		case MSG_VIEWMODE_FRONT:
-		{
-			fStlView->Reset(true, false, true);
-			fStlView->SetXRotate(-90);
-			fStlView->SetYRotate(0);
-			UpdateUI();
-			break;
-		}
 		case MSG_VIEWMODE_TOP:
+		case MSG_VIEWMODE_RIGHT:
+		case MSG_VIEWMODE_ISO:
 		{
-			fStlView->Reset(true, false, true);
-			fStlView->SetXRotate(0);
-			fStlView->SetYRotate(0);
+			fStlView->SetViewPreset(message->what);
 			UpdateUI();
 			break;
 		}
-		
+
 		case MSG_VIEWMODE_ORTHO:
 		{
 			fViewOrtho=!fViewOrtho;
@@ -800,15 +1223,6 @@ STLWindow::MessageReceived(BMessage *message)
 			fStlView->SetOrthographic(fViewOrtho);
 			break;
 		}
-		
-		case MSG_VIEWMODE_RIGHT:
-		{
-			fStlView->Reset(true, false, true);
-			fStlView->SetXRotate(-90);
-			fStlView->SetYRotate(-90);
-			UpdateUI();
-			break;
-		}
 
 		case MSG_FILE_RELOAD:
 		{
@@ -853,6 +1267,7 @@ STLWindow::MessageReceived(BMessage *message)
 			}
 
 			fStlView->SetMeasureMode(fMeasureMode);
+			StartSnapIndex();
 			UpdateUI();
 			break;
 		}
@@ -863,6 +1278,29 @@ STLWindow::MessageReceived(BMessage *message)
 			UpdateUI();
 			break;
 		}
+		case MSG_TOOLS_MEASURE_INDEX_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLSnapIndex *index = NULL;
+			int32 revision = -1;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("index", (void**)&index);
+			message->FindInt32("revision", &revision);
+			int32 objects = message->FindInt32("objects");
+			fSnapRunning = false;
+
+			if (IsLoaded() && mesh == fMesh && revision == fMesh->Revision()
+				&& objects == (int32)fAppendedObjects.size()) {
+				fStlView->SetSnapIndex(index);
+				fSnapValid = true;
+			} else {
+				delete index;
+				StartSnapIndex();
+			}
+
+			mesh->ReleaseReference();
+			break;
+		}
 		case MSG_TOOLS_MEASURE_UPDATE:
 		{
 			if (fMeasureMode) {
@@ -876,175 +1314,684 @@ STLWindow::MessageReceived(BMessage *message)
 			}
 			break;
 		}
-		case MSG_VIEWMODE_STAT:
+		case MSG_TOOLS_SECTION:
 		{
-			fShowStat = !fShowStat;
+			if (fSectionMode) {
+				if (fSectionWindow) {
+					fSectionWindow->Lock();
+					fSectionWindow->Quit();
+					fSectionWindow = NULL;
+				}
+				EndSection();
+				break;
+			}
+
+			if (!IsLoaded())
+				break;
+
+			float minZ = fStlObject->stats.min.z;
+			float maxZ = fStlObject->stats.max.z;
+			float height = (minZ + maxZ) / 2.0f;
+
+			fSectionMode = true;
+			fSectionWindow = new STLInputWindow(B_TRANSLATE("Section view"), this, MSG_TOOLS_SECTION_DROP, BUTTON_RESET | BUTTON_CLOSE);
+			fSectionWindow->AddSliderField("height", B_TRANSLATE("Height:"), height, minZ, maxZ);
+			fSectionWindow->AddFloatField("area", B_TRANSLATE("Area:"), 0.0);
+			fSectionWindow->SetFieldEditable("area", false);
+			fSectionWindow->AddIntegerField("contours", B_TRANSLATE("Contours:"), 0);
+			fSectionWindow->SetFieldEditable("contours", false);
+			UpdateSection(height);
+			fSectionWindow->Show();
 			UpdateUI();
 			break;
 		}
-		case MSG_TOOLS_REPAIR:
+		case MSG_TOOLS_SECTION_DROP:
 		{
-			BMessage *options = new BMessage();
-			options->AddInt32("fExactFlag", fExactFlag);
-			options->AddInt32("fNearbyFlag", fNearbyFlag);
-			options->AddInt32("fRemoveUnconnectedFlag", fRemoveUnconnectedFlag);
-			options->AddInt32("fFillHolesFlag", fFillHolesFlag);
-			options->AddInt32("fNormalDirectionsFlag", fNormalDirectionsFlag);
-			options->AddInt32("fNormalValuesFlag", fNormalValuesFlag);
-			options->AddInt32("fReverseAllFlag", fReverseAllFlag);
-			options->AddInt32("fIterationsValue", fIterationsValue);
-			options->AddFloat("toleranceValue", fStlObject->stats.shortest_edge);
-			options->AddFloat("incrementValue", fStlObject->stats.bounding_diameter / 10000.0);
-			STLRepairWindow *repairDialog = new STLRepairWindow(this, MSG_TOOLS_REPAIR_DO, options);
-			repairDialog->Show();
-			UpdateUIStates(false);
+			fSectionWindow = NULL;
+			EndSection();
 			break;
 		}
-		case MSG_TOOLS_REPAIR_DO:
+		case MSG_TOOLS_OVERHANG:
 		{
-			fExactFlag = message->FindInt32("fExactFlag");
-			fNearbyFlag = message->FindInt32("fNearbyFlag");
-			fRemoveUnconnectedFlag = message->FindInt32("fRemoveUnconnectedFlag");
-			fFillHolesFlag = message->FindInt32("fFillHolesFlag");
-			fNormalDirectionsFlag = message->FindInt32("fNormalDirectionsFlag");
-			fNormalValuesFlag = message->FindInt32("fNormalValuesFlag");
-			fReverseAllFlag = message->FindInt32("fReverseAllFlag");
-			fIterationsValue = message->FindInt32("fIterationsValue");
-			float toleranceValue = message->FindInt32("toleranceValue");
-			float incrementValue = message->FindInt32("incrementValue");
-			if (IsLoaded()) {
-				stl_repair(fStlObject, 0, fExactFlag, 1, toleranceValue, 1, incrementValue, fNearbyFlag,
-					fIterationsValue, fRemoveUnconnectedFlag, fFillHolesFlag, fNormalDirectionsFlag,
-					fNormalValuesFlag, fReverseAllFlag, 0);
-				fStlModified = true;
-				fStlView->Reload();
-				UpdateUI();
+			if (fOverhangMode) {
+				if (fOverhangWindow) {
+					fOverhangWindow->Lock();
+					fOverhangWindow->Quit();
+					fOverhangWindow = NULL;
+				}
+				EndOverhang();
+				break;
 			}
+
+			if (!IsLoaded())
+				break;
+
+			CloseHeatmaps();
+
+			fOverhangMode = true;
+			fOverhangWindow = new STLInputWindow(B_TRANSLATE("Overhangs"), this, MSG_TOOLS_OVERHANG_DROP, BUTTON_RESET | BUTTON_CLOSE);
+			fOverhangWindow->AddSliderField("angle", B_TRANSLATE("Angle:"), fOverhangAngle, 0, 90);
+			fOverhangWindow->AddFloatField("area", B_TRANSLATE("Area:"), 0.0);
+			fOverhangWindow->SetFieldEditable("area", false);
+			UpdateOverhang(fOverhangAngle);
+			fOverhangWindow->Show();
+			UpdateUI();
 			break;
 		}
-		case MSG_TOOLS_EDIT_TITLE:
+		case MSG_TOOLS_OVERHANG_DROP:
 		{
-			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("STL Title"), this, MSG_TOOLS_TITLE_SET);
-			input->AddTextField("title", B_TRANSLATE("Title:"), (const char*)fStlObject->stats.header);
-			input->Show();
-			UpdateUIStates(false);
+			fOverhangWindow = NULL;
+			EndOverhang();
 			break;
 		}
-		case MSG_TOOLS_TITLE_SET:
+		case MSG_TOOLS_THICKNESS:
 		{
-			const char *value = message->FindString("title");
-			if (value != NULL && IsLoaded()) {
-				snprintf(fStlObject->stats.header, 80, value);
-				fStlModified = true;
-				UpdateUI();
+			if (fThicknessMode) {
+				if (fThicknessWindow) {
+					fThicknessWindow->Lock();
+					fThicknessWindow->Quit();
+					fThicknessWindow = NULL;
+				}
+				EndThickness();
+				break;
 			}
+
+			if (!IsLoaded())
+				break;
+
+			CloseHeatmaps();
+
+			// No wall is thicker than half of the largest dimension
+			float maxLimit = std::max(std::max(fStlObject->stats.size.x, fStlObject->stats.size.y),
+				fStlObject->stats.size.z) / 2.0f;
+			fThicknessLimit = std::min(fThicknessLimit, maxLimit);
+
+			fThicknessMode = true;
+			fThicknessWindow = new STLInputWindow(B_TRANSLATE("Wall thickness"), this, MSG_TOOLS_THICKNESS_DROP, BUTTON_RESET | BUTTON_CLOSE);
+			fThicknessWindow->AddSliderField("limit", B_TRANSLATE("Limit:"), fThicknessLimit, 0, maxLimit);
+			fThicknessWindow->AddFloatField("minimum", B_TRANSLATE("Minimum:"), 0.0);
+			fThicknessWindow->SetFieldEditable("minimum", false);
+			fThicknessWindow->AddFloatField("area", B_TRANSLATE("Area:"), 0.0);
+			fThicknessWindow->SetFieldEditable("area", false);
+			StartThickness();
+			fThicknessWindow->Show();
+			UpdateUI();
 			break;
 		}
-		case MSG_TOOLS_SCALE:
+		case MSG_TOOLS_THICKNESS_DROP:
 		{
-			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("Scale"), this, MSG_TOOLS_SCALE_SET);
-			input->AddFloatField("scale", B_TRANSLATE("Scale factor:"), 1.0);
-			input->Show();
-			UpdateUIStates(false);
+			fThicknessWindow = NULL;
+			EndThickness();
 			break;
 		}
-		case MSG_TOOLS_SCALE_SET:
+		case MSG_TOOLS_THICKNESS_DONE:
 		{
-			float value = message->FindFloat("scale");
-			if (IsLoaded()) {
-				
-				stl_scale(fStlObject, value);
-				
-				fStlModified = true;
-				UpdateUI();
-				fStlView->HidePreview();
-				fStlView->Reload();
+			STLMesh *mesh = NULL;
+			STLThickness *thickness = NULL;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("thickness", (void**)&thickness);
+			fThicknessRunning = false;
+
+			// The mesh may have been edited while the rays were cast,
+			// edits work on a copy of it, so the result is simply stale
+			if (fThicknessMode && mesh == fMesh) {
+				delete fThickness;
+				fThickness = thickness;
+				fStlView->SetThickness(true, fThicknessLimit, &fThickness->Values());
+				UpdateThickness(fThicknessLimit);
+			} else {
+				delete thickness;
+				if (fThicknessMode)
+					StartThickness();
 			}
+
+			mesh->ReleaseReference();
 			break;
 		}
-		case MSG_TOOLS_SCALE_3:
-		{
-			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("Custom axis scale"), this, MSG_TOOLS_SCALE_SET_3);
-			input->AddFloatField("x", B_TRANSLATE("Scale X factor:"), 1.0);
-			input->SetFieldBackgroundColor("x", {255, 164, 164});
-			input->AddFloatField("y", B_TRANSLATE("Scale Y factor:"), 1.0);
-			input->SetFieldBackgroundColor("y", {164, 255, 164});
-			input->AddFloatField("z", B_TRANSLATE("Scale Z factor:"), 1.0);
-			input->SetFieldBackgroundColor("z", {164, 164, 255});
-			input->Show();
-			UpdateUIStates(false);
-			break;
-		}
-		case MSG_TOOLS_SCALE_SET_3:
+		case MSG_TOOLS_INTERSECTIONS:
 		{
-			float values[3];
-			values[0] = message->FindFloat("x");
-			values[1] = message->FindFloat("y");
-			values[2] = message->FindFloat("z");
-			
-			if (IsLoaded()) {
-				stl_scale_versor(fStlObject, values);
-				
-				fStlModified = true;
-				UpdateUI();
-				fStlView->HidePreview();
-				fStlView->Reload();
+			if (fIntersectionsMode) {
+				if (fIntersectionsWindow) {
+					fIntersectionsWindow->Lock();
+					fIntersectionsWindow->Quit();
+					fIntersectionsWindow = NULL;
+				}
+				EndIntersections();
+				break;
 			}
+
+			if (!IsLoaded())
+				break;
+
+			CloseHeatmaps();
+
+			fIntersectionsMode = true;
+			fIntersectionsWindow = new STLInputWindow(B_TRANSLATE("Self-intersections"), this, MSG_TOOLS_INTERSECTIONS_DROP, BUTTON_CLOSE);
+			fIntersectionsWindow->AddIntegerField("pairs", B_TRANSLATE("Pairs:"), 0);
+			fIntersectionsWindow->SetFieldEditable("pairs", false);
+			fIntersectionsWindow->AddIntegerField("facets", B_TRANSLATE("Facets:"), 0);
+			fIntersectionsWindow->SetFieldEditable("facets", false);
+			StartIntersections();
+			fIntersectionsWindow->Show();
+			UpdateUI();
 			break;
 		}
-		case MSG_TOOLS_ROTATE:
+		case MSG_TOOLS_INTERSECTIONS_DROP:
 		{
-			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("Rotate"), this, MSG_TOOLS_ROTATE_SET);
-			input->AddSliderField("x", B_TRANSLATE("X-axis:"), 0, -180, 180);
-			input->SetFieldBackgroundColor("x", {255, 164, 164});
-			input->AddSliderField("y", B_TRANSLATE("Y-axis:"), 0, -180, 180);
-			input->SetFieldBackgroundColor("y", {164, 255, 164});
-			input->AddSliderField("z", B_TRANSLATE("Z-axis:"), 0, -180, 180);
-			input->SetFieldBackgroundColor("z", {164, 164, 255});
-			input->Show();
-			UpdateUIStates(false);
+			fIntersectionsWindow = NULL;
+			EndIntersections();
 			break;
 		}
-		case MSG_TOOLS_ROTATE_SET:
+		case MSG_TOOLS_INTERSECTIONS_DONE:
 		{
-			float values[3];
-			values[0] = message->FindFloat("x");
-			values[1] = message->FindFloat("y");
-			values[2] = message->FindFloat("z");
-
-			if (IsLoaded()) {
-				stl_rotate_x(fStlObject, values[0]);
-				stl_rotate_y(fStlObject, values[1]);
-				stl_rotate_z(fStlObject, values[2]);
-				
-				fStlModified = true;
-				UpdateUI();
-				fStlView->HidePreview();
-				fStlView->Reload();
+			STLMesh *mesh = NULL;
+			STLIntersections *intersections = NULL;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("intersections", (void**)&intersections);
+			fIntersectionsRunning = false;
+
+			if (fIntersectionsMode && mesh == fMesh) {
+				delete fIntersections;
+				fIntersections = intersections;
+				fStlView->SetIntersections(true, &fIntersections->Facets());
+				if (fIntersectionsWindow != NULL) {
+					fIntersectionsWindow->SetIntegerFieldValue("pairs", fIntersections->Pairs().size());
+					fIntersectionsWindow->SetIntegerFieldValue("facets", fIntersections->Facets().size());
+				}
+			} else {
+				delete intersections;
+				if (fIntersectionsMode)
+					StartIntersections();
 			}
+
+			mesh->ReleaseReference();
 			break;
 		}
-		case MSG_TOOLS_MOVE_CENTER:
+		case MSG_TOOLS_COMPARE:
 		{
-			stl_translate(fStlObject, -fStlObject->stats.size.x / 2, -fStlObject->stats.size.y / 2, -fStlObject->stats.size.z / 2);
-			fStlModified = true;
-			fStlView->Reload();
-			UpdateUI();
-			break;
+			if (!message->HasRef("refs")) {
+				if (fCompareMode) {
+					if (fCompareWindow) {
+						fCompareWindow->Lock();
+						fCompareWindow->Quit();
+						fCompareWindow = NULL;
+					}
+					EndCompare();
+					break;
+				}
+
+				if (!IsLoaded())
+					break;
+
+				if (fOpenFilePanel == NULL) {
+					fOpenFilePanel = new BFilePanel(B_OPEN_PANEL, NULL, NULL,
+						B_FILE_NODE, true, NULL, NULL, false, true);
+					fOpenFilePanel->SetTarget(this);
+				}
+
+				BMessage *compareMsg = new BMessage(MSG_TOOLS_COMPARE);
+				fOpenFilePanel->SetMessage(compareMsg);
+				delete compareMsg;
+
+				fOpenFilePanel->Show();
+				break;
+			}
+
+			entry_ref ref;
+			BPath path;
+			if (!IsLoaded() || message->FindRef("refs", &ref) != B_OK
+				|| path.SetTo(&ref) != B_OK)
+				break;
+
+			CloseHeatmaps();
+
+			fCompareMode = true;
+			fComparePath = path.Path();
+			fCompareWindow = new STLInputWindow(B_TRANSLATE("Compare"), this, MSG_TOOLS_COMPARE_DROP, BUTTON_CLOSE);
+			fCompareWindow->AddTextField("reference", B_TRANSLATE("Reference:"), path.Leaf());
+			fCompareWindow->SetFieldEditable("reference", false);
+			fCompareWindow->AddFloatField("tolerance", B_TRANSLATE("Tolerance:"), fCompareTolerance, 0.0f);
+			fCompareWindow->AddCheckBoxField("align", B_TRANSLATE("Align bounding boxes:"), fCompareAlign);
+			fCompareWindow->AddTextField("maximum", B_TRANSLATE("Maximum:"));
+			fCompareWindow->SetFieldEditable("maximum", false);
+			fCompareWindow->AddTextField("mean", B_TRANSLATE("Mean:"));
+			fCompareWindow->SetFieldEditable("mean", false);
+			fCompareWindow->AddTextField("rms", B_TRANSLATE("RMS:"));
+			fCompareWindow->SetFieldEditable("rms", false);
+			fCompareWindow->AddTextField("hausdorff", B_TRANSLATE("Hausdorff:"));
+			fCompareWindow->SetFieldEditable("hausdorff", false);
+			fCompareWindow->AddFloatField("outside", B_TRANSLATE("Out of tolerance, %:"), 0.0);
+			fCompareWindow->SetFieldEditable("outside", false);
+			StartCompare();
+			fCompareWindow->Show();
+			UpdateUI();
+			break;
+		}
+		case MSG_TOOLS_COMPARE_DROP:
+		{
+			fCompareWindow = NULL;
+			EndCompare();
+			break;
+		}
+		case MSG_TOOLS_COMPARE_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLMesh *reference = NULL;
+			STLCompare *compare = NULL;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("reference", (void**)&reference);
+			message->FindPointer("compare", (void**)&compare);
+			BString path = message->FindString("path");
+			int32 revision = message->FindInt32("revision");
+			bool align = message->FindBool("align");
+			fCompareRunning = false;
+
+			bool current = fCompareMode && IsLoaded() && mesh == fMesh
+				&& revision == fMesh->Revision() && path == fComparePath
+				&& align == fCompareAlign;
+			if (current && reference == mesh) {
+				// The window shows the reference file unedited, there is
+				// nothing to compare against
+				reference->ReleaseReference();
+				if (fCompareWindow) {
+					fCompareWindow->Lock();
+					fCompareWindow->Quit();
+					fCompareWindow = NULL;
+				}
+				EndCompare();
+
+				BString alertText(B_TRANSLATE("'%filename%' is the model shown in this window."));
+				alertText.ReplaceFirst("%filename%", BPath(path.String()).Leaf());
+				BAlert *alert = new BAlert(B_TRANSLATE("Compare"), alertText, B_TRANSLATE("OK"),
+					NULL, NULL, B_WIDTH_AS_USUAL, B_STOP_ALERT);
+				alert->Go(NULL);
+			} else if (current && reference != NULL) {
+				delete fCompare;
+				fCompare = compare;
+				// Held on to so the next run after an edit finds the
+				// reference already parsed
+				if (fCompareReference != NULL)
+					fCompareReference->ReleaseReference();
+				fCompareReference = reference;
+				fStlView->SetDeviation(true, fCompareTolerance, &fCompare->Values());
+				UpdateCompare(fCompareTolerance);
+			} else if (current) {
+				if (fCompareWindow) {
+					fCompareWindow->Lock();
+					fCompareWindow->Quit();
+					fCompareWindow = NULL;
+				}
+				EndCompare();
+
+				BString alertText(B_TRANSLATE("Unable to open '%filename%'."));
+				alertText.ReplaceFirst("%filename%", BPath(path.String()).Leaf());
+				BAlert *alert = new BAlert(B_TRANSLATE("Compare"), alertText, B_TRANSLATE("OK"),
+					NULL, NULL, B_WIDTH_AS_USUAL, B_STOP_ALERT);
+				alert->Go(NULL);
+			} else {
+				delete compare;
+				if (reference != NULL)
+					reference->ReleaseReference();
+				if (fCompareMode)
+					StartCompare();
+			}
+
+			mesh->ReleaseReference();
+			break;
+		}
+		case MSG_TOOLS_CURVATURE:
+		{
+			int32 type = message->FindInt32("type");
+			if (fCurvatureMode && type == fCurvatureType) {
+				if (fCurvatureWindow) {
+					fCurvatureWindow->Lock();
+					fCurvatureWindow->Quit();
+					fCurvatureWindow = NULL;
+				}
+				EndCurvature();
+				break;
+			}
+
+			if (!IsLoaded())
+				break;
+
+			CloseHeatmaps();
+
+			float maxRadius = std::max(std::max(fStlObject->stats.size.x, fStlObject->stats.size.y),
+				fStlObject->stats.size.z) / 2.0f;
+			fCurvatureRadius = std::min(fCurvatureRadius, maxRadius);
+
+			fCurvatureMode = true;
+			fCurvatureType = type;
+			fCurvatureWindow = new STLInputWindow(type == CURVATURE_GAUSSIAN ? B_TRANSLATE("Gaussian curvature")
+				: B_TRANSLATE("Mean curvature"), this, MSG_TOOLS_CURVATURE_DROP, BUTTON_RESET | BUTTON_CLOSE);
+			fCurvatureWindow->AddSliderField("radius", B_TRANSLATE("Radius:"), fCurvatureRadius, 0, maxRadius);
+			fCurvatureWindow->AddIntegerField("sharp", B_TRANSLATE("Sharp vertices:"), 0);
+			fCurvatureWindow->SetFieldEditable("sharp", false);
+			fCurvatureWindow->AddFloatField("area", B_TRANSLATE("Sharp area:"), 0.0);
+			fCurvatureWindow->SetFieldEditable("area", false);
+			StartCurvature();
+			fCurvatureWindow->Show();
+			UpdateUI();
+			break;
+		}
+		case MSG_TOOLS_CURVATURE_DROP:
+		{
+			fCurvatureWindow = NULL;
+			EndCurvature();
+			break;
+		}
+		case MSG_TOOLS_CURVATURE_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLCurvature *curvature = NULL;
+			int32 revision = -1;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("curvature", (void**)&curvature);
+			message->FindInt32("revision", &revision);
+			fCurvatureRunning = false;
+
+			if (IsLoaded() && mesh == fMesh && revision == fMesh->Revision()) {
+				fMesh->SetCurvature(curvature, revision);
+				if (fCurvatureMode)
+					ShowCurvature();
+			} else {
+				delete curvature;
+				if (fCurvatureMode)
+					StartCurvature();
+			}
+
+			mesh->ReleaseReference();
+			break;
+		}
+		case MSG_VIEWMODE_STAT:
+		{
+			fShowStat = !fShowStat;
+			UpdateUI();
+			break;
+		}
+		case MSG_TOOLS_REPAIR:
+		{
+			if (fRepairWindow != NULL) {
+				fRepairWindow->Activate();
+				break;
+			}
+
+			BMessage *options = new BMessage();
+			options->AddInt32("exactFlag", fExactFlag);
+			options->AddInt32("nearbyFlag", fNearbyFlag);
+			options->AddInt32("removeUnconnectedFlag", fRemoveUnconnectedFlag);
+			options->AddInt32("fillHolesFlag", fFillHolesFlag);
+			options->AddInt32("normalDirectionsFlag", fNormalDirectionsFlag);
+			options->AddInt32("normalValuesFlag", fNormalValuesFlag);
+			options->AddInt32("reverseAllFlag", fReverseAllFlag);
+			options->AddInt32("iterationsValue", fIterationsValue);
+			options->AddFloat("toleranceValue", fStlObject->stats.shortest_edge);
+			options->AddFloat("incrementValue", fStlObject->stats.bounding_diameter / 10000.0);
+			fRepairWindow = new STLRepairWindow(this, MSG_TOOLS_REPAIR_DO, options);
+			fRepairWindow->Show();
+			UpdateUIStates(false);
+			break;
+		}
+		case MSG_TOOLS_REPAIR_DO:
+		{
+			fExactFlag = message->FindInt32("exactFlag");
+			fNearbyFlag = message->FindInt32("nearbyFlag");
+			fRemoveUnconnectedFlag = message->FindInt32("removeUnconnectedFlag");
+			fFillHolesFlag = message->FindInt32("fillHolesFlag");
+			fNormalDirectionsFlag = message->FindInt32("normalDirectionsFlag");
+			fNormalValuesFlag = message->FindInt32("normalValuesFlag");
+			fReverseAllFlag = message->FindInt32("reverseAllFlag");
+			fIterationsValue = message->FindInt32("iterationsValue");
+			StartRepair(message);
+			break;
+		}
+		case MSG_TOOLS_REPAIR_CANCEL:
+		{
+			// The dialog is gone, a running repair is stopped and its
+			// result dropped when it reports back
+			fRepairWindow = NULL;
+			if (fRepairCancel != NULL)
+				atomic_set(fRepairCancel, 1);
+			UpdateUI();
+			break;
+		}
+		case MSG_TOOLS_REPAIR_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLMesh *result = NULL;
+			int32 *cancel = NULL;
+			int32 revision = -1;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("result", (void**)&result);
+			message->FindPointer("cancel", (void**)&cancel);
+			message->FindInt32("revision", &revision);
+			fRepairRunning = false;
+			fRepairCancel = NULL;
+
+			if (fRepairWindow != NULL) {
+				if (fRepairWindow->Lock())
+					fRepairWindow->Quit();
+				fRepairWindow = NULL;
+			}
+
+			// The repaired copy replaces the mesh as a whole, unless the
+			// repair was cancelled or the mesh changed under it
+			if (result != NULL && atomic_get(cancel) == 0 && IsLoaded()
+				&& mesh == fMesh && revision == fMesh->Revision()) {
+				bool apply = true;
+				if (!fHistory->AddEdit(fStlObject, result->Stl())) {
+					BAlert *alert = new BAlert(B_TRANSLATE("Repair"),
+						B_TRANSLATE("The repair changes too much of the model to be undone. "
+						"Apply it and clear the undo history?"),
+						B_TRANSLATE("Cancel"), B_TRANSLATE("Apply"), NULL,
+						B_WIDTH_AS_USUAL, B_WARNING_ALERT);
+					alert->SetShortcut(0, B_ESCAPE);
+					apply = alert->Go() == 1;
+					if (apply)
+						fHistory->Clear();
+				}
+				if (apply) {
+					fMesh->ReleaseReference();
+					SetSTL(result);
+					fStlModified = true;
+					MeshChanged();
+				} else
+					result->ReleaseReference();
+			} else if (result != NULL) {
+				result->ReleaseReference();
+			}
+
+			delete cancel;
+			mesh->ReleaseReference();
+			UpdateUI();
+			break;
+		}
+		case MSG_EDIT_UNDO:
+		case MSG_EDIT_REDO:
+		{
+			if (!IsLoaded())
+				break;
+
+			DetachMesh();
+			bool possible = message->what == MSG_EDIT_UNDO ? fHistory->CanUndo()
+				: fHistory->CanRedo();
+			int32 type = message->what == MSG_EDIT_UNDO ? fHistory->Undo(fStlObject)
+				: fHistory->Redo(fStlObject);
+			if (type != HISTORY_NONE) {
+				fStlModified = true;
+				if (type != HISTORY_TITLE)
+					MeshChanged();
+			} else if (possible) {
+				BAlert *alert = new BAlert(B_TRANSLATE("Undo"),
+					B_TRANSLATE("The model no longer matches this step of the undo history, "
+					"it was left as it is."),
+					B_TRANSLATE("OK"), NULL, NULL, B_WIDTH_AS_USUAL, B_WARNING_ALERT);
+				alert->Go(NULL);
+			}
+			UpdateUI();
+			break;
+		}
+		case MSG_TOOLS_EDIT_TITLE:
+		{
+			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("STL Title"), this, MSG_TOOLS_TITLE_SET);
+			input->AddTextField("title", B_TRANSLATE("Title:"), (const char*)fStlObject->stats.header);
+			input->Show();
+			UpdateUIStates(false);
+			break;
+		}
+		case MSG_TOOLS_TITLE_SET:
+		{
+			const char *value = message->FindString("title");
+			if (value != NULL && IsLoaded()) {
+				DetachMesh();
+				BString before(fStlObject->stats.header);
+				snprintf(fStlObject->stats.header, 80, value);
+				fHistory->AddTitle(before.String(), fStlObject->stats.header);
+				fStlModified = true;
+				UpdateUI();
+			}
+			break;
+		}
+		case MSG_TOOLS_SCALE:
+		{
+			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("Scale"), this, MSG_TOOLS_SCALE_SET);
+			input->AddFloatField("scale", B_TRANSLATE("Scale factor:"), 1.0);
+			input->Show();
+			UpdateUIStates(false);
+			break;
+		}
+		case MSG_TOOLS_SCALE_SET:
+		{
+			float value = message->FindFloat("scale");
+			if (IsLoaded()) {
+				
+				TransformMesh(STLTransform().Scale(value));
+				
+				fStlModified = true;
+				UpdateUI();
+				fStlView->HidePreview();
+				MeshChanged();
+			}
+			break;
+		}
+		case MSG_TOOLS_SCALE_3:
+		{
+			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("Custom axis scale"), this, MSG_TOOLS_SCALE_SET_3);
+			input->AddFloatField("x", B_TRANSLATE("Scale X factor:"), 1.0);
+			input->SetFieldBackgroundColor("x", {255, 164, 164});
+			input->AddFloatField("y", B_TRANSLATE("Scale Y factor:"), 1.0);
+			input->SetFieldBackgroundColor("y", {164, 255, 164});
+			input->AddFloatField("z", B_TRANSLATE("Scale Z factor:"), 1.0);
+			input->SetFieldBackgroundColor("z", {164, 164, 255});
+			input->Show();
+			UpdateUIStates(false);
+			break;
+		}
+		case MSG_TOOLS_SCALE_SET_3:
+		{
+			float values[3];
+			values[0] = message->FindFloat("x");
+			values[1] = message->FindFloat("y");
+			values[2] = message->FindFloat("z");
+			
+			if (IsLoaded()) {
+				TransformMesh(STLTransform().Scale(values[0], values[1], values[2]));
+				
+				fStlModified = true;
+				UpdateUI();
+				fStlView->HidePreview();
+				MeshChanged();
+			}
+			break;
+		}
+		case MSG_TOOLS_ROTATE:
+		{
+			STLInputWindow *input = new STLInputWindow(B_TRANSLATE("Rotate"), this, MSG_TOOLS_ROTATE_SET);
+			input->AddSliderField("x", B_TRANSLATE("X-axis:"), 0, -180, 180);
+			input->SetFieldBackgroundColor("x", {255, 164, 164});
+			input->AddSliderField("y", B_TRANSLATE("Y-axis:"), 0, -180, 180);
+			input->SetFieldBackgroundColor("y", {164, 255, 164});
+			input->AddSliderField("z", B_TRANSLATE("Z-axis:"), 0, -180, 180);
+			input->SetFieldBackgroundColor("z", {164, 164, 255});
+			input->Show();
+			UpdateUIStates(false);
+			break;
+		}
+		case MSG_TOOLS_ROTATE_SET:
+		{
+			float values[3];
+			values[0] = message->FindFloat("x");
+			values[1] = message->FindFloat("y");
+			values[2] = message->FindFloat("z");
+
+			if (IsLoaded()) {
+				TransformMesh(STLTransform().RotateX(values[0]).RotateY(values[1]).RotateZ(values[2]));
+				
+				fStlModified = true;
+				UpdateUI();
+				fStlView->HidePreview();
+				MeshChanged();
+			}
+			break;
+		}
+		case MSG_TOOLS_ORIENT_HEIGHT:
+		{
+			StartOrient(ORIENT_HEIGHT);
+			break;
+		}
+		case MSG_TOOLS_ORIENT_SUPPORT:
+		{
+			StartOrient(ORIENT_SUPPORT);
+			break;
+		}
+		case MSG_TOOLS_ORIENT_DONE:
+		{
+			STLMesh *mesh = NULL;
+			STLAutoOrient *orient = NULL;
+			int32 revision = -1;
+			message->FindPointer("mesh", (void**)&mesh);
+			message->FindPointer("orient", (void**)&orient);
+			message->FindInt32("revision", &revision);
+			fOrientRunning = false;
+
+			// An edit made meanwhile wins, the search was for the old shape
+			if (IsLoaded() && mesh == fMesh && revision == fMesh->Revision()) {
+				TransformMesh(STLTransform(glm::mat4(orient->Rotation())));
+				TransformMesh(STLTransform::MoveTo(fStlObject, -fStlObject->stats.size.x / 2,
+					-fStlObject->stats.size.y / 2, 0), true);
+
+				fStlModified = true;
+				MeshChanged();
+			}
+
+			delete orient;
+			mesh->ReleaseReference();
+			UpdateUI();
+			break;
+		}
+		case MSG_TOOLS_MOVE_CENTER:
+		{
+			TransformMesh(STLTransform::MoveTo(fStlObject, -fStlObject->stats.size.x / 2, -fStlObject->stats.size.y / 2,
+				-fStlObject->stats.size.z / 2));
+			fStlModified = true;
+			MeshChanged();
+			UpdateUI();
+			break;
 		}
 		case MSG_TOOLS_MOVE_MIDDLE:
 		{
-			stl_translate(fStlObject, -fStlObject->stats.size.x / 2, -fStlObject->stats.size.y / 2, 0);
+			TransformMesh(STLTransform::MoveTo(fStlObject, -fStlObject->stats.size.x / 2, -fStlObject->stats.size.y / 2, 0));
 			fStlModified = true;
-			fStlView->Reload();
+			MeshChanged();
 			UpdateUI();
 			break;
 		}
 		case MSG_TOOLS_MOVE_ZERO:
 		{
-			stl_translate(fStlObject, 0, 0, 0);
+			TransformMesh(STLTransform::MoveTo(fStlObject, 0, 0, 0));
 			fStlModified = true;
-			fStlView->Reload();
+			MeshChanged();
 			UpdateUI();
 			break;
 		}
@@ -1068,11 +2015,11 @@ STLWindow::MessageReceived(BMessage *message)
 			values[1] = message->FindFloat("y");
 			values[2] = message->FindFloat("z");
 			if (IsLoaded()) {
-				stl_translate(fStlObject, values[0], values[1], values[2]);
+				TransformMesh(STLTransform::MoveTo(fStlObject, values[0], values[1], values[2]));
 				fStlModified = true;
 				UpdateUI();
 				fStlView->HidePreview();
-				fStlView->Reload();
+				MeshChanged();
 			}
 			break;
 		}
@@ -1096,35 +2043,35 @@ STLWindow::MessageReceived(BMessage *message)
 			values[1] = message->FindFloat("y");
 			values[2] = message->FindFloat("z");
 			if (IsLoaded()) {
-				stl_translate_relative(fStlObject, values[0], values[1], values[2]);
+				TransformMesh(STLTransform().Translate(values[0], values[1], values[2]));
 				fStlModified = true;
 				UpdateUI();
 				fStlView->HidePreview();
-				fStlView->Reload();
+				MeshChanged();
 			}
 			break;
 		}
 		case MSG_TOOLS_MIRROR_XY:
 		{
-			stl_mirror_xy(fStlObject);
+			TransformMesh(STLTransform().MirrorXY());
 			fStlModified = true;
-			fStlView->Reload();
+			MeshChanged();
 			UpdateUI();
 			break;
 		}
 		case MSG_TOOLS_MIRROR_YZ:
 		{
-			stl_mirror_yz(fStlObject);
+			TransformMesh(STLTransform().MirrorYZ());
 			fStlModified = true;
-			fStlView->Reload();
+			MeshChanged();
 			UpdateUI();
 			break;
 		}
 		case MSG_TOOLS_MIRROR_XZ:
 		{
-			stl_mirror_xz(fStlObject);
+			TransformMesh(STLTransform().MirrorXZ());
 			fStlModified = true;
-			fStlView->Reload();
+			MeshChanged();
 			UpdateUI();
 			break;
 		}
@@ -1202,6 +2149,62 @@ STLWindow::MessageReceived(BMessage *message)
 					fStlView->ShowPreview(glm::value_ptr(matrix));
 					break;
 				}
+				case MSG_TOOLS_OVERHANG_DROP:
+				{
+					float angle = message->FindFloat("angle");
+					if (fOverhangMode && angle != fOverhangAngle)
+						UpdateOverhang(angle);
+					break;
+				}
+				case MSG_TOOLS_THICKNESS_DROP:
+				{
+					float limit = message->FindFloat("limit");
+					if (fThicknessMode && limit != fThicknessLimit)
+						UpdateThickness(limit);
+					break;
+				}
+				case MSG_VIEWMODE_CREASE_DROP:
+				{
+					float angle = message->FindFloat("angle");
+					if (angle != fCreaseAngle) {
+						fCreaseAngle = angle;
+						fSmoothValid = false;
+						StartSmoothNormals();
+					}
+					break;
+				}
+				case MSG_TOOLS_CURVATURE_DROP:
+				{
+					float radius = message->FindFloat("radius");
+					if (fCurvatureMode && radius != fCurvatureRadius)
+						UpdateCurvature(radius);
+					break;
+				}
+				case MSG_TOOLS_COMPARE_DROP:
+				{
+					float tolerance = message->FindFloat("tolerance");
+					if (fCompareMode && tolerance >= 0.0f && tolerance != fCompareTolerance)
+						UpdateCompare(tolerance);
+					bool align = message->FindBool("align");
+					if (fCompareMode && align != fCompareAlign) {
+						fCompareAlign = align;
+						delete fCompare;
+						fCompare = NULL;
+						std::vector<float> none;
+						fStlView->SetDeviation(true, fCompareTolerance, &none);
+						StartCompare();
+					}
+					break;
+				}
+				case MSG_TOOLS_SECTION_DROP:
+				{
+					// Setting the result fields echoes an update back,
+					// only a moved plane is cut again
+					float height = message->FindFloat("height");
+					if (fSectionMode && height != fSection->Height())
+						UpdateSection(height);
+					break;
+				}
 				case MSG_TOOLS_MEASURE_DROP:
 				{
 					int32 extended = message->FindInt32("extended");
@@ -1225,12 +2228,28 @@ STLWindow::MessageReceived(BMessage *message)
 		case MSG_VIEWMODE_POINTS:
 		case MSG_VIEWMODE_WIREFRAME:
 		case MSG_VIEWMODE_SOLID:
+		case MSG_VIEWMODE_SOLID_EDGES:
 		{
 			fShowMode = message->what;
 			fStlView->SetViewMode(fShowMode);
 			UpdateUI();
 			break;
 		}
+		case MSG_BENCHMARK:
+		{
+			if (fBenchmarkRunning || IsLoading())
+				break;
+
+			fBenchmarkRunning = true;
+			atomic_set(&fBenchmarkAbort, 0);
+			thread_id benchmarkThread = spawn_thread(_BenchmarkFunction, "benchmarkThread", B_NORMAL_PRIORITY, (void*)this);
+			if (benchmarkThread < B_OK) {
+				fBenchmarkRunning = false;
+				break;
+			}
+			resume_thread(benchmarkThread);
+			break;
+		}
 		case MSG_EASTER_EGG:
 		{
 			app_info info;
@@ -1267,10 +2286,13 @@ STLWindow::MessageReceived(BMessage *message)
 			_menuItemWireframe->SetMarked(fShowMode == MSG_VIEWMODE_WIREFRAME);
 			BMenuItem *_menuItemSolid = new BMenuItem(B_TRANSLATE("Solid"), new BMessage(MSG_VIEWMODE_SOLID));
 			_menuItemSolid->SetMarked(fShowMode == MSG_VIEWMODE_SOLID);
+			BMenuItem *_menuItemSolidEdges = new BMenuItem(B_TRANSLATE("Solid with edges"), new BMessage(MSG_VIEWMODE_SOLID_EDGES));
+			_menuItemSolidEdges->SetMarked(fShowMode == MSG_VIEWMODE_SOLID_EDGES);
 
 			menu->AddItem(_menuItemPoints);
 			menu->AddItem(_menuItemWireframe);
 			menu->AddItem(_menuItemSolid);
+			menu->AddItem(_menuItemSolidEdges);
 			menu->AddSeparatorItem();
 
 			BMenuItem *_menuItemShowAxes = new BMenuItem(B_TRANSLATE("Axes"), new BMessage(MSG_VIEWMODE_AXES));
@@ -1327,14 +2349,26 @@ STLWindow::UpdateUIStates(bool show)
 
 	fMenuItemClose->SetEnabled(show);
 	fMenuView->SetEnabled(show);
-	fMenuTools->SetEnabled(show);
+	fMenuTools->SetEnabled(show && !fRepairRunning);
 	fMenuToolsMirror->SetEnabled(show);
 	fMenuToolsScale->SetEnabled(show);
 	fMenuToolsMove->SetEnabled(show);
 	fMenuFileSaveAs->SetEnabled(show);
+	fMenuItemScreenshot->SetEnabled(show && !fScreenshotRunning);
 	fMenuItemReload->SetEnabled(show);
+	fMenuItemAppend->SetEnabled(show);
 	fMenuItemSave->SetEnabled(show && fStlModified);
+	fMenuEdit->SetEnabled(show && !fRepairRunning);
+	fMenuItemUndo->SetEnabled(show && fHistory->CanUndo());
+	fMenuItemRedo->SetEnabled(show && fHistory->CanRedo());
 	fMenuItemShowBox->SetMarked(fShowBoundingBox);
+	fMenuItemShowDefects->SetMarked(fShowDefects);
+	fMenuItemShowHull->SetMarked(fShowHull);
+	fMenuItemShowMinimumBox->SetMarked(fShowMinimumBox);
+	fMenuItemSmoothShading->SetMarked(fSmoothShading);
+	fMenuItemCreaseAngle->SetEnabled(fSmoothShading);
+	fMenuToolsOrient->SetEnabled(show && !fOrientRunning && fMesh != NULL && fMesh->Hull() != NULL);
+	fMenuItemNextDefect->SetEnabled(show && fEdges != NULL && !fEdges->Defects().empty());
 	fMenuItemShowAxes->SetMarked(fShowAxes);
 	fMenuItemShowAxesPlane->SetMarked(fShowAxesPlane);
 	fMenuItemShowAxesCompass->SetMarked(fShowAxesCompass);
@@ -1344,24 +2378,32 @@ STLWindow::UpdateUIStates(bool show)
 	fMenuItemPoints->SetMarked(fShowMode == MSG_VIEWMODE_POINTS);
 	fMenuItemWireframe->SetMarked(fShowMode == MSG_VIEWMODE_WIREFRAME);
 	fMenuItemSolid->SetMarked(fShowMode == MSG_VIEWMODE_SOLID);
+	fMenuItemSolidEdges->SetMarked(fShowMode == MSG_VIEWMODE_SOLID_EDGES);
 	fMenuItemOrthographicView->SetMarked(fViewOrtho);
 	fMenuItemStat->SetEnabled(show);
 	fMenuItemStat->SetMarked(fShowStat);
+	fMenuItemSection->SetMarked(fSectionMode);
+	fMenuItemOverhang->SetMarked(fOverhangMode);
+	fMenuItemThickness->SetMarked(fThicknessMode);
+	fMenuItemIntersections->SetMarked(fIntersectionsMode);
+	fMenuItemCompare->SetMarked(fCompareMode);
+	fMenuToolsCurvature->ItemAt(CURVATURE_MEAN)->SetMarked(fCurvatureMode && fCurvatureType == CURVATURE_MEAN);
+	fMenuToolsCurvature->ItemAt(CURVATURE_GAUSSIAN)->SetMarked(fCurvatureMode && fCurvatureType == CURVATURE_GAUSSIAN);
 
 	fToolBar->SetActionEnabled(MSG_FILE_SAVE, show && fStlModified);
 	fToolBar->SetActionEnabled(MSG_VIEWMODE_STAT, show);
 	fToolBar->SetActionPressed(MSG_VIEWMODE_STAT, fShowStat);
-	fToolBar->SetActionEnabled(MSG_TOOLS_EDIT_TITLE, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_MIRROR_XY, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_MIRROR_YZ, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_MIRROR_XZ, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_REPAIR, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_SCALE, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_SCALE_3, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_ROTATE, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_MOVE_TO, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_MOVE_BY, show);
-	fToolBar->SetActionEnabled(MSG_TOOLS_MOVE_MIDDLE, show);
+	fToolBar->SetActionEnabled(MSG_TOOLS_EDIT_TITLE, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_MIRROR_XY, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_MIRROR_YZ, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_MIRROR_XZ, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_REPAIR, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_SCALE, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_SCALE_3, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_ROTATE, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_MOVE_TO, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_MOVE_BY, show && !fRepairRunning);
+	fToolBar->SetActionEnabled(MSG_TOOLS_MOVE_MIDDLE, show && !fRepairRunning);
 	fToolBar->SetActionPressed(MSG_TOOLS_MEASURE, fMeasureMode);
 	fToolBar->SetActionEnabled(MSG_TOOLS_MEASURE, show);
 
@@ -1392,38 +2434,855 @@ STLWindow::UpdateUIStates(bool show)
 }
 
 void
-STLWindow::SetSTL(stl_file *stl)
+STLWindow::SetSTL(STLMesh *mesh)
 {
-	fStlObject = stl;
-	fStlView->SetSTL(stl);
+	fMesh = mesh;
+	fStlObject = mesh != NULL ? mesh->Stl() : NULL;
 }
 
 void
-STLWindow::OpenFile(const char *filename)
-{	
-	CloseFile();
-
-	fOpenedFileName.SetTo(filename);
-	fStlLogoView->SetText(B_TRANSLATE("Loading" B_UTF8_ELLIPSIS));
+STLWindow::DetachMesh(void)
+{
+	if (fMesh == NULL || fMesh->MakePrivate())
+		return;
+
+	STLMesh *mesh = fMesh->Copy();
+	if (mesh == NULL)
+		return;
+
+	fMesh->ReleaseReference();
+	SetSTL(mesh);
+	fStlView->ReplaceSTL(fStlObject, fMesh->Parts());
+	fSnapValid = false;
+	StartSnapIndex();
+}
 
-	fStlLoading = true;
-	fFileLoaderThread = spawn_thread(_FileLoaderFunction, "loaderThread", B_NORMAL_PRIORITY, (void*)this);
-	resume_thread(fFileLoaderThread);
+void
+STLWindow::TransformMesh(const STLTransform &transform, bool join)
+{
+	DetachMesh();
+
+	// A flattening matrix has no inverse, the facets are kept instead
+	float determinant = glm::determinant(glm::mat3(transform.Matrix()));
+	if (fabs(determinant) < 1.0e-18) {
+		bool kept = fHistory->BeginEdit(fStlObject);
+		transform.Apply(fStlObject);
+		if (!kept || !fHistory->EndEdit(fStlObject)) {
+			fHistory->Clear();
+			BAlert *alert = new BAlert(B_TRANSLATE("Undo"),
+				B_TRANSLATE("The change is too large to be undone, the undo history was cleared."),
+				B_TRANSLATE("OK"), NULL, NULL, B_WIDTH_AS_USUAL, B_WARNING_ALERT);
+			alert->Go(NULL);
+		}
+	} else {
+		transform.Apply(fStlObject);
+		fHistory->AddTransform(transform.Matrix(), join);
+	}
 }
 
 void
-STLWindow::CloseFile(void)
+STLWindow::MeshChanged(void)
 {
-	if (IsLoaded()) {
-		fStlLogoView->Show();
-		fStlView->Hide();
+	// Edits move or reshape the components, so copies are matched again.
+	// The view lets go of the old parts before they are dropped.
+	fStlView->ReplaceSTL(fStlObject, NULL);
+	fMesh->Changed();
+	fSmoothValid = false;
+	fStlView->SetSmoothNormals(NULL);
+	fSnapValid = false;
+	fStlView->SetSnapIndex(NULL);
+	fStlView->Reload();
+
+	if (fSection != NULL) {
+		float height = fSection->Height();
+		delete fSection;
+		fSection = NULL;
+		UpdateSection(height);
+	}
 
-		SetTitle(MAIN_WIN_TITLE);
-		fStlValid = false;
+	if (fOverhang != NULL) {
+		delete fOverhang;
+		fOverhang = NULL;
+		UpdateOverhang(fOverhangAngle);
+	}
+
+	if (fThicknessMode) {
+		delete fThickness;
+		fThickness = NULL;
+		std::vector<float> none;
+		fStlView->SetThickness(true, fThicknessLimit, &none);
+		StartThickness();
+	}
+
+	if (fIntersectionsMode) {
+		delete fIntersections;
+		fIntersections = NULL;
+		fStlView->SetIntersections(true);
+		StartIntersections();
+	}
+
+	if (fCompareMode) {
+		delete fCompare;
+		fCompare = NULL;
+		std::vector<float> none;
+		fStlView->SetDeviation(true, fCompareTolerance, &none);
+		StartCompare();
+	}
+
+	if (fCurvatureMode) {
+		std::vector<float> none;
+		fStlView->SetCurvature(true, 1.0f, &none);
+		StartCurvature();
+	}
+
+	delete fEdges;
+	fEdges = NULL;
+	fDefectIndex = -1;
+	fStlView->SetDefects(NULL);
+	StartEdges();
+
+	fStlView->SetHull(NULL);
+	StartHull();
+	StartParts();
+
+	StartSmoothNormals();
+	StartSnapIndex();
+}
+
+void
+STLWindow::UpdateSection(float height)
+{
+	// The slab index is built once per mesh, moving the plane only cuts
+	if (fSection == NULL)
+		fSection = new STLSection(fStlObject);
+
+	fSection->Cut(height);
+	fStlView->SetSection(true, height);
+	fStlView->SetSectionContours(fSection);
+
+	if (fSectionWindow != NULL) {
+		fSectionWindow->SetFloatFieldValue("area", fSection->Area());
+		fSectionWindow->SetIntegerFieldValue("contours", fSection->Contours().size());
+	}
+}
+
+void
+STLWindow::UpdateOverhang(float angle)
+{
+	// Facet values are computed once per mesh and handed to the view,
+	// the angle only changes the shader limit and the area sum
+	fOverhangAngle = angle;
+	if (fOverhang == NULL) {
+		fOverhang = new STLOverhang(fStlObject);
+		fStlView->SetOverhang(true, angle, &fOverhang->Values());
+	} else
+		fStlView->SetOverhang(true, angle);
+
+	if (fOverhangWindow != NULL)
+		fOverhangWindow->SetFloatFieldValue("area", fOverhang->Area(angle));
+}
+
+void
+STLWindow::EndOverhang(void)
+{
+	fOverhangMode = false;
+	delete fOverhang;
+	fOverhang = NULL;
+	fStlView->SetOverhang(false, fOverhangAngle);
+	UpdateUI();
+}
+
+void
+STLWindow::CloseHeatmaps(void)
+{
+	// All heatmaps color the same facets, only one is shown at a time
+	if (fOverhangMode) {
+		if (fOverhangWindow) {
+			fOverhangWindow->Lock();
+			fOverhangWindow->Quit();
+			fOverhangWindow = NULL;
+		}
+		EndOverhang();
+	}
+
+	if (fThicknessMode) {
+		if (fThicknessWindow) {
+			fThicknessWindow->Lock();
+			fThicknessWindow->Quit();
+			fThicknessWindow = NULL;
+		}
+		EndThickness();
+	}
+
+	if (fIntersectionsMode) {
+		if (fIntersectionsWindow) {
+			fIntersectionsWindow->Lock();
+			fIntersectionsWindow->Quit();
+			fIntersectionsWindow = NULL;
+		}
+		EndIntersections();
+	}
+
+	if (fCompareMode) {
+		if (fCompareWindow) {
+			fCompareWindow->Lock();
+			fCompareWindow->Quit();
+			fCompareWindow = NULL;
+		}
+		EndCompare();
+	}
+
+	if (fCurvatureMode) {
+		if (fCurvatureWindow) {
+			fCurvatureWindow->Lock();
+			fCurvatureWindow->Quit();
+			fCurvatureWindow = NULL;
+		}
+		EndCurvature();
+	}
+}
+
+void
+STLWindow::StartThickness(void)
+{
+	// A running job is restarted by its result handler, which sees the
+	// mesh it measured is no longer the current one
+	if (fThicknessRunning)
+		return;
+
+	// The job keeps its own reference, so edits made meanwhile detach
+	// the window onto a copy instead of changing the mesh under it
+	fMesh->AcquireReference();
+	fThicknessRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+
+	thread_id thread = spawn_thread(_ThicknessFunction, "thicknessThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fThicknessRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::UpdateThickness(float limit)
+{
+	fThicknessLimit = limit;
+	if (fThickness == NULL)
+		return;
+
+	fStlView->SetThickness(true, limit);
+
+	if (fThicknessWindow != NULL) {
+		fThicknessWindow->SetFloatFieldValue("minimum", std::max(fThickness->Minimum(), 0.0f));
+		fThicknessWindow->SetFloatFieldValue("area", fThickness->Area(limit));
+	}
+}
+
+void
+STLWindow::EndThickness(void)
+{
+	fThicknessMode = false;
+	delete fThickness;
+	fThickness = NULL;
+	fStlView->SetThickness(false, fThicknessLimit);
+	UpdateUI();
+}
+
+void
+STLWindow::StartIntersections(void)
+{
+	// Same as for the thickness, the job holds the mesh it searches
+	if (fIntersectionsRunning)
+		return;
+
+	fMesh->AcquireReference();
+	fIntersectionsRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+
+	thread_id thread = spawn_thread(_IntersectionsFunction, "intersectionsThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fIntersectionsRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::EndIntersections(void)
+{
+	fIntersectionsMode = false;
+	delete fIntersections;
+	fIntersections = NULL;
+	fStlView->SetIntersections(false);
+	UpdateUI();
+}
+
+void
+STLWindow::StartCompare(void)
+{
+	if (fCompareRunning)
+		return;
+
+	fMesh->AcquireReference();
+	fCompareRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+	request->AddInt32("revision", fMesh->Revision());
+	request->AddString("path", fComparePath);
+	request->AddBool("align", fCompareAlign);
+
+	thread_id thread = spawn_thread(_CompareFunction, "compareThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fCompareRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::UpdateCompare(float tolerance)
+{
+	fCompareTolerance = tolerance;
+	if (fCompare == NULL)
+		return;
+
+	fStlView->SetDeviation(true, tolerance);
+
+	// Deviations are often far below the two decimals of a float field
+	if (fCompareWindow != NULL) {
+		BString text;
+		text.SetToFormat("%g", fCompare->Maximum());
+		fCompareWindow->SetTextFieldValue("maximum", text);
+		text.SetToFormat("%g", fCompare->Mean());
+		fCompareWindow->SetTextFieldValue("mean", text);
+		text.SetToFormat("%g", fCompare->RMS());
+		fCompareWindow->SetTextFieldValue("rms", text);
+		text.SetToFormat("%g", fCompare->Hausdorff());
+		fCompareWindow->SetTextFieldValue("hausdorff", text);
+		fCompareWindow->SetFloatFieldValue("outside", fCompare->Outside(tolerance));
+	}
+}
+
+void
+STLWindow::EndCompare(void)
+{
+	fCompareMode = false;
+	delete fCompare;
+	fCompare = NULL;
+	if (fCompareReference != NULL)
+		fCompareReference->ReleaseReference();
+	fCompareReference = NULL;
+	fStlView->SetDeviation(false, fCompareTolerance);
+	UpdateUI();
+}
+
+void
+STLWindow::StartEdges(void)
+{
+	// Runs after every load and edit, the result feeds the defect overlay
+	// and the navigation whether the overlay is shown or not
+	if (fEdgesRunning)
+		return;
+
+	fMesh->AcquireReference();
+	fEdgesRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+
+	thread_id thread = spawn_thread(_EdgesFunction, "edgesThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fEdgesRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::StartHull(void)
+{
+	// Windows showing the same file share one hull, it is built again
+	// only after an edit
+	if (fMesh->Hull() != NULL) {
+		fStlView->SetHull(fMesh->Hull());
+		return;
+	}
+
+	if (fHullRunning)
+		return;
+
+	fMesh->AcquireReference();
+	fHullRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+	request->AddInt32("revision", fMesh->Revision());
+
+	thread_id thread = spawn_thread(_HullFunction, "hullThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fHullRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::StartParts(void)
+{
+	// Copies are matched again after an edit, the view draws the mesh
+	// without instancing until then
+	if (fMesh->Parts() != NULL || fPartsRunning)
+		return;
+
+	fMesh->AcquireReference();
+	fPartsRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+	request->AddInt32("revision", fMesh->Revision());
+
+	thread_id thread = spawn_thread(_PartsFunction, "partsThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fPartsRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::StartSmoothNormals(void)
+{
+	// One job at a time, a finished one starts the next if the model
+	// or the crease angle changed meanwhile
+	if (!fSmoothShading || fSmoothValid || fSmoothRunning || !IsLoaded())
+		return;
+
+	fMesh->AcquireReference();
+	fSmoothRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+	request->AddInt32("revision", fMesh->Revision());
+	request->AddFloat("angle", fCreaseAngle);
+
+	thread_id thread = spawn_thread(_SmoothNormalsFunction, "smoothNormalsThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fSmoothRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::StartSnapIndex(void)
+{
+	// Built while the measure tool is open and kept until the model
+	// changes or an object is appended, the view snaps to nothing until
+	// it is there. The appended objects are only held while it is built.
+	if (!fMeasureMode || fSnapValid || fSnapRunning || !IsLoaded())
+		return;
+
+	fMesh->AcquireReference();
+	fSnapRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+	request->AddInt32("revision", fMesh->Revision());
+	request->AddInt32("objects", fAppendedObjects.size());
+	for (size_t i = 0; i < fAppendedObjects.size(); i++) {
+		fAppendedObjects[i].mesh->AcquireReference();
+		request->AddPointer("object", fAppendedObjects[i].mesh);
+		request->AddData("offset", B_RAW_TYPE, &fAppendedObjects[i].offset, sizeof(glm::vec3));
+	}
+
+	thread_id thread = spawn_thread(_SnapIndexFunction, "snapIndexThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fSnapRunning = false;
+		for (size_t i = 0; i < fAppendedObjects.size(); i++)
+			fAppendedObjects[i].mesh->ReleaseReference();
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::StartCurvature(void)
+{
+	// Kept on the mesh like the hull, switching between the mean and
+	// the Gaussian map or reopening it costs nothing until an edit
+	if (fMesh->Curvature() != NULL) {
+		ShowCurvature();
+		return;
+	}
+
+	if (fCurvatureRunning)
+		return;
+
+	fMesh->AcquireReference();
+	fCurvatureRunning = true;
+
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+	request->AddInt32("revision", fMesh->Revision());
+
+	thread_id thread = spawn_thread(_CurvatureFunction, "curvatureThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete request;
+		fCurvatureRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+}
+
+void
+STLWindow::ShowCurvature(void)
+{
+	std::vector<float> values;
+	fMesh->Curvature()->CornerValues(fCurvatureType, values);
+	fStlView->SetCurvature(true, 1.0f, &values);
+	UpdateCurvature(fCurvatureRadius);
+}
+
+void
+STLWindow::UpdateCurvature(float radius)
+{
+	fCurvatureRadius = radius;
+	STLCurvature *curvature = fMesh->Curvature();
+	if (curvature == NULL)
+		return;
+
+	// The colors saturate at the curvature of a sphere of that radius
+	radius = std::max(radius, 1.0e-3f);
+	float limit = fCurvatureType == CURVATURE_GAUSSIAN ? 1.0f / (radius * radius) : 1.0f / radius;
+	fStlView->SetCurvature(true, limit);
+
+	if (fCurvatureWindow != NULL) {
+		float area = 0.0f;
+		fCurvatureWindow->SetIntegerFieldValue("sharp", curvature->CountSharp(radius, &area));
+		fCurvatureWindow->SetFloatFieldValue("area", area);
+	}
+}
+
+void
+STLWindow::EndCurvature(void)
+{
+	fCurvatureMode = false;
+	fStlView->SetCurvature(false, 1.0f);
+	UpdateUI();
+}
+
+void
+STLWindow::StartOrient(int32 goal)
+{
+	if (!IsLoaded() || fOrientRunning || fMesh->Hull() == NULL)
+		return;
+
+	fMesh->AcquireReference();
+	fOrientRunning = true;
+
+	// The thread gets its own hull, the shared one goes away with the
+	// next edit of the mesh
+	BMessage *request = new BMessage();
+	request->AddMessenger("target", BMessenger(this));
+	request->AddPointer("mesh", fMesh);
+	request->AddPointer("hull", new STLHull(*fMesh->Hull()));
+	request->AddInt32("revision", fMesh->Revision());
+	request->AddInt32("goal", goal);
+	request->AddFloat("angle", fOverhangAngle);
+
+	thread_id thread = spawn_thread(_OrientFunction, "orientThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		STLHull *hull = NULL;
+		request->FindPointer("hull", (void**)&hull);
+		delete hull;
+		delete request;
+		fOrientRunning = false;
+		fMesh->ReleaseReference();
+		return;
+	}
+	resume_thread(thread);
+	UpdateUIStates(true);
+}
+
+void
+STLWindow::StartRepair(BMessage *options)
+{
+	if (!IsLoaded() || fRepairRunning) {
+		if (fRepairWindow != NULL && fRepairWindow->Lock()) {
+			fRepairWindow->Quit();
+			fRepairWindow = NULL;
+		}
+		UpdateUI();
+		return;
+	}
+
+	fMesh->AcquireReference();
+	fRepairRunning = true;
+	fRepairCancel = new int32(0);
+
+	// Progress goes straight to the dialog, the cancel flag is shared
+	// with the thread and freed with the result message
+	BMessage *request = new BMessage(*options);
+	request->AddMessenger("target", BMessenger(this));
+	request->AddMessenger("progress", BMessenger(fRepairWindow));
+	request->AddPointer("mesh", fMesh);
+	request->AddPointer("cancel", fRepairCancel);
+	request->AddInt32("revision", fMesh->Revision());
+
+	thread_id thread = spawn_thread(_RepairFunction, "repairThread", B_LOW_PRIORITY, (void*)request);
+	if (thread < B_OK) {
+		delete fRepairCancel;
+		fRepairCancel = NULL;
+		delete request;
+		fRepairRunning = false;
+		fMesh->ReleaseReference();
+		if (fRepairWindow != NULL && fRepairWindow->Lock()) {
+			fRepairWindow->Quit();
+			fRepairWindow = NULL;
+		}
+		UpdateUI();
+		return;
+	}
+	resume_thread(thread);
+	UpdateUI();
+}
+
+void
+STLWindow::NextDefect(void)
+{
+	if (fEdges == NULL || fEdges->Defects().empty())
+		return;
+
+	const std::vector<STLEdges::Defect> &defects = fEdges->Defects();
+	fDefectIndex = (fDefectIndex + 1) % defects.size();
+	fStlView->FocusOn(defects[fDefectIndex].low, defects[fDefectIndex].high);
+
+	if (!fShowDefects) {
+		fShowDefects = true;
+		fStlView->ShowDefects(true);
+	}
+}
+
+void
+STLWindow::EndSection(void)
+{
+	fSectionMode = false;
+	delete fSection;
+	fSection = NULL;
+	fStlView->SetSection(false, 0.0f);
+	UpdateUI();
+}
+
+void
+STLWindow::AppendFile(const char *file)
+{
+	BMessage *request = new BMessage(MSG_FILE_APPEND);
+	request->AddPointer("window", this);
+	request->AddString("path", file);
+
+	thread_id appendThread = spawn_thread(_AppendLoaderFunction, "appendThread", B_NORMAL_PRIORITY, (void*)request);
+	if (appendThread < B_OK) {
+		delete request;
+		return;
+	}
+	resume_thread(appendThread);
+}
+
+void
+STLWindow::AddObject(STLMesh *mesh)
+{
+	// Line the new part up along +X next to everything already placed,
+	// resting on the same floor as the first model
+	stl_stats &stats = mesh->Stl()->stats;
+	float sceneMinX, sceneMinY, sceneMinZ, sceneMaxX, sceneMaxY, sceneMaxZ;
+	SceneBounds(&sceneMinX, &sceneMinY, &sceneMinZ, &sceneMaxX, &sceneMaxY, &sceneMaxZ);
+
+	float gap = std::max(sceneMaxX - sceneMinX, stats.size.x) * 0.1f;
+
+	AppendedObject object;
+	object.mesh = mesh;
+	object.offset = glm::vec3(sceneMaxX + gap - stats.min.x, 0.0f,
+		fStlObject->stats.min.z - stats.min.z);
+	fAppendedObjects.push_back(object);
+
+	fStlView->AddObject(mesh->Stl(), glm::translate(glm::mat4(1.0f), object.offset), mesh->Parts());
+
+	// The index in the view still snaps to the objects it has
+	fSnapValid = false;
+	StartSnapIndex();
+
+	// The camera still orbits the origin, so fit the larger half of the
+	// scene on every axis
+	SceneBounds(&sceneMinX, &sceneMinY, &sceneMinZ, &sceneMaxX, &sceneMaxY, &sceneMaxZ);
+	ViewExtent(2.0f * std::max(-sceneMinX, sceneMaxX), 2.0f * std::max(-sceneMinY, sceneMaxY),
+		2.0f * std::max(-sceneMinZ, sceneMaxZ), &fZDepth, &fMaxExtent);
+	fStlView->SetExtent(fZDepth, fMaxExtent);
+}
+
+void
+STLWindow::SceneBounds(float *minX, float *minY, float *minZ, float *maxX, float *maxY, float *maxZ)
+{
+	stl_stats &stats = fStlObject->stats;
+	*minX = stats.min.x;
+	*minY = stats.min.y;
+	*minZ = stats.min.z;
+	*maxX = stats.max.x;
+	*maxY = stats.max.y;
+	*maxZ = stats.max.z;
+
+	for (size_t i = 0; i < fAppendedObjects.size(); i++) {
+		stl_stats &objectStats = fAppendedObjects[i].mesh->Stl()->stats;
+		glm::vec3 offset = fAppendedObjects[i].offset;
+		*minX = std::min(*minX, objectStats.min.x + offset.x);
+		*minY = std::min(*minY, objectStats.min.y + offset.y);
+		*minZ = std::min(*minZ, objectStats.min.z + offset.z);
+		*maxX = std::max(*maxX, objectStats.max.x + offset.x);
+		*maxY = std::max(*maxY, objectStats.max.y + offset.y);
+		*maxZ = std::max(*maxZ, objectStats.max.z + offset.z);
+	}
+}
+
+stl_file*
+STLWindow::SceneSTL(bool copy)
+{
+	if (fAppendedObjects.empty() && !copy)
+		return fStlObject;
+
+	// Appended objects are written out together with the model, each
+	// one moved to where it is shown
+	int32 facets = fStlObject->stats.number_of_facets;
+	for (size_t i = 0; i < fAppendedObjects.size(); i++)
+		facets += fAppendedObjects[i].mesh->Stl()->stats.number_of_facets;
+
+	stl_file *stl = new stl_file;
+	stl_initialize(stl);
+	stl->stats.type = fStlObject->stats.type;
+	stl->stats.number_of_facets = facets;
+	stl->stats.original_num_facets = facets;
+	memcpy(stl->stats.header, fStlObject->stats.header, sizeof(stl->stats.header));
+	stl_allocate(stl);
+
+	if (stl_get_error(stl)) {
+		stl_close(stl);
+		delete stl;
+		return fStlObject;
+	}
+
+	int32 facet = 0;
+	memcpy(stl->facet_start, fStlObject->facet_start,
+		fStlObject->stats.number_of_facets * sizeof(stl_facet));
+	facet += fStlObject->stats.number_of_facets;
+
+	for (size_t i = 0; i < fAppendedObjects.size(); i++) {
+		stl_file *source = fAppendedObjects[i].mesh->Stl();
+		glm::vec3 offset = fAppendedObjects[i].offset;
+		for (int32 j = 0; j < source->stats.number_of_facets; j++, facet++) {
+			stl->facet_start[facet] = source->facet_start[j];
+			for (int32 k = 0; k < 3; k++) {
+				stl->facet_start[facet].vertex[k].x += offset.x;
+				stl->facet_start[facet].vertex[k].y += offset.y;
+				stl->facet_start[facet].vertex[k].z += offset.z;
+			}
+		}
+	}
+
+	stl_get_size(stl);
+
+	return stl;
+}
+
+void
+STLWindow::ReleaseSceneSTL(stl_file *stl)
+{
+	if (stl == fStlObject)
+		return;
+
+	stl_close(stl);
+	delete stl;
+}
+
+void
+STLWindow::OpenFile(const char *filename)
+{	
+	CloseFile();
+
+	fOpenedFileName.SetTo(filename);
+	fStlLogoView->SetText(B_TRANSLATE("Loading" B_UTF8_ELLIPSIS));
+
+	fStlLoading = true;
+	fFileLoaderThread = spawn_thread(_FileLoaderFunction, "loaderThread", B_NORMAL_PRIORITY, (void*)this);
+	resume_thread(fFileLoaderThread);
+}
+
+void
+STLWindow::CloseFile(void)
+{
+	if (IsLoaded()) {
+		fStlLogoView->Show();
+		fStlView->Hide();
+
+		SetTitle(MAIN_WIN_TITLE);
+		fStlValid = false;
+		fHistory->Clear();
+
+		if (fSectionMode) {
+			if (fSectionWindow) {
+				fSectionWindow->Lock();
+				fSectionWindow->Quit();
+				fSectionWindow = NULL;
+			}
+			EndSection();
+		}
+
+		CloseHeatmaps();
+
+		delete fEdges;
+		fEdges = NULL;
+		fDefectIndex = -1;
+		fStlView->SetDefects(NULL);
+		fStlView->SetHull(NULL);
+		fStlView->SetSmoothNormals(NULL);
+		fSmoothValid = false;
+		fSnapValid = false;
 
-		stl_close(fStlObject);
-		delete fStlObject;
-		fStlObject = NULL;
+		fStlView->SetSTL(NULL);
+		fMesh->ReleaseReference();
+		SetSTL(NULL);
+		for (size_t i = 0; i < fAppendedObjects.size(); i++)
+			fAppendedObjects[i].mesh->ReleaseReference();
+		fAppendedObjects.clear();
 
 		fStlLogoView->SetText(B_TRANSLATE("Drop STL files here"));
 		fStlLogoView->SetTextColor(255, 255, 255);
@@ -1436,13 +3295,15 @@ void
 STLWindow::UpdateStats(void)
 {
 	bool isLoaded = IsLoaded();
-	if (isLoaded)
+	if (isLoaded && !fMesh->IsShared())
 		stl_calculate_volume(fStlObject);
 
 	BPath path(fOpenedFileName);
 	fStatView->SetTextValue("filename", isLoaded ? path.Leaf() : 0);
 	fStatView->SetTextValue("type", isLoaded ? (fStlObject->stats.type == binary ? B_TRANSLATE("Binary") : B_TRANSLATE("ASCII")) : "");
 	fStatView->SetTextValue("title", isLoaded ? fStlObject->stats.header : "");
+	fStatView->SetTextValue("fingerprint", isLoaded && fMesh->Parts() != NULL
+		? fMesh->Fingerprint().HashString().String() : "");
 
 	fStatView->SetFloatValue("min-x", isLoaded ? fStlObject->stats.min.x : 0);
 	fStatView->SetFloatValue("min-y", isLoaded ? fStlObject->stats.min.y : 0);
@@ -1454,7 +3315,16 @@ STLWindow::UpdateStats(void)
 	fStatView->SetFloatValue("length", isLoaded ? fStlObject->stats.size.y : 0);
 	fStatView->SetFloatValue("height", isLoaded ? fStlObject->stats.size.z : 0);
 	fStatView->SetFloatValue("volume", isLoaded ? fStlObject->stats.volume : 0, false);
+
+	// Zero until the hull is built, also for flat models that have none
+	STLHull *hull = isLoaded ? fMesh->Hull() : NULL;
+	bool hasHull = hull != NULL && hull->IsValid() && hull->Volume() > 0;
+	fStatView->SetFloatValue("hull_volume", hasHull ? hull->Volume() : 0, false);
+	fStatView->SetFloatValue("solidity", hasHull ? fabs(fStlObject->stats.volume) / hull->Volume() : 0, false);
 	fStatView->SetIntValue("num_facets", isLoaded ? fStlObject->stats.number_of_facets : 0);
+	STLParts *parts = isLoaded ? fMesh->Parts() : NULL;
+	fStatView->SetIntValue("components", parts != NULL ? parts->CountComponents() : 0);
+	fStatView->SetIntValue("unique_parts", parts != NULL ? parts->CountUnique() : 0);
 	fStatView->SetIntValue("num_disconnected_facets",
 		isLoaded ? (fStlObject->stats.facets_w_1_bad_edge + fStlObject->stats.facets_w_2_bad_edge +
 		fStlObject->stats.facets_w_3_bad_edge) : 0);
@@ -1476,38 +3346,44 @@ STLWindow::UpdateStats(void)
 }
 
 void
-STLWindow::TransformPosition()
+STLWindow::TransformPosition(stl_file *stl, float *zDepth, float *maxExtent)
 {
-	stl_translate(fStlObject, 0, 0, 0);
+	stl_translate(stl, 0, 0, 0);
 
 	float xMaxExtent = 0;
 	float yMaxExtent = 0;
 	float zMaxExtent = 0;
 
-	for (int i = 0 ; i < fStlObject->stats.number_of_facets ; i++) {
+	for (int i = 0 ; i < stl->stats.number_of_facets ; i++) {
 		for (int j = 0; j < 3; j++) {
-			if (fStlObject->facet_start[i].vertex[j].x > xMaxExtent)
-				xMaxExtent = fStlObject->facet_start[i].vertex[0].x;
-			if (fStlObject->facet_start[i].vertex[j].y > yMaxExtent)
-				yMaxExtent = fStlObject->facet_start[i].vertex[0].y;
-			if (fStlObject->facet_start[i].vertex[j].z > zMaxExtent)
-				zMaxExtent = fStlObject->facet_start[i].vertex[0].z;
+			if (stl->facet_start[i].vertex[j].x > xMaxExtent)
+				xMaxExtent = stl->facet_start[i].vertex[0].x;
+			if (stl->facet_start[i].vertex[j].y > yMaxExtent)
+				yMaxExtent = stl->facet_start[i].vertex[0].y;
+			if (stl->facet_start[i].vertex[j].z > zMaxExtent)
+				zMaxExtent = stl->facet_start[i].vertex[0].z;
 		}
 	}
 
-	float longerSide = xMaxExtent > yMaxExtent ? xMaxExtent : yMaxExtent;
-	longerSide += (zMaxExtent * (sin(FOV * (M_PI / 180.0)) / sin((90.0 - FOV) * (M_PI / 180.0))));
+	ViewExtent(xMaxExtent, yMaxExtent, zMaxExtent, zDepth, maxExtent);
+
+	stl_translate_relative(stl, -xMaxExtent / 2.0, -yMaxExtent / 2.0, -zMaxExtent / 2.0);
+}
 
-	fZDepth = -1.2 *((longerSide / 2.0) / tanf((FOV / 2.0) * (M_PI / 180.0)));
+void
+STLWindow::ViewExtent(float x, float y, float z, float *zDepth, float *maxExtent)
+{
+	float longerSide = x > y ? x : y;
+	longerSide += (z * (sin(FOV * (M_PI / 180.0)) / sin((90.0 - FOV) * (M_PI / 180.0))));
 
-	if ((xMaxExtent > yMaxExtent) && (xMaxExtent > zMaxExtent))
-    	fMaxExtent = xMaxExtent;
-	if ((yMaxExtent > xMaxExtent) && (yMaxExtent > zMaxExtent))
-		fMaxExtent = yMaxExtent;
-	if ((zMaxExtent > yMaxExtent) && (zMaxExtent > xMaxExtent))
-		fMaxExtent = zMaxExtent;
+	*zDepth = -1.2 *((longerSide / 2.0) / tanf((FOV / 2.0) * (M_PI / 180.0)));
 
-	stl_translate_relative(fStlObject, -xMaxExtent / 2.0, -yMaxExtent / 2.0, -zMaxExtent / 2.0);
+	if ((x > y) && (x > z))
+    	*maxExtent = x;
+	if ((y > x) && (y > z))
+		*maxExtent = y;
+	if ((z > y) && (z > x))
+		*maxExtent = z;
 }
 
 int32
@@ -1524,24 +3400,564 @@ STLWindow::_RenderFunction(void *data)
 	return 0;
 }
 
-int32
-STLWindow::_FileLoaderFunction(void *data)
+static stl_file*
+CreateBenchmarkMesh(int32 facets)
 {
-	STLWindow *window = (STLWindow*)data;
+	int32 cells = (int32)ceilf(sqrtf(facets / 2.0f));
+	float step = 100.0f / cells;
 
 	stl_file *stl = new stl_file;
-
-	stl_open(stl, (char*)window->Filename().String());
+	stl_initialize(stl);
+	stl->stats.type = binary;
+	stl->stats.number_of_facets = cells * cells * 2;
+	stl->stats.original_num_facets = stl->stats.number_of_facets;
+	stl_allocate(stl);
 
 	if (stl_get_error(stl)) {
-		window->SetSTL(NULL);
-		window->PostMessage(MSG_FILE_OPEN_FAILED);
+		stl_close(stl);
 		delete stl;
-	} else {
-		stl_fix_normal_values(stl);
-		window->SetSTL(stl);
+		return NULL;
+	}
+
+	auto height = [](float x, float y) {
+		return 5.0f * sinf(x * 0.2f) * cosf(y * 0.2f) + 10.0f;
+	};
+
+	int32 facet = 0;
+	for (int32 i = 0; i < cells; i++) {
+		for (int32 j = 0; j < cells; j++) {
+			float x0 = i * step, x1 = (i + 1) * step;
+			float y0 = j * step, y1 = (j + 1) * step;
+			stl_vertex v00 = {x0, y0, height(x0, y0)};
+			stl_vertex v10 = {x1, y0, height(x1, y0)};
+			stl_vertex v01 = {x0, y1, height(x0, y1)};
+			stl_vertex v11 = {x1, y1, height(x1, y1)};
+
+			stl_facet *first = &stl->facet_start[facet++];
+			first->vertex[0] = v00;
+			first->vertex[1] = v10;
+			first->vertex[2] = v11;
+
+			stl_facet *second = &stl->facet_start[facet++];
+			second->vertex[0] = v00;
+			second->vertex[1] = v11;
+			second->vertex[2] = v01;
+		}
+	}
+
+	for (int32 i = 0; i < stl->stats.number_of_facets; i++) {
+		float normal[3];
+		stl_calculate_normal(normal, &stl->facet_start[i]);
+		stl_normalize_vector(normal);
+		stl->facet_start[i].normal.x = normal[0];
+		stl->facet_start[i].normal.y = normal[1];
+		stl->facet_start[i].normal.z = normal[2];
+	}
+
+	stl_get_size(stl);
+
+	return stl;
+}
+
+int32
+STLWindow::_BenchmarkFunction(void *data)
+{
+	STLWindow *window = (STLWindow*)data;
+
+	const int32 triangles[] = { 1000000, 10000000 };
+	const int32 frames = 50;
+
+	printf("Wireframe benchmark, %" B_PRId32 " frames per mode, ms per frame\n", frames);
+	printf("%10s %10s %10s %10s %12s\n", "triangles", "solid", "GL_LINE", "wireframe", "solid+edges");
+
+	for (size_t i = 0; i < sizeof(triangles) / sizeof(triangles[0])
+			&& atomic_get(&window->fBenchmarkAbort) == 0; i++) {
+		stl_file *stl = CreateBenchmarkMesh(triangles[i]);
+		if (stl == NULL) {
+			printf("%10" B_PRId32 ": not enough memory\n", triangles[i]);
+			break;
+		}
+		int32 facets = stl->stats.number_of_facets;
+
+		// The benchmark keeps its own reference, closing the file from the
+		// window must not free the mesh under it
+		STLMesh *mesh = new STLMesh(stl);
+		mesh->AcquireReference();
+
+		if (!window->Lock()) {
+			mesh->ReleaseReference();
+			mesh->ReleaseReference();
+			break;
+		}
+		window->CloseFile();
+		window->fOpenedFileName.SetTo("Benchmark");
+		window->fStlLoading = true;
+		window->SetSTL(mesh);
 		window->PostMessage(MSG_FILE_OPENED);
+		window->Unlock();
+
+		// Given up when the window drops the mesh, stops the benchmark
+		// or takes too long
+		bool loaded = false;
+		bigtime_t deadline = system_time() + BENCHMARK_LOAD_TIMEOUT;
+		while (system_time() < deadline && atomic_get(&window->fBenchmarkAbort) == 0) {
+			if (!window->Lock())
+				break;
+			bool dropped = window->fMesh != mesh;
+			loaded = !dropped && window->IsLoaded();
+			window->Unlock();
+			if (loaded || dropped)
+				break;
+			snooze(10000);
+		}
+		if (!loaded) {
+			mesh->ReleaseReference();
+			break;
+		}
+
+		STLView *view = window->fStlView;
+		bigtime_t solid = view->Benchmark(MSG_VIEWMODE_SOLID, false, frames);
+		bigtime_t legacy = view->Benchmark(MSG_VIEWMODE_WIREFRAME, true, frames);
+		bigtime_t wireframe = view->Benchmark(MSG_VIEWMODE_WIREFRAME, false, frames);
+		bigtime_t edges = view->Benchmark(MSG_VIEWMODE_SOLID_EDGES, false, frames);
+		mesh->ReleaseReference();
+
+		if (solid < 0 || legacy < 0 || wireframe < 0 || edges < 0)
+			break;
+
+		printf("%10" B_PRId32 " %10.2f %10.2f %10.2f %12.2f\n", facets,
+			solid / 1000.0, legacy / 1000.0, wireframe / 1000.0, edges / 1000.0);
+	}
+
+	if (window->Lock()) {
+		window->fBenchmarkRunning = false;
+		if (atomic_get(&window->fBenchmarkAbort) != 0)
+			window->PostMessage(B_QUIT_REQUESTED);
+		window->Unlock();
 	}
 
 	return 0;
 }
+
+int32
+STLWindow::_ScreenshotFunction(void *data)
+{
+	STLWindow *window = (STLWindow*)data;
+
+	status_t status = window->fStlView->RenderTiled(window->fScreenshotPath.String(),
+		window->fScreenshotWidth, window->fScreenshotHeight);
+
+	if (status == B_OK) {
+		BNode node(window->fScreenshotPath.String());
+		BNodeInfo nodeInfo(&node);
+		nodeInfo.SetType("image/png");
+	} else {
+		BString alertText(B_TRANSLATE("Unable to save screenshot '%filename%': %error%"));
+		alertText.ReplaceFirst("%filename%", BPath(window->fScreenshotPath).Leaf());
+		alertText.ReplaceFirst("%error%", strerror(status));
+		BAlert *alert = new BAlert(B_TRANSLATE("Save screenshot"), alertText, B_TRANSLATE("OK"),
+			NULL, NULL, B_WIDTH_AS_USUAL, B_STOP_ALERT);
+		alert->Go(NULL);
+	}
+
+	if (window->Lock()) {
+		window->fScreenshotRunning = false;
+		window->UpdateUI();
+		window->Unlock();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_AppendLoaderFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	STLWindow *window = NULL;
+	request->FindPointer("window", (void**)&window);
+	const char *path = request->FindString("path");
+
+	STLMesh *mesh = STLMesh::Acquire(path);
+	if (mesh != NULL) {
+		BMessage message(MSG_FILE_APPENDED);
+		message.AddPointer("mesh", mesh);
+		if (window->PostMessage(&message) != B_OK)
+			mesh->ReleaseReference();
+	} else {
+		BMessage message(MSG_FILE_APPEND_FAILED);
+		message.AddString("path", path);
+		window->PostMessage(&message);
+	}
+
+	delete request;
+
+	return 0;
+}
+
+int32
+STLWindow::_ThicknessFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	delete request;
+
+	STLThickness *thickness = new STLThickness(mesh->Stl());
+
+	// The window may be gone by now, then the result is dropped here
+	BMessage message(MSG_TOOLS_THICKNESS_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("thickness", thickness);
+	if (target.SendMessage(&message) != B_OK) {
+		delete thickness;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_IntersectionsFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	delete request;
+
+	STLIntersections *intersections = new STLIntersections(mesh->Stl());
+
+	BMessage message(MSG_TOOLS_INTERSECTIONS_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("intersections", intersections);
+	if (target.SendMessage(&message) != B_OK) {
+		delete intersections;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_CompareFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	int32 revision = request->FindInt32("revision");
+	BString path = request->FindString("path");
+	bool align = request->FindBool("align");
+	delete request;
+
+	// A missing reference comes back without a result. Edited meshes are
+	// out of the registry, so getting the mesh itself back means the window
+	// shows the reference file as it is on disk.
+	STLMesh *reference = STLMesh::Acquire(path.String());
+	STLCompare *compare = NULL;
+	if (reference != NULL && reference != mesh) {
+		stl_file *stl = mesh->Stl();
+		stl_file *referenceStl = reference->Stl();
+		glm::vec3 offset = reference->Shift() - mesh->Shift();
+		if (align) {
+			offset = glm::vec3(referenceStl->stats.min.x - stl->stats.min.x,
+				referenceStl->stats.min.y - stl->stats.min.y,
+				referenceStl->stats.min.z - stl->stats.min.z);
+		}
+		compare = new STLCompare(stl, referenceStl, offset);
+	}
+
+	BMessage message(MSG_TOOLS_COMPARE_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddInt32("revision", revision);
+	message.AddPointer("reference", reference);
+	message.AddPointer("compare", compare);
+	message.AddString("path", path);
+	message.AddBool("align", align);
+	if (target.SendMessage(&message) != B_OK) {
+		delete compare;
+		if (reference != NULL)
+			reference->ReleaseReference();
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_EdgesFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	delete request;
+
+	STLEdges *edges = new STLEdges(mesh->Stl());
+
+	BMessage message(MSG_VIEWMODE_DEFECTS_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("edges", edges);
+	if (target.SendMessage(&message) != B_OK) {
+		delete edges;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_HullFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	int32 revision = -1;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	request->FindInt32("revision", &revision);
+	delete request;
+
+	STLHull *hull = new STLHull(mesh->Stl());
+
+	BMessage message(MSG_VIEWMODE_HULL_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("hull", hull);
+	message.AddInt32("revision", revision);
+	if (target.SendMessage(&message) != B_OK) {
+		delete hull;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_PartsFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	int32 revision = -1;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	request->FindInt32("revision", &revision);
+	delete request;
+
+	STLParts *parts = new STLParts(mesh->Stl());
+	STLFingerprint *fingerprint = new STLFingerprint(mesh->Stl());
+
+	BMessage message(MSG_VIEWMODE_PARTS_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("parts", parts);
+	message.AddPointer("fingerprint", fingerprint);
+	message.AddInt32("revision", revision);
+	if (target.SendMessage(&message) != B_OK) {
+		delete parts;
+		delete fingerprint;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_CurvatureFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	int32 revision = -1;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	request->FindInt32("revision", &revision);
+	delete request;
+
+	// The weld is shared with the smooth normals of the same revision
+	STLWeld *weld = mesh->TakeWeld(revision);
+	if (weld == NULL)
+		weld = new STLWeld(mesh->Stl());
+	STLCurvature *curvature = new STLCurvature(mesh->Stl(), *weld);
+	mesh->SetWeld(weld, revision);
+
+	BMessage message(MSG_TOOLS_CURVATURE_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("curvature", curvature);
+	message.AddInt32("revision", revision);
+	if (target.SendMessage(&message) != B_OK) {
+		delete curvature;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_SmoothNormalsFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	int32 revision = -1;
+	float angle = 0.0f;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	request->FindInt32("revision", &revision);
+	request->FindFloat("angle", &angle);
+	delete request;
+
+	// Moving the crease slider only redoes the averaging, the weld is
+	// built once per revision
+	STLWeld *weld = mesh->TakeWeld(revision);
+	if (weld == NULL)
+		weld = new STLWeld(mesh->Stl());
+	STLNormals *normals = new STLNormals(mesh->Stl(), *weld, angle);
+	mesh->SetWeld(weld, revision);
+
+	BMessage message(MSG_VIEWMODE_SMOOTH_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("normals", normals);
+	message.AddInt32("revision", revision);
+	if (target.SendMessage(&message) != B_OK) {
+		delete normals;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_SnapIndexFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	int32 revision = -1;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	request->FindInt32("revision", &revision);
+
+	std::vector<SnapObject> objects;
+	std::vector<STLMesh*> appended;
+	objects.push_back({mesh->Stl(), glm::mat4(1.0f)});
+	STLMesh *object = NULL;
+	const void *offset = NULL;
+	ssize_t size;
+	for (int32 i = 0; request->FindPointer("object", i, (void**)&object) == B_OK
+		&& request->FindData("offset", B_RAW_TYPE, i, &offset, &size) == B_OK; i++) {
+		objects.push_back({object->Stl(), glm::translate(glm::mat4(1.0f), *(const glm::vec3*)offset)});
+		appended.push_back(object);
+	}
+	int32 count = request->FindInt32("objects");
+	delete request;
+
+	STLSnapIndex *index = new STLSnapIndex(objects);
+	for (size_t i = 0; i < appended.size(); i++)
+		appended[i]->ReleaseReference();
+
+	BMessage message(MSG_TOOLS_MEASURE_INDEX_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("index", index);
+	message.AddInt32("revision", revision);
+	message.AddInt32("objects", count);
+	if (target.SendMessage(&message) != B_OK) {
+		delete index;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_OrientFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	STLMesh *mesh = NULL;
+	STLHull *hull = NULL;
+	int32 revision = -1;
+	int32 goal = ORIENT_HEIGHT;
+	float angle = 45.0f;
+	request->FindMessenger("target", &target);
+	request->FindPointer("mesh", (void**)&mesh);
+	request->FindPointer("hull", (void**)&hull);
+	request->FindInt32("revision", &revision);
+	request->FindInt32("goal", &goal);
+	request->FindFloat("angle", &angle);
+	delete request;
+
+	STLAutoOrient *orient = new STLAutoOrient(mesh->Stl(), hull, goal, angle);
+	delete hull;
+
+	BMessage message(MSG_TOOLS_ORIENT_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("orient", orient);
+	message.AddInt32("revision", revision);
+	if (target.SendMessage(&message) != B_OK) {
+		delete orient;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_RepairFunction(void *data)
+{
+	BMessage *request = (BMessage*)data;
+	BMessenger target;
+	BMessenger progress;
+	STLMesh *mesh = NULL;
+	int32 *cancel = NULL;
+	int32 revision = -1;
+	request->FindMessenger("target", &target);
+	request->FindMessenger("progress", &progress);
+	request->FindPointer("mesh", (void**)&mesh);
+	request->FindPointer("cancel", (void**)&cancel);
+	request->FindInt32("revision", &revision);
+	STLRepair repair(request);
+	delete request;
+
+	// The window keeps showing and editing its mesh, the repair works on
+	// a snapshot
+	STLMesh *result = mesh->Copy();
+	if (result != NULL && repair.Run(result->Stl(), progress, MSG_TOOLS_REPAIR_PROGRESS, cancel) != B_OK) {
+		result->ReleaseReference();
+		result = NULL;
+	}
+
+	BMessage message(MSG_TOOLS_REPAIR_DONE);
+	message.AddPointer("mesh", mesh);
+	message.AddPointer("result", result);
+	message.AddPointer("cancel", cancel);
+	message.AddInt32("revision", revision);
+	if (target.SendMessage(&message) != B_OK) {
+		if (result != NULL)
+			result->ReleaseReference();
+		delete cancel;
+		mesh->ReleaseReference();
+	}
+
+	return 0;
+}
+
+int32
+STLWindow::_FileLoaderFunction(void *data)
+{
+	STLWindow *window = (STLWindow*)data;
+
+	STLMesh *mesh = STLMesh::Acquire(window->Filename().String());
+
+	window->SetSTL(mesh);
+	if (mesh == NULL)
+		window->PostMessage(MSG_FILE_OPEN_FAILED);
+	else
+		window->PostMessage(MSG_FILE_OPENED);
+
+	return 0;
+}
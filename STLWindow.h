@@ -38,12 +38,25 @@
 
 #include <admesh/stl.h>
 
+#include <vector>
+#include <glm/glm.hpp>
+
 class STLView;
+class STLMesh;
+class STLSection;
+class STLOverhang;
+class STLThickness;
+class STLEdges;
+class STLCompare;
+class STLIntersections;
 class STLLogoView;
 class STLStatView;
 class STLStatWindow;
 class STLInputWindow;
+class STLRepairWindow;
 class STLToolBar;
+class STLHistory;
+class STLTransform;
 
 class STLWindow : public BWindow {
 	public:
@@ -53,11 +66,40 @@ class STLWindow : public BWindow {
 		virtual void MessageReceived(BMessage *message);
 		virtual bool QuitRequested();
 
-		void SetSTL(stl_file *stl);
+		void SetSTL(STLMesh *mesh);
+		void DetachMesh(void);
+		void TransformMesh(const STLTransform &transform, bool join = false);
+		void MeshChanged(void);
+		void UpdateSection(float height);
+		void EndSection(void);
+		void UpdateOverhang(float angle);
+		void EndOverhang(void);
+		void StartThickness(void);
+		void UpdateThickness(float limit);
+		void EndThickness(void);
+		void StartIntersections(void);
+		void EndIntersections(void);
+		void StartCompare(void);
+		void UpdateCompare(float tolerance);
+		void EndCompare(void);
+		void StartCurvature(void);
+		void ShowCurvature(void);
+		void UpdateCurvature(float radius);
+		void EndCurvature(void);
+		void StartEdges(void);
+		void StartHull(void);
+		void StartParts(void);
+		void StartOrient(int32 goal);
+		void StartRepair(BMessage *options);
+		void StartSmoothNormals(void);
+		void StartSnapIndex(void);
+		void NextDefect(void);
+		void AppendFile(const char *file);
 		void OpenFile(const char *file);
 		void CloseFile(void);
 		void UpdateStats(void);
-		void TransformPosition(void);
+		static void TransformPosition(stl_file *stl, float *zDepth, float *maxExtent);
+		static void ViewExtent(float x, float y, float z, float *zDepth, float *maxExtent);
 
 		int GetErrorTimer(void) { return fErrorTimeCounter; }
 		float GetBigExtent(void) { return fMaxExtent; }
@@ -71,11 +113,30 @@ class STLWindow : public BWindow {
 
 		static int32 _RenderFunction(void *data);
 		static int32 _FileLoaderFunction(void *data);
+		static int32 _AppendLoaderFunction(void *data);
+		static int32 _BenchmarkFunction(void *data);
+		static int32 _ScreenshotFunction(void *data);
+		static int32 _ThicknessFunction(void *data);
+		static int32 _IntersectionsFunction(void *data);
+		static int32 _CompareFunction(void *data);
+		static int32 _CurvatureFunction(void *data);
+		static int32 _EdgesFunction(void *data);
+		static int32 _HullFunction(void *data);
+		static int32 _PartsFunction(void *data);
+		static int32 _OrientFunction(void *data);
+		static int32 _RepairFunction(void *data);
+		static int32 _SmoothNormalsFunction(void *data);
+		static int32 _SnapIndexFunction(void *data);
 
 	private:
 		void UpdateUIStates(bool show);
+		void CloseHeatmaps(void);
 		void LoadSettings(void);
 		void SaveSettings(void);
+		void AddObject(STLMesh *mesh);
+		void SceneBounds(float *minX, float *minY, float *minZ, float *maxX, float *maxY, float *maxZ);
+		stl_file* SceneSTL(bool copy = false);
+		void ReleaseSceneSTL(stl_file *stl);
 	
 		thread_id fRendererThread;
 		thread_id fFileLoaderThread;
@@ -83,21 +144,33 @@ class STLWindow : public BWindow {
 		BMenuBar *fMenuBar;
 		BMenu *fMenuFile;
 		BMenu *fMenuFileSaveAs;
+		BMenu *fMenuEdit;
 		BMenu *fMenuView;
 		BMenu *fMenuTools;
 		BMenu *fMenuToolsMirror;
 		BMenu *fMenuToolsScale;
 		BMenu *fMenuToolsMove;
+		BMenu *fMenuToolsOrient;
+		BMenu *fMenuToolsCurvature;
 		BMenu *fMenuHelp;
 		BMenu *fMenuAxes;
 		BMenuItem *fMenuItemOpen;
 		BMenuItem *fMenuItemReload;
+		BMenuItem *fMenuItemAppend;
 		BMenuItem *fMenuItemClose;
 		BMenuItem *fMenuItemSave;
+		BMenuItem *fMenuItemScreenshot;
 		BMenuItem *fMenuItemPoints;
 		BMenuItem *fMenuItemWireframe;
 		BMenuItem *fMenuItemSolid;
+		BMenuItem *fMenuItemSolidEdges;
 		BMenuItem *fMenuItemShowBox;
+		BMenuItem *fMenuItemShowDefects;
+		BMenuItem *fMenuItemNextDefect;
+		BMenuItem *fMenuItemShowHull;
+		BMenuItem *fMenuItemShowMinimumBox;
+		BMenuItem *fMenuItemSmoothShading;
+		BMenuItem *fMenuItemCreaseAngle;
 		BMenuItem *fMenuItemShowAxes;
 		BMenuItem *fMenuItemShowAxesPlane;
 		BMenuItem *fMenuItemShowAxesCompass;
@@ -105,10 +178,17 @@ class STLWindow : public BWindow {
 		BMenuItem *fMenuItemOrthographicView;
 		BMenuItem *fMenuItemStat;
 		BMenuItem *fMenuItemReset;
+		BMenuItem *fMenuItemUndo;
+		BMenuItem *fMenuItemRedo;
 		BMenuItem *fMenuItemEditTitle;
 		BMenuItem *fMenuItemRotate;
 		BMenuItem *fMenuItemRepair;
 		BMenuItem *fMenuItemMeasure;
+		BMenuItem *fMenuItemSection;
+		BMenuItem *fMenuItemOverhang;
+		BMenuItem *fMenuItemThickness;
+		BMenuItem *fMenuItemIntersections;
+		BMenuItem *fMenuItemCompare;
 		BFilePanel *fOpenFilePanel;
 		BFilePanel *fSaveFilePanel;
 
@@ -120,6 +200,14 @@ class STLWindow : public BWindow {
 		STLToolBar *fViewToolBar;
 		STLStatView *fStatView;
 		STLInputWindow *fMeasureWindow;
+		STLInputWindow *fSectionWindow;
+		STLInputWindow *fOverhangWindow;
+		STLInputWindow *fThicknessWindow;
+		STLInputWindow *fIntersectionsWindow;
+		STLInputWindow *fCompareWindow;
+		STLInputWindow *fCurvatureWindow;
+		STLInputWindow *fCreaseWindow;
+		STLRepairWindow *fRepairWindow;
 
 		bool fRenderWork;
 
@@ -132,8 +220,38 @@ class STLWindow : public BWindow {
 		bool fShowAxesPlane;
 		bool fShowAxesCompass;
 		bool fShowOXY;
+		bool fShowDefects;
+		bool fShowHull;
+		bool fShowMinimumBox;
+		bool fSmoothShading;
+		bool fSmoothRunning;
+		bool fSmoothValid;
 		bool fViewOrtho;
 		bool fMeasureMode;
+		bool fSnapRunning;
+		bool fSnapValid;
+		bool fSectionMode;
+		bool fOverhangMode;
+		bool fThicknessMode;
+		bool fThicknessRunning;
+		bool fIntersectionsMode;
+		bool fIntersectionsRunning;
+		bool fCompareMode;
+		bool fCompareRunning;
+		bool fCurvatureMode;
+		bool fCurvatureRunning;
+		bool fEdgesRunning;
+		bool fHullRunning;
+		bool fPartsRunning;
+		bool fOrientRunning;
+		bool fRepairRunning;
+		int32 *fRepairCancel;
+		bool fBenchmarkRunning;
+		int32 fBenchmarkAbort;
+		bool fScreenshotRunning;
+		int32 fScreenshotWidth;
+		int32 fScreenshotHeight;
+		BString fScreenshotPath;
 
 		int32 fExactFlag;
 		int32 fNearbyFlag;
@@ -151,6 +269,30 @@ class STLWindow : public BWindow {
 		float fMaxExtent;
 
 		stl_file *fStlObject;
+		STLMesh *fMesh;
+		STLSection *fSection;
+		STLOverhang *fOverhang;
+		float fOverhangAngle;
+		STLThickness *fThickness;
+		float fThicknessLimit;
+		STLIntersections *fIntersections;
+		STLCompare *fCompare;
+		STLMesh *fCompareReference;
+		BString fComparePath;
+		float fCompareTolerance;
+		bool fCompareAlign;
+		int32 fCurvatureType;
+		float fCurvatureRadius;
+		float fCreaseAngle;
+		STLEdges *fEdges;
+		int32 fDefectIndex;
+		STLHistory *fHistory;
+
+		struct AppendedObject {
+			STLMesh *mesh;
+			glm::vec3 offset;
+		};
+		std::vector<AppendedObject> fAppendedObjects;
 };
 
 #endif
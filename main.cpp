@@ -17,9 +17,26 @@
  */
 
 #include "STLApp.h"
+#include "STLThumbnailer.h"
+#include "STLDuplicateFinder.h"
 
-int main(int, char *argv[])
+#include <string.h>
+
+int main(int argc, char *argv[])
 {
+	if (argc > 1 && strcmp(argv[1], "--thumbnails") == 0) {
+		STLThumbnailer *thumbnailer = new STLThumbnailer(argc, argv);
+		thumbnailer->Run();
+		int32 result = thumbnailer->Result();
+		delete thumbnailer;
+		return result;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--find-duplicates") == 0) {
+		STLDuplicateFinder finder(argc, argv);
+		return finder.Run();
+	}
+
 	STLoverApplication *app = new STLoverApplication();
 	app->Run();
 }